@@ -0,0 +1,84 @@
+#version 150
+
+// Temporal anti-aliasing resolve. The current (jittered) frame is blended with the history, which is reprojected with the velocity
+// buffer (in pixels) and clipped to the color range of the current 3x3 neighborhood in YCoCg to reject stale samples.
+// References:
+// - Karis, "High Quality Temporal Supersampling", SIGGRAPH 2014
+// - Pedersen, "Temporal Reprojection Anti-Aliasing in INSIDE", GDC 2016
+
+uniform sampler2D uTexColor;
+uniform sampler2D uTexHistory;
+uniform sampler2D uTexVelocity;
+
+uniform float uFeedbackMin;		// history weight where the current frame differs most from it
+uniform float uFeedbackMax;		// history weight where they agree
+uniform bool uHistoryValid;
+uniform vec2 uRenderScale = vec2( 1.0 );	// rendered part of the velocity buffer, when the scene is upscaled before the resolve
+
+in vec2	vTexCoord;
+out vec4 oFragColor;
+
+vec3 rgbToYCoCg( vec3 c )
+{
+	return vec3( 0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b );
+}
+
+vec3 yCoCgToRgb( vec3 c )
+{
+	return vec3( c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z );
+}
+
+// clips towards the center of the box rather than clamping per channel, which keeps the hue of the history
+vec3 clipAabb( vec3 boxMin, vec3 boxMax, vec3 history )
+{
+	vec3 center = 0.5 * ( boxMax + boxMin );
+	vec3 extents = 0.5 * ( boxMax - boxMin ) + 0.0001;
+	vec3 offset = history - center;
+	vec3 units = abs( offset / extents );
+	float maxUnit = max( units.x, max( units.y, units.z ) );
+	return maxUnit > 1.0 ? center + offset / maxUnit : history;
+}
+
+void main()
+{
+	ivec2 size = textureSize( uTexColor, 0 );
+	ivec2 velocitySize = textureSize( uTexVelocity, 0 );
+	ivec2 coord = ivec2( gl_FragCoord.xy );
+	vec4 current = texelFetch( uTexColor, coord, 0 );
+	vec3 currentYCoCg = rgbToYCoCg( current.rgb );
+
+	// neighborhood color range, and the longest velocity around the pixel so that edges of moving objects reproject with them
+	vec3 boxMin = currentYCoCg;
+	vec3 boxMax = currentYCoCg;
+	vec2 velocity = vec2( 0.0 );
+	for( int y = -1; y <= 1; y++ ) {
+		for( int x = -1; x <= 1; x++ ) {
+			ivec2 neighborCoord = clamp( coord + ivec2( x, y ), ivec2( 0 ), size - 1 );
+			vec3 neighbor = rgbToYCoCg( texelFetch( uTexColor, neighborCoord, 0 ).rgb );
+			boxMin = min( boxMin, neighbor );
+			boxMax = max( boxMax, neighbor );
+
+			ivec2 velocityCoord = min( ivec2( ( vec2( neighborCoord ) + 0.5 ) * uRenderScale ), velocitySize - 1 );
+			vec2 v = texelFetch( uTexVelocity, velocityCoord, 0 ).rg / uRenderScale;
+			if( dot( v, v ) > dot( velocity, velocity ) )
+				velocity = v;
+		}
+	}
+
+	vec2 prevCoord = vTexCoord - velocity / vec2( size );
+	if( ! uHistoryValid || any( lessThan( prevCoord, vec2( 0.0 ) ) ) || any( greaterThan( prevCoord, vec2( 1.0 ) ) ) ) {
+		oFragColor = current;
+		return;
+	}
+
+	vec3 history = clipAabb( boxMin, boxMax, rgbToYCoCg( texture( uTexHistory, prevCoord ).rgb ) );
+
+	// trust the history less where its luminance differs from the current frame, which reduces ghosting
+	float lumaCurrent = currentYCoCg.x;
+	float lumaHistory = history.x;
+	float difference = abs( lumaCurrent - lumaHistory ) / max( lumaCurrent, max( lumaHistory, 0.2 ) );
+	float weight = 1.0 - difference;
+	float feedback = mix( uFeedbackMin, uFeedbackMax, weight * weight );
+
+	oFragColor = vec4( yCoCgToRgb( mix( currentYCoCg, history, feedback ) ), current.a );
+}
@@ -0,0 +1,25 @@
+#version 150
+
+uniform sampler2D uMagTex;		// one STFT frame per row, linear magnitudes in red. Live views use it as a ring buffer
+uniform sampler2D uLutTex;		// color lookup, indexed by normalized decibels along x
+uniform float	uRowOffset;		// normalized row of the oldest frame
+uniform float	uRowScale;		// fraction of rows that hold frames
+
+in vec2	vTexCoord;
+
+out vec4 oFragColor;
+
+// same as ci::audio::linearToDecibel() / 100
+float linearToDecibelNormalized( float gain )
+{
+	return gain < 1e-5 ? 0.0 : ( 20.0 * log( gain ) / log( 10.0 ) + 100.0 ) / 100.0;
+}
+
+void main()
+{
+	// time runs along x, frequency along y with the highest bin at the top
+	float row = fract( uRowOffset + vTexCoord.x * uRowScale );
+	float mag = texture( uMagTex, vec2( vTexCoord.y, row ) ).r;
+
+	oFragColor = texture( uLutTex, vec2( clamp( linearToDecibelNormalized( mag ), 0.0, 1.0 ), 0.5 ) );
+}
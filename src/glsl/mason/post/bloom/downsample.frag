@@ -0,0 +1,53 @@
+#version 150
+
+// Dual filter downsample (Bjorge, "Bandwidth-Efficient Rendering", SIGGRAPH 2015). The first level also applies the threshold.
+
+uniform sampler2D uTexColor;
+uniform vec2 uHalfTexel;	// half a texel of uTexColor
+uniform vec2 uCoordMax = vec2( 1.0 );	// center of the last texel of uTexColor within the render size, taps are clamped to it
+
+#if defined( PREFILTER )
+uniform float uThreshold;	// brightness where bloom starts, 0 passes colors through unchanged
+uniform float uKnee;		// width of the soft transition below uThreshold as a fraction of it, 0 is a hard cut-off
+#endif
+
+in vec2	vTexCoord;
+out vec4 oFragColor;
+
+#if defined( PREFILTER )
+// quadratic soft knee, blends from no bloom at uThreshold - knee to linear above uThreshold. The knee is relative to the
+// threshold so it never reaches below zero, where it would boost dim colors.
+vec3 prefilter( vec3 color )
+{
+	if( uThreshold <= 0.0 )
+		return color;
+
+	float knee = uThreshold * uKnee;
+	float brightness = max( color.r, max( color.g, color.b ) );
+	float soft = clamp( brightness - uThreshold + knee, 0.0, 2.0 * knee );
+	soft = soft * soft * 0.25 / max( knee, 1e-5 );
+	float contribution = max( soft, brightness - uThreshold ) / max( brightness, 1e-5 );
+	return color * contribution;
+}
+#endif
+
+vec3 tap( vec2 coord )
+{
+	return texture( uTexColor, min( coord, uCoordMax ) ).rgb;
+}
+
+void main()
+{
+	vec3 sum = tap( vTexCoord ) * 4.0;
+	sum += tap( vTexCoord - uHalfTexel );
+	sum += tap( vTexCoord + uHalfTexel );
+	sum += tap( vTexCoord + vec2( uHalfTexel.x, -uHalfTexel.y ) );
+	sum += tap( vTexCoord - vec2( uHalfTexel.x, -uHalfTexel.y ) );
+
+	vec3 color = sum / 8.0;
+#if defined( PREFILTER )
+	color = prefilter( color );
+#endif
+
+	oFragColor = vec4( color, 1.0 );
+}
@@ -0,0 +1,32 @@
+#version 150
+
+// Dual filter upsample (Bjorge, "Bandwidth-Efficient Rendering", SIGGRAPH 2015), added to the downsampled level of the same size.
+
+uniform sampler2D uTexLower;	// the previous, half resolution upsample level
+uniform sampler2D uTexColor;	// the downsample level at this resolution
+uniform vec2 uHalfTexel;		// half a texel of uTexLower
+uniform vec2 uCoordMax = vec2( 1.0 );	// center of the last texel of uTexLower within the render size, taps are clamped to it
+uniform float uScale = 1.0;		// scales the result, the last level applies the bloom intensity
+
+in vec2	vTexCoord;
+out vec4 oFragColor;
+
+vec3 tap( vec2 coord )
+{
+	return texture( uTexLower, min( coord, uCoordMax ) ).rgb;
+}
+
+void main()
+{
+	vec3 sum = tap( vTexCoord + vec2( -uHalfTexel.x * 2.0, 0.0 ) );
+	sum += tap( vTexCoord + vec2( uHalfTexel.x * 2.0, 0.0 ) );
+	sum += tap( vTexCoord + vec2( 0.0, -uHalfTexel.y * 2.0 ) );
+	sum += tap( vTexCoord + vec2( 0.0, uHalfTexel.y * 2.0 ) );
+	sum += tap( vTexCoord + vec2( -uHalfTexel.x, uHalfTexel.y ) ) * 2.0;
+	sum += tap( vTexCoord + vec2( uHalfTexel.x, uHalfTexel.y ) ) * 2.0;
+	sum += tap( vTexCoord + vec2( uHalfTexel.x, -uHalfTexel.y ) ) * 2.0;
+	sum += tap( vTexCoord + vec2( -uHalfTexel.x, -uHalfTexel.y ) ) * 2.0;
+
+	vec3 color = sum / 12.0 + texture( uTexColor, vTexCoord ).rgb;
+	oFragColor = vec4( color * uScale, 1.0 );
+}
@@ -1,5 +1,11 @@
-// Old postprocess shader that was trying to combine DoF and fog in a single pass
-// Currently defunct.
+// Composites the scene with the results of the post effects. Features are compiled in with defines generated from
+// PostProcess::Options, so each combination is its own variant:
+// - BLOOM_ENABLED: adds uTexGlow
+// - TONE_MAP_ENABLED: filmic tone mapping with uExposure
+// - GAMMA_ENABLED: gamma correction
+// - LUT_ENABLED: color grading with uTexLut, a strip of N slices of N x N texels along x, blue increasing by slice
+// - SHARPEN_ENABLED: contrast adaptive sharpening while upscaling from the rendered part of the scene buffers
+// - FXAA_ENABLED: anti-aliases in this pass, compositing each tap, when the result is drawn straight to the output
 
 #version 400
 
@@ -14,128 +20,183 @@
 #define AA_TYPE AA_NONE // disabled
 #endif
 
-uniform mat4 uProjectionMatrixInverse;
-
 uniform sampler2D uTexColor;
 uniform sampler2D uTexDepth;
 uniform sampler2D uTexGlow;
 uniform sampler2D uTexVelocity;
+uniform sampler2D uTexLut;
 
-uniform vec2 uProjectionParams; // needed to compute linear depth
+uniform vec2 uRenderScale = vec2( 1.0 ); // part of the scene buffers that was rendered to, less than one with dynamic resolution
 
 in vec2	vTexCoord;
 out vec4 oFragColor;
 
 uniform float uExposure = 1.0; // hud: "tone-mapping exposure", step = 0.02
 
-uniform bool uFogEnabled = false;
-float fogDensity = 0.000002;
-float distStart = 20.0;
-float distRange = 300.0;
-uniform vec3 fogColor = vec3( 0.1, 0.25, 0.35 );
-//vec3 fogColor = vec3( 0 );
-
-float getLinearDepth( float depth )
-{
-  return uProjectionParams.y / ( depth - uProjectionParams.x );
-}
+vec2 gTexelSize;
+vec2 gCoordMax;
 
-float getGBufferLinearDepth( vec2 uv )
+// scene color with the glow added, in linear HDR
+vec4 sampleScene( vec2 coord )
 {
-	vec4 gbufferDepthSample = texture( uTexDepth, uv );
-	return getLinearDepth( gbufferDepthSample.r );
-}
+	vec4 col = texture( uTexColor, coord );
 
-vec3 getGBufferPosition( vec2 uv )
-{
-    vec4 posProj = vec4( ( uv.x - 0.5 ) * 2.0, ( uv.y - 0.5 ) * 2.0, 0.0, 1.0 );
-    vec3 viewRay = ( uProjectionMatrixInverse * posProj ).xyz;
-    return viewRay * getGBufferLinearDepth( uv );
-}
+#if defined( BLOOM_ENABLED )
+	col.rgb += texture( uTexGlow, coord ).rgb;
+#endif
 
-// http://www.iquilezles.org/www/articles/fog/fog.htm
-vec3 applyFog( in vec3 sceneColor, in vec3 fogColor, in float dist )
-{
-	float fog = exp( - fogDensity * dist * dist );
-	return mix( fogColor, sceneColor, fog );
+	return col;
 }
 
+#if defined( SHARPEN_ENABLED )
+uniform float uSharpness = 0.5; // hud: "upscale sharpness", min = 0, max = 1
 
-vec4 calcBlurredColor( vec2 coord )
+// Contrast adaptive sharpening, after AMD FidelityFX CAS. Sharpens less where the neighborhood already has a high contrast,
+// so edges don't ring. The scene is HDR, so the amount only depends on the ratio of the neighborhood's min and max.
+vec4 sampleSharpened( vec2 coord )
 {
-	 const int numSamples = 40;
-	 vec2 vel = texture( uTexVelocity, coord ).xy;
+	vec4 center = texture( uTexColor, coord );
+	vec3 n = texture( uTexColor, min( coord + vec2( 0.0, gTexelSize.y ), gCoordMax ) ).rgb;
+	vec3 s = texture( uTexColor, coord - vec2( 0.0, gTexelSize.y ) ).rgb;
+	vec3 e = texture( uTexColor, min( coord + vec2( gTexelSize.x, 0.0 ), gCoordMax ) ).rgb;
+	vec3 w = texture( uTexColor, coord - vec2( gTexelSize.x, 0.0 ) ).rgb;
 
-	 // TODO: this looks good around 20 for the objects in the scene, but that looks horrible for the camera motion blur
-	 vel *= 1.5;
+	vec3 minRgb = min( center.rgb, min( min( n, s ), min( e, w ) ) );
+	vec3 maxRgb = max( center.rgb, max( max( n, s ), max( e, w ) ) );
+	vec3 amount = sqrt( clamp( minRgb / max( maxRgb, vec3( 0.0001 ) ), 0.0, 1.0 ) );
+	vec3 weight = -amount * mix( 0.125, 0.2, uSharpness );
 
-	 vec4 col = texture( uTexColor, coord );
-	 for( int i = 1; i < numSamples; i++ ) {
-	 	vec2 offset = vel * ( float(i) / float( numSamples - 1 ) - 0.5 );
-	 	col += texture( uTexColor, coord + offset );
-	 }
-	 col /= float( numSamples );
+	vec4 col = vec4( ( center.rgb + weight * ( n + s + e + w ) ) / ( 1.0 + 4.0 * weight ), center.a );
+	col.rgb = max( col.rgb, vec3( 0.0 ) );
 
-	 return col;
+#if defined( BLOOM_ENABLED )
+	col.rgb += texture( uTexGlow, coord ).rgb;
+#endif
+
+	return col;
 }
+#endif
 
-void main()
+#if defined( LUT_ENABLED )
+vec3 applyLut( vec3 col )
 {
-	vec2 coord = vTexCoord;
+	vec2 lutSize = vec2( textureSize( uTexLut, 0 ) );
+	float n = lutSize.y;
+	vec3 c = clamp( col, 0.0, 1.0 ) * ( n - 1.0 );
+
+	// blend between the two nearest blue slices, red and green are filtered by the sampler. Images are flipped on load, so green
+	// increasing down the strip runs towards v = 0
+	float slice0 = floor( c.b );
+	float slice1 = min( slice0 + 1.0, n - 1.0 );
+	float v = 1.0 - ( c.g + 0.5 ) / n;
+	vec3 col0 = texture( uTexLut, vec2( ( slice0 * n + c.r + 0.5 ) / lutSize.x, v ) ).rgb;
+	vec3 col1 = texture( uTexLut, vec2( ( slice1 * n + c.r + 0.5 ) / lutSize.x, v ) ).rgb;
+
+	return mix( col0, col1, c.b - slice0 );
+}
+#endif
 
-	// FIXME: why is there nothing in the blue channel?
-	// .. ok now it's working :/
-	#if 0
-		oFragColor = texture( uTexColor, coord );
-		// oFragColor.b = 1.0; // this has no effect either
-		// oFragColor.a = 1.0;
-		return;
-	#endif
+// maps linear HDR to the display
+vec3 grade( vec3 col )
+{
+#if defined( TONE_MAP_ENABLED )
+	// disabled if uExposure <= 0
+	if( uExposure > 0 ) {
+		col = toneMap( col, uExposure );
+	}
+#endif
 
-	float dist = length( getGBufferPosition( coord ) );
+#if defined( GAMMA_ENABLED )
+	col = pow( clamp( col, 0.0, 1.0 ), vec3( 1.0 / 2.2 ) );
+#endif
 
-	//float distAdjusted = dist - distStart;
-	float distAdjusted = dist;
+#if defined( LUT_ENABLED )
+	col = applyLut( col );
+#endif
 
-	vec4 col = vec4( 0 );
+	return col;
+}
 
-	col = texture( uTexColor, coord );
+const vec3 luminance = vec3( 0.299, 0.587, 0.114 );
 
-	// vec3 fogColor = texture( uTexBackground, coord ).rgb;
+#if defined( FXAA_ENABLED )
+#define FXAA_SPAN_MAX 8.0
+#define FXAA_REDUCE_MUL ( 1.0 / 8.0 )
+#define FXAA_REDUCE_MIN ( 1.0 / 128.0 )
+#define FXAA_EDGE_THRESHOLD ( 1.0 / 8.0 )
+#define FXAA_EDGE_THRESHOLD_MIN ( 1.0 / 16.0 )
 
-#if 0
-	if( uFogEnabled )
-		col.rgb = applyFog( col.rgb, fogColor, distAdjusted );
+// each tap goes through the same path as the center in main(), so the luma edge test compares like with like
+vec3 compositeAt( vec2 coord )
+{
+	coord = clamp( coord, vec2( 0.0 ), gCoordMax );
+#if defined( SHARPEN_ENABLED )
+	return grade( sampleSharpened( coord ).rgb );
+#else
+	return grade( sampleScene( coord ).rgb );
 #endif
+}
 
-	// if( dist > distStart && dist < ( distStart + distRange ) ) {
-	// 	col.r += 0.6;
-	// }
+// The nine tap FXAA from Lottes' original whitepaper, blurring along the edge found from the luma of the diagonal neighbors.
+// Each tap is composited, so this reads the scene buffers rather than a separate composited buffer. It is lower quality than
+// the FXAA class's pass, which searches much further along edges.
+vec3 fxaa( vec2 coord, vec3 center )
+{
+	vec2 rcpFrame = gTexelSize;
+	float lumaNW = dot( compositeAt( coord + vec2( -1.0, -1.0 ) * rcpFrame ), luminance );
+	float lumaNE = dot( compositeAt( coord + vec2( 1.0, -1.0 ) * rcpFrame ), luminance );
+	float lumaSW = dot( compositeAt( coord + vec2( -1.0, 1.0 ) * rcpFrame ), luminance );
+	float lumaSE = dot( compositeAt( coord + vec2( 1.0, 1.0 ) * rcpFrame ), luminance );
+	float lumaM = dot( center, luminance );
+
+	float lumaMin = min( lumaM, min( min( lumaNW, lumaNE ), min( lumaSW, lumaSE ) ) );
+	float lumaMax = max( lumaM, max( max( lumaNW, lumaNE ), max( lumaSW, lumaSE ) ) );
+	if( lumaMax - lumaMin < max( FXAA_EDGE_THRESHOLD_MIN, lumaMax * FXAA_EDGE_THRESHOLD ) ) {
+		return center;
+	}
 
-	// col -= vec4( 0, 0.5, 0.5, 0.0 );
+	vec2 dir;
+	dir.x = -( ( lumaNW + lumaNE ) - ( lumaSW + lumaSE ) );
+	dir.y = ( ( lumaNW + lumaSW ) - ( lumaNE + lumaSE ) );
 
-#if defined( BLOOM_ENABLED )
-	vec4 glow = texture( uTexGlow, coord );
-	// col.a += glow.a;
-	col += glow;
-#endif
+	float dirReduce = max( ( lumaNW + lumaNE + lumaSW + lumaSE ) * ( 0.25 * FXAA_REDUCE_MUL ), FXAA_REDUCE_MIN );
+	float rcpDirMin = 1.0 / ( min( abs( dir.x ), abs( dir.y ) ) + dirReduce );
+	dir = clamp( dir * rcpDirMin, vec2( -FXAA_SPAN_MAX ), vec2( FXAA_SPAN_MAX ) ) * rcpFrame;
 
-	// tone mapping (disabled if uExposure < 0 )
-	if( uExposure > 0 ) {
-   		// col.rgb = toneMap( col.rgb, uExposure );
-	}
+	vec3 rgbA = 0.5 * ( compositeAt( coord + dir * ( 1.0 / 3.0 - 0.5 ) ) + compositeAt( coord + dir * ( 2.0 / 3.0 - 0.5 ) ) );
+	vec3 rgbB = rgbA * 0.5 + 0.25 * ( compositeAt( coord - dir * 0.5 ) + compositeAt( coord + dir * 0.5 ) );
 
-#if defined( GAMMA_ENABLED )
-    col.rgb = pow( clamp( col.rgb, 0.0, 1.0 ), vec3( 1.0 / 2.2 ) );
+	// the wider blur crossed another edge if its luma is outside the neighborhood's range
+	float lumaB = dot( rgbB, luminance );
+	return ( lumaB < lumaMin || lumaB > lumaMax ) ? rgbA : rgbB;
+}
+#endif
+
+void main()
+{
+	// with dynamic resolution the scene only covers the lower left of the buffers, which is upscaled here
+	gTexelSize = 1.0 / vec2( textureSize( uTexColor, 0 ) );
+	gCoordMax = uRenderScale - 0.5 * gTexelSize;
+	vec2 coord = min( vTexCoord * uRenderScale, gCoordMax );
+
+#if defined( SHARPEN_ENABLED )
+	vec4 col = sampleSharpened( coord );
+#else
+	vec4 col = sampleScene( coord );
 #endif
 
-   	// FXAA requires luma to be written to the alpha channel
-   	const vec3 luminance = vec3( 0.299, 0.587, 0.114 );
+	col.rgb = grade( col.rgb );
+
+#if defined( FXAA_ENABLED )
+	// drawn straight to the output, which is always opaque
+	oFragColor = vec4( fxaa( coord, col.rgb ), 1.0 );
+#else
+	// FXAA and SMAA passes require luma to be written to the alpha channel
 #if AA_TYPE == AA_FXAA || AA_TYPE == AA_SMAA
-   	float luma = dot( col.rgb, luminance );
-   	// luma = pow( luma, 1.0 / 2.2 ); // note from FxaaPixelShader() docs: "{___a} = luma in perceptual color space (not linear)"
-   	col.a = luma;
+	// luma in perceptual color space, see FxaaPixelShader() docs
+	col.a = dot( col.rgb, luminance );
 #endif
 
 	oFragColor = col;
+#endif
 }
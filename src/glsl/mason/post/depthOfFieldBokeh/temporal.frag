@@ -0,0 +1,54 @@
+#version 150
+
+// Accumulates the disk blur over frames, reprojecting the history with the velocity buffer (in pixels). The history is clamped to
+// the neighborhood of the current blur to limit ghosting. Tiles that were skipped by the checkerboard this frame reuse the history.
+
+#include "mason/post/depthOfFieldBokeh/tiles.glsl"
+
+uniform sampler2D uTexCurrent;
+uniform sampler2D uTexHistory;
+uniform sampler2D uTexVelocity;
+uniform int uTileSize;
+uniform float uFeedback;		// weight of the history, 0 disables accumulation
+uniform bool uHistoryValid;
+uniform vec2 uHistoryScale = vec2( 1.0 );		// render scale of the history relative to the current one, with dynamic resolution
+uniform vec2 uHistoryCoordMax = vec2( 1.0 );	// center of the last texel rendered to in the history
+
+in vec2	vTexCoord;
+out vec4 oFragColor;
+
+void main()
+{
+	ivec2 coord = ivec2( gl_FragCoord.xy );
+	ivec2 tile = coord / uTileSize;
+	vec4 current = texelFetch( uTexCurrent, coord, 0 );
+
+	// in focus tiles were cleared and composite the sharp color
+	if( ! tileNeedsBlur( tile ) || ! uHistoryValid ) {
+		oFragColor = current;
+		return;
+	}
+
+	vec2 velocity = texture( uTexVelocity, vTexCoord ).rg / vec2( textureSize( uTexVelocity, 0 ) );
+	vec4 history = texture( uTexHistory, min( ( vTexCoord - velocity ) * uHistoryScale, uHistoryCoordMax ) );
+
+	if( ! tileRenderedThisFrame( tile ) ) {
+		oFragColor = history;
+		return;
+	}
+
+	// only rendered texels within this tile are valid neighbors
+	ivec2 tileMin = tile * uTileSize;
+	ivec2 tileMax = min( tileMin + uTileSize, textureSize( uTexCurrent, 0 ) ) - 1;
+	vec4 minColor = current;
+	vec4 maxColor = current;
+	for( int y = -1; y <= 1; y++ ) {
+		for( int x = -1; x <= 1; x++ ) {
+			vec4 neighbor = texelFetch( uTexCurrent, clamp( coord + ivec2( x, y ), tileMin, tileMax ), 0 );
+			minColor = min( minColor, neighbor );
+			maxColor = max( maxColor, neighbor );
+		}
+	}
+
+	oFragColor = mix( current, clamp( history, minColor, maxColor ), uFeedback );
+}
@@ -0,0 +1,28 @@
+#version 150
+
+// Reduces the prefiltered CoC (stored in alpha as a signed fraction of the screen height, negative in the near field) to the
+// largest far and near CoC of each tile.
+
+uniform sampler2D uTexPrefiltered;
+uniform int uTileSize;
+
+out vec4 oFragColor;
+
+void main()
+{
+	ivec2 size = textureSize( uTexPrefiltered, 0 );
+	ivec2 origin = ivec2( gl_FragCoord.xy ) * uTileSize;
+	ivec2 end = min( origin + uTileSize, size );
+
+	float far = 0.0;
+	float near = 0.0;
+	for( int y = origin.y; y < end.y; y++ ) {
+		for( int x = origin.x; x < end.x; x++ ) {
+			float coc = texelFetch( uTexPrefiltered, ivec2( x, y ), 0 ).a;
+			far = max( far, coc );
+			near = max( near, -coc );
+		}
+	}
+
+	oFragColor = vec4( far, near, 0.0, 1.0 );
+}
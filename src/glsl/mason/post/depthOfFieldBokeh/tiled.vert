@@ -0,0 +1,31 @@
+#version 410
+
+// Drop-in replacement for passthrough.vert that draws one quad per tile with attributeless rendering, collapsing the quads of
+// tiles that don't need to be blurred so they cost nothing in the fragment shader. Draw with 6 vertices per tile.
+
+#include "mason/post/depthOfFieldBokeh/tiles.glsl"
+
+uniform ivec2 uNumTiles;
+uniform int uTileSize;
+uniform vec2 uTargetSize;
+
+out vec2 vTexCoord;
+
+const ivec2 kCorners[6] = ivec2[]( ivec2( 0, 0 ), ivec2( 1, 0 ), ivec2( 1, 1 ), ivec2( 0, 0 ), ivec2( 1, 1 ), ivec2( 0, 1 ) );
+
+void main()
+{
+	int tileIndex = gl_VertexID / 6;
+	ivec2 tile = ivec2( tileIndex % uNumTiles.x, tileIndex / uNumTiles.x );
+
+	if( ! tileNeedsBlur( tile ) || ! tileRenderedThisFrame( tile ) ) {
+		// degenerate, outside of the clip volume
+		vTexCoord = vec2( 0.0 );
+		gl_Position = vec4( -2.0, -2.0, 0.0, 1.0 );
+		return;
+	}
+
+	vec2 pixel = min( vec2( ( tile + kCorners[gl_VertexID % 6] ) * uTileSize ), uTargetSize );
+	vTexCoord = pixel / uTargetSize;
+	gl_Position = vec4( vTexCoord * 2.0 - 1.0, 0.0, 1.0 );
+}
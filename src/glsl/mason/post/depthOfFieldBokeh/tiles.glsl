@@ -0,0 +1,41 @@
+#ifndef MASON_BOKEH_TILES_GLSL
+#define MASON_BOKEH_TILES_GLSL
+
+// Tile classification shared by the tiled bokeh passes. Each texel of uTexTiles holds the largest far (r) and near (g) CoC
+// within a tile, as produced by tileClassify.frag.
+
+uniform sampler2D uTexTiles;
+uniform int uTileRadius;		// number of tiles the near field can spread over
+uniform int uTileDilation;		// extra tiles around the ones that need blur, so filters reading past their edges find valid data
+uniform float uCoCThreshold;	// CoC below which a pixel is considered in focus
+uniform bool uCheckerboard;		// only render every other tile, alternating each frame
+uniform int uFrameIndex;
+
+// Far field only blurs within its own tile, while the near field bleeds onto the neighboring tiles within the max CoC. Both are
+// grown by uTileDilation tiles.
+bool tileNeedsBlur( ivec2 tile )
+{
+	ivec2 numTiles = textureSize( uTexTiles, 0 );
+	ivec2 minTile = max( tile - uTileRadius - uTileDilation, ivec2( 0 ) );
+	ivec2 maxTile = min( tile + uTileRadius + uTileDilation, numTiles - 1 );
+	for( int y = minTile.y; y <= maxTile.y; y++ ) {
+		for( int x = minTile.x; x <= maxTile.x; x++ ) {
+			vec2 coc = texelFetch( uTexTiles, ivec2( x, y ), 0 ).rg;
+			if( coc.g > uCoCThreshold )
+				return true;
+
+			ivec2 offset = abs( ivec2( x, y ) - tile );
+			if( max( offset.x, offset.y ) <= uTileDilation && coc.r > uCoCThreshold )
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool tileRenderedThisFrame( ivec2 tile )
+{
+	return ! uCheckerboard || ( ( tile.x + tile.y + uFrameIndex ) & 1 ) == 0;
+}
+
+#endif
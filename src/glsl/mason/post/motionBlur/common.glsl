@@ -0,0 +1,18 @@
+#ifndef MASON_MOTION_BLUR_COMMON_GLSL
+#define MASON_MOTION_BLUR_COMMON_GLSL
+
+// Shared by the compute path of MotionBlurEffect. Velocities are in pixels.
+
+uniform float uExposureTime;	// fraction of the frame interval the shutter is open
+uniform int uMaxBlurRadius;		// in pixels, also the tile size
+
+// Scales a velocity by the exposure time and clamps it to the maximum blur radius.
+vec2 preprocessVelocity( vec2 v )
+{
+	v *= uExposureTime;
+	float len = length( v );
+	float maxLen = float( uMaxBlurRadius );
+	return len > maxLen ? v * ( maxLen / len ) : v;
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/MappedFile.h"
+
+#include "cinder/Cinder.h"
+#include "cinder/Log.h"
+
+#if defined( CINDER_MSW )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace ci;
+using namespace std;
+
+namespace mason {
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined( CINDER_MSW )
+
+bool MappedFile::open( const fs::path &path )
+{
+	close();
+
+	HANDLE file = ::CreateFileW( path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE ) {
+		CI_LOG_E( "failed to open file: " << path );
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if( ! ::GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 ) {
+		::CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping = ::CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( ! mapping ) {
+		CI_LOG_E( "failed to create file mapping for: " << path );
+		::CloseHandle( file );
+		return false;
+	}
+
+	void *data = ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( ! data ) {
+		CI_LOG_E( "failed to map view of file: " << path );
+		::CloseHandle( mapping );
+		::CloseHandle( file );
+		return false;
+	}
+
+	mFileHandle = file;
+	mMappingHandle = mapping;
+	mData = static_cast<const uint8_t *>( data );
+	mSize = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if( mData )
+		::UnmapViewOfFile( mData );
+	if( mMappingHandle )
+		::CloseHandle( mMappingHandle );
+	if( mFileHandle )
+		::CloseHandle( mFileHandle );
+
+	mData = nullptr;
+	mSize = 0;
+	mMappingHandle = nullptr;
+	mFileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open( const fs::path &path )
+{
+	close();
+
+	int fd = ::open( path.string().c_str(), O_RDONLY );
+	if( fd < 0 ) {
+		CI_LOG_E( "failed to open file: " << path );
+		return false;
+	}
+
+	struct stat fileStat;
+	if( ::fstat( fd, &fileStat ) != 0 || fileStat.st_size == 0 ) {
+		::close( fd );
+		return false;
+	}
+
+	void *data = ::mmap( nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if( data == MAP_FAILED ) {
+		CI_LOG_E( "failed to mmap file: " << path );
+		::close( fd );
+		return false;
+	}
+
+	mFileDescriptor = fd;
+	mData = static_cast<const uint8_t *>( data );
+	mSize = (size_t)fileStat.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if( mData )
+		::munmap( const_cast<uint8_t *>( mData ), mSize );
+	if( mFileDescriptor >= 0 )
+		::close( mFileDescriptor );
+
+	mData = nullptr;
+	mSize = 0;
+	mFileDescriptor = -1;
+}
+
+#endif
+
+} // namespace mason
@@ -0,0 +1,57 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "mason/Export.h"
+#include "cinder/Filesystem.h"
+
+namespace mason {
+
+//! Read-only memory mapping of a file. Pages are only loaded from disk when they are first touched.
+class MA_API MappedFile {
+  public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile( const MappedFile & ) = delete;
+	MappedFile& operator=( const MappedFile & ) = delete;
+
+	//! Maps the file at \a path, closing any previously mapped file. Returns false if the file couldn't be opened or is empty.
+	bool	open( const ci::fs::path &path );
+	//! Unmaps the file.
+	void	close();
+
+	bool			isOpen() const		{ return mData != nullptr; }
+	const uint8_t*	getData() const		{ return mData; }
+	size_t			getSize() const		{ return mSize; }
+
+  private:
+	const uint8_t*	mData = nullptr;
+	size_t			mSize = 0;
+#if defined( CINDER_MSW )
+	void*			mFileHandle = nullptr;
+	void*			mMappingHandle = nullptr;
+#else
+	int				mFileDescriptor = -1;
+#endif
+};
+
+} // namespace mason
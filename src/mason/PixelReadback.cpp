@@ -0,0 +1,155 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/PixelReadback.h"
+
+#include "cinder/gl/scoped.h"
+#include "cinder/app/AppBase.h"
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+
+using namespace ci;
+using namespace std;
+
+namespace mason {
+
+PixelReadback::PixelReadback( size_t numBuffers )
+	: mSlots( max<size_t>( 1, numBuffers ) )
+{
+}
+
+bool PixelReadback::request( const gl::TextureBaseRef &texture, const ivec3 &coord, const ivec3 &size, GLint level )
+{
+	CI_ASSERT( texture );
+
+	// buffers are used in order, so if the next one is still in flight all of them are
+	auto &slot = mSlots[mNextSlot];
+	if( slot.mFence ) {
+		mStats.mNumDropped++;
+		return false;
+	}
+
+	Timer timer( true );
+
+	const GLsizeiptr numBytes = GLsizeiptr( size.x * size.y * size.z * sizeof( vec4 ) );
+	if( ! slot.mBuffer || slot.mBuffer->getSize() < numBytes ) {
+		slot.mBuffer = gl::BufferObj::create( GL_PIXEL_PACK_BUFFER, numBytes, nullptr, GL_STREAM_READ );
+		slot.mBuffer->setLabel( "PixelReadback" );
+	}
+
+	// with a pack buffer bound, the last argument is an offset into it and the copy happens asynchronously
+	{
+		gl::ScopedBuffer scopedBuffer( slot.mBuffer );
+		glGetTextureSubImage( texture->getId(), level, coord.x, coord.y, coord.z, size.x, size.y, size.z, GL_RGBA, GL_FLOAT, (GLsizei)numBytes, nullptr );
+	}
+
+	slot.mFence = gl::Sync::create();
+	slot.mCoord = coord;
+	slot.mSize = size;
+	slot.mRequestFrame = mFrame;
+	slot.mRequestTime = app::getElapsedSeconds();
+	slot.mIssueSeconds = timer.getSeconds();
+
+	mNextSlot = ( mNextSlot + 1 ) % mSlots.size();
+	mStats.mNumRequested++;
+	return true;
+}
+
+bool PixelReadback::update()
+{
+	mFrame++;
+
+	// requests complete in order, so stop at the first one that isn't ready
+	bool newResult = false;
+	size_t index = ( mNextSlot + mSlots.size() - getNumPending() ) % mSlots.size();
+	for( size_t i = 0; i < mSlots.size(); i++, index = ( index + 1 ) % mSlots.size() ) {
+		auto &slot = mSlots[index];
+		if( ! slot.mFence )
+			break;
+
+		GLenum status = slot.mFence->clientWaitSync( GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		if( status == GL_TIMEOUT_EXPIRED )
+			break;
+
+		if( status == GL_WAIT_FAILED ) {
+			CI_LOG_E( "clientWaitSync failed, dropping request" );
+			slot.mFence = nullptr;
+			continue;
+		}
+
+		Timer timer( true );
+
+		const size_t numPixels = size_t( slot.mSize.x * slot.mSize.y * slot.mSize.z );
+		mResult.mCoord = slot.mCoord;
+		mResult.mSize = slot.mSize;
+		mResult.mPixels.resize( numPixels );
+		{
+			gl::ScopedBuffer scopedBuffer( slot.mBuffer );
+			auto data = (const vec4 *)slot.mBuffer->mapBufferRange( 0, numPixels * sizeof( vec4 ), GL_MAP_READ_BIT );
+			if( data ) {
+				copy( data, data + numPixels, mResult.mPixels.begin() );
+			}
+			slot.mBuffer->unmap();
+		}
+
+		slot.mFence = nullptr;
+		mHasResult = true;
+		newResult = true;
+
+		mStats.mNumCompleted++;
+		mStats.mLatencyFrames = int( mFrame - slot.mRequestFrame );
+		mStats.mLatencySeconds = app::getElapsedSeconds() - slot.mRequestTime;
+		mStats.mStallSeconds = slot.mIssueSeconds + timer.getSeconds();
+	}
+
+	return newResult;
+}
+
+void PixelReadback::clear()
+{
+	// buffers are kept for reuse, the copies into them may still be in progress but will never be mapped
+	for( auto &slot : mSlots )
+		slot.mFence = nullptr;
+
+	mNextSlot = 0;
+	mResult.mPixels.clear();
+	mHasResult = false;
+}
+
+vec4 PixelReadback::getPixel( const vec4 &defaultValue ) const
+{
+	if( ! mHasResult || mResult.mPixels.empty() )
+		return defaultValue;
+
+	return mResult.mPixels.front();
+}
+
+size_t PixelReadback::getNumPending() const
+{
+	size_t result = 0;
+	for( const auto &slot : mSlots ) {
+		if( slot.mFence )
+			result++;
+	}
+
+	return result;
+}
+
+} // namespace mason
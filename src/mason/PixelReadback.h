@@ -0,0 +1,97 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "mason/Mason.h"
+
+#include "cinder/gl/BufferObj.h"
+#include "cinder/gl/Sync.h"
+#include "cinder/gl/Texture.h"
+
+#include <vector>
+
+namespace mason {
+
+//! \brief Reads pixels back from textures without stalling the GPU, through a ring of pixel buffer objects.
+//!
+//! request() copies a region of a texture into the next free pixel buffer and places a fence after the copy. update() polls the
+//! fences without waiting and maps the buffers whose copies completed, so results arrive a frame or two after they were requested.
+//! Pixels are read as RGBA floats.
+class MA_API PixelReadback {
+  public:
+	struct Result {
+		ci::ivec3				mCoord;
+		ci::ivec3				mSize;
+		std::vector<ci::vec4>	mPixels;
+	};
+
+	struct Stats {
+		size_t	mNumRequested = 0;
+		size_t	mNumCompleted = 0;
+		//! Requests dropped because every buffer was still in flight.
+		size_t	mNumDropped = 0;
+		//! Number of update() calls between the last completed request and its result, usually frames.
+		int		mLatencyFrames = 0;
+		double	mLatencySeconds = 0;
+		//! Time the CPU spent issuing the last request and mapping its result.
+		double	mStallSeconds = 0;
+	};
+
+	//! Creates a readback with \a numBuffers in flight at most.
+	PixelReadback( size_t numBuffers = 3 );
+
+	//! Requests the pixels of \a texture starting at \a coord, in texels with the origin at the bottom left. Returns false if all buffers are in flight.
+	bool	request( const ci::gl::TextureBaseRef &texture, const ci::ivec3 &coord, const ci::ivec3 &size = ci::ivec3( 1 ), GLint level = 0 );
+	//! Collects completed requests without waiting. Returns true if a new result is available. Call once per frame.
+	bool	update();
+	//! Drops all requests in flight and the last result, ex. when the texture being read from changes. Stats are kept.
+	void	clear();
+
+	//! Returns true once a request has completed.
+	bool			hasResult() const		{ return mHasResult; }
+	//! Returns the most recently completed request. Check its mCoord if requests for different coordinates may be in flight.
+	const Result&	getResult() const		{ return mResult; }
+	//! Returns the first pixel of the most recently completed request, or \a defaultValue if none has completed yet.
+	ci::vec4		getPixel( const ci::vec4 &defaultValue = ci::vec4( 0 ) ) const;
+
+	size_t			getNumPending() const;
+	const Stats&	getStats() const		{ return mStats; }
+
+  private:
+	struct Slot {
+		ci::gl::BufferObjRef	mBuffer;
+		ci::gl::SyncRef			mFence;
+		ci::ivec3				mCoord;
+		ci::ivec3				mSize;
+		size_t					mRequestFrame = 0;
+		double					mRequestTime = 0;
+		double					mIssueSeconds = 0;
+	};
+
+	std::vector<Slot>	mSlots;
+	size_t				mNextSlot = 0;
+	size_t				mFrame = 0;
+	Result				mResult;
+	bool				mHasResult = false;
+	Stats				mStats;
+};
+
+} // namespace mason
@@ -73,6 +73,12 @@ InputType getInputTypeFromString( const std::string &typeStr )
 		return InputType::UNKNOWN;
 }
 
+//! Returns false when running without an app or window (ex. headless analysis), in which case neither hotkeys nor the Hud are available.
+bool isAppWindowAvailable()
+{
+	return app::AppBase::get() && app::AppBase::get()->getNumWindows() > 0;
+}
+
 } // anonymous namespace
 
 // ----------------------------------------------------------------------------------------------------
@@ -88,6 +94,10 @@ Track::~Track()
 {
 	if( mMonitorSpectralNode )
 		mMonitorSpectralNode->disconnectAllOutputs();
+	if( mGain )
+		mGain->disconnectAllOutputs();
+	if( mFeatureExtractorNode )
+		mFeatureExtractorNode->disconnectAllInputs();
 }
 
 void Track::setGain( float value, double rampSeconds )
@@ -114,12 +124,30 @@ float Track::getLoudness() const
 
 float Track::getSpectralCentroid() const
 {
+	if( mSpectralNode )
+		return ci::audio::dsp::spectralCentroid( mMagSpectrum.data(), mMagSpectrum.size(), (size_t)getSampleRate() );
+
 	return mMonitorSpectralNode->getSpectralCentroid();
 }
 
 float Track::getSampleRate() const
 {
-	return (float)ci::audio::master()->getSampleRate();
+	return (float)mGain->getContext()->getSampleRate();
+}
+
+size_t Track::getFftSize() const
+{
+	return mSpectralNode ? mSpectralNode->getFftSize() : mMonitorSpectralNode->getFftSize();
+}
+
+size_t Track::getWindowSize() const
+{
+	return mSpectralNode ? mSpectralNode->getWindowSize() : mMonitorSpectralNode->getWindowSize();
+}
+
+size_t Track::getNumBins() const
+{
+	return mSpectralNode ? mSpectralNode->getNumBins() : mMonitorSpectralNode->getNumBins();
 }
 
 double Track::getSamplePlaybackTime() const
@@ -140,17 +168,46 @@ double Track::getSampleDuration() const
 
 void Track::setSpectrumSmoothingFactor( float x )
 {
-	mMonitorSpectralNode->setSmoothingFactor( x );
+	if( mSpectralNode )
+		mSpectrumSmoothingFactor = x;
+	else
+		mMonitorSpectralNode->setSmoothingFactor( x );
 }
 
 float Track::getSpectrumSmoothFactor() const
 {
-	return mMonitorSpectralNode->getSmoothingFactor();
+	return mSpectralNode ? mSpectrumSmoothingFactor : mMonitorSpectralNode->getSmoothingFactor();
 }
 
 void Track::update()
 {
-	float volume = ci::audio::linearToDecibel( mMonitorSpectralNode->getVolume() );
+	float volume;
+	if( mSpectralNode ) {
+		// The shared node analyzes the device input before this track's gain, so it is applied here.
+		// Tracks spanning multiple channels use the average magnitude and the combined RMS of those channels.
+		const size_t numBins = mSpectralNode->getNumBins();
+		const float gain = mGain->getValue();
+		const float magScale = gain / float( mNumChannels ) * ( 1 - mSpectrumSmoothingFactor );
+
+		mMagSpectrum.resize( numBins, 0.0f );
+		for( size_t i = 0; i < numBins; i++ )
+			mMagSpectrum[i] *= mSpectrumSmoothingFactor;
+
+		float sumSquares = 0;
+		for( size_t ch = mChannelOffset; ch < mChannelOffset + mNumChannels && ch < mSpectralNode->getNumAnalyzedChannels(); ch++ ) {
+			const float *mags = mSpectralNode->getMagSpectrum( ch );
+			for( size_t i = 0; i < numBins; i++ )
+				mMagSpectrum[i] += mags[i] * magScale;
+
+			const float rms = mSpectralNode->getVolume( ch );
+			sumSquares += rms * rms;
+		}
+
+		volume = ci::audio::linearToDecibel( gain * sqrt( sumSquares / float( mNumChannels ) ) );
+	}
+	else {
+		volume = ci::audio::linearToDecibel( mMonitorSpectralNode->getVolume() );
+	}
 
 	// TODO: switch to ImGui throughout
 	// - will be a bit of work to get the analyzer views in there, but perhaps that can stay separate to start
@@ -172,7 +229,8 @@ void Track::update()
 		mVolumeRMSLastOnset = mVolumeRMSLastOnset * mVolumeSmoothingFactor + volume * ( 1 - mVolumeSmoothingFactor );
 	}
 	
-	mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
+	if( ! mSpectralNode )
+		mMagSpectrum = mMonitorSpectralNode->getMagSpectrum();
 
 	sumFrequencyBands();
 }
@@ -194,8 +252,8 @@ void Track::setBarkBandsEnabled( bool enable )
 
 void Track::initBarkBands()
 {
-	CI_ASSERT( mMonitorSpectralNode );
-	CI_ASSERT( mMonitorSpectralNode->isInitialized() );
+	CI_ASSERT( mSpectralNode || mMonitorSpectralNode );
+	CI_ASSERT( mSpectralNode || mMonitorSpectralNode->isInitialized() );
 
 	// https://ccrma.stanford.edu/~jos/bbt/Bark_Frequency_Scale.html
 	const array<float, 27> barkBandEdges = {
@@ -205,8 +263,8 @@ void Track::initBarkBands()
 	};
 
 	float sr = getSampleRate();
-	float N = mMonitorSpectralNode->getFftSize();
-	int numBins = mMonitorSpectralNode->getNumBins();
+	float N = getFftSize();
+	int numBins = getNumBins();
 
 	for( size_t i = 0; i < barkBandEdges.size() - 1; i++ ) {
 		float freqLower = barkBandEdges[i];
@@ -280,9 +338,14 @@ void setAnalyzerInstance( const std::shared_ptr<AudioAnalyzer> &analyzer )
 	sInstance = analyzer;
 }
 
-AudioAnalyzer::AudioAnalyzer()
+AudioAnalyzer::AudioAnalyzer( const Options &options )
+	: mOptions( options )
 {
-	mConnKeyDown = app::getWindow()->getSignalKeyDown().connect( signals::slot( this, &AudioAnalyzer::keyDown ) );
+	mOfflineContext = dynamic_pointer_cast<OfflineContext>( mOptions.getContext() );
+
+	if( mOptions.isKeyboardShortcutsEnabled() && isAppWindowAvailable() ) {
+		mConnKeyDown = app::getWindow()->getSignalKeyDown().connect( signals::slot( this, &AudioAnalyzer::keyDown ) );
+	}
 }
 
 AudioAnalyzer::~AudioAnalyzer()
@@ -290,9 +353,14 @@ AudioAnalyzer::~AudioAnalyzer()
 	CI_LOG_I( "instance: " << hex << this << dec );
 }
 
+ci::audio::Context* AudioAnalyzer::getContext() const
+{
+	return mOptions.getContext() ? mOptions.getContext().get() : ci::audio::master();
+}
+
 void AudioAnalyzer::enable()
 {
-	auto ctx = ci::audio::master();
+	auto ctx = getContext();
 	ctx->enable();
 
 	for( const auto &track : mTracks ) {
@@ -305,7 +373,7 @@ void AudioAnalyzer::enable()
 
 void AudioAnalyzer::disable()
 {
-	auto ctx = ci::audio::master();
+	auto ctx = getContext();
 	ctx->disable();
 
 	for( const auto &track : mTracks ) {
@@ -318,7 +386,7 @@ void AudioAnalyzer::disable()
 
 bool AudioAnalyzer::isEnabled() const
 {
-	return ci::audio::master()->isEnabled();
+	return getContext()->isEnabled();
 }
 
 void AudioAnalyzer::play()
@@ -328,13 +396,15 @@ void AudioAnalyzer::play()
 
 	mIsPaused = false;
 
+	// all players start on the same frame, gains ramp up from there
+	const double audioTime = getContext()->getNumProcessedSeconds();
+	const double startWhen = mTransport->start();
+	LOG_ANALYZER( "[" << audioTime << "] starting transport at " << startWhen );
+
 	for( const auto &track : mTracks ) {
 		if( track->mSamplePlayerNode ) {
 			track->mGain->setValue( 0 );
-			track->mGain->getParam()->applyRamp( track->mGainValue, mSeekRampSeconds, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ) );
-			double audioTime = ci::audio::master()->getNumProcessedSeconds();
-			LOG_ANALYZER( "[" << audioTime << "] enabling track '" << track->getId() );
-			track->mInputNode->enable();
+			track->mGain->getParam()->applyRamp( track->mGainValue, mSeekRampSeconds, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ).delay( startWhen - audioTime ) );
 		}
 	}
 }
@@ -346,46 +416,42 @@ void AudioAnalyzer::pause()
 
 	mIsPaused = true;
 
-	// delay this and ramp down first
+	// ramp down first, the transport stops all players once the ramp is done
 	for( const auto &track : mTracks ) {
 		if( track->mSamplePlayerNode ) {
 			track->mGain->getParam()->applyRamp( 0, mSeekRampSeconds, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ) );
-			//track->mSamplePlayerNode->disable( ci::audio::master()->getNumProcessedSeconds() + mSeekRampSeconds + 0.01 );
-
-			double audioTime = ci::audio::master()->getNumProcessedSeconds();
-			double disableWhen = audioTime + mSeekRampSeconds + 0.01;
-			LOG_ANALYZER( "[" << audioTime << "] disabling track '" << track->getId() << "' at " << disableWhen );
-			track->mSamplePlayerNode->disable( disableWhen );
 		}
 	}
+
+	const double stopWhen = mTransport->stop( mSeekRampSeconds );
+	LOG_ANALYZER( "[" << getContext()->getNumProcessedSeconds() << "] stopping transport at " << stopWhen );
 }
 
 void AudioAnalyzer::seek( double time, bool playSnippet )
 {	
-	if( ! ci::audio::master()->isEnabled() || ! mIsPaused )
+	if( ! getContext()->isEnabled() || ! mIsPaused )
 		playSnippet = false;
 
-	for( const auto &track : mTracks ) {
-		if( track->mSamplePlayerNode ) {
-			track->mSamplePlayerNode->seekToTime( time );
-			LOG_ANALYZER( "seeked track '" << track->getId() << "' to time: " << time << "s. playSnippet: " << playSnippet );
-			if( playSnippet ) {
-				double playSnippetDuration = 0.5;
-				track->mSamplePlayerNode->enable();
+	const double seekWhen = mTransport->seek( time );
+	LOG_ANALYZER( "seeked transport to time: " << time << "s at " << seekWhen << ". playSnippet: " << playSnippet );
+
+	if( playSnippet ) {
+		const double playSnippetDuration = 0.5;
+		const double audioTime = getContext()->getNumProcessedSeconds();
+		const double startWhen = mTransport->start();
+		for( const auto &track : mTracks ) {
+			if( track->mSamplePlayerNode ) {
 				track->mGain->getParam()->applyRamp( 0, 0.01 );
-				track->mGain->getParam()->appendRamp( track->mGainValue, mSeekRampSeconds / 2, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ) );
+				track->mGain->getParam()->appendRamp( track->mGainValue, mSeekRampSeconds / 2, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ).delay( std::max( 0.0, startWhen - audioTime - 0.01 ) ) );
 				track->mGain->getParam()->appendRamp( 0, mSeekRampSeconds / 2, ci::audio::Param::Options().rampFn( &ci::audio::rampOutQuad ).delay( playSnippetDuration ) );
-
-				double audioTime = ci::audio::master()->getNumProcessedSeconds();
-				double disableWhen = audioTime + mSeekRampSeconds + playSnippetDuration + 0.02 ;
-				LOG_ANALYZER( "\t-[" << audioTime << "] disabling track '" << track->getId() << "' at " << disableWhen );
-				track->mSamplePlayerNode->disable( disableWhen );
-
-				// TODO: should probably seek back to `time` upon disable
-				// - don't need to currently with Tracker since unpausing will issue another seek
-				//track->mSamplePlayerNode->seekToTime( time );
 			}
 		}
+
+		const double stopWhen = mTransport->stop( startWhen - audioTime + mSeekRampSeconds + playSnippetDuration );
+		LOG_ANALYZER( "\t-[" << audioTime << "] playing snippet from " << startWhen << " until " << stopWhen );
+
+		// TODO: should probably seek back to `time` after the snippet
+		// - don't need to currently with Tracker since unpausing will issue another seek
 	}
 }
 
@@ -426,7 +492,12 @@ void AudioAnalyzer::initEntry( const ma::Info &config )
 
 void AudioAnalyzer::initContext( const ma::Info &config )
 {
-	auto ctx = ci::audio::master();
+	if( mOfflineContext ) {
+		initOfflineContext( config );
+		return;
+	}
+
+	auto ctx = getContext();
 	ctx->disable();
 
 	//CI_LOG_I( "audio graph before:\n" << ctx->printGraphToString() );
@@ -466,6 +537,29 @@ void AudioAnalyzer::initContext( const ma::Info &config )
 	mMasterGain = ctx->makeNode<ci::audio::GainNode>();
 	mMasterGain->setName( "master gain" );
 	mMasterGain >> ctx->getOutput();	
+
+	// the clock runs off the master gain, which is pulled every block whether or not tracks are playing
+	mTransport = make_shared<Transport>( mMasterGain );
+	mTransport->setScheduleAheadSeconds( config.get<double>( "transportScheduleAheadSeconds", mTransport->getScheduleAheadSeconds() ) );
+	double outputLatencySeconds = double( outputDev->getFramesPerBlock() ) / double( outputDev->getSampleRate() );
+	mTransport->getClock().setLatencySeconds( config.get<double>( "outputLatencySeconds", outputLatencySeconds ) );
+}
+
+void AudioAnalyzer::initOfflineContext( const ma::Info &config )
+{
+	// no devices, samplerate and block size come from config. Blocks can be larger than realtime ones, see OfflineContext::setFramesPerBlock()
+	auto ctx = mOfflineContext;
+	ctx->setSampleRate( config.get<size_t>( "sampleRate", ctx->getSampleRate() ) );
+	ctx->setFramesPerBlock( config.get<size_t>( "framesPerBlock", ctx->getFramesPerBlock() ) );
+	CI_LOG_I( "offline samplerate: " << ctx->getSampleRate() << ", frames per block: " << ctx->getFramesPerBlock() );
+
+	mMasterGain = ctx->makeNode<ci::audio::GainNode>();
+	mMasterGain->setName( "master gain" );
+	mMasterGain >> ctx->getOutput();
+
+	// nothing is heard, so the clock isn't latency compensated
+	mTransport = make_shared<Transport>( mMasterGain );
+	mTransport->setScheduleAheadSeconds( config.get<double>( "transportScheduleAheadSeconds", mTransport->getScheduleAheadSeconds() ) );
 }
 
 void AudioAnalyzer::initTracks( const ma::Info &config )
@@ -474,10 +568,48 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 	auto fftSize = config.get<size_t>( "fftSize", 1024 );
 	auto windowSize = config.get<size_t>( "windowSize", 512 );
 
-	auto ctx = ci::audio::master();
+	auto ctx = getContext();
 	auto monitorFormat = ci::audio::MonitorSpectralNode::Format().fftSize( fftSize ).windowSize( windowSize );
+	auto spectralFormat = MultichannelSpectralNode::Format().fftSize( fftSize ).windowSize( windowSize );
+
+	// optional extended features, computed on the audio thread. Example config:
+	// "features": { "enabled": true, "windowSize": 1024, "hopSize": 512, "historySize": 128, "mfccCoeffs": 13 }
+	bool featuresEnabled = false;
+	auto featuresFormat = FeatureExtractorNode::Format().fftSize( fftSize ).windowSize( windowSize );
+	if( config.contains( "features" ) ) {
+		auto featuresInfo = config.get<ma::Info>( "features" );
+		featuresEnabled = featuresInfo.get<bool>( "enabled", true );
+		featuresFormat.windowSize( featuresInfo.get<size_t>( "windowSize", featuresFormat.getWindowSize() ) );
+		featuresFormat.fftSize( featuresInfo.get<size_t>( "fftSize", featuresFormat.getFftSize() ) );
+		featuresFormat.hopSize( featuresInfo.get<size_t>( "hopSize", featuresFormat.getHopSize() ) );
+		featuresFormat.historySize( featuresInfo.get<size_t>( "historySize", featuresFormat.getHistorySize() ) );
+		featuresFormat.numMfccCoeffs( featuresInfo.get<size_t>( "mfccCoeffs", featuresFormat.getNumMfccCoeffs() ) );
+		featuresFormat.numMelBands( featuresInfo.get<size_t>( "melBands", featuresFormat.getNumMelBands() ) );
+		featuresFormat.rolloffPercent( featuresInfo.get<float>( "rolloffPercent", featuresFormat.getRolloffPercent() ) );
+	}
 	
+	// optional file loading params, only read on the first initialize. Example config:
+	// "fileLoader": { "threads": 4, "cacheDir": "build/audio", "resampleCache": true, "playableSeconds": 2 }
+	if( ! mFileLoader ) {
+		// offline there's no app to issue callbacks on and tracks need their samples before rendering starts
+		auto loaderOptions = AudioFileLoader::Options().synchronous( isOffline() );
+		if( config.contains( "fileLoader" ) ) {
+			auto loaderInfo = config.get<ma::Info>( "fileLoader" );
+			loaderOptions.numThreads( loaderInfo.get<size_t>( "threads", loaderOptions.getNumThreads() ) );
+			loaderOptions.cacheDir( loaderInfo.get<string>( "cacheDir", loaderOptions.getCacheDir().string() ) );
+			loaderOptions.resampleCache( loaderInfo.get<bool>( "resampleCache", loaderOptions.isResampleCacheEnabled() ) );
+			loaderOptions.playableSeconds( loaderInfo.get<double>( "playableSeconds", loaderOptions.getPlayableSeconds() ) );
+		}
+		mFileLoader = make_unique<AudioFileLoader>( loaderOptions );
+	}
+
 	mTracks.clear(); // TODO: this is going to clear audio buffers - add option to cache them
+
+	// the fft params may have changed, so analysis nodes for input devices are recreated as tracks need them
+	for( auto &nodePair : mSharedSpectralNodes )
+		nodePair.second->disconnectAllInputs();
+	mSharedSpectralNodes.clear();
+
 	for( size_t i = 0; i < tracks.size(); i++ ) {
 		// TODO: move individual track looking to a different method and wrap in a try / catch, so other tracks continue to load
 		const auto &trackInfo = tracks[i];
@@ -504,11 +636,14 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 		auto track = make_shared<ma::audio::Track>( id, (int)i );	
 		track->mGain = ctx->makeNode( new ci::audio::GainNode( gain ) );
 		track->mGainValue = gain;
-		track->mMonitorSpectralNode = ctx->makeNode( new ci::audio::MonitorSpectralNode( monitorFormat ) );
 
-		track->mGain >> track->mMonitorSpectralNode >> mMasterGain;
+		ci::audio::NodeRef trackOutput; // what the optional FeatureExtractorNode is connected to
 
 		if( inputType == InputType::FILE_PLAYER || inputType == InputType::BUFFER_PLAYER ) {
+			track->mMonitorSpectralNode = ctx->makeNode( new ci::audio::MonitorSpectralNode( monitorFormat ) );
+			track->mGain >> track->mMonitorSpectralNode >> mMasterGain;
+			trackOutput = track->mMonitorSpectralNode;
+
 			const auto loopEnabled = trackInfo.get<bool>( "loopEnabled", false );
 			track->mSampleFileName = trackInfo.get<string>( "fileName" );
 			auto audioFilePath = resolvePathFromUrl( track->mSampleFileName );
@@ -517,20 +652,25 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 			weak_ptr<Track>	weakTrack = track; // avoid circular ownership in track callback lambdas
 
 			if( inputType == InputType::FILE_PLAYER ) {
-				track->mFilePlayerNode = ci::audio::master()->makeNode<ci::audio::FilePlayerNode>();
+				track->mFilePlayerNode = ctx->makeNode<ci::audio::FilePlayerNode>();
 				track->mFilePlayerNode->setLoopEnabled( loopEnabled );
 				track->mFilePlayerNode->setName( "FilePlayerNode (" + track->mSampleFileName + ")" );
 				track->mInputNode = track->mSamplePlayerNode = track->mFilePlayerNode;
 				track->mConnAudioFile = ma::assets()->getFile( audioFilePath, [this, weakTrack]( DataSourceRef dataSource ) {
-					auto source = ci::audio::load( dataSource, ci::audio::master()->getSampleRate() );
-					auto track = weakTrack.lock();
-					track->mFilePlayerNode->setSourceFile( source );
-					CI_LOG_I( "\t- [FilePlayerNode] loaded SourceFile with source at path: " << dataSource->getFilePath() );
-					
+					// the file is opened on a worker thread, FilePlayerNode streams it from there on
+					mFileLoader->loadSourceFile( dataSource, getContext()->getSampleRate(), [this, weakTrack, dataSource]( const ci::audio::SourceFileRef &source ) {
+						auto track = weakTrack.lock();
+						if( ! track )
+							return;
+
+						track->mFilePlayerNode->setSourceFile( source );
+						mTransport->syncPlayer( track->mFilePlayerNode );
+						CI_LOG_I( "\t- [FilePlayerNode] loaded SourceFile with source at path: " << dataSource->getFilePath() );
+					} );
 				} );
 			}
 			else if( inputType == InputType::BUFFER_PLAYER ) {
-				track->mBufferPlayerNode = ci::audio::master()->makeNode<ci::audio::BufferPlayerNode>();
+				track->mBufferPlayerNode = ctx->makeNode<ci::audio::BufferPlayerNode>();
 				track->mBufferPlayerNode->setLoopEnabled( loopEnabled );
 				track->mBufferPlayerNode->setName( "BufferPlayerNode (" + track->mSampleFileName + ")" );
 				track->mInputNode = track->mSamplePlayerNode = track->mBufferPlayerNode;
@@ -540,8 +680,6 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 					CI_LOG_I( "\t- [BufferPlayerNode] loaded Buffer from cache with source at path: " << audioFilePath );
 				}
 				track->mConnAudioFile = ma::assets()->getFile( audioFilePath, [this, audioFilePath, weakTrack]( DataSourceRef dataSource ) {
-					// TODO: load to BufferRef async
-
 					auto timeLastWrite = fs::last_write_time( dataSource->getFilePath() );
 					auto bufferIt = mBufferCache.find( audioFilePath );
 					if( bufferIt != mBufferCache.end() && timeLastWrite <= bufferIt->second.second ) {
@@ -549,12 +687,28 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 						return;
 					}
 
-					auto source = ci::audio::load( dataSource, ci::audio::master()->getSampleRate() );
-					auto buffer = source->loadBuffer();
-					mBufferCache[audioFilePath] = { buffer, timeLastWrite };
 					auto track = weakTrack.lock();
-					track->mBufferPlayerNode->loadBuffer( source );
-					CI_LOG_I( "\t- [BufferPlayerNode] loaded SourceFile with source at path: " << dataSource->getFilePath() );
+					if( ! track )
+						return;
+
+					// Decoded on a worker thread. The player gets the full length Buffer once its first seconds are in, the rest fills in while it plays.
+					// Releasing a previous load (the file changed on disk) cancels it.
+					track->mBufferLoad = mFileLoader->loadBuffer( dataSource, getContext()->getSampleRate(),
+						[this, weakTrack]( const BufferLoadRef &load ) {
+							auto track = weakTrack.lock();
+							if( ! track )
+								return;
+
+							track->mBufferPlayerNode->setBuffer( load->getBuffer() );
+							mTransport->syncPlayer( track->mBufferPlayerNode );
+						},
+						[this, audioFilePath, timeLastWrite]( const BufferLoadRef &load ) {
+							if( load->isFailed() )
+								return;
+
+							mBufferCache[audioFilePath] = { load->getBuffer(), timeLastWrite };
+							CI_LOG_I( "\t- [BufferPlayerNode] loaded Buffer in " << load->getLoadSeconds() << "s" << ( load->isFromCache() ? " (from resample cache)" : "" ) << " with source at path: " << load->getFilePath() );
+						} );
 				} );
 			}
 
@@ -571,6 +725,11 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 			track->mInputNode >> track->mGain >> track->mMonitorSpectralNode;
 		}
 		else if( inputType == InputType::INPUT_DEVICE ) {
+			if( mOfflineContext ) {
+				CI_LOG_W( "input devices aren't available when rendering offline, skipping track '" << id << "'" );
+				continue;
+			}
+
 			const auto deviceName = trackInfo.get<string>( "deviceName" );
 
 			const size_t channelOffset = trackInfo.get<size_t>( "channelOffset" );
@@ -595,28 +754,57 @@ void AudioAnalyzer::initTracks( const ma::Info &config )
 				track->mInputDeviceNode = ctx->createInputDeviceNode( inputDevice );
 				track->mInputNode = track->mInputDeviceNode;
 			}
+			mSharedInputDeviceNodes[deviceName] = track->mInputDeviceNode;
 
-			if( channelOffset == 0 && numChannels == track->mInputDeviceNode->getDevice()->getNumInputChannels() ) {
-				track->mInputDeviceNode >> track->mGain >> track->mMonitorSpectralNode;
+			const size_t deviceChannels = track->mInputDeviceNode->getDevice()->getNumInputChannels();
+			if( numChannels == 0 || channelOffset + numChannels > deviceChannels ) {
+				CI_LOG_E( "channel params out of range for track '" << id << "'. channelOffset: " << channelOffset << ", numChannels: " << numChannels );
+				continue;
+			}
+
+			// All tracks of a device are analyzed by one node that takes every channel of the device
+			auto &spectralNode = mSharedSpectralNodes[deviceName];
+			if( ! spectralNode ) {
+				spectralNode = ctx->makeNode( new MultichannelSpectralNode( spectralFormat ) );
+				spectralNode->setName( "MultichannelSpectralNode (" + deviceName + ")" );
+				track->mInputDeviceNode >> spectralNode;
+			}
+			track->mSpectralNode = spectralNode;
+			track->mChannelOffset = channelOffset;
+			track->mNumChannels = numChannels;
+
+			if( channelOffset == 0 && numChannels == deviceChannels ) {
+				track->mInputDeviceNode >> track->mGain >> mMasterGain;
+				trackOutput = track->mGain;
 			}
 			else {
-				// we need a router to split up channels. But first check that we won't go out of range in the device's channels
-				if( channelOffset + numChannels > track->mInputDeviceNode->getDevice()->getNumInputChannels() ) {
-					CI_LOG_E( "channel params out of range for track '" << id << "'. channelOffset: " << channelOffset << ", numChannels: " << numChannels );
-					continue;
-				}
+				// we need a router to split up channels for what is heard
 				auto router = ctx->makeNode( new ci::audio::ChannelRouterNode( ci::audio::Node::Format().channels( 1 ) ) );
-				track->mInputDeviceNode >> track->mGain >> router->route( channelOffset, 0, numChannels ) >> track->mMonitorSpectralNode;			
+				track->mInputDeviceNode >> track->mGain >> router->route( channelOffset, 0, numChannels ) >> mMasterGain;
+				trackOutput = router;
 			}
 			track->mInputDeviceNode->setName( "InputDeviceNode (" + deviceName + ")" );
 			track->mInputNode = track->mInputDeviceNode;
 		}
 
+		if( featuresEnabled ) {
+			// auto-pulled, so it doesn't need to be connected to the output
+			track->mFeatureExtractorNode = ctx->makeNode( new FeatureExtractorNode( featuresFormat ) );
+			trackOutput >> track->mFeatureExtractorNode;
+		}
+
 		track->setBarkBandsEnabled( true ); // TODO: make optional?
 
 		mTracks.push_back( track );
 	}
 
+	vector<ci::audio::SamplePlayerNodeRef> players;
+	for( const auto &track : mTracks ) {
+		if( track->mSamplePlayerNode )
+			players.push_back( track->mSamplePlayerNode );
+	}
+	mTransport->setPlayers( players );
+
 	seek( 0, false );
 
 	CI_LOG_I( "complete." );
@@ -629,7 +817,10 @@ ci::fs::path AudioAnalyzer::resolvePathFromUrl( const std::string &url )
 	if( ! result.empty() )
 		return result;
 
-	// default: try ci::app asset system
+	// default: try ci::app asset system, headless there is none so the url is used as a path
+	if( ! app::AppBase::get() )
+		return url;
+
 	return app::getAssetPath( url );
 }
 
@@ -649,8 +840,8 @@ void AudioAnalyzer::keyDown( app::KeyEvent &event )
 	bool handled = true;
 	if( event.isShiftDown() ) {
 		if( event.getChar() == '?' ) {
-			setEnabled( ! ci::audio::master()->isEnabled() );
-			CI_LOG_I( "audio::Context enabled: " << boolalpha << ci::audio::master()->isEnabled() << ", AudioAnalyzer paused: " << mIsPaused << dec );
+			setEnabled( ! getContext()->isEnabled() );
+			CI_LOG_I( "audio::Context enabled: " << boolalpha << getContext()->isEnabled() << ", AudioAnalyzer paused: " << mIsPaused << dec );
 		}
 		else if( event.getChar() == ' ' ) {
 			setPaused( ! isPaused() );
@@ -683,7 +874,8 @@ void AudioAnalyzer::keyDown( app::KeyEvent &event )
 
 void AudioAnalyzer::update()
 {
-	bool analyzerParamsEnabled = ma::hud()->checkBox( "analyzer params", false )->isEnabled();
+	// offline analyzers (ex. benchmarks) shouldn't add to the app's Hud
+	bool analyzerParamsEnabled = ! isOffline() && isAppWindowAvailable() && ma::hud()->checkBox( "analyzer params", false )->isEnabled();
 	if( analyzerParamsEnabled && ! mTracks.empty() ) {
 		const auto &firstTrack = mTracks[0];
 		float volumeSmoothning = firstTrack->getVolumeSmoothFactor(); 
@@ -702,15 +894,42 @@ void AudioAnalyzer::update()
 		}
 	}
 
+	// analyze every input device in one pass before its tracks read the results
+	for( const auto &nodePair : mSharedSpectralNodes ) {
+		nodePair.second->update();
+	}
+
 	for( const auto &track : mTracks ) {
 		track->update();
 	}	
 }
 
+void AudioAnalyzer::renderOffline( double seconds, double updateIntervalSeconds, const std::function<void ()> &updateFn )
+{
+	if( ! mOfflineContext ) {
+		CI_LOG_E( "only available when constructed with an OfflineContext" );
+		return;
+	}
+
+	// the OfflineContext always processes whole blocks, so chunks are too, keeping the render length exact
+	const size_t framesPerBlock = mOfflineContext->getFramesPerBlock();
+	const size_t numFrames = (size_t)lround( seconds * (double)mOfflineContext->getSampleRate() );
+	const size_t updateBlocks = max<size_t>( (size_t)ceil( updateIntervalSeconds * (double)mOfflineContext->getSampleRate() / (double)framesPerBlock ), 1 );
+	const size_t chunkFrames = updateBlocks * framesPerBlock;
+
+	for( size_t frame = 0; frame < numFrames; frame += chunkFrames ) {
+		mOfflineContext->renderBlocks( min( chunkFrames, numFrames - frame ), []( const ci::audio::Buffer &, size_t, size_t ) {} );
+
+		update();
+		if( updateFn )
+			updateFn();
+	}
+}
+
 void AudioAnalyzer::printInfo()
 {
 	stringstream str;
-	auto ctx = ci::audio::master();
+	auto ctx = getContext();
 
 	str << "\n-------------- Context info --------------\n";
 	str << "enabled: " << boolalpha << ctx->isEnabled() << ", samplerate: " << ctx->getSampleRate() << ", frames per block: " << ctx->getFramesPerBlock() << endl;
@@ -724,7 +943,7 @@ void AudioAnalyzer::printInfo()
 	}
 	
 	str << "-------------- Graph configuration: --------------" << endl;
-	str << ci::audio::master()->printGraphToString();
+	str << getContext()->printGraphToString();
 	str << "--------------------------------------------------" << endl;
 
 	CI_LOG_I( str.str() );
@@ -43,8 +43,14 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "mason/Export.h"
 #include "mason/Info.h"
+#include "mason/audio/AudioFileLoader.h"
+#include "mason/audio/FeatureExtractor.h"
+#include "mason/audio/MultichannelSpectralNode.h"
+#include "mason/audio/OfflineContext.h"
+#include "mason/audio/Transport.h"
 
 #include <array>
+#include <functional>
 
 namespace mason { namespace audio {
 
@@ -86,6 +92,12 @@ public:
 	float	getSpectralCentroid() const;
 	//! Returns the samplerate of this Track
 	float	getSampleRate() const;
+	//! Returns the FFT size used to compute the magnitude spectrum.
+	size_t	getFftSize() const;
+	//! Returns the number of samples analyzed per spectrum.
+	size_t	getWindowSize() const;
+	//! Returns the number of bins in the magnitude spectrum.
+	size_t	getNumBins() const;
 
 	//!
 	const std::string&	getId() const;
@@ -95,6 +107,10 @@ public:
 	void setBarkBandsEnabled( bool enable );
 	const std::vector<FrequencyBand>&	getFrequencyBands() const	{ return mFreqBands; }
 
+	//! Returns true if this Track is computing extended audio features (enabled with the "features" section of the analyzer config).
+	bool	isFeatureExtractionEnabled() const		{ return (bool)mFeatureExtractorNode; }
+	//! Returns the history of extended audio features computed on the audio thread. Must only be called if isFeatureExtractionEnabled() returns true.
+	const FeatureHistory&	getFeatureHistory() const	{ return mFeatureExtractorNode->getHistory(); }
 
 
 	//!
@@ -103,10 +119,16 @@ public:
 	double	getSamplePlaybackTime() const;
 	//!
 	double	getSampleDuration() const;
+	//! Returns the progress of decoding this Track's sample file if it is a buffer player, otherwise null.
+	const BufferLoadRef&	getBufferLoad() const	{ return mBufferLoad; }
 
 	ci::audio::GainNodeRef	getGainNode() const	{ return mGain; }
 	ci::audio::SamplePlayerNodeRef	getSamplePlayerNode() const	{ return mSamplePlayerNode; }
+	//! Returns the Node that analyzes this Track if it plays a sample file, otherwise null.
 	ci::audio::MonitorSpectralNodeRef	getMonitorSpectralNode() const	{ return mMonitorSpectralNode; }
+	//! Returns the Node that analyzes all of the channels of this Track's input device, which is shared with the device's other Tracks. Null if this isn't an input device Track.
+	MultichannelSpectralNodeRef	getSpectralNode() const	{ return mSpectralNode; }
+	FeatureExtractorNodeRef	getFeatureExtractorNode() const	{ return mFeatureExtractorNode; }
 
 	ci::fs::path	getSampleFilePath() const;
 	
@@ -126,9 +148,15 @@ private:
 	ci::audio::InputDeviceNodeRef		mInputDeviceNode;
 
 	ci::audio::MonitorSpectralNodeRef	mMonitorSpectralNode;
+	MultichannelSpectralNodeRef			mSpectralNode;		// used instead of mMonitorSpectralNode for input device tracks
+	size_t								mChannelOffset = 0;	// channels of mSpectralNode that this track analyzes
+	size_t								mNumChannels = 0;
+	float								mSpectrumSmoothingFactor = 0.5f; // only used with mSpectralNode, since it is shared
+	FeatureExtractorNodeRef				mFeatureExtractorNode;
 	ci::audio::GainNodeRef				mGain;
 	std::vector<float>					mMagSpectrum;
 	std::string							mSampleFileName;
+	BufferLoadRef						mBufferLoad;
 	std::string							mId;
 	int									mIndex = -1;
 	float								mGainValue = 1;
@@ -161,11 +189,26 @@ typedef ci::signals::Signal<ci::fs::path ( const std::string & )>	SignalResolveP
 
 class MA_API AudioAnalyzer {
 public:
+	struct Options {
+		Options() {}
+
+		//! Sets the Context that the graph is built in. Passing an OfflineContext runs without audio devices, driven by renderOffline(). Defaults to ci::audio::master().
+		Options&	context( const std::shared_ptr<ci::audio::Context> &context )	{ mContext = context; return *this; }
+		//! Sets whether the hotkeys are connected to the app window's key down signal. Defaults to true.
+		Options&	keyboardShortcuts( bool enable )	{ mKeyboardShortcuts = enable; return *this; }
+
+		const std::shared_ptr<ci::audio::Context>&	getContext() const	{ return mContext; }
+		bool	isKeyboardShortcutsEnabled() const	{ return mKeyboardShortcuts; }
+
+	private:
+		std::shared_ptr<ci::audio::Context>	mContext;
+		bool	mKeyboardShortcuts = true;
+	};
 
 	//! Call whenever configuration changes
 	void initialize( const Info &config );
 	
-	AudioAnalyzer();
+	AudioAnalyzer( const Options &options = Options() );
 	AudioAnalyzer( const AudioAnalyzer& ) = delete;
 	AudioAnalyzer& operator=( const AudioAnalyzer& ) = delete;
 	~AudioAnalyzer();
@@ -188,6 +231,8 @@ public:
 	bool isPaused() const		{ return mIsPaused; }
 	//! Seeks samples to the specified time
 	void seek( double time, bool playSnippet = false );
+	//! Returns the Transport that starts, stops and seeks all sample tracks together, and its clock for syncing visuals.
+	const TransportRef& getTransport() const	{ return mTransport; }
 	//! Set the master gain (volume) in normalized (0:1) dB. This only effects what you hear, not what you see.
 	void setMasterGain( float value, double rampSeconds = 0.3 );
 	//! Returns the master game in normalized (0:1) dB.
@@ -195,6 +240,16 @@ public:
 
 	void update();
 
+	//! Returns the Context the graph is built in.
+	ci::audio::Context*	getContext() const;
+	//! Returns true if the graph is rendered with an OfflineContext rather than audio devices.
+	bool	isOffline() const	{ return (bool)mOfflineContext; }
+	//! \brief Renders \a seconds of all tracks with the OfflineContext, calling update() every \a updateIntervalSeconds of audio.
+	//!
+	//! The interval is rounded up to whole blocks. \a updateFn is called after each update(), for example to read or record track features.
+	//! Sample files load synchronously when offline, so tracks are ready as soon as initialize() returns. Input device tracks are skipped.
+	void	renderOffline( double seconds, double updateIntervalSeconds = 1.0 / 60.0, const std::function<void ()> &updateFn = nullptr );
+
 	const std::vector<TrackRef>& getTracks() const		{ return mTracks; }
 	
 	const ma::audio::TrackRef&	getTrack( int index ) const;
@@ -206,13 +261,17 @@ public:
 private:
 	void initEntry( const Info &config );
 	void initContext( const Info &config );
+	void initOfflineContext( const Info &config );
 	void initTracks( const Info &config );
 	ci::fs::path resolvePathFromUrl( const std::string &url );
 
 	void keyDown( ci::app::KeyEvent &event );
 	void printInfo();
 	
+	Options							mOptions;
+	OfflineContextRef				mOfflineContext; // set if mOptions has an OfflineContext
 	ci::audio::GainNodeRef			mMasterGain;
+	TransportRef					mTransport;
 	std::vector<TrackRef>			mTracks;
 	ci::signals::Signal<void ()>	mSignalTracksChanged;
 	SignalResolvePath				mSignalResolvePath;
@@ -220,8 +279,10 @@ private:
 	double							mSeekRampSeconds = 0.02;
 
 	ci::signals::ScopedConnection	mConnKeyDown;
+	std::unique_ptr<AudioFileLoader>	mFileLoader; // decodes sample files for all tracks in parallel
 
 	std::map<std::string, ci::audio::InputDeviceNodeRef>	mSharedInputDeviceNodes; // in the case of multi-channel inputs, share InputDeviceNodes
+	std::map<std::string, MultichannelSpectralNodeRef>		mSharedSpectralNodes; // one per input device, analyzes the channels of all its tracks in one pass
 	std::map<ci::fs::path, std::pair<ci::audio::BufferRef, ci::fs::file_time_type>>	mBufferCache; // only load audio Buffers once until they are updated on file
 };
 
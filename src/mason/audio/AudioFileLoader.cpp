@@ -0,0 +1,423 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mason/audio/AudioFileLoader.h"
+#include "mason/audio/SpectrogramCache.h"
+#include "mason/Dispatch.h"
+#include "mason/MappedFile.h"
+
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+// Fills \a buffer in chunks of \a chunkFrames by calling \a readFn( buffer, frameOffset, numFrames ), which returns the number of frames it read.
+// Publishes progress after every chunk with \a progressFn( numFramesLoaded ), which returns false once the load has been released.
+// Returns true if every frame was read.
+template <typename ProgressFn, typename ReadFn>
+bool fillProgressively( ci::audio::Buffer *buffer, size_t chunkFrames, size_t playableFrames, const function<void()> &playableFn, ProgressFn progressFn, ReadFn readFn )
+{
+	const size_t numFrames = buffer->getNumFrames();
+	bool playableSent = false;
+	size_t offset = 0;
+	while( offset < numFrames ) {
+		const size_t framesRead = readFn( buffer, offset, min( chunkFrames, numFrames - offset ) );
+		if( framesRead == 0 )
+			break;
+
+		offset += framesRead;
+		if( ! progressFn( offset ) )
+			return false;
+
+		if( ! playableSent && offset >= playableFrames ) {
+			playableFn();
+			playableSent = true;
+		}
+	}
+
+	if( ! playableSent )
+		playableFn();
+
+	return offset == numFrames;
+}
+
+string toHex( uint64_t x )
+{
+	stringstream str;
+	str << hex << setw( 16 ) << setfill( '0' ) << x;
+	return str.str();
+}
+
+// runs on worker threads, so filesystem errors are logged and return false rather than throwing
+bool writeResampleCache( const fs::path &path, uint64_t contentHash, size_t sampleRate, const ci::audio::Buffer &buffer )
+{
+	std::error_code ec;
+	if( ! path.parent_path().empty() && ! fs::exists( path.parent_path(), ec ) ) {
+		fs::create_directories( path.parent_path(), ec );
+		if( ec ) {
+			CI_LOG_E( "failed to create resample cache directory: " << path.parent_path() << ", error: " << ec.message() );
+			return false;
+		}
+	}
+
+	// written to a temp file first so that a partially written cache is never opened. The temp name is unique to this thread,
+	// since other workers (or loaders) may be writing the same cache file at the same time
+	fs::path tempPath = path;
+	tempPath += "." + toHex( hash<thread::id>()( this_thread::get_id() ) ) + ".tmp";
+
+	ResampleCacheHeader header;
+	header.mContentHash = contentHash;
+	header.mNumFrames = buffer.getNumFrames();
+	header.mSampleRate = (uint32_t)sampleRate;
+	header.mNumChannels = (uint32_t)buffer.getNumChannels();
+
+	{
+		ofstream stream( tempPath.string(), ios::binary | ios::trunc );
+		stream.write( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+		stream.write( reinterpret_cast<const char *>( buffer.getData() ), buffer.getSize() * sizeof( float ) );
+		if( stream.fail() ) {
+			CI_LOG_E( "failed to write resample cache: " << tempPath );
+			stream.close();
+			fs::remove( tempPath, ec );
+			return false;
+		}
+	}
+
+	// rename() won't replace an existing file on all platforms. If another worker got there first, its file is just as good
+	if( fs::exists( path, ec ) ) {
+		fs::remove( path, ec );
+	}
+	fs::rename( tempPath, path, ec );
+	if( ec ) {
+		CI_LOG_W( "failed to rename resample cache: " << tempPath << " to: " << path << ", error: " << ec.message() );
+		fs::remove( tempPath, ec );
+		return false;
+	}
+
+	return true;
+}
+
+//! Runs \a fn on the main thread, or right away if there is no \a queue because loads are synchronous.
+void dispatchOnMain( DispatchQueue *queue, const function<void ()> &fn )
+{
+	if( queue )
+		queue->dispatchOnMain( fn );
+	else
+		fn();
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// AudioFileLoader
+// ----------------------------------------------------------------------------------------------------
+
+AudioFileLoader::AudioFileLoader( const Options &options )
+	: mOptions( options )
+{
+	if( mOptions.isSynchronous() )
+		return;
+
+	size_t numThreads = mOptions.getNumThreads();
+	if( numThreads == 0 )
+		numThreads = max<size_t>( thread::hardware_concurrency() / 2, 1 );
+
+	mQueue = make_unique<DispatchQueue>( "AudioFileLoader", numThreads );
+}
+
+AudioFileLoader::~AudioFileLoader()
+{
+}
+
+size_t AudioFileLoader::getNumQueuedOperations() const
+{
+	return mQueue ? mQueue->getNumQueuedOperations() : 0;
+}
+
+void AudioFileLoader::dispatch( const function<void ()> &fn )
+{
+	if( mQueue )
+		mQueue->dispatch( fn );
+	else
+		fn();
+}
+
+void AudioFileLoader::loadSourceFile( const DataSourceRef &dataSource, size_t sampleRate, const function<void( const ci::audio::SourceFileRef & )> &loadedFn )
+{
+	auto queue = mQueue.get();
+	dispatch( [queue, dataSource, sampleRate, loadedFn] {
+		ci::audio::SourceFileRef source;
+		try {
+			source = ci::audio::load( dataSource, sampleRate );
+		}
+		catch( std::exception &exc ) {
+			CI_LOG_EXCEPTION( "failed to open audio file: " << dataSource->getFilePath(), exc );
+			return;
+		}
+
+		dispatchOnMain( queue, [source, loadedFn] {
+			loadedFn( source );
+		} );
+	} );
+}
+
+BufferLoadRef AudioFileLoader::loadBuffer( const DataSourceRef &dataSource, size_t sampleRate, const function<void( const BufferLoadRef & )> &playableFn,
+											const function<void( const BufferLoadRef & )> &completeFn )
+{
+	const fs::path filePath = dataSource->getFilePath();
+	const auto inFlightKey = make_pair( filePath, sampleRate );
+	auto queue = mQueue.get();
+
+	std::error_code ec;
+	const auto fileTime = filePath.empty() ? fs::file_time_type() : fs::last_write_time( filePath, ec );
+
+	// join a load of the same file at the same samplerate that hasn't completed yet, rather than decoding it twice. A load of an
+	// older version of the file isn't joined, it is replaced.
+	for( auto it = mInFlightLoads.begin(); it != mInFlightLoads.end(); ) {
+		auto load = it->second.lock();
+		if( ! load || load->mCompleteIssued )
+			it = mInFlightLoads.erase( it );
+		else
+			++it;
+	}
+
+	auto inFlightIt = filePath.empty() ? mInFlightLoads.end() : mInFlightLoads.find( inFlightKey );
+	auto load = inFlightIt != mInFlightLoads.end() ? inFlightIt->second.lock() : nullptr;
+	if( load && load->mFileTime == fileTime ) {
+		if( completeFn )
+			load->mCompleteFns.push_back( completeFn );
+
+		if( playableFn && load->mPlayableIssued ) {
+			weak_ptr<BufferLoad> weakLoad = load;
+			dispatchOnMain( queue, [weakLoad, playableFn] {
+				auto load = weakLoad.lock();
+				if( load )
+					playableFn( load );
+			} );
+		}
+		else if( playableFn ) {
+			load->mPlayableFns.push_back( playableFn );
+		}
+
+		return load;
+	}
+
+	auto result = make_shared<BufferLoad>();
+	result->mFilePath = filePath;
+	result->mFileTime = fileTime;
+	if( playableFn )
+		result->mPlayableFns.push_back( playableFn );
+	if( completeFn )
+		result->mCompleteFns.push_back( completeFn );
+
+	if( ! filePath.empty() )
+		mInFlightLoads[inFlightKey] = result;
+
+	const Options options = mOptions;
+	weak_ptr<BufferLoad> weakLoad = result;
+
+	// callbacks are skipped if the BufferLoad was released by the time they reach the main thread. The Buffer is only published
+	// there too, since getBuffer() can be called from the main thread at any time.
+	auto dispatchCallback = [queue, weakLoad]( bool complete, const ci::audio::BufferRef &buffer ) {
+		dispatchOnMain( queue, [weakLoad, complete, buffer] {
+			auto load = weakLoad.lock();
+			if( ! load )
+				return;
+
+			if( ! load->mBuffer )
+				load->mBuffer = buffer;
+
+			// moved out first, as a callback may start another load of the same file
+			auto &pending = complete ? load->mCompleteFns : load->mPlayableFns;
+			auto callbacks = std::move( pending );
+			pending.clear();
+
+			if( complete )
+				load->mCompleteIssued = true;
+			else
+				load->mPlayableIssued = true;
+
+			for( const auto &fn : callbacks )
+				fn( load );
+		} );
+	};
+
+	dispatch( [dataSource, sampleRate, options, weakLoad, dispatchCallback] {
+		Timer timer( true );
+		auto load = weakLoad.lock();
+		if( ! load )
+			return;
+
+		// only a weak reference is kept while decoding, so that releasing the BufferLoad cancels it
+		const fs::path filePath = load->mFilePath;
+		load.reset();
+
+		auto finish = [&]( const ci::audio::BufferRef &buffer, bool fromCache, bool failed ) {
+			auto load = weakLoad.lock();
+			if( ! load )
+				return;
+
+			load->mFromCache = fromCache;
+			load->mFailed = failed;
+			load->mLoadSeconds = timer.getSeconds();
+			load->mComplete = ! failed;
+			dispatchCallback( true, buffer );
+		};
+
+		// the Buffer being filled, handed to the BufferLoad on the main thread along with the playable callback
+		ci::audio::BufferRef currentBuffer;
+		auto setBuffer = [&]( const ci::audio::BufferRef &buffer ) {
+			currentBuffer = buffer;
+		};
+
+		const size_t chunkFrames = max<size_t>( size_t( options.getChunkSeconds() * sampleRate ), 1 );
+		const size_t playableFrames = size_t( options.getPlayableSeconds() * sampleRate );
+		auto notifyPlayable = [&] { dispatchCallback( false, currentBuffer ); };
+		auto updateProgress = [&]( size_t numFramesLoaded ) {
+			auto load = weakLoad.lock();
+			if( load )
+				load->mNumFramesLoaded = numFramesLoaded;
+			return (bool)load;
+		};
+
+		// worker threads have nothing to catch exceptions, so anything thrown while loading is reported as a failed load
+		auto decode = [&] {
+			uint64_t contentHash = 0;
+			fs::path cachePath;
+			if( options.isResampleCacheEnabled() && ! filePath.empty() ) {
+				contentHash = hashFileContents( filePath, options.getCacheDir() );
+				if( contentHash )
+					cachePath = getResampleCachePath( options.getCacheDir(), contentHash, sampleRate );
+			}
+
+			// Copy from the resample cache if there is a valid one for this file and samplerate
+			std::error_code ec;
+			if( ! cachePath.empty() && fs::exists( cachePath, ec ) ) {
+				MappedFile file;
+				ResampleCacheHeader header;
+				bool valid = file.open( cachePath ) && file.getSize() >= sizeof( header );
+				if( valid ) {
+					memcpy( &header, file.getData(), sizeof( header ) );
+					valid = header.mMagic == ResampleCacheHeader::MAGIC && header.mVersion == ResampleCacheHeader::VERSION
+						&& header.mContentHash == contentHash && header.mSampleRate == sampleRate && header.mNumChannels > 0
+						&& file.getSize() >= sizeof( header ) + header.mNumFrames * header.mNumChannels * sizeof( float );
+				}
+
+				if( valid ) {
+					const size_t numFrames = (size_t)header.mNumFrames;
+					const float *samples = reinterpret_cast<const float *>( file.getData() + sizeof( header ) );
+					auto buffer = make_shared<ci::audio::Buffer>( numFrames, header.mNumChannels );
+					setBuffer( buffer );
+
+					bool complete = fillProgressively( buffer.get(), chunkFrames, playableFrames, notifyPlayable, updateProgress,
+						[samples, numFrames]( ci::audio::Buffer *buffer, size_t offset, size_t count ) {
+							for( size_t ch = 0; ch < buffer->getNumChannels(); ch++ )
+								memcpy( buffer->getChannel( ch ) + offset, samples + ch * numFrames + offset, count * sizeof( float ) );
+							return count;
+						} );
+
+					if( complete )
+						finish( buffer, true, false );
+
+					return;
+				}
+
+				CI_LOG_W( "resample cache is invalid, decoding instead: " << cachePath );
+			}
+
+			ci::audio::SourceFileRef source;
+			try {
+				source = ci::audio::load( dataSource, sampleRate );
+			}
+			catch( std::exception &exc ) {
+				CI_LOG_EXCEPTION( "failed to open audio file: " << filePath, exc );
+				finish( nullptr, false, true );
+				return;
+			}
+
+			auto buffer = make_shared<ci::audio::Buffer>( source->getNumFrames(), source->getNumChannels() );
+			setBuffer( buffer );
+
+			ci::audio::BufferDynamic chunk( chunkFrames, source->getNumChannels() );
+			bool complete = fillProgressively( buffer.get(), chunkFrames, playableFrames, notifyPlayable, updateProgress,
+				[&source, &chunk]( ci::audio::Buffer *buffer, size_t offset, size_t count ) {
+					chunk.setNumFrames( count );
+					const size_t framesRead = source->read( &chunk );
+					for( size_t ch = 0; ch < buffer->getNumChannels(); ch++ )
+						memcpy( buffer->getChannel( ch ) + offset, chunk.getChannel( ch ), framesRead * sizeof( float ) );
+					return framesRead;
+				} );
+
+			if( ! complete ) {
+				auto load = weakLoad.lock();
+				if( load ) {
+					CI_LOG_W( "decoded " << load->getNumFramesLoaded() << " of " << buffer->getNumFrames() << " frames from: " << filePath );
+					load.reset();
+
+					// truncated: the tail of the Buffer is silent, so this is reported as failed rather than complete
+					finish( buffer, false, true );
+				}
+				return;
+			}
+
+			// only resampled files are cached, decoding alone is cheap enough that the disk space isn't worth it
+			if( ! cachePath.empty() && source->getSampleRateNative() != sampleRate ) {
+				writeResampleCache( cachePath, contentHash, sampleRate, *buffer );
+			}
+
+			finish( buffer, false, false );
+		};
+
+		try {
+			decode();
+		}
+		catch( std::exception &exc ) {
+			CI_LOG_EXCEPTION( "failed to load audio file: " << filePath, exc );
+			finish( currentBuffer, false, true );
+		}
+	} );
+
+	return result;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Free functions
+// ----------------------------------------------------------------------------------------------------
+
+fs::path getResampleCachePath( const fs::path &cacheDir, uint64_t contentHash, size_t sampleRate )
+{
+	return cacheDir / ( toHex( contentHash ) + "_" + to_string( sampleRate ) + ".resampled" );
+}
+
+} } // namespace mason::audio
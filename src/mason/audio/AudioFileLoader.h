@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/audio/Buffer.h"
+#include "cinder/audio/Source.h"
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+
+#include "mason/Export.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace mason {
+
+class DispatchQueue;
+
+namespace audio {
+
+using AudioFileLoaderRef = std::shared_ptr<class AudioFileLoader>;
+using BufferLoadRef = std::shared_ptr<class BufferLoad>;
+
+//! \brief Binary layout of a resample cache file, all values little-endian.
+//!
+//! The 64 byte header is followed by numChannels * numFrames float32 samples, channel-major (the same layout as ci::audio::Buffer).
+struct ResampleCacheHeader {
+	static const uint32_t MAGIC = 0x4353524d; // "MRSC"
+	static const uint32_t VERSION = 1;
+
+	uint32_t	mMagic = MAGIC;
+	uint32_t	mVersion = VERSION;
+	uint64_t	mContentHash = 0;
+	uint64_t	mNumFrames = 0;
+	uint32_t	mSampleRate = 0;
+	uint32_t	mNumChannels = 0;
+	uint32_t	mReserved[8] = {};
+};
+
+static_assert( sizeof( ResampleCacheHeader ) == 64, "ResampleCacheHeader must stay 64 bytes so sample data is aligned" );
+
+//! \brief Progress of one Buffer being decoded by AudioFileLoader.
+//!
+//! The Buffer is allocated at its full length before decoding starts and filled in place, getNumFramesLoaded() tells how much of it is valid.
+//! Releasing the last reference to a BufferLoad cancels the remaining work. Loads of the same file at the same samplerate that overlap share one BufferLoad.
+class MA_API BufferLoad {
+  public:
+	//! Returns the full length Buffer, which may still be filling in. Null until the playable callback has been issued. Only call this from the
+	//! main thread (or the thread that loads when Options::synchronous() is set), which is where it is assigned.
+	const ci::audio::BufferRef&	getBuffer() const	{ return mBuffer; }
+	//! Returns the path of the file being loaded, which may be empty if the DataSource isn't a file.
+	const ci::fs::path&		getFilePath() const			{ return mFilePath; }
+	//! Returns the number of frames that have been decoded so far, safe to call from any thread.
+	size_t	getNumFramesLoaded() const	{ return mNumFramesLoaded; }
+	//! Returns true once every frame has been decoded.
+	bool	isComplete() const			{ return mComplete; }
+	//! Returns true if the file couldn't be opened or decoded, or if decoding stopped before the end. In that case getBuffer() holds the
+	//! frames that were decoded, followed by silence.
+	bool	isFailed() const			{ return mFailed; }
+	//! Returns true if the samples were copied from the resample cache rather than decoded. Valid once the complete callback has been issued.
+	bool	isFromCache() const			{ return mFromCache; }
+	//! Returns the number of seconds the worker spent on this load. Valid once the complete callback has been issued.
+	double	getLoadSeconds() const		{ return mLoadSeconds; }
+
+  private:
+	ci::audio::BufferRef	mBuffer;
+	ci::fs::path			mFilePath;
+	std::atomic<size_t>		mNumFramesLoaded = { 0 };
+	std::atomic<bool>		mComplete = { false };
+	std::atomic<bool>		mFailed = { false };
+	bool					mFromCache = false;
+	double					mLoadSeconds = 0;
+
+	// only touched on the main thread, so loads that join this one can add their callbacks
+	std::vector<std::function<void( const BufferLoadRef & )>>	mPlayableFns, mCompleteFns;
+	ci::fs::file_time_type	mFileTime;
+	bool	mPlayableIssued = false;
+	bool	mCompleteIssued = false;
+
+	friend class AudioFileLoader;
+};
+
+//! \brief Opens and decodes audio files on a pool of worker threads.
+//!
+//! Callbacks are always issued on the main thread, unless Options::synchronous() is set. Files that need samplerate conversion are written to a resample cache
+//! after they are decoded, keyed by content hash and samplerate, so later loads of the same file copy samples instead of resampling again.
+class MA_API AudioFileLoader {
+  public:
+	struct Options {
+		Options() {}
+
+		//! Sets the number of worker threads. Defaults to half of the hardware threads, at least one.
+		Options&	numThreads( size_t n )				{ mNumThreads = n; return *this; }
+		//! Sets the directory that resampled files are cached in. Defaults to "build/audio".
+		Options&	cacheDir( const ci::fs::path &dir )	{ mCacheDir = dir; return *this; }
+		//! Sets whether resampled files are cached on disk. Defaults to true.
+		Options&	resampleCache( bool enable )		{ mResampleCache = enable; return *this; }
+		//! Sets how many seconds of a Buffer need to be decoded before it is handed out as playable. Defaults to 2.
+		Options&	playableSeconds( double seconds )	{ mPlayableSeconds = seconds; return *this; }
+		//! Sets how many seconds are decoded between checks for cancellation and progress updates. Defaults to 0.5.
+		Options&	chunkSeconds( double seconds )		{ mChunkSeconds = seconds; return *this; }
+		//! Sets whether loads run on the calling thread and issue their callbacks before returning, for use without an app (ex. headless analysis). Defaults to false.
+		Options&	synchronous( bool enable = true )	{ mSynchronous = enable; return *this; }
+
+		size_t				getNumThreads() const		{ return mNumThreads; }
+		const ci::fs::path&	getCacheDir() const			{ return mCacheDir; }
+		bool				isResampleCacheEnabled() const	{ return mResampleCache; }
+		double				getPlayableSeconds() const	{ return mPlayableSeconds; }
+		double				getChunkSeconds() const		{ return mChunkSeconds; }
+		bool				isSynchronous() const		{ return mSynchronous; }
+
+	  private:
+		size_t			mNumThreads = 0;
+		ci::fs::path	mCacheDir = "build/audio";
+		bool			mResampleCache = true;
+		double			mPlayableSeconds = 2;
+		double			mChunkSeconds = 0.5;
+		bool			mSynchronous = false;
+	};
+
+	AudioFileLoader( const Options &options = Options() );
+	~AudioFileLoader();
+
+	const Options&	getOptions() const	{ return mOptions; }
+
+	//! Opens \a dataSource as a SourceFile that outputs \a sampleRate on a worker thread, then calls \a loadedFn on the main thread. \a loadedFn isn't called if opening fails.
+	void loadSourceFile( const ci::DataSourceRef &dataSource, size_t sampleRate, const std::function<void( const ci::audio::SourceFileRef & )> &loadedFn );
+	//! Decodes \a dataSource into a Buffer at \a sampleRate on a worker thread. \a playableFn is called on the main thread once the first
+	//! Options::playableSeconds() are in the Buffer, decoding then continues into the same Buffer until \a completeFn is called. Either callback
+	//! may be empty, neither is called if the returned BufferLoad has been released. If the load fails, only \a completeFn is called.
+	//! If the same file is already loading at \a sampleRate, that BufferLoad is returned and the callbacks are added to it.
+	BufferLoadRef loadBuffer( const ci::DataSourceRef &dataSource, size_t sampleRate, const std::function<void( const BufferLoadRef & )> &playableFn,
+								const std::function<void( const BufferLoadRef & )> &completeFn );
+
+	//! Returns the number of loads waiting for a worker thread.
+	size_t	getNumQueuedOperations() const;
+
+  private:
+	void	dispatch( const std::function<void ()> &fn );
+
+	Options							mOptions;
+	std::unique_ptr<DispatchQueue>	mQueue; // null when loading synchronously
+
+	std::map<std::pair<ci::fs::path, size_t>, std::weak_ptr<BufferLoad>>	mInFlightLoads; // loads that can still be joined, keyed by file path and samplerate
+};
+
+//! Returns the path within \a cacheDir where the file with \a contentHash, resampled to \a sampleRate, is cached.
+MA_API ci::fs::path	getResampleCachePath( const ci::fs::path &cacheDir, uint64_t contentHash, size_t sampleRate );
+
+} } // namespace mason::audio
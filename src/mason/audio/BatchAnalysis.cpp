@@ -0,0 +1,369 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/audio/BatchAnalysis.h"
+#include "mason/audio/OfflineContext.h"
+
+#include "cinder/audio/SamplePlayerNode.h"
+#include "cinder/audio/Source.h"
+#include "cinder/Exception.h"
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <thread>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+bool isLittleEndian()
+{
+	const uint32_t one = 1;
+	return *reinterpret_cast<const uint8_t *>( &one ) == 1;
+}
+
+void writeUInt32( ofstream &os, uint32_t value )
+{
+	const char bytes[4] = { char( value & 0xff ), char( ( value >> 8 ) & 0xff ), char( ( value >> 16 ) & 0xff ), char( ( value >> 24 ) & 0xff ) };
+	os.write( bytes, sizeof( bytes ) );
+}
+
+void writeHeader( ofstream &os, const AnalysisFileHeader &header )
+{
+	for( uint32_t value : { header.mMagic, header.mVersion, header.mSampleRate, header.mFftSize, header.mHopSize, header.mNumFrames,
+							header.mNumBins, header.mFeatureMask, header.mNumMfccCoeffs, header.mNumOnsets } ) {
+		writeUInt32( os, value );
+	}
+}
+
+// floats are written byte by byte only on big-endian hosts, elsewhere their memory already has the file's layout
+void writeArray( ofstream &os, const vector<float> &values )
+{
+	if( isLittleEndian() ) {
+		if( ! values.empty() )
+			os.write( reinterpret_cast<const char *>( values.data() ), values.size() * sizeof( float ) );
+
+		return;
+	}
+
+	for( float value : values ) {
+		uint32_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		writeUInt32( os, bits );
+	}
+}
+
+// Returns the deepest directory that contains all of \a paths, which are absolute and normalized.
+fs::path commonParentPath( const vector<fs::path> &paths )
+{
+	fs::path result = paths.front().parent_path();
+	for( const auto &path : paths ) {
+		const fs::path dir = path.parent_path();
+		fs::path common;
+		for( auto a = result.begin(), b = dir.begin(); a != result.end() && b != dir.end() && *a == *b; ++a, ++b )
+			common /= *a;
+
+		result = common;
+	}
+
+	return result;
+}
+
+} // anonymous namespace
+
+AnalysisResult analyzeFile( const fs::path &audioFile, const fs::path &outputFile, const AnalysisOptions &options )
+{
+	AnalysisResult result;
+	result.mInputPath = audioFile;
+	result.mOutputPath = outputFile;
+
+	Timer timer( true );
+
+	try {
+		auto sourceFile = ci::audio::load( loadFile( audioFile ) );
+
+		// analyze at the file's native samplerate so nothing needs to be resampled
+		auto ctx = make_shared<OfflineContext>();
+		ctx->setSampleRate( sourceFile->getSampleRate() );
+		ctx->setFramesPerBlock( options.mFramesPerBlock );
+		ctx->setOuputNumChannels( 1 );
+
+		// history only needs to hold the frames produced by one pull, as they are drained after each one
+		size_t hopSize = max<size_t>( options.mHopSize, 1 );
+		size_t historySize = options.mFramesPerBlock / hopSize + 2;
+
+		auto format = FeatureExtractorNode::Format()
+			.fftSize( options.mFftSize ).windowSize( options.mWindowSize ).hopSize( hopSize )
+			.features( options.mFeatures ).numMfccCoeffs( options.mNumMfccCoeffs )
+			.historySize( historySize ).storeMagSpectrum( options.mWriteSpectrogram );
+
+		// read synchronously, there is no realtime deadline to protect
+		auto player = ctx->makeNode( new ci::audio::FilePlayerNode( sourceFile, false ) );
+		player->setName( "<offline> FilePlayerNode (" + audioFile.filename().string() + ")" );
+		auto extractor = ctx->makeNode( new FeatureExtractorNode( format ) );
+
+		player >> extractor >> ctx->getOutput();
+
+		player->start();
+		ctx->enable();
+
+		const auto &history = extractor->getHistory();
+		const size_t numBins = history.getNumBins();
+		const size_t numMfccCoeffs = history.getNumMfccCoeffs();
+		const bool storeChroma = extractor->isFeatureEnabled( Feature::CHROMA );
+		const size_t expectedFrames = sourceFile->getNumFrames() / hopSize + 1;
+
+		vector<float> spectrogram, mfcc, chroma;
+		array<vector<float>, (size_t)Feature::NUM_SCALAR_FEATURES> scalars;
+
+		spectrogram.reserve( expectedFrames * numBins );
+		mfcc.reserve( expectedFrames * numMfccCoeffs );
+		if( storeChroma )
+			chroma.reserve( expectedFrames * 12 );
+		for( size_t f = 0; f < scalars.size(); f++ ) {
+			if( extractor->isFeatureEnabled( Feature( f ) ) )
+				scalars[f].reserve( expectedFrames );
+		}
+
+		ci::audio::Buffer buffer( ctx->getFramesPerBlock(), 1 );
+		uint64_t framesRead = 0;
+
+		while( ! player->isEof() ) {
+			ctx->pull( &buffer );
+
+			uint64_t framesWritten = history.getNumFramesWritten();
+			CI_ASSERT( framesWritten - framesRead <= history.getCapacity() );
+
+			for( ; framesRead < framesWritten; framesRead++ ) {
+				size_t framesAgo = size_t( framesWritten - 1 - framesRead );
+
+				for( size_t f = 0; f < scalars.size(); f++ ) {
+					if( extractor->isFeatureEnabled( Feature( f ) ) )
+						scalars[f].push_back( history.getValue( Feature( f ), framesAgo ) );
+				}
+
+				if( numBins ) {
+					const float *mags = history.getMagSpectrum( framesAgo );
+					spectrogram.insert( spectrogram.end(), mags, mags + numBins );
+				}
+				if( numMfccCoeffs ) {
+					const float *coeffs = history.getMfcc( framesAgo );
+					mfcc.insert( mfcc.end(), coeffs, coeffs + numMfccCoeffs );
+				}
+				if( storeChroma ) {
+					const float *pitchClasses = history.getChroma( framesAgo );
+					chroma.insert( chroma.end(), pitchClasses, pitchClasses + 12 );
+				}
+			}
+		}
+
+		ctx->disable();
+
+		vector<float> onsetTimes;
+		const auto &flux = scalars[(size_t)Feature::FLUX];
+		if( options.mWriteOnsets && ! flux.empty() ) {
+			float framesPerSecond = extractor->getFrameRate();
+			for( size_t frame : detectOnsets( flux, framesPerSecond, options.mOnsetThreshold, options.mOnsetMinInterval ) )
+				onsetTimes.push_back( float( frame ) / framesPerSecond );
+		}
+
+		AnalysisFileHeader header;
+		header.mSampleRate = (uint32_t)ctx->getSampleRate();
+		header.mFftSize = (uint32_t)extractor->getFftSize();
+		header.mHopSize = (uint32_t)extractor->getHopSize();
+		header.mNumFrames = (uint32_t)framesRead;
+		header.mNumBins = (uint32_t)numBins;
+		header.mFeatureMask = extractor->getFeatures();
+		header.mNumMfccCoeffs = (uint32_t)numMfccCoeffs;
+		header.mNumOnsets = (uint32_t)onsetTimes.size();
+
+		if( outputFile.has_parent_path() ) {
+			// other workers may be creating the same directory, so it's only an error if it still doesn't exist
+			error_code ec;
+			fs::create_directories( outputFile.parent_path(), ec );
+			if( ! fs::is_directory( outputFile.parent_path(), ec ) )
+				throw ci::Exception( "could not create output directory: " + outputFile.parent_path().string() );
+		}
+
+		ofstream os( outputFile, ios::binary );
+		if( ! os )
+			throw ci::Exception( "could not open output file: " + outputFile.string() );
+
+		writeHeader( os, header );
+		writeArray( os, spectrogram );
+		for( const auto &values : scalars )
+			writeArray( os, values );
+		writeArray( os, mfcc );
+		writeArray( os, chroma );
+		writeArray( os, onsetTimes );
+
+		result.mNumFrames = (size_t)framesRead;
+		result.mNumOnsets = onsetTimes.size();
+		result.mAudioSeconds = sourceFile->getNumSeconds();
+		result.mSucceeded = true;
+	}
+	catch( exception &exc ) {
+		result.mError = exc.what();
+	}
+
+	result.mProcessSeconds = timer.getSeconds();
+	return result;
+}
+
+vector<AnalysisResult> analyzeFiles( const vector<fs::path> &audioFiles, const fs::path &outputDir, const AnalysisOptions &options, size_t numThreads, const AnalysisCallback &callback )
+{
+	vector<AnalysisResult> results( audioFiles.size() );
+	if( audioFiles.empty() )
+		return results;
+
+	if( numThreads == 0 )
+		numThreads = max<size_t>( thread::hardware_concurrency(), 1 );
+
+	numThreads = min( numThreads, audioFiles.size() );
+
+	// outputs mirror the inputs' paths below the directory they share, so same-named files in different sub-directories
+	// of a recursive search don't overwrite each other
+	vector<fs::path> outputFiles;
+	{
+		vector<fs::path> inputPaths;
+		for( const auto &audioFile : audioFiles ) {
+			error_code ec;
+			fs::path path = fs::absolute( audioFile, ec );
+			inputPaths.push_back( ( ec ? audioFile : path ).lexically_normal() );
+		}
+
+		const fs::path root = commonParentPath( inputPaths );
+		for( const auto &path : inputPaths ) {
+			fs::path relative = path.lexically_relative( root );
+			if( relative.empty() )
+				relative = path.relative_path();
+
+			fs::path outputFile = outputDir / relative;
+			outputFile += ".maaf";
+			outputFiles.push_back( outputFile );
+		}
+	}
+
+	// each worker claims the next unprocessed file and analyzes it with its own OfflineContext
+	atomic<size_t> nextIndex = { 0 };
+	auto worker = [&] {
+		while( true ) {
+			size_t i = nextIndex++;
+			if( i >= audioFiles.size() )
+				break;
+
+			results[i] = analyzeFile( audioFiles[i], outputFiles[i], options );
+
+			if( callback )
+				callback( results[i] );
+		}
+	};
+
+	vector<thread> threads;
+	for( size_t i = 0; i < numThreads; i++ )
+		threads.emplace_back( worker );
+
+	for( auto &t : threads )
+		t.join();
+
+	return results;
+}
+
+vector<fs::path> findAudioFiles( const fs::path &directory, bool recursive )
+{
+	const vector<string> extensions = { ".wav", ".aif", ".aiff", ".flac", ".mp3", ".ogg", ".m4a", ".caf" };
+
+	auto isAudioFile = [&extensions]( const fs::path &path ) {
+		string ext = path.extension().string();
+		transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+		return find( extensions.begin(), extensions.end(), ext ) != extensions.end();
+	};
+
+	vector<fs::path> result;
+	if( recursive ) {
+		for( const auto &entry : fs::recursive_directory_iterator( directory ) ) {
+			if( fs::is_regular_file( entry.path() ) && isAudioFile( entry.path() ) )
+				result.push_back( entry.path() );
+		}
+	}
+	else {
+		for( const auto &entry : fs::directory_iterator( directory ) ) {
+			if( fs::is_regular_file( entry.path() ) && isAudioFile( entry.path() ) )
+				result.push_back( entry.path() );
+		}
+	}
+
+	sort( result.begin(), result.end() );
+	return result;
+}
+
+// Peak picking on the flux series: a frame is an onset if it is a local maximum, exceeds the mean of its neighborhood by
+// threshold, and is at least minIntervalSeconds after the previous onset.
+vector<size_t> detectOnsets( const vector<float> &flux, float framesPerSecond, float threshold, float minIntervalSeconds )
+{
+	vector<size_t> result;
+	if( flux.size() < 3 )
+		return result;
+
+	const size_t halfWindow = max<size_t>( size_t( 0.1f * framesPerSecond ), 1 ); // ~100ms each side
+	const size_t minIntervalFrames = size_t( minIntervalSeconds * framesPerSecond );
+	const float minFlux = 1e-6f;
+
+	// running sum over [i - halfWindow, i + halfWindow]
+	double windowSum = 0;
+	size_t windowBegin = 0, windowEnd = 0;
+	bool hasOnset = false;
+	size_t lastOnset = 0;
+
+	for( size_t i = 0; i < flux.size(); i++ ) {
+		size_t begin = i > halfWindow ? i - halfWindow : 0;
+		size_t end = min( i + halfWindow + 1, flux.size() );
+		while( windowEnd < end )
+			windowSum += flux[windowEnd++];
+		while( windowBegin < begin )
+			windowSum -= flux[windowBegin++];
+
+		float localMean = float( windowSum / double( windowEnd - windowBegin ) );
+		float value = flux[i];
+
+		bool isPeak = ( i == 0 || value >= flux[i - 1] ) && ( i + 1 == flux.size() || value > flux[i + 1] );
+		if( ! isPeak || value < minFlux || value <= localMean * threshold )
+			continue;
+
+		if( hasOnset && i - lastOnset < minIntervalFrames )
+			continue;
+
+		result.push_back( i );
+		lastOnset = i;
+		hasOnset = true;
+	}
+
+	return result;
+}
+
+} } // namespace mason::audio
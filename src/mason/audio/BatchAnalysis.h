@@ -0,0 +1,103 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "mason/Export.h"
+#include "mason/audio/FeatureExtractor.h"
+
+#include <functional>
+
+namespace mason { namespace audio {
+
+//! \brief Binary layout written by analyzeFile(), all values little-endian whatever the byte order of the host.
+//!
+//! The header is followed by contiguous float32 arrays, each one present only if its count is non-zero:
+//! - magnitude spectrogram: numFrames * numBins, frame-major (linear magnitudes)
+//! - scalar features: for each bit set in featureMask below Feature::NUM_SCALAR_FEATURES (in enum order), numFrames values
+//! - MFCCs: numFrames * numMfccCoeffs
+//! - chroma: numFrames * 12 (if the Feature::CHROMA bit is set)
+//! - onsets: numOnsets times in seconds
+struct AnalysisFileHeader {
+	static const uint32_t MAGIC = 0x4641414d; // "MAAF"
+	static const uint32_t VERSION = 1;
+
+	uint32_t	mMagic = MAGIC;
+	uint32_t	mVersion = VERSION;
+	uint32_t	mSampleRate = 0;
+	uint32_t	mFftSize = 0;
+	uint32_t	mHopSize = 0;
+	uint32_t	mNumFrames = 0;
+	uint32_t	mNumBins = 0;
+	uint32_t	mFeatureMask = 0;
+	uint32_t	mNumMfccCoeffs = 0;
+	uint32_t	mNumOnsets = 0;
+};
+
+//! Options used for offline analysis of audio files.
+struct MA_API AnalysisOptions {
+	size_t		mFftSize = 2048;
+	size_t		mWindowSize = 2048;
+	size_t		mHopSize = 512;
+	//! Number of frames rendered per OfflineContext::pull(). Larger blocks mean less overhead per pull.
+	size_t		mFramesPerBlock = 8192;
+	FeatureMask	mFeatures = FEATURE_MASK_ALL;
+	size_t		mNumMfccCoeffs = 13;
+	bool		mWriteSpectrogram = true;
+	bool		mWriteOnsets = true;
+	//! Flux must exceed the local mean by this factor to count as an onset.
+	float		mOnsetThreshold = 1.5f;
+	//! Minimum seconds between detected onsets.
+	float		mOnsetMinInterval = 0.05f;
+};
+
+//! Stats from analyzing one file.
+struct MA_API AnalysisResult {
+	ci::fs::path	mInputPath, mOutputPath;
+	bool			mSucceeded = false;
+	std::string		mError;
+	size_t			mNumFrames = 0;
+	size_t			mNumOnsets = 0;
+	double			mAudioSeconds = 0;		//! duration of the analyzed audio
+	double			mProcessSeconds = 0;	//! wall-clock time spent decoding, analyzing and writing
+
+	//! Returns how many times faster than realtime the file was analyzed.
+	double getRealtimeFactor() const	{ return mProcessSeconds > 0 ? mAudioSeconds / mProcessSeconds : 0; }
+};
+
+//! Analyzes \a audioFile with its own OfflineContext and writes the results to \a outputFile, in the format described by AnalysisFileHeader.
+MA_API AnalysisResult analyzeFile( const ci::fs::path &audioFile, const ci::fs::path &outputFile, const AnalysisOptions &options = AnalysisOptions() );
+
+//! Called from worker threads whenever a file finishes in analyzeFiles().
+using AnalysisCallback = std::function<void ( const AnalysisResult & )>;
+
+//! Analyzes \a audioFiles in parallel using \a numThreads workers (0 = hardware concurrency), each with its own OfflineContext.
+//! Output files are placed in \a outputDir at each input's path relative to the deepest directory containing all of them, with
+//! '.maaf' appended to the file name. Sub-directories are created as needed.
+MA_API std::vector<AnalysisResult> analyzeFiles( const std::vector<ci::fs::path> &audioFiles, const ci::fs::path &outputDir, const AnalysisOptions &options = AnalysisOptions(), size_t numThreads = 0, const AnalysisCallback &callback = nullptr );
+
+//! Returns the audio files (by extension) found in \a directory, optionally recursing into sub-directories.
+MA_API std::vector<ci::fs::path> findAudioFiles( const ci::fs::path &directory, bool recursive = false );
+
+//! Returns the onset frame indices found by peak picking the spectral \a flux series.
+MA_API std::vector<size_t> detectOnsets( const std::vector<float> &flux, float framesPerSecond, float threshold, float minIntervalSeconds );
+
+} } // namespace mason::audio
@@ -20,6 +20,7 @@
  */
 
 #include "mason/audio/CompressorNode.h"
+#include "mason/audio/FastMath.h"
 #include "cinder/CinderAssert.h"
 #include "cinder/CinderMath.h"
 #include "cinder/Log.h"
@@ -31,10 +32,6 @@ using namespace ci::audio;
 
 namespace mason { namespace audio {
 
-const size_t MaxPreDelayFrames = 1024;
-const size_t MaxPreDelayFramesMask = MaxPreDelayFrames - 1;
-const size_t DefaultPreDelayFrames = 256;
-
 float decibelsToLinear( float decibels )
 {
 	return powf( 10, 0.05f * decibels );
@@ -60,15 +57,37 @@ CompressorNode::CompressorNode( const Format &format )
 	mParamRatio( this, 12 ),
 	mParamKnee( this, 30 ),
 	mParamAttackTime( this, 0.003f ),
-	mParamReleaseTime( this, 0.25f )
+	mParamReleaseTime( this, 0.25f ),
+	mParamPostGain( this, 0 ),
+	mParamMix( this, 1 ),
+	mParamSidechain( this, 0 ),
+	mLookahead( format.getLookahead() ),
+	mMaxLookahead( std::max( format.getLookahead(), format.getMaxLookahead() ) ),
+	mApproximations( format.isApproximationsEnabled() )
 {
 }
 
 void CompressorNode::initialize()
 {
-	m_lastPreDelayFrames = DefaultPreDelayFrames;
-	m_preDelayReadIndex = 0;
-	m_preDelayWriteIndex = DefaultPreDelayFrames;
+	// The delay line must hold the max lookahead plus one block, since a whole block is written before it is read back.
+	// Its length is a power of two so indices wrap with a mask.
+	size_t minDelayFrames = size_t( mMaxLookahead * getSampleRate() ) + getFramesPerBlock() + 1;
+	size_t delayFrames = 1;
+	while( delayFrames < minDelayFrames )
+		delayFrames <<= 1;
+
+	mPreDelayBuffer.setSize( delayFrames, getNumChannels() );
+	mPreDelayMask = delayFrames - 1;
+	m_lastPreDelayFrames = std::min( unsigned( mLookahead * getSampleRate() ), unsigned( mMaxLookahead * getSampleRate() ) );
+
+	// padded so the approximate path can always process whole vectors
+	const size_t vectorFrames = ( getFramesPerBlock() + simd::LANES - 1 ) & ~( simd::LANES - 1 );
+	mDetectorInput.resize( vectorFrames );
+	mFrameGain.resize( vectorFrames );
+	mAttenuation.resize( vectorFrames );
+	mSatReleaseRate.resize( vectorFrames );
+	mEnvelopeGain.resize( vectorFrames );
+	mMeterDb.resize( vectorFrames );
 
 	m_ratio = -1;
 	m_slope = -1;
@@ -80,7 +99,8 @@ void CompressorNode::initialize()
 	m_ykneeThresholdDb = -1;
 	m_K = -1;
 
-	mPreDelayBuffer.setSize( MaxPreDelayFrames, getNumChannels() );
+	// forces the cached parameters to be recomputed in the first process()
+	mCached = CachedParameters();
 
 	reset();
 
@@ -98,17 +118,32 @@ void CompressorNode::reset()
 	mPreDelayBuffer.zero();
 
 	m_preDelayReadIndex = 0;
-	m_preDelayWriteIndex = DefaultPreDelayFrames;
+	m_preDelayWriteIndex = m_lastPreDelayFrames;
 
 	m_maxAttackCompressionDiffDb = -1; // uninitialized state
 }
 
+void CompressorNode::setLookahead( float seconds )
+{
+	mLookahead = std::min( std::max( 0.0f, seconds ), mMaxLookahead );
+}
+
+void CompressorNode::setSidechain( const ci::audio::NodeRef &node )
+{
+	mSidechain = node;
+	if( node )
+		mParamSidechain.setProcessor( node );
+	else
+		mParamSidechain.reset();
+}
+
 // Re-configure look-ahead section pre-delay if delay time has changed.
-void CompressorNode::setPreDelayTime( float preDelayTime )
+void CompressorNode::updateLookahead()
 {
-	unsigned preDelayFrames = preDelayTime * getSampleRate();
-	if( preDelayFrames > MaxPreDelayFrames - 1 )
-		preDelayFrames = MaxPreDelayFrames - 1;
+	unsigned preDelayFrames = unsigned( mLookahead * getSampleRate() );
+	unsigned maxPreDelayFrames = unsigned( mMaxLookahead * getSampleRate() );
+	if( preDelayFrames > maxPreDelayFrames )
+		preDelayFrames = maxPreDelayFrames;
 
 	if( m_lastPreDelayFrames != preDelayFrames ) {
 		m_lastPreDelayFrames = preDelayFrames;
@@ -224,37 +259,22 @@ float CompressorNode::updateStaticCurveParameters( float dbThreshold, float dbKn
 	return m_K;
 }
 
-void CompressorNode::process( ci::audio::Buffer *buffer )
+void CompressorNode::updateCachedParameters( float dbThreshold, float dbKnee, float ratio, float attackTime, float releaseTime, float dbPostGain )
 {
-	unsigned numberOfChannels = buffer->getNumChannels();
-	unsigned framesToProcess = buffer->getNumFrames();
-
-	mParamKnee.eval();
-	mParamRatio.eval();
-	mParamAttackTime.eval();
-	mParamReleaseTime.eval();
-	mParamThreshold.eval();
-
-	float dbKnee = mParamKnee.getValue();
-	float ratio = mParamRatio.getValue();
-	float attackTime = mParamAttackTime.getValue();
-	float releaseTime = mParamReleaseTime.getValue();
-	float dbThreshold = mParamThreshold.getValue();
-
-	float preDelayTime = 0.006f;
-	float dbPostGain = 0; // db
-	float effectBlend = 1; // equal power crossfade
+	if( dbThreshold == mCached.mDbThreshold && dbKnee == mCached.mDbKnee && ratio == mCached.mRatio
+		&& attackTime == mCached.mAttackTime && releaseTime == mCached.mReleaseTime && dbPostGain == mCached.mDbPostGain ) {
+		return;
+	}
 
-	float releaseZone1 = 0.09f;
-	float releaseZone2 = 0.16f;
-	float releaseZone3 = 0.42f;
-	float releaseZone4 = 0.98f;
+	mCached.mDbThreshold = dbThreshold;
+	mCached.mDbKnee = dbKnee;
+	mCached.mRatio = ratio;
+	mCached.mAttackTime = attackTime;
+	mCached.mReleaseTime = releaseTime;
+	mCached.mDbPostGain = dbPostGain;
 
 	float sampleRate = getSampleRate();
 
-	float dryMix = 1 - effectBlend;
-	float wetMix = effectBlend;
-
 	float k = updateStaticCurveParameters(dbThreshold, dbKnee, ratio);
 
 	// Makeup gain.
@@ -264,24 +284,29 @@ void CompressorNode::process( ci::audio::Buffer *buffer )
 	// Empirical/perceptual tuning.
 	fullRangeMakeupGain = powf( fullRangeMakeupGain, 0.6f );
 
-	float masterLinearGain = decibelsToLinear(dbPostGain) * fullRangeMakeupGain;
+	mCached.mMasterLinearGain = decibelsToLinear(dbPostGain) * fullRangeMakeupGain;
 
 	// Attack parameters.
 	attackTime = std::max( 0.001f, attackTime );
-	float attackFrames = attackTime * sampleRate;
+	mCached.mAttackFrames = attackTime * sampleRate;
 
 	// Release parameters.
 	float releaseFrames = sampleRate * releaseTime;
 
 	// Detector release time.
 	float satReleaseTime = 0.0025f;
-	float satReleaseFrames = satReleaseTime * sampleRate;
+	mCached.mSatReleaseFrames = satReleaseTime * sampleRate;
 
 	// Create a smooth function which passes through four points.
 
 	// Polynomial of the form
 	// y = a + b*x + c*x^2 + d*x^3 + e*x^4;
 
+	float releaseZone1 = 0.09f;
+	float releaseZone2 = 0.16f;
+	float releaseZone3 = 0.42f;
+	float releaseZone4 = 0.98f;
+
 	float y1 = releaseFrames * releaseZone1;
 	float y2 = releaseFrames * releaseZone2;
 	float y3 = releaseFrames * releaseZone3;
@@ -289,199 +314,420 @@ void CompressorNode::process( ci::audio::Buffer *buffer )
 
 	// All of these coefficients were derived for 4th order polynomial curve fitting where the y values
 	// match the evenly spaced x values as follows: (y1 : x == 0, y2 : x == 1, y3 : x == 2, y4 : x == 3)
-	float kA = 0.9999999999999998f * y1 + 1.8432219684323923e-16f * y2 - 1.9373394351676423e-16f * y3 + 8.824516011816245e-18f * y4;
-	float kB = -1.5788320352845888f * y1 + 2.3305837032074286f * y2 - 0.9141194204840429f * y3 + 0.1623677525612032f * y4;
-	float kC = 0.5334142869106424f * y1 - 1.272736789213631f * y2 + 0.9258856042207512f * y3 - 0.18656310191776226f * y4;
-	float kD = 0.08783463138207234f * y1 - 0.1694162967925622f * y2 + 0.08588057951595272f * y3 - 0.00429891410546283f * y4;
-	float kE = -0.042416883008123074f * y1 + 0.1115693827987602f * y2 - 0.09764676325265872f * y3 + 0.028494263462021576f * y4;
+	mCached.mKA = 0.9999999999999998f * y1 + 1.8432219684323923e-16f * y2 - 1.9373394351676423e-16f * y3 + 8.824516011816245e-18f * y4;
+	mCached.mKB = -1.5788320352845888f * y1 + 2.3305837032074286f * y2 - 0.9141194204840429f * y3 + 0.1623677525612032f * y4;
+	mCached.mKC = 0.5334142869106424f * y1 - 1.272736789213631f * y2 + 0.9258856042207512f * y3 - 0.18656310191776226f * y4;
+	mCached.mKD = 0.08783463138207234f * y1 - 0.1694162967925622f * y2 + 0.08588057951595272f * y3 - 0.00429891410546283f * y4;
+	mCached.mKE = -0.042416883008123074f * y1 + 0.1115693827987602f * y2 - 0.09764676325265872f * y3 + 0.028494263462021576f * y4;
+}
 
-	setPreDelayTime( preDelayTime );
+// ----------------------------------------------------------------------------------------------------
+// Gain computer
+// ----------------------------------------------------------------------------------------------------
 
-	const int nDivisionFrames = 32;
+namespace {
 
-	const int nDivisions = framesToProcess / nDivisionFrames;
+const float PI_OVER_TWO_FLOAT = M_PI / 2.0;
 
-	unsigned frameIndex = 0;
-	for (int i = 0; i < nDivisions; ++i) {
-		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-		// Calculate desired gain
-		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Math used by the reference implementation.
+struct PreciseMath {
+	static float linearToDecibels( float linear )	{ return mason::audio::linearToDecibels( linear ); }
+	static float decibelsToLinear( float decibels )	{ return mason::audio::decibelsToLinear( decibels ); }
+	static float pow( float x, float y )			{ return powf( x, y ); }
+	static float asinNormalized( float x )			{ return asinf( x ) / PI_OVER_TWO_FLOAT; }
+};
 
-		// Fix gremlins.
-		if( std::isnan( m_detectorAverage ) )
-			m_detectorAverage = 1;
-		if( std::isinf( m_detectorAverage ) )
-			m_detectorAverage = 1;
+// Polynomial approximations, with the same results as the reference for the zero and non-finite values the gremlin checks rely on.
+struct ApproximateMath {
+	static float linearToDecibels( float linear )	{ return ( linear > 0 && linear < INFINITY ) ? fastmath::linearToDecibels( linear ) : 20 * log10f( linear ); }
+	static float decibelsToLinear( float decibels )	{ return fastmath::decibelsToLinear( decibels ); }
+	static float pow( float x, float y )			{ return fastmath::pow( x, y ); }
+	static float asinNormalized( float x )			{ return fastmath::asinNormalized( x ); }
+};
 
-		float desiredGain = m_detectorAverage;
+// result[i] = a[i] * b[i]
+void multiply( const float *a, const float *b, float *result, size_t count )
+{
+	size_t i = 0;
+	for( ; i + simd::LANES <= count; i += simd::LANES )
+		( simd::float4::load( a + i ) * simd::float4::load( b + i ) ).store( result + i );
 
-		// Pre-warp so we get desiredGain after sin() warp below.
-		float piOverTwoFloat = M_PI / 2.0;
-		float scaledDesiredGain = asinf( desiredGain ) / piOverTwoFloat;
+	for( ; i < count; i++ )
+		result[i] = a[i] * b[i];
+}
 
-		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-		// Deal with envelopes
-		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+} // anonymous namespace
 
-		// envelopeRate is the rate we slew from current compressor level to the desired level.
-		// The exact rate depends on if we're attacking or releasing and by how much.
-		float envelopeRate;
+// Called at the start of each division: fixes up the detector state, returns the rate at which the compressor gain
+// moves towards scaledDesiredGain over the division.
+template <typename MathT>
+float CompressorNode::computeEnvelopeRate( float *scaledDesiredGain )
+{
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Calculate desired gain
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-		bool isReleasing = scaledDesiredGain > m_compressorGain;
+	// Fix gremlins.
+	if( std::isnan( m_detectorAverage ) )
+		m_detectorAverage = 1;
+	if( std::isinf( m_detectorAverage ) )
+		m_detectorAverage = 1;
 
-		// compressionDiffDb is the difference between current compression level and the desired level.
-		float compressionDiffDb = linearToDecibels(m_compressorGain / scaledDesiredGain);
+	float desiredGain = m_detectorAverage;
 
-		if( isReleasing ) {
-			// Release mode - compressionDiffDb should be negative dB
-			m_maxAttackCompressionDiffDb = -1;
+	// Pre-warp so we get desiredGain after sin() warp below.
+	*scaledDesiredGain = MathT::asinNormalized( desiredGain );
 
-			// Fix gremlins.
-			if( std::isnan( compressionDiffDb ) )
-				compressionDiffDb = -1;
-			if( std::isinf( compressionDiffDb ) )
-				compressionDiffDb = -1;
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Deal with envelopes
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-			// Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
+	// envelopeRate is the rate we slew from current compressor level to the desired level.
+	// The exact rate depends on if we're attacking or releasing and by how much.
+	float envelopeRate;
 
-			// Contain within range: -12 -> 0 then scale to go from 0 -> 3
-			float x = compressionDiffDb;
-			x = std::max( -12.0f, x );
-			x = std::min( 0.0f, x );
-			x = 0.25f * ( x + 12 );
+	bool isReleasing = *scaledDesiredGain > m_compressorGain;
 
-			// Compute adaptive release curve using 4th order polynomial.
-			// Normal values for the polynomial coefficients would create a monotonically increasing function.
-			float x2 = x * x;
-			float x3 = x2 * x;
-			float x4 = x2 * x2;
-			float releaseFrames = kA + kB * x + kC * x2 + kD * x3 + kE * x4;
+	// compressionDiffDb is the difference between current compression level and the desired level.
+	float compressionDiffDb = MathT::linearToDecibels( m_compressorGain / *scaledDesiredGain );
 
-			const float spacingDb = 5;
-			float dbPerFrame = spacingDb / releaseFrames;
+	if( isReleasing ) {
+		// Release mode - compressionDiffDb should be negative dB
+		m_maxAttackCompressionDiffDb = -1;
 
-			envelopeRate = decibelsToLinear(dbPerFrame);
-		} else {
-			// Attack mode - compressionDiffDb should be positive dB
+		// Fix gremlins.
+		if( std::isnan( compressionDiffDb ) )
+			compressionDiffDb = -1;
+		if( std::isinf( compressionDiffDb ) )
+			compressionDiffDb = -1;
 
-			// Fix gremlins.
-			if (std::isnan(compressionDiffDb))
-				compressionDiffDb = 1;
-			if (std::isinf(compressionDiffDb))
-				compressionDiffDb = 1;
+		// Adaptive release - higher compression (lower compressionDiffDb)  releases faster.
 
-			// As long as we're still in attack mode, use a rate based off
-			// the largest compressionDiffDb we've encountered so far.
-			if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
-				m_maxAttackCompressionDiffDb = compressionDiffDb;
+		// Contain within range: -12 -> 0 then scale to go from 0 -> 3
+		float x = compressionDiffDb;
+		x = std::max( -12.0f, x );
+		x = std::min( 0.0f, x );
+		x = 0.25f * ( x + 12 );
 
-			float effAttenDiffDb = std::max( 0.5f, m_maxAttackCompressionDiffDb );
+		// Compute adaptive release curve using 4th order polynomial.
+		// Normal values for the polynomial coefficients would create a monotonically increasing function.
+		float x2 = x * x;
+		float x3 = x2 * x;
+		float x4 = x2 * x2;
+		float releaseFrames = mCached.mKA + mCached.mKB * x + mCached.mKC * x2 + mCached.mKD * x3 + mCached.mKE * x4;
 
-			float x = 0.25f / effAttenDiffDb;
-			envelopeRate = 1 - powf( x, 1 / attackFrames );
-		}
+		const float spacingDb = 5;
+		float dbPerFrame = spacingDb / releaseFrames;
+
+		envelopeRate = MathT::decibelsToLinear( dbPerFrame );
+	} else {
+		// Attack mode - compressionDiffDb should be positive dB
+
+		// Fix gremlins.
+		if (std::isnan(compressionDiffDb))
+			compressionDiffDb = 1;
+		if (std::isinf(compressionDiffDb))
+			compressionDiffDb = 1;
+
+		// As long as we're still in attack mode, use a rate based off
+		// the largest compressionDiffDb we've encountered so far.
+		if (m_maxAttackCompressionDiffDb == -1 || m_maxAttackCompressionDiffDb < compressionDiffDb)
+			m_maxAttackCompressionDiffDb = compressionDiffDb;
+
+		float effAttenDiffDb = std::max( 0.5f, m_maxAttackCompressionDiffDb );
+
+		float x = 0.25f / effAttenDiffDb;
+		envelopeRate = 1 - MathT::pow( x, 1 / mCached.mAttackFrames );
+	}
+
+	return envelopeRate;
+}
+
+// Reference implementation, one frame at a time with the standard library math functions.
+void CompressorNode::computeFrameGainPrecise( size_t framesToProcess, float dryMix, float wetMix )
+{
+	const size_t nDivisionFrames = 32;
+	const float k = m_K;
+	const float masterLinearGain = mCached.mMasterLinearGain;
+	const float satReleaseFrames = mCached.mSatReleaseFrames;
+	const float *detectorInput = mDetectorInput.data();
+	float *frameGain = mFrameGain.data();
+
+	for( size_t frameIndex = 0; frameIndex < framesToProcess; ) {
+		float scaledDesiredGain;
+		float envelopeRate = computeEnvelopeRate<PreciseMath>( &scaledDesiredGain );
 
 		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-		// Inner loop - calculate shaped power average - apply compression.
+		// Inner loop - calculate shaped power average - compute the gain for each frame.
 		// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-		{
-			int preDelayReadIndex = m_preDelayReadIndex;
-			int preDelayWriteIndex = m_preDelayWriteIndex;
-			float detectorAverage = m_detectorAverage;
-			float compressorGain = m_compressorGain;
+		float detectorAverage = m_detectorAverage;
+		float compressorGain = m_compressorGain;
 
-			int loopFrames = nDivisionFrames;
-			while( loopFrames-- ) {
-				float compressorInput = 0;
+		size_t loopFrames = std::min( nDivisionFrames, framesToProcess - frameIndex );
+		while( loopFrames-- ) {
+			// Calculate shaped power on undelayed input.
+			float absInput = detectorInput[frameIndex];
 
-				// Predelay signal, computing compression amount from un-delayed version.
-				for (unsigned i = 0; i < numberOfChannels; ++i) {
-					float *delayBuffer = mPreDelayBuffer.getChannel( i );
-					float undelayedSource = buffer->getChannel( i )[frameIndex];
+			// Put through shaping curve.
+			// This is linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
+			// The transition from the threshold to the knee is smooth (1st derivative matched).
+			// The transition from the knee to the ratio portion is smooth (1st derivative matched).
+			float shapedInput = saturate( absInput, k );
 
-					CI_ASSERT( preDelayWriteIndex < mPreDelayBuffer.getNumFrames() );
+			float attenuation = absInput <= 0.0001f ? 1 : shapedInput / absInput;
 
-					delayBuffer[preDelayWriteIndex] = undelayedSource;
+			float attenuationDb = -linearToDecibels(attenuation);
+			attenuationDb = std::max( 2.0f, attenuationDb );
+
+			float dbPerFrame = attenuationDb / satReleaseFrames;
+
+			float satReleaseRate = decibelsToLinear(dbPerFrame) - 1;
+
+			bool isRelease = (attenuation > detectorAverage);
+			float rate = isRelease ? satReleaseRate : 1;
+
+			detectorAverage += ( attenuation - detectorAverage ) * rate;
+			detectorAverage = std::min( 1.0f, detectorAverage );
+
+			// Fix gremlins.
+			if (std::isnan(detectorAverage))
+				detectorAverage = 1;
+			if (std::isinf(detectorAverage))
+				detectorAverage = 1;
+
+			// Exponential approach to desired gain.
+			if (envelopeRate < 1) {
+				// Attack - reduce gain to desired.
+				compressorGain += (scaledDesiredGain - compressorGain) * envelopeRate;
+			} else {
+				// Release - exponentially increase gain to 1.0
+				compressorGain *= envelopeRate;
+				compressorGain = std::min( 1.0f, compressorGain );
+			}
 
-					float absUndelayedSource = undelayedSource > 0 ? undelayedSource : -undelayedSource;
-					if (compressorInput < absUndelayedSource)
-						compressorInput = absUndelayedSource;
-				}
+			// Warp pre-compression gain to smooth out sharp exponential transition points.
+			float postWarpCompressorGain = sinf(PI_OVER_TWO_FLOAT * compressorGain);
 
-				// Calculate shaped power on undelayed input.
+			// Calculate total gain using master gain and effect blend.
+			frameGain[frameIndex] = dryMix + wetMix * masterLinearGain * postWarpCompressorGain;
 
-				float scaledInput = compressorInput;
-				float absInput = scaledInput > 0 ? scaledInput : -scaledInput;
+			// Calculate metering.
+			float dbRealGain = 20 * log10(postWarpCompressorGain);
+			if (dbRealGain < m_meteringGain)
+				m_meteringGain = dbRealGain;
+			else
+				m_meteringGain += (dbRealGain - m_meteringGain) * m_meteringReleaseK;
 
-				// Put through shaping curve.
-				// This is linear up to the threshold, then enters a "knee" portion followed by the "ratio" portion.
-				// The transition from the threshold to the knee is smooth (1st derivative matched).
-				// The transition from the knee to the ratio portion is smooth (1st derivative matched).
-				float shapedInput = saturate( absInput, k );
+			frameIndex++;
+		}
 
-				float attenuation = absInput <= 0.0001f ? 1 : shapedInput / absInput;
+		// Locals back to member variables.
+		m_detectorAverage = detectorAverage;
+		m_compressorGain = compressorGain;
+	}
+}
 
-				float attenuationDb = -linearToDecibels(attenuation);
-				attenuationDb = std::max( 2.0f, attenuationDb );
+// Same algorithm as computeFrameGainPrecise(), split so that everything that doesn't depend on the previous frame
+// (the static curve, the detector release rate, the sin() warp and the metering dB) is computed four frames at a time
+// with polynomial approximations, leaving only the envelope and metering recursions to run serially.
+void CompressorNode::computeFrameGainApproximate( size_t framesToProcess, float dryMix, float wetMix )
+{
+	using simd::float4;
+
+	const size_t nDivisionFrames = 32;
+	const size_t vectorFrames = ( framesToProcess + simd::LANES - 1 ) & ~( simd::LANES - 1 );
+	const float k = m_K;
+
+	float *detectorInput = mDetectorInput.data();
+	float *attenuationFrames = mAttenuation.data();
+	float *satReleaseRateFrames = mSatReleaseRate.data();
+	float *envelopeGain = mEnvelopeGain.data();
+	float *meterDb = mMeterDb.data();
+	float *frameGain = mFrameGain.data();
+
+	// the padding frames are processed along with the last vector, make sure they hold finite values
+	std::fill( detectorInput + framesToProcess, detectorInput + vectorFrames, 0.0f );
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Static curve and detector release rate for each frame.
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	{
+		const float LOG2_E = 1.44269504f;
+		const float4 linearThreshold( m_linearThreshold );
+		const float4 kneeThreshold( m_kneeThreshold );
+		const float4 minInput( 0.0001f );
+		const float4 one( 1.0f );
+		const float4 minAttenuationDb( 2.0f );
+		const float expScale = -k * LOG2_E;
+		const float invK = 1 / k;
+		const float invSatReleaseFrames = 1 / mCached.mSatReleaseFrames;
+
+		for( size_t i = 0; i < vectorFrames; i += simd::LANES ) {
+			const float4 absInput = float4::load( detectorInput + i );
+			const float4 safeInput = simd::max( absInput, minInput );
+
+			// knee portion: linearThreshold + ( 1 - exp( -k * ( x - linearThreshold ) ) ) / k, linear below the threshold
+			const float4 knee = linearThreshold + ( one - fastmath::exp2( ( absInput - linearThreshold ) * expScale ) ) * invK;
+			const float4 kneeAttenuation = simd::select( absInput < linearThreshold, one, knee / safeInput );
+
+			// ratio portion, the attenuation is computed directly in dB which saves converting the shaped input back and forth
+			const float4 inputDb = fastmath::linearToDecibels( safeInput );
+			const float4 ratioAttenuation = fastmath::decibelsToLinear( ( inputDb - m_kneeThresholdDb ) * m_slope + m_ykneeThresholdDb - inputDb );
+
+			float4 attenuation = simd::select( absInput < kneeThreshold, kneeAttenuation, ratioAttenuation );
+			attenuation = simd::select( absInput <= minInput, one, attenuation );
+
+			const float4 attenuationDb = simd::max( minAttenuationDb, float4::zero() - fastmath::linearToDecibels( attenuation ) );
+			const float4 satReleaseRate = fastmath::decibelsToLinear( attenuationDb * invSatReleaseFrames ) - one;
+
+			attenuation.store( attenuationFrames + i );
+			satReleaseRate.store( satReleaseRateFrames + i );
+		}
+	}
 
-				float dbPerFrame = attenuationDb / satReleaseFrames;
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Detector and compressor envelopes.
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-				float satReleaseRate = decibelsToLinear(dbPerFrame) - 1;
+	for( size_t frameIndex = 0; frameIndex < framesToProcess; ) {
+		float scaledDesiredGain;
+		float envelopeRate = computeEnvelopeRate<ApproximateMath>( &scaledDesiredGain );
 
-				bool isRelease = (attenuation > detectorAverage);
-				float rate = isRelease ? satReleaseRate : 1;
+		float detectorAverage = m_detectorAverage;
+		float compressorGain = m_compressorGain;
 
-				detectorAverage += ( attenuation - detectorAverage ) * rate;
-				detectorAverage = std::min( 1.0f, detectorAverage );
+		size_t loopFrames = std::min( nDivisionFrames, framesToProcess - frameIndex );
+		while( loopFrames-- ) {
+			float attenuation = attenuationFrames[frameIndex];
+			float rate = attenuation > detectorAverage ? satReleaseRateFrames[frameIndex] : 1;
 
-				// Fix gremlins.
-				if (std::isnan(detectorAverage))
-					detectorAverage = 1;
-				if (std::isinf(detectorAverage))
-					detectorAverage = 1;
+			detectorAverage += ( attenuation - detectorAverage ) * rate;
+			detectorAverage = std::min( 1.0f, detectorAverage );
 
-				// Exponential approach to desired gain.
-				if (envelopeRate < 1) {
-					// Attack - reduce gain to desired.
-					compressorGain += (scaledDesiredGain - compressorGain) * envelopeRate;
-				} else {
-					// Release - exponentially increase gain to 1.0
-					compressorGain *= envelopeRate;
-					compressorGain = std::min( 1.0f, compressorGain );
-				}
+			// Fix gremlins.
+			if( std::isnan( detectorAverage ) )
+				detectorAverage = 1;
+			if( std::isinf( detectorAverage ) )
+				detectorAverage = 1;
+
+			if( envelopeRate < 1 )
+				compressorGain += ( scaledDesiredGain - compressorGain ) * envelopeRate;
+			else
+				compressorGain = std::min( 1.0f, compressorGain * envelopeRate );
+
+			envelopeGain[frameIndex] = compressorGain;
+			frameIndex++;
+		}
 
-				// Warp pre-compression gain to smooth out sharp exponential transition points.
-				float postWarpCompressorGain = sinf(piOverTwoFloat * compressorGain);
+		m_detectorAverage = detectorAverage;
+		m_compressorGain = compressorGain;
+	}
 
-				// Calculate total gain using master gain and effect blend.
-				float totalGain = dryMix + wetMix * masterLinearGain * postWarpCompressorGain;
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// sin() warp, total gain and metering.
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-				// Calculate metering.
-				float dbRealGain = 20 * log10(postWarpCompressorGain);
-				if (dbRealGain < m_meteringGain)
-					m_meteringGain = dbRealGain;
-				else
-					m_meteringGain += (dbRealGain - m_meteringGain) * m_meteringReleaseK;
+	std::fill( envelopeGain + framesToProcess, envelopeGain + vectorFrames, 1.0f );
 
-				// Apply final gain.
-				for (unsigned i = 0; i < numberOfChannels; ++i) {
-					float* delayBuffer = mPreDelayBuffer.getChannel( i );
-					buffer->getChannel( i )[frameIndex] = delayBuffer[preDelayReadIndex] * totalGain;
-				}
+	const float4 dry( dryMix );
+	const float4 wet( wetMix * mCached.mMasterLinearGain );
+	for( size_t i = 0; i < vectorFrames; i += simd::LANES ) {
+		const float4 postWarpCompressorGain = fastmath::sinHalfPi( float4::load( envelopeGain + i ) );
+		( dry + wet * postWarpCompressorGain ).store( frameGain + i );
+		fastmath::linearToDecibels( postWarpCompressorGain ).store( meterDb + i );
+	}
 
-				frameIndex++;
-				preDelayReadIndex = (preDelayReadIndex + 1) & MaxPreDelayFramesMask;
-				preDelayWriteIndex = (preDelayWriteIndex + 1) & MaxPreDelayFramesMask;
-			}
+	for( size_t i = 0; i < framesToProcess; i++ ) {
+		float dbRealGain = meterDb[i];
+		if( dbRealGain < m_meteringGain )
+			m_meteringGain = dbRealGain;
+		else
+			m_meteringGain += ( dbRealGain - m_meteringGain ) * m_meteringReleaseK;
+	}
+}
+
+void CompressorNode::process( ci::audio::Buffer *buffer )
+{
+	const size_t numberOfChannels = buffer->getNumChannels();
+	const size_t framesToProcess = buffer->getNumFrames();
+	CI_ASSERT( framesToProcess <= mFrameGain.size() );
+
+	mParamKnee.eval();
+	mParamRatio.eval();
+	mParamAttackTime.eval();
+	mParamReleaseTime.eval();
+	mParamThreshold.eval();
+	mParamPostGain.eval();
+	mParamMix.eval();
+	const bool sidechainEnabled = mParamSidechain.eval(); // only varies when driven by the sidechain Node
+
+	updateCachedParameters( mParamThreshold.getValue(), mParamKnee.getValue(), mParamRatio.getValue(), mParamAttackTime.getValue(), mParamReleaseTime.getValue(), mParamPostGain.getValue() );
+	updateLookahead();
 
-			// Locals back to member variables.
-			m_preDelayReadIndex = preDelayReadIndex;
-			m_preDelayWriteIndex = preDelayWriteIndex;
-			m_detectorAverage = detectorAverage;
-			m_compressorGain = compressorGain;
+	float effectBlend = std::min( std::max( 0.0f, mParamMix.getValue() ), 1.0f );
+	float dryMix = 1 - effectBlend;
+	float wetMix = effectBlend;
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Detector input - linked across channels by taking the loudest one, unless a sidechain is set.
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	float *detectorInput = mDetectorInput.data();
+	if( sidechainEnabled ) {
+		const float *sidechain = mParamSidechain.getValueArray();
+		for( size_t i = 0; i < framesToProcess; i++ )
+			detectorInput[i] = fabsf( sidechain[i] );
+	}
+	else {
+		std::fill( detectorInput, detectorInput + framesToProcess, 0.0f );
+		for( size_t ch = 0; ch < numberOfChannels; ch++ ) {
+			const float *channel = buffer->getChannel( ch );
+			for( size_t i = 0; i < framesToProcess; i++ )
+				detectorInput[i] = std::max( detectorInput[i], fabsf( channel[i] ) );
 		}
 	}
+
+	float detectorPeak = 0;
+	for( size_t i = 0; i < framesToProcess; i++ )
+		detectorPeak = std::max( detectorPeak, detectorInput[i] );
+
+	// The delay line is read and written in at most two contiguous segments, split where the index wraps.
+	const size_t delayFrames = mPreDelayBuffer.getNumFrames();
+	const size_t writeFrames = std::min( framesToProcess, delayFrames - m_preDelayWriteIndex );
+	const size_t readFrames = std::min( framesToProcess, delayFrames - m_preDelayReadIndex );
+
+	// Write the undelayed signal into the lookahead delay line, it is read back after the gain is known.
+	for( size_t ch = 0; ch < numberOfChannels; ch++ ) {
+		const float *channel = buffer->getChannel( ch );
+		float *delayBuffer = mPreDelayBuffer.getChannel( ch );
+		std::copy( channel, channel + writeFrames, delayBuffer + m_preDelayWriteIndex );
+		std::copy( channel + writeFrames, channel + framesToProcess, delayBuffer );
+	}
+
+	if( mApproximations )
+		computeFrameGainApproximate( framesToProcess, dryMix, wetMix );
+	else
+		computeFrameGainPrecise( framesToProcess, dryMix, wetMix );
+
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+	// Apply final gain to the delayed signal, the same gain for all channels.
+	// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	const float *frameGain = mFrameGain.data();
+	for( size_t ch = 0; ch < numberOfChannels; ch++ ) {
+		float *channel = buffer->getChannel( ch );
+		const float *delayBuffer = mPreDelayBuffer.getChannel( ch );
+		multiply( delayBuffer + m_preDelayReadIndex, frameGain, channel, readFrames );
+		multiply( delayBuffer, frameGain + readFrames, channel + readFrames, framesToProcess - readFrames );
+	}
+
+	m_preDelayReadIndex = ( m_preDelayReadIndex + framesToProcess ) & mPreDelayMask;
+	m_preDelayWriteIndex = ( m_preDelayWriteIndex + framesToProcess ) & mPreDelayMask;
+
+	mMeterGainReductionDb.store( std::min( 0.0f, m_meteringGain ), std::memory_order_relaxed );
+	mMeterDetectorPeak.store( detectorPeak, std::memory_order_relaxed );
 }
 
 } } // namespace mason::audio
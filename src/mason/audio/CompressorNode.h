@@ -25,12 +25,45 @@
 #include "cinder/audio/Node.h"
 #include "cinder/audio/Param.h"
 
+#include <atomic>
+#include <cmath>
+#include <vector>
+
 namespace mason { namespace audio {
 
 typedef std::shared_ptr<class CompressorNode>		CompressorNodeRef;
 
+//! \brief Dynamics compressor, ported from WebKit's DynamicsCompressor.
+//!
+//! Detection is linked across channels: the loudest channel (or the sidechain, if one is set) drives a single gain that is applied to all channels,
+//! so the stereo image doesn't shift under compression. The signal is delayed by the lookahead time so gain reduction can start ahead of transients.
 class CompressorNode : public ci::audio::Node {
   public:
+	struct Format : public ci::audio::Node::Format {
+		Format()	{}
+
+		//! Sets the initial lookahead time in seconds. Defaults to 0.006.
+		Format&		lookahead( float seconds )		{ mLookahead = seconds; return *this; }
+		//! Sets the largest lookahead time that can be set later, which sizes the delay line. Defaults to 0.1 seconds.
+		Format&		maxLookahead( float seconds )	{ mMaxLookahead = seconds; return *this; }
+		//! Sets whether the gain computer uses polynomial approximations of the dB conversions and the vectorized kernel. Defaults to false, so output matches the reference implementation.
+		Format&		approximations( bool enable )	{ mApproximations = enable; return *this; }
+
+		float		getLookahead() const		{ return mLookahead; }
+		float		getMaxLookahead() const		{ return mMaxLookahead; }
+		bool		isApproximationsEnabled() const	{ return mApproximations; }
+
+		// reimpl Node::Format
+		Format&		channels( size_t ch )							{ Node::Format::channels( ch ); return *this; }
+		Format&		channelMode( ChannelMode mode )					{ Node::Format::channelMode( mode ); return *this; }
+		Format&		autoEnable( bool autoEnable = true )			{ Node::Format::autoEnable( autoEnable ); return *this; }
+
+	  protected:
+		float	mLookahead = 0.006f;
+		float	mMaxLookahead = 0.1f;
+		bool	mApproximations = false;
+	};
+
 	CompressorNode( const Format &format = Format() );
 
 	void reset();
@@ -40,21 +73,51 @@ class CompressorNode : public ci::audio::Node {
 	ci::audio::Param* getParamKnee()			{ return &mParamKnee; }
 	ci::audio::Param* getParamAttackTime()		{ return &mParamAttackTime; }
 	ci::audio::Param* getParamReleaseTime()		{ return &mParamReleaseTime; }
+	//! Gain in decibels applied after compression, on top of the automatic makeup gain. Defaults to 0.
+	ci::audio::Param* getParamPostGain()		{ return &mParamPostGain; }
+	//! Blend between the dry (0) and compressed (1) signal. Defaults to 1.
+	ci::audio::Param* getParamMix()				{ return &mParamMix; }
+
+	//! Sets the lookahead time in seconds, clamped to Format::maxLookahead(). Changing it clears the delay line.
+	void	setLookahead( float seconds );
+	//! Returns the lookahead time in seconds.
+	float	getLookahead() const		{ return mLookahead; }
+
+	//! Switches between the approximate, vectorized gain computer and the reference implementation. Output differs from the reference by at most 1e-5 (-100 dBFS).
+	void	setApproximationsEnabled( bool enable )	{ mApproximations = enable; }
+	//! Returns whether the approximate gain computer is used.
+	bool	isApproximationsEnabled() const			{ return mApproximations; }
+
+	//! Drives gain reduction from the first channel of \a node's output instead of this node's input. Pass nullptr to detect from the input again.
+	void	setSidechain( const ci::audio::NodeRef &node );
+	//! Returns the sidechain Node, or nullptr if gain reduction is driven by the input.
+	const ci::audio::NodeRef&	getSidechain() const	{ return mSidechain; }
+
+	//! Returns the current gain reduction in decibels (0 or negative), smoothed with a 325 ms release. Safe to call from any thread.
+	float	getGainReductionDb() const	{ return mMeterGainReductionDb.load( std::memory_order_relaxed ); }
+	//! Returns the peak absolute detector input over the last processed block. Safe to call from any thread.
+	float	getDetectorPeak() const		{ return mMeterDetectorPeak.load( std::memory_order_relaxed ); }
 
   protected:
 	void initialize() override;
 	void process( ci::audio::Buffer *buffer )	override;
 
   private:
-
-	void setPreDelayTime( float preDelayTime );
+	void updateLookahead();
+	void updateCachedParameters( float dbThreshold, float dbKnee, float ratio, float attackTime, float releaseTime, float dbPostGain );
+	void computeFrameGainPrecise( size_t framesToProcess, float dryMix, float wetMix );
+	void computeFrameGainApproximate( size_t framesToProcess, float dryMix, float wetMix );
+	template <typename MathT>
+	float computeEnvelopeRate( float *scaledDesiredGain );
 	float kneeCurve( float x, float k );
 	float saturate( float x, float k );
 	float slopeAt( float x, float k );
 	float kAtSlope( float desiredSlope );
 	float updateStaticCurveParameters( float dbThreshold, float dbKnee, float ratio );
 
-	ci::audio::Param	mParamThreshold, mParamRatio, mParamKnee, mParamAttackTime, mParamReleaseTime;
+	ci::audio::Param	mParamThreshold, mParamRatio, mParamKnee, mParamAttackTime, mParamReleaseTime, mParamPostGain, mParamMix;
+	ci::audio::Param	mParamSidechain; // driven by mSidechain, when set
+	ci::audio::NodeRef	mSidechain;
 
 	float m_detectorAverage;
 	float m_compressorGain;
@@ -62,12 +125,23 @@ class CompressorNode : public ci::audio::Node {
 	// Metering
 	float m_meteringGain;
 	float m_meteringReleaseK;
-	
+	std::atomic<float>	mMeterGainReductionDb = { 0 };
+	std::atomic<float>	mMeterDetectorPeak = { 0 };
+
 	// Lookahead section.
+	std::atomic<float>	mLookahead;
+	float mMaxLookahead;
 	unsigned m_lastPreDelayFrames;
 	ci::audio::BufferDynamic mPreDelayBuffer;
-	int m_preDelayReadIndex;
-	int m_preDelayWriteIndex;
+	size_t mPreDelayMask;
+	size_t m_preDelayReadIndex;
+	size_t m_preDelayWriteIndex;
+
+	// Per-frame values for the current block, shared by all channels. Sized to a multiple of simd::LANES.
+	std::vector<float>	mDetectorInput;
+	std::vector<float>	mFrameGain;
+	std::vector<float>	mAttenuation, mSatReleaseRate, mEnvelopeGain, mMeterDb; // approximate path only
+	std::atomic<bool>	mApproximations;
 
 	float m_maxAttackCompressionDiffDb;
 
@@ -90,6 +164,19 @@ class CompressorNode : public ci::audio::Node {
 
 	// Internal parameter for the knee portion of the curve.
 	float m_K;
+
+	// Values derived from the params, only recomputed when one of them changes.
+	struct CachedParameters {
+		float	mDbThreshold = NAN, mDbKnee = NAN, mRatio = NAN, mAttackTime = NAN, mReleaseTime = NAN, mDbPostGain = NAN;
+
+		float	mMasterLinearGain = 1;
+		float	mAttackFrames = 0;
+		float	mSatReleaseFrames = 0;
+		// adaptive release polynomial
+		float	mKA = 0, mKB = 0, mKC = 0, mKD = 0, mKE = 0;
+	};
+
+	CachedParameters	mCached;
 };
 
 } } // namespace mason::audio
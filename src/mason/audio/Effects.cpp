@@ -20,9 +20,10 @@
 */
 
 #include "mason/audio/Effects.h"
+#include "mason/audio/FastMath.h"
+#include "mason/audio/Simd.h"
 
 #include "cinder/audio/Context.h"
-#include "cinder/audio/ChannelRouterNode.h"
 
 #include "glm/common.hpp"
 
@@ -35,80 +36,233 @@ namespace mason { namespace audio {
 // MoogFilterNode
 // ----------------------------------------------------------------------------------------------------
 
-MoogFilterNode::MoogFilterNode( const Format &format )
-	: Node( format ), mCutoffFreq( this, 400 ), mQ( this, 2 )
+namespace {
+
+const size_t MOOG_STATE_VARS = 8;
+const size_t VCF_STATE_VARS = 2;
+
+// Returns the number of channels that fill whole groups of four, which are processed in SIMD lanes. The rest, including the
+// common mono case, are processed one at a time so no lanes are wasted on padding.
+inline size_t getNumLaneChannels( size_t numChannels )
 {
-	setChannelMode( ChannelMode::SPECIFIED );
-	setNumChannels( 1 );
+	return numChannels - numChannels % simd::LANES;
 }
 
-void MoogFilterNode::initialize()
+// Fills \a channels with pointers to the four channels starting at \a firstChannel.
+void getLaneChannels( ci::audio::Buffer *buffer, size_t firstChannel, float *channels[simd::LANES] )
 {
-	reset();
+	for( size_t lane = 0; lane < simd::LANES; lane++ ) {
+		channels[lane] = buffer->getChannel( firstChannel + lane );
+	}
 }
 
-void MoogFilterNode::reset()
+// Returns the state of channel \a ch, where each group of four channels stores \a numVars lanes of four. Vars of one channel are simd::LANES apart.
+inline float* getChannelState( std::vector<float> &state, size_t numVars, size_t ch )
 {
-	mX1 = mX2 = mX3 = mX4 = 0;
-	mY1 = mY2 = mY3 = mY4 = 0;
+	return &state[( ch / simd::LANES ) * numVars * simd::LANES + ch % simd::LANES];
 }
 
-void MoogFilterNode::process( ci::audio::Buffer *buffer )
+// Runs \a tick for each frame of the four channels in \a channels, where tick takes one frame across all lanes along with its frame index.
+// Blocks of four frames are transposed into lanes so loads and stores stay contiguous.
+template <typename TickFn>
+void processLanes( float *channels[simd::LANES], size_t numFrames, const TickFn &tick )
 {
-	CI_ASSERT_MSG( buffer->getNumChannels() == 1, "multi channel not yet supported" );
+	using simd::float4;
 
-	float *data = buffer->getData();
+	size_t i = 0;
+	for( ; i + simd::LANES <= numFrames; i += simd::LANES ) {
+		float4 a = float4::load( channels[0] + i );
+		float4 b = float4::load( channels[1] + i );
+		float4 c = float4::load( channels[2] + i );
+		float4 d = float4::load( channels[3] + i );
 
-	size_t n = buffer->getNumFrames();
+		// each vector now holds one frame of all four channels
+		simd::transpose( a, b, c, d );
 
-	mCutoffFreq.eval();
-	mQ.eval();
+		a = tick( a, i );
+		b = tick( b, i + 1 );
+		c = tick( c, i + 2 );
+		d = tick( d, i + 3 );
 
-	const float *cutoffFreq = mCutoffFreq.getValueArray();
-	const float *quality	= mQ.getValueArray();
+		simd::transpose( a, b, c, d );
 
-	float x1 = mX1;
-    float x2 = mX2;
-    float x3 = mX3;
-    float x4 = mX4;
-    float ys1 = mY1;
-    float ys2 = mY2;
-    float ys3 = mY3;
-    float ys4 = mY4;
+		a.store( channels[0] + i );
+		b.store( channels[1] + i );
+		c.store( channels[2] + i );
+		d.store( channels[3] + i );
+	}
 
-	while( n-- ) {
-		float freq = glm::min( *cutoffFreq++, 8140.0f );
-		float q = glm::clamp( *quality++, 0.0f, 4.0f );
+	for( ; i < numFrames; i++ ) {
+		float out[simd::LANES];
+		tick( float4( channels[0][i], channels[1][i], channels[2][i], channels[3][i] ), i ).store( out );
+		for( size_t lane = 0; lane < simd::LANES; lane++ )
+			channels[lane][i] = out[lane];
+	}
+}
+
+inline void computeMoogCoefficients( float freq, float q, float *pt, float *pt1, float *qResult )
+{
+	freq = glm::min( freq, 8140.0f );
+	q = glm::clamp( q, 0.0f, 4.0f );
 
-		if( freq > 3800 )
-			q = q - 0.5f * ( ( freq - 3800 ) / 4300 );
+	if( freq > 3800 )
+		q = q - 0.5f * ( ( freq - 3800 ) / 4300 );
 
-		float pt = freq * 0.01f * 0.0140845f - 0.9999999f;
-		float pt1 = ( pt + 1 ) * 0.76923077f;
+	*pt = freq * 0.01f * 0.0140845f - 0.9999999f;
+	*pt1 = ( *pt + 1 ) * 0.76923077f;
+	*qResult = q;
+}
+
+} // anonymous namespace
+
+MoogFilterNode::MoogFilterNode( const Format &format )
+	: Node( format ), mCutoffFreq( this, 400 ), mQ( this, 2 )
+{
+}
+
+void MoogFilterNode::initialize()
+{
+	const size_t numGroups = ( getNumChannels() + simd::LANES - 1 ) / simd::LANES;
+	const size_t framesPerBlock = getFramesPerBlock();
+
+	mState.resize( numGroups * MOOG_STATE_VARS * simd::LANES );
+	mCoeffPt.resize( framesPerBlock );
+	mCoeffPt1.resize( framesPerBlock );
+	mCoeffQ.resize( framesPerBlock );
+
+	reset();
+}
 
-		float in = *data - q * ys4;
+void MoogFilterNode::reset()
+{
+	std::fill( mState.begin(), mState.end(), 0.0f );
+}
 
-		ys1 = pt1 * ( in  + 0.3f * x1 ) - pt * ys1;
-		ys2 = pt1 * ( ys1 + 0.3f * x2 ) - pt * ys2;
-		ys3 = pt1 * ( ys2 + 0.3f * x3 ) - pt * ys3;
-		ys4 = pt1 * ( ys3 + 0.3f * x4 ) - pt * ys4;
+void MoogFilterNode::process( ci::audio::Buffer *buffer )
+{
+	using simd::float4;
+
+	const size_t numFrames = buffer->getNumFrames();
+	CI_ASSERT( numFrames <= mCoeffPt.size() );
+
+	// coefficients are shared by all channels, so they are computed once per block unless a param is ramping.
+	// A stride of zero reads the same value for every frame.
+	float pt, pt1, q;
+	const float *ptArray = &pt;
+	const float *pt1Array = &pt1;
+	const float *qArray = &q;
+	size_t coeffStride = 0;
+
+	const bool freqVarying = mCutoffFreq.eval();
+	const bool qVarying = mQ.eval();
+	if( freqVarying || qVarying ) {
+		const float *freqValues = freqVarying ? mCutoffFreq.getValueArray() : nullptr;
+		const float *qValues = qVarying ? mQ.getValueArray() : nullptr;
+		const float freqValue = mCutoffFreq.getValue();
+		const float qValue = mQ.getValue();
+
+		for( size_t i = 0; i < numFrames; i++ ) {
+			computeMoogCoefficients( freqValues ? freqValues[i] : freqValue, qValues ? qValues[i] : qValue, &mCoeffPt[i], &mCoeffPt1[i], &mCoeffQ[i] );
+		}
 
-		x1 = in;
-		x2 = ys1;
-		x3 = ys2;
-		x4 = ys3;
+		ptArray = mCoeffPt.data();
+		pt1Array = mCoeffPt1.data();
+		qArray = mCoeffQ.data();
+		coeffStride = 1;
+	}
+	else {
+		computeMoogCoefficients( mCutoffFreq.getValue(), mQ.getValue(), &pt, &pt1, &q );
+	}
 
-		*data++ = ys4;
+	const size_t numChannels = buffer->getNumChannels();
+	const size_t numLaneChannels = getNumLaneChannels( numChannels );
+	const float4 mix( 0.3f );
+
+	for( size_t firstChannel = 0; firstChannel < numLaneChannels; firstChannel += simd::LANES ) {
+		float *channels[simd::LANES];
+		getLaneChannels( buffer, firstChannel, channels );
+
+		float *state = getChannelState( mState, MOOG_STATE_VARS, firstChannel );
+		float4 x1 = float4::load( state );
+		float4 x2 = float4::load( state + 4 );
+		float4 x3 = float4::load( state + 8 );
+		float4 x4 = float4::load( state + 12 );
+		float4 ys1 = float4::load( state + 16 );
+		float4 ys2 = float4::load( state + 20 );
+		float4 ys3 = float4::load( state + 24 );
+		float4 ys4 = float4::load( state + 28 );
+
+		processLanes( channels, numFrames, [&]( const float4 &input, size_t frame ) {
+			const size_t c = frame * coeffStride;
+			const float4 pt( ptArray[c] );
+			const float4 pt1( pt1Array[c] );
+
+			float4 in = input - float4( qArray[c] ) * ys4;
+
+			ys1 = pt1 * ( in  + mix * x1 ) - pt * ys1;
+			ys2 = pt1 * ( ys1 + mix * x2 ) - pt * ys2;
+			ys3 = pt1 * ( ys2 + mix * x3 ) - pt * ys3;
+			ys4 = pt1 * ( ys3 + mix * x4 ) - pt * ys4;
+
+			x1 = in;
+			x2 = ys1;
+			x3 = ys2;
+			x4 = ys3;
+
+			return ys4;
+		} );
+
+		x1.store( state );
+		x2.store( state + 4 );
+		x3.store( state + 8 );
+		x4.store( state + 12 );
+		ys1.store( state + 16 );
+		ys2.store( state + 20 );
+		ys3.store( state + 24 );
+		ys4.store( state + 28 );
 	}
 
-    mY1 = ys1;
-    mY2 = ys2;
-    mY3 = ys3;
-    mY4 = ys4;
-    mX1 = x1;
-    mX2 = x2;
-    mX3 = x3;
-    mX4 = x4;
+	for( size_t ch = numLaneChannels; ch < numChannels; ch++ ) {
+		float *state = getChannelState( mState, MOOG_STATE_VARS, ch );
+		float x1 = state[0];
+		float x2 = state[4];
+		float x3 = state[8];
+		float x4 = state[12];
+		float ys1 = state[16];
+		float ys2 = state[20];
+		float ys3 = state[24];
+		float ys4 = state[28];
+
+		float *data = buffer->getChannel( ch );
+		for( size_t i = 0; i < numFrames; i++ ) {
+			const size_t c = i * coeffStride;
+			const float pt = ptArray[c];
+			const float pt1 = pt1Array[c];
+
+			float in = data[i] - qArray[c] * ys4;
+
+			ys1 = pt1 * ( in  + 0.3f * x1 ) - pt * ys1;
+			ys2 = pt1 * ( ys1 + 0.3f * x2 ) - pt * ys2;
+			ys3 = pt1 * ( ys2 + 0.3f * x3 ) - pt * ys3;
+			ys4 = pt1 * ( ys3 + 0.3f * x4 ) - pt * ys4;
+
+			x1 = in;
+			x2 = ys1;
+			x3 = ys2;
+			x4 = ys3;
+
+			data[i] = ys4;
+		}
+
+		state[0] = x1;
+		state[4] = x2;
+		state[8] = x3;
+		state[12] = x4;
+		state[16] = ys1;
+		state[20] = ys2;
+		state[24] = ys3;
+		state[28] = ys4;
+	}
 }
 
 // ----------------------------------------------------------------------------------------------------
@@ -206,12 +360,30 @@ static inline t_float dsp_getCosineAtLUT (double position)
 
 #define dsp_getSineAtLUT(index) dsp_getCosineAtLUT ((double)(index) - (COSINE_TABLE_SIZE / 4.0))
 
+namespace {
+
+// computed in double precision as in [vcf~], the pole radius gets very close to 1 at low frequencies and high q
+inline void computeVcfCoefficients( float freq, float q, float conversion, double *gain, double *pReal, double *pImaginary )
+{
+	double qInverse = (q > 0.0 ? 1.0 / q : 0.0);
+	double correction = 2.0 - (2.0 / (q + 2.0));
+
+	double centerFrequency = freq * conversion;
+	centerFrequency = PD_MAX (0.0, centerFrequency);
+
+	double r = (qInverse > 0.0 ? 1.0 - centerFrequency * qInverse : 0.0);
+	r = PD_MAX (0.0, r);
+
+	*gain = correction * (1.0 - r);
+	*pReal = r * dsp_getCosineAtLUT (centerFrequency * (COSINE_TABLE_SIZE / PD_TWO_PI));
+	*pImaginary = r * dsp_getSineAtLUT (centerFrequency * (COSINE_TABLE_SIZE / PD_TWO_PI));
+}
+
+} // anonymous namespace
+
 VcfNode::VcfNode( const Format &format )
 	: Node( format ), mFreq( this, 400 ), mQ( this, 2 )
 {
-	setChannelMode( ChannelMode::SPECIFIED );
-	setNumChannels( 1 );
-
 	cos_tilde_initialize();
 }
 
@@ -223,145 +395,315 @@ void VcfNode::initialize()
 {
 	mConversion = ( 2.0f * M_PI ) / float( getSampleRate() );
 
+	const size_t numGroups = ( getNumChannels() + simd::LANES - 1 ) / simd::LANES;
+	const size_t framesPerBlock = getFramesPerBlock();
+
+	mState.resize( numGroups * VCF_STATE_VARS * simd::LANES );
+	mCoeffGain.resize( framesPerBlock );
+	mCoeffReal.resize( framesPerBlock );
+	mCoeffImaginary.resize( framesPerBlock );
+
 	reset();
 }
 
 void VcfNode::reset()
 {
-	mReal = 0;
-	mImaginary = 0;
+	std::fill( mState.begin(), mState.end(), 0.0f );
 }
 
 void VcfNode::process( ci::audio::Buffer *buffer )
 {
-	CI_ASSERT_MSG( buffer->getNumChannels() == 1, "multi channel not yet supported" );
-
-	mFreq.eval();
-	mQ.eval();
-
-	//float *in1 = (float *)(w[1]);
-	//float *in2 = (float *)(w[2]);
-	//float *out1 = (float *)(w[3]);
-	//float *out2 = (float *)(w[4]);
-	//t_vcfctl *c = (t_vcfctl *)(w[5]);
-	float *in1 = buffer->getData();
-	const float *in2 = mFreq.getValueArray();
-	float *out1 = in1;
-
-	//int n = (int)w[6];
-	//int i;
-	//float re = c->c_re, re2;
-	//float im = c->c_im;
-	//float q = c->c_q;
+	using simd::float4;
+
+	const size_t numFrames = buffer->getNumFrames();
+	CI_ASSERT( numFrames <= mCoeffGain.size() );
+
+	// as with MoogFilterNode, coefficients are only computed per-frame while a param is ramping
+	double gain, pReal, pImaginary;
+	const double *gainArray = &gain;
+	const double *realArray = &pReal;
+	const double *imaginaryArray = &pImaginary;
+	size_t coeffStride = 0;
+
+	const bool freqVarying = mFreq.eval();
+	const bool qVarying = mQ.eval();
+	if( freqVarying || qVarying ) {
+		const float *freqValues = freqVarying ? mFreq.getValueArray() : nullptr;
+		const float *qValues = qVarying ? mQ.getValueArray() : nullptr;
+		const float freqValue = mFreq.getValue();
+		const float qValue = mQ.getValue();
+
+		for( size_t i = 0; i < numFrames; i++ ) {
+			computeVcfCoefficients( freqValues ? freqValues[i] : freqValue, qValues ? qValues[i] : qValue, mConversion, &mCoeffGain[i], &mCoeffReal[i], &mCoeffImaginary[i] );
+		}
 
-	int n = buffer->getNumFrames();
-	float re = mReal;
-	float im = mImaginary;
-	float q = mQ.getValue();
-	float k = mConversion;
+		gainArray = mCoeffGain.data();
+		realArray = mCoeffReal.data();
+		imaginaryArray = mCoeffImaginary.data();
+		coeffStride = 1;
+	}
+	else {
+		computeVcfCoefficients( mFreq.getValue(), mQ.getValue(), mConversion, &gain, &pReal, &pImaginary );
+	}
 
-	Mode mode = mMode;
+	// Output real part in bandpass mode, imaginary in lowpass mode
+	// https://lists.puredata.info/pipermail/pd-list/2012-09/097546.html
+	const bool outputReal = ( mMode == Mode::BANDPASS );
 
-	double qInverse = (q > 0.0 ? 1.0 / q : 0.0);
-	double correction = 2.0 - (2.0 / (q + 2.0));
+	const size_t numChannels = buffer->getNumChannels();
+	const size_t numLaneChannels = getNumLaneChannels( numChannels );
 
-	while( n-- ) {
-		double centerFrequency;
-		double r, g;
-		double pReal;
-		double pImaginary;
+	// the lanes run in single precision. The state is rounded to float every frame in [vcf~] as well, only the products lose precision
+	for( size_t firstChannel = 0; firstChannel < numLaneChannels; firstChannel += simd::LANES ) {
+		float *channels[simd::LANES];
+		getLaneChannels( buffer, firstChannel, channels );
 
-		centerFrequency = (*in2++) * k; 
-		centerFrequency = PD_MAX (0.0, centerFrequency);
+		float *state = getChannelState( mState, VCF_STATE_VARS, firstChannel );
+		float4 re = float4::load( state );
+		float4 im = float4::load( state + 4 );
 
-		r = (qInverse > 0.0 ? 1.0 - centerFrequency * qInverse : 0.0);
-		r = PD_MAX (0.0, r);
-		g = correction * (1.0 - r);
+		processLanes( channels, numFrames, [&]( const float4 &input, size_t frame ) {
+			const size_t c = frame * coeffStride;
+			const float4 pr( (float)realArray[c] );
+			const float4 pi( (float)imaginaryArray[c] );
 
-		pReal      = r * dsp_getCosineAtLUT (centerFrequency * (COSINE_TABLE_SIZE / PD_TWO_PI));
-		pImaginary = r * dsp_getSineAtLUT   (centerFrequency * (COSINE_TABLE_SIZE / PD_TWO_PI));
+			const float4 tReal = re;
+			re = float4( (float)gainArray[c] ) * input + ( pr * tReal - pi * im );
+			im = pi * tReal + pr * im;
 
-		{
-			double s = (*in1++);
-			double tReal = re;
-			double tImaginary = im;
+			return outputReal ? re : im;
+		} );
 
-			re = (t_sample)((g * s) + (pReal * tReal - pImaginary * tImaginary));
-			im = (t_sample)((pImaginary * tReal + pReal * tImaginary));
+		re.store( state );
+		im.store( state + 4 );
 
-			// Output real part in bandpass mode, imaginary in lowpass mode
-			// https://lists.puredata.info/pipermail/pd-list/2012-09/097546.html
-			*out1++ = ( mode == Mode::BANDPASS ? re : im );
+		for( size_t i = 0; i < VCF_STATE_VARS * simd::LANES; i++ ) {
+			if( PD_IS_BIG_OR_SMALL( state[i] ) ) {
+				state[i] = 0;
+			}
 		}
 	}
 
-	if (PD_IS_BIG_OR_SMALL (re)) { re = (t_sample)0.0; }
-	if (PD_IS_BIG_OR_SMALL (im)) { im = (t_sample)0.0; }
+	// the remaining channels match [vcf~] exactly, computing in double and storing the state as float
+	for( size_t ch = numLaneChannels; ch < numChannels; ch++ ) {
+		float *state = getChannelState( mState, VCF_STATE_VARS, ch );
+		t_sample re = state[0];
+		t_sample im = state[4];
+
+		float *data = buffer->getChannel( ch );
+		for( size_t i = 0; i < numFrames; i++ ) {
+			const size_t c = i * coeffStride;
+			const double tReal = re;
+			const double tImaginary = im;
+			re = (t_sample)( ( gainArray[c] * data[i] ) + ( realArray[c] * tReal - imaginaryArray[c] * tImaginary ) );
+			im = (t_sample)( imaginaryArray[c] * tReal + realArray[c] * tImaginary );
+
+			data[i] = outputReal ? re : im;
+		}
+
+		if( PD_IS_BIG_OR_SMALL( re ) ) { re = (t_sample)0.0; }
+		if( PD_IS_BIG_OR_SMALL( im ) ) { im = (t_sample)0.0; }
 
-	mReal = re;
-	mImaginary = im;
+		state[0] = re;
+		state[4] = im;
+	}
 }
 
 // ----------------------------------------------------------------------------------------------------
-// Chorus
+// ChorusNode
 // ----------------------------------------------------------------------------------------------------
 
-Chorus::Chorus()
+namespace {
+
+const float CHORUS_BYPASS_RAMP_SECONDS = 0.01f;
+
+// sin( 2 pi phase ) for phase in [0, 1), folds the phase onto a triangle in [-1, 1] that sinHalfPi() maps back to a sine.
+inline float lfoSine( float phase )
 {
+	const float q = phase * 4;
+	const float x = q < 1 ? q : ( q < 3 ? 2 - q : q - 4 );
+	return fastmath::sinHalfPi( x );
 }
 
-void Chorus::setupGraph()
+// 4-point, 3rd-order Hermite interpolation between y0 and y1, at fraction t.
+inline float hermite( float yMinus1, float y0, float y1, float y2, float t )
 {
-	CI_ASSERT_MSG( mInput, "no input" );
-	CI_ASSERT_MSG( mOutput, "no output" );
+	const float c1 = 0.5f * ( y1 - yMinus1 );
+	const float c2 = yMinus1 - 2.5f * y0 + 2 * y1 - 0.5f * y2;
+	const float c3 = 0.5f * ( y2 - yMinus1 ) + 1.5f * ( y0 - y1 );
+	return ( ( c3 * t + c2 ) * t + c1 ) * t + y0;
+}
 
-	auto ctx = ci::audio::master();
+} // anonymous namespace
 
-	// setup 3 delays chains, each offset by M_PI / 3 radians
-	setupDelayChain( 0, 0 );
-	setupDelayChain( 1, 2 * M_PI / 3.0f );
-	setupDelayChain( 2, 4 * M_PI / 3.0f );
+ChorusNode::ChorusNode( const Format &format )
+	: Node( format ), mDelay( this, 0.02f ), mRate( this, 0.9f ), mDepth( this, 0.002f ), mMix( this, 0.5f ),
+		mNumVoices( std::max<size_t>( format.getNumVoices(), 1 ) ), mMaxDelaySeconds( format.getMaxDelaySeconds() )
+{
+	setChannelMode( ChannelMode::SPECIFIED );
+	setNumChannels( 2 );
+}
 
-	auto router = ctx->makeNode( new ci::audio::ChannelRouterNode( ci::audio::Node::Format().channels( 2 ) ) );
-	auto leftMix = ctx->makeNode( new ci::audio::Node( ci::audio::Node::Format() ) );
-	auto rightMix = ctx->makeNode( new ci::audio::Node( ci::audio::Node::Format() ) );
+void ChorusNode::initialize()
+{
+	const float sampleRate = float( getSampleRate() );
+
+	// one frame ahead and two behind the integer delay are read for interpolation
+	const size_t requiredFrames = size_t( std::ceil( mMaxDelaySeconds * sampleRate ) ) + 4;
+	size_t length = 1;
+	while( length < requiredFrames )
+		length <<= 1;
+
+	mDelayLine.resize( length );
+	mDelayMask = length - 1;
+	mPhases.resize( mNumVoices );
+	mPanLeft.resize( mNumVoices );
+	mPanRight.resize( mNumVoices );
+	mPanSpread = -1;
+	mWetGainStep = 1.0f / ( CHORUS_BYPASS_RAMP_SECONDS * sampleRate );
+
+	reset();
+}
 
-	// split the input into each of the delay chains
-	mInput >> mDelayChains[0].mDelay;
-	mInput >> mDelayChains[1].mDelay;
-	mInput >> mDelayChains[2].mDelay;
+void ChorusNode::reset()
+{
+	std::fill( mDelayLine.begin(), mDelayLine.end(), 0.0f );
+	mWriteIndex = 0;
 
-	// route 0 to left, 1 to both, and 2 to right
-	mDelayChains[0].mDelay >> leftMix;
-	mDelayChains[1].mDelay >> leftMix;
-	mDelayChains[1].mDelay >> rightMix;
-	mDelayChains[2].mDelay >> rightMix;
+	for( size_t v = 0; v < mPhases.size(); v++ )
+		mPhases[v] = float( v ) / float( mPhases.size() );
 
-	leftMix >> router->route( 0, 0 );
-	rightMix >> router->route( 0, 1 );
+	mWetGain = mBypass ? 0.0f : 1.0f;
+}
 
-	router >> mOutput;
+void ChorusNode::updatePanGains( float spread )
+{
+	// normalized so that voices panned to the center sum to unity in each channel
+	const float norm = float( M_SQRT2 ) / float( mNumVoices );
+	for( size_t v = 0; v < mNumVoices; v++ ) {
+		const float position = mNumVoices > 1 ? ( 2 * float( v ) / float( mNumVoices - 1 ) - 1 ) * spread : 0.0f; // [-1:1], left to right
+		const float angle = ( position + 1 ) * float( M_PI ) / 4;
+		mPanLeft[v] = std::cos( angle ) * norm;
+		mPanRight[v] = std::sin( angle ) * norm;
+	}
 
-	if( mConnectInputToOutput )
-		mInput >> mOutput;
+	mPanSpread = spread;
 }
 
-void Chorus::setupDelayChain( size_t index, float phaseOffset )
+void ChorusNode::process( ci::audio::Buffer *buffer )
 {
-	auto ctx = ci::audio::master();
-	auto &chain = mDelayChains.at( index );
+	const size_t numFrames = buffer->getNumFrames();
+	const float sampleRate = float( getSampleRate() );
+	float *left = buffer->getChannel( 0 );
+	float *right = buffer->getChannel( 1 );
+	float *delayLine = mDelayLine.data();
+	float *phases = mPhases.data();
+
+	const float spread = glm::clamp( mSpread.load(), 0.0f, 1.0f );
+	if( spread != mPanSpread )
+		updatePanGains( spread );
+
+	const float wetTarget = mBypass ? 0.0f : 1.0f;
+
+	const float *rateValues = mRate.eval() ? mRate.getValueArray() : nullptr;
+	const float rateValue = mRate.getValue();
+
+	// fully bypassed: keep the delay line and LFOs running but leave the buffer as is
+	if( mWetGain == 0 && wetTarget == 0 ) {
+		float phaseAdvance = 0;
+		for( size_t i = 0; i < numFrames; i++ ) {
+			delayLine[mWriteIndex] = 0.5f * ( left[i] + right[i] );
+			mWriteIndex = ( mWriteIndex + 1 ) & mDelayMask;
+			phaseAdvance += ( rateValues ? rateValues[i] : rateValue ) / sampleRate;
+		}
 
-	chain.mDelay = ctx->makeNode( new ci::audio::DelayNode );
-	chain.mDelay->setMaxDelaySeconds( 1 ); // TODO: calculate the max delay seconds from other params
+		phaseAdvance -= std::floor( phaseAdvance );
+		for( size_t v = 0; v < mNumVoices; v++ ) {
+			phases[v] += phaseAdvance;
+			if( phases[v] >= 1 )
+				phases[v] -= 1;
+		}
+		return;
+	}
 
-	chain.mLfo = ctx->makeNode( new ci::audio::GenSineNode( mLfoRate, ci::audio::Node::Format().autoEnable() ) );
-	chain.mLfo->setPhase( phaseOffset );
+	const float *delayValues = mDelay.eval() ? mDelay.getValueArray() : nullptr;
+	const float *depthValues = mDepth.eval() ? mDepth.getValueArray() : nullptr;
+	const float *mixValues = mMix.eval() ? mMix.getValueArray() : nullptr;
+	const float delayValue = mDelay.getValue();
+	const float depthValue = mDepth.getValue();
+	const float mixValue = mMix.getValue();
+	const bool additive = mMixMode == MixMode::Additive;
+
+	const float minDelayFrames = 1;
+	const float maxDelayFrames = float( mDelayLine.size() - 3 );
+
+	for( size_t i = 0; i < numFrames; i++ ) {
+		const float dryLeft = left[i];
+		const float dryRight = right[i];
+		delayLine[mWriteIndex] = 0.5f * ( dryLeft + dryRight );
+
+		if( mWetGain < wetTarget )
+			mWetGain = std::min( mWetGain + mWetGainStep, wetTarget );
+		else if( mWetGain > wetTarget )
+			mWetGain = std::max( mWetGain - mWetGainStep, wetTarget );
+
+		const float centerFrames = ( delayValues ? delayValues[i] : delayValue ) * sampleRate;
+		const float depthFrames = ( depthValues ? depthValues[i] : depthValue ) * sampleRate;
+		const float phaseIncr = ( rateValues ? rateValues[i] : rateValue ) / sampleRate;
+
+		float wetLeft = 0;
+		float wetRight = 0;
+		for( size_t v = 0; v < mNumVoices; v++ ) {
+			const float delayFrames = glm::clamp( centerFrames + depthFrames * lfoSine( phases[v] ), minDelayFrames, maxDelayFrames );
+			const size_t delayInt = size_t( delayFrames );
+			const float frac = delayFrames - float( delayInt );
+
+			const size_t index = mWriteIndex - delayInt; // wraps with the mask below
+			const float sample = hermite( delayLine[( index + 1 ) & mDelayMask], delayLine[index & mDelayMask],
+											delayLine[( index - 1 ) & mDelayMask], delayLine[( index - 2 ) & mDelayMask], frac );
+
+			wetLeft += sample * mPanLeft[v];
+			wetRight += sample * mPanRight[v];
+
+			phases[v] += phaseIncr;
+			if( phases[v] >= 1 )
+				phases[v] -= 1;
+		}
+
+		const float wet = ( mixValues ? mixValues[i] : mixValue ) * mWetGain;
+		const float dry = additive ? 1 : 1 - wet;
+		left[i] = dryLeft * dry + wetLeft * wet;
+		right[i] = dryRight * dry + wetRight * wet;
+
+		mWriteIndex = ( mWriteIndex + 1 ) & mDelayMask;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Chorus
+// ----------------------------------------------------------------------------------------------------
+
+Chorus::Chorus()
+{
+	mChorusNode = ci::audio::master()->makeNode( new ChorusNode );
+
+	// the defaults of the graph this class used to manage
+	mChorusNode->setDelay( 0.3f );
+	mChorusNode->setRate( 0.9f );
+	mChorusNode->setDepth( 0.0008f );
+
+	// the old graph summed the full dry signal with two unnormalized delay taps per side, a power of 2 per channel for
+	// uncorrelated taps. The ChorusNode's normalized, equal power panned voices have a power of 1/3 per channel, so the wet gain is sqrt( 6 )
+	mChorusNode->setMixMode( ChorusNode::MixMode::Additive );
+	mChorusNode->setMix( std::sqrt( 6.0f ) );
+}
 
-	chain.mLfoGain = ctx->makeNode( new ci::audio::GainNode( mLfoGain ) );
-	chain.mDelaySeconds = ctx->makeNode( new ci::audio::AddNode( mDelaySeconds ) );
+void Chorus::setupGraph()
+{
+	CI_ASSERT_MSG( mInput, "no input" );
+	CI_ASSERT_MSG( mOutput, "no output" );
 
-	chain.mLfo >> chain.mLfoGain >> chain.mDelaySeconds;
-	chain.mDelay->getParamDelaySeconds()->setProcessor( chain.mDelaySeconds );
+	mInput >> mChorusNode >> mOutput;
 }
 
 void Chorus::setInput( const ci::audio::NodeRef &node )
@@ -377,29 +719,27 @@ void Chorus::setOutput( const ci::audio::NodeRef &node )
 
 void Chorus::setLfoRate( float rate )
 {
-	mLfoRate = rate;
-	for( auto &chain : mDelayChains ) {
-		if( chain.mLfo )
-			chain.mLfo->setFreq( rate );
-	}
+	mChorusNode->setRate( rate );
 }
 
 void Chorus::setLfoGain( float gainLinear )
 {
-	mLfoGain = gainLinear;
-	for( auto &chain : mDelayChains ) {
-		if( chain.mLfoGain )
-			chain.mLfoGain->setValue( gainLinear );
-	}
+	mChorusNode->setDepth( gainLinear );
 }
 
 void Chorus::setDelay( float delaySeconds )
 {
-	mDelaySeconds = delaySeconds;
-	for( auto &chain : mDelayChains ) {
-		if( chain.mDelaySeconds )
-			chain.mDelaySeconds->setValue( delaySeconds );
-	}
+	mChorusNode->setDelay( delaySeconds );
+}
+
+void Chorus::setBypass( bool bypass )
+{
+	mChorusNode->setBypass( bypass );
+}
+
+bool Chorus::isBypassed() const
+{
+	return mChorusNode->isBypassed();
 }
 
 } } // namespace mason::audio
@@ -28,6 +28,8 @@
 #include "cinder/audio/NodeEffects.h"
 
 #include <array>
+#include <atomic>
+#include <vector>
 
 namespace mason { namespace audio {
 
@@ -39,6 +41,7 @@ using VcfNodeRef = std::shared_ptr<class VcfNode>;
 //! Implementation based on the source from Gunter Geiger's [moog~] pd external.
 //! A similar algorithm can be found at: http://www.musicdsp.org/showArchiveComment.php?ArchiveID=26
 //!
+//! Any number of channels are processed, groups of four in SIMD lanes and the rest (ex. mono) one at a time. By default the channel count matches the input.
 class MoogFilterNode : public ci::audio::Node {
 public:
 	MoogFilterNode( const Format &format = Format() );
@@ -66,14 +69,15 @@ private:
 	ci::audio::Param	mCutoffFreq;
 	ci::audio::Param	mQ;
 
-	float mX1, mX2, mX3, mX4;
-	float mY1, mY2, mY3, mY4;
+	std::vector<float>	mState;		// x1-4 and y1-4 for each group of four channels, one value per lane
+	std::vector<float>	mCoeffPt, mCoeffPt1, mCoeffQ; // per-frame coefficients, only filled while a param is ramping
 };
 
 //! Port of Pd's [vcf~] Node
 //!
 //! Complex one-pole resonant filter (with audio-rate center frequency input).
 //! Default Mode is bandpass, can also be used as a lowpass resonant filter.
+//! Any number of channels are processed, groups of four in SIMD lanes and the rest (ex. mono) one at a time. By default the channel count matches the input.
 class VcfNode : public ci::audio::Node {
 public:
 	//! These map to the left and right outputs of [vcf~]
@@ -111,13 +115,113 @@ private:
 	ci::audio::Param	mQ;
 	
 	std::atomic<Mode>	mMode = { Mode::BANDPASS };
-	float	mReal, mImaginary, mConversion;
+	float	mConversion = 0;
+
+	std::vector<float>	mState;		// real and imaginary parts for each group of four channels, one value per lane
+	std::vector<double>	mCoeffGain, mCoeffReal, mCoeffImaginary; // per-frame coefficients, only filled while a param is ramping
 };
 
+using ChorusNodeRef = std::shared_ptr<class ChorusNode>;
 typedef std::shared_ptr<class Chorus>	ChorusRef;
 
-//! Manages a graph that constructs a stereo chorus effect.
-// TODO: this needs enable / disable functionality
+//! \brief Multi-voice stereo chorus in a single Node.
+//!
+//! Each voice reads a mono sum of the input from a shared delay line, modulated by its own sine LFO and interpolated at
+//! fractional delays with a 4-point Hermite curve. LFO phases are spread evenly across the voices and the voices are panned
+//! from left to right by the spread amount. The output is always stereo, a mono input is upmixed to both channels for the dry signal.
+class ChorusNode : public ci::audio::Node {
+  public:
+	//! How the wet signal is combined with the dry signal.
+	enum class MixMode {
+		Crossfade,	//!< dry * ( 1 - mix ) + wet * mix
+		Additive	//!< dry + wet * mix, the dry signal is never attenuated and mix may exceed 1
+	};
+
+	struct Format : public ci::audio::Node::Format {
+		Format()	{ channels( 2 ); }
+
+		//! Sets the number of chorus voices. Default is 3.
+		Format&	voices( size_t numVoices )			{ mNumVoices = numVoices; return *this; }
+		//! Sets the maximum delay in seconds that the delay line can hold, which bounds delay plus depth. Default is 1.
+		Format&	maxDelay( float seconds )			{ mMaxDelaySeconds = seconds; return *this; }
+
+		size_t	getNumVoices() const				{ return mNumVoices; }
+		float	getMaxDelaySeconds() const			{ return mMaxDelaySeconds; }
+
+		// reimpl Node::Format, the channel count is fixed at two
+		Format&	autoEnable( bool autoEnable = true ){ Node::Format::autoEnable( autoEnable ); return *this; }
+
+	  private:
+		size_t	mNumVoices = 3;
+		float	mMaxDelaySeconds = 1;
+	};
+
+	ChorusNode( const Format &format = Format() );
+
+	//! Param for the center delay of each voice in seconds.
+	ci::audio::Param*	getParamDelay()		{ return &mDelay; }
+	//! Param for the LFO frequency in hertz.
+	ci::audio::Param*	getParamRate()		{ return &mRate; }
+	//! Param for the LFO depth in seconds, which is added to and subtracted from the delay.
+	ci::audio::Param*	getParamDepth()		{ return &mDepth; }
+	//! Param for the wet / dry balance, where 0 is fully dry and 1 is fully wet. With MixMode::Additive this is the gain of the wet signal.
+	ci::audio::Param*	getParamMix()		{ return &mMix; }
+
+	void	setDelay( float seconds )	{ mDelay.setValue( seconds ); }
+	float	getDelay() const			{ return mDelay.getValue(); }
+	void	setRate( float hertz )		{ mRate.setValue( hertz ); }
+	float	getRate() const				{ return mRate.getValue(); }
+	void	setDepth( float seconds )	{ mDepth.setValue( seconds ); }
+	float	getDepth() const			{ return mDepth.getValue(); }
+	void	setMix( float mix )			{ mMix.setValue( mix ); }
+	float	getMix() const				{ return mMix.getValue(); }
+	//! Sets how the wet signal is combined with the dry signal. Default is MixMode::Crossfade.
+	void	setMixMode( MixMode mode )	{ mMixMode = mode; }
+	MixMode	getMixMode() const			{ return mMixMode; }
+
+	//! Sets how far the voices are panned apart, where 0 places them all in the center and 1 spreads them from hard left to hard right.
+	void	setSpread( float spread )	{ mSpread = spread; }
+	float	getSpread() const			{ return mSpread; }
+
+	//! Fades the wet signal out (or back in) over a few milliseconds, after which the input is passed through untouched. The delay line
+	//! and LFOs keep running while bypassed so that re-enabling doesn't replay stale audio. Unlike disabling the Node, this is click free.
+	void	setBypass( bool bypass )	{ mBypass = bypass; }
+	bool	isBypassed() const			{ return mBypass; }
+
+	size_t	getNumVoices() const		{ return mNumVoices; }
+	float	getMaxDelaySeconds() const	{ return mMaxDelaySeconds; }
+
+	//! Clears the delay line and restarts the LFOs.
+	void reset();
+
+  protected:
+	void initialize() override;
+	void process( ci::audio::Buffer *buffer )	override;
+
+  private:
+	void updatePanGains( float spread );
+
+	ci::audio::Param	mDelay, mRate, mDepth, mMix;
+
+	const size_t		mNumVoices;
+	const float			mMaxDelaySeconds;
+	std::atomic<float>	mSpread = { 1 };
+	std::atomic<bool>	mBypass = { false };
+	std::atomic<MixMode>	mMixMode = { MixMode::Crossfade };
+
+	std::vector<float>	mDelayLine;			// mono sum of the input, length is a power of two
+	size_t				mDelayMask = 0;
+	size_t				mWriteIndex = 0;
+	std::vector<float>	mPhases;			// normalized LFO phase of each voice, [0:1)
+	std::vector<float>	mPanLeft, mPanRight; // equal power pan gains of each voice, scaled to normalize the wet sum
+	float				mPanSpread = -1;	// spread that the pan gains were computed for
+	float				mWetGain = 1;		// ramps between 0 and 1 when bypass changes
+	float				mWetGainStep = 0;
+};
+
+//! Manages a stereo chorus between an input and output Node. The effect itself is a ChorusNode, which this connects in between.
+//! It is set up to match the graph this class used to build: the full dry signal plus the voices at about the same level as the
+//! previous two unnormalized delay taps per side. The voices are panned with an equal power law rather than hard left / center / right.
 class Chorus {
   public:
 	Chorus();
@@ -129,25 +233,17 @@ class Chorus {
 	void setLfoGain( float gainLinear );
 	void setDelay( float delaySeconds );
 
-  private:
-	struct DelayChain {
-		ci::audio::DelayNodeRef		mDelay;
-		ci::audio::AddNodeRef		mDelaySeconds;
-		ci::audio::GenSineNodeRef	mLfo;
-		ci::audio::GainNodeRef		mLfoGain;
-	};
-
-	void setupGraph();
-	void setupDelayChain( size_t index, float phaseOffset );
+	//! Fades the chorus out without disconnecting anything. \see ChorusNode::setBypass()
+	void setBypass( bool bypass );
+	bool isBypassed() const;
 
-	ci::audio::NodeRef			mInput, mOutput;
+	const ChorusNodeRef&	getNode() const	{ return mChorusNode; }
 
-	std::array<DelayChain, 3>	mDelayChains;
+  private:
+	void setupGraph();
 
-	float mDelaySeconds = 0.3f;
-	float mLfoRate = 0.9f;
-	float mLfoGain = 0.0008f;
-	bool  mConnectInputToOutput = true;
+	ci::audio::NodeRef	mInput, mOutput;
+	ChorusNodeRef		mChorusNode;
 };
 
 inline const ChorusRef& operator>>( const ci::audio::NodeRef &input, const ChorusRef &chorus )
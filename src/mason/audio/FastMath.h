@@ -0,0 +1,202 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+//! \file FastMath.h
+//! Polynomial approximations of the transcendental functions used in per-sample DSP, in scalar and simd::float4 versions.
+//! Relative error of exp2() and log2() is below 2e-7 over the normal float range, sinHalfPi() and asinNormalized() are within 2e-7 absolute on [0, 1].
+
+#include "mason/audio/Simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace mason { namespace audio { namespace fastmath {
+
+namespace detail {
+
+// 2^f for f in [-0.5, 0.5], Taylor series of e^(f ln2) through f^6
+template <typename T>
+inline T exp2Poly( const T &f )
+{
+	T p = T( 1.5403530393381609e-4f );
+	p = p * f + T( 1.3333558146428443e-3f );
+	p = p * f + T( 9.6181291076284772e-3f );
+	p = p * f + T( 5.5504108664821580e-2f );
+	p = p * f + T( 2.4022650695910071e-1f );
+	p = p * f + T( 6.9314718055994531e-1f );
+	return p * f + T( 1.0f );
+}
+
+// log2(m) for m in [sqrt(0.5), sqrt(2)], atanh series in t = (m - 1) / (m + 1) through t^9
+template <typename T>
+inline T log2Poly( const T &m )
+{
+	const T t = ( m - T( 1.0f ) ) / ( m + T( 1.0f ) );
+	const T t2 = t * t;
+	T p = T( 0.32059401f );	// 2 / ( 9 ln2 )
+	p = p * t2 + T( 0.41219230f );	// 2 / ( 7 ln2 )
+	p = p * t2 + T( 0.57706925f );	// 2 / ( 5 ln2 )
+	p = p * t2 + T( 0.96178209f );	// 2 / ( 3 ln2 )
+	p = p * t2 + T( 2.88539008f );	// 2 / ln2
+	return p * t;
+}
+
+const float SQRT_2 = 1.41421356f;
+const float LOG2_10_OVER_20 = 0.166096404744f;	// converts decibels to log2 units
+const float DB_PER_LOG2 = 6.02059991328f;		// 20 * log10( 2 )
+
+} // namespace detail
+
+//! Returns 2^x, \a x is clamped to [-126, 126].
+inline float exp2( float x )
+{
+	x = std::min( std::max( x, -126.0f ), 126.0f );
+	const float xi = std::floor( x + 0.5f );
+	const int32_t bits = ( int32_t( xi ) + 127 ) << 23;
+	float scale;
+	memcpy( &scale, &bits, sizeof( float ) );
+	return scale * detail::exp2Poly( x - xi );
+}
+
+//! Returns log2( x ) for positive, normal \a x.
+inline float log2( float x )
+{
+	int32_t bits;
+	memcpy( &bits, &x, sizeof( float ) );
+	float e = float( ( ( bits >> 23 ) & 0xff ) - 127 );
+	bits = ( bits & 0x007fffff ) | 0x3f800000;
+	float m;
+	memcpy( &m, &bits, sizeof( float ) );
+	if( m > detail::SQRT_2 ) {
+		m *= 0.5f;
+		e += 1;
+	}
+
+	return e + detail::log2Poly( m );
+}
+
+//! Returns x^y for positive \a x.
+inline float pow( float x, float y )
+{
+	return exp2( y * log2( x ) );
+}
+
+inline float decibelsToLinear( float decibels )
+{
+	return exp2( decibels * detail::LOG2_10_OVER_20 );
+}
+
+inline float linearToDecibels( float linear )
+{
+	return log2( linear ) * detail::DB_PER_LOG2;
+}
+
+//! Returns sin( x * pi / 2 ) for \a x in [-1, 1].
+template <typename T>
+inline T sinHalfPi( const T &x )
+{
+	const T y = x * T( 1.57079632679f );
+	const T y2 = y * y;
+	T p = T( -2.50521084e-8f );
+	p = p * y2 + T( 2.75573192e-6f );
+	p = p * y2 + T( -1.98412698e-4f );
+	p = p * y2 + T( 8.33333333e-3f );
+	p = p * y2 + T( -1.66666667e-1f );
+	p = p * y2 + T( 1.0f );
+	return p * y;
+}
+
+//! Returns asin( x ) / ( pi / 2 ) for \a x in [0, 1]. Uses the two range reduction of the Cephes asinf(), so it stays accurate relative to \a x near 0.
+inline float asinNormalized( float x )
+{
+	x = std::min( std::max( x, 0.0f ), 1.0f );
+
+	// asin( x ) = x + x^3 * P( x^2 ) below 0.5, above that asin( x ) = pi / 2 - 2 asin( sqrt( ( 1 - x ) / 2 ) )
+	const bool upper = x > 0.5f;
+	const float z = upper ? 0.5f * ( 1 - x ) : x * x;
+	const float s = upper ? std::sqrt( z ) : x;
+
+	float p = 4.2163199048e-2f;
+	p = p * z + 2.4181311049e-2f;
+	p = p * z + 4.5470025998e-2f;
+	p = p * z + 7.4953002686e-2f;
+	p = p * z + 1.6666752422e-1f;
+	const float r = s + s * z * p;
+
+	return upper ? 1.0f - r * 1.27323954f : r * 0.636619772f; // 2 / ( pi / 2 ), 1 / ( pi / 2 )
+}
+
+// ----------------------------------------------------------------------------------------------------
+// simd::float4 versions
+// ----------------------------------------------------------------------------------------------------
+
+#if MA_SIMD_SSE
+
+inline simd::float4 exp2( const simd::float4 &x )
+{
+	const __m128 clamped = _mm_min_ps( _mm_max_ps( x.v, _mm_set1_ps( -126.0f ) ), _mm_set1_ps( 126.0f ) );
+	const __m128i xi = _mm_cvtps_epi32( clamped ); // rounds to nearest
+	const __m128 f = _mm_sub_ps( clamped, _mm_cvtepi32_ps( xi ) );
+	const __m128 scale = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( xi, _mm_set1_epi32( 127 ) ), 23 ) );
+	return simd::float4( scale ) * detail::exp2Poly( simd::float4( f ) );
+}
+
+inline simd::float4 log2( const simd::float4 &x )
+{
+	const __m128i bits = _mm_castps_si128( x.v );
+	const __m128i exponent = _mm_sub_epi32( _mm_and_si128( _mm_srli_epi32( bits, 23 ), _mm_set1_epi32( 0xff ) ), _mm_set1_epi32( 127 ) );
+	simd::float4 e = _mm_cvtepi32_ps( exponent );
+	simd::float4 m = _mm_castsi128_ps( _mm_or_si128( _mm_and_si128( bits, _mm_set1_epi32( 0x007fffff ) ), _mm_set1_epi32( 0x3f800000 ) ) );
+
+	const simd::float4 above = m > simd::float4( detail::SQRT_2 );
+	m = simd::select( above, m * 0.5f, m );
+	e = e + simd::float4( _mm_and_ps( above.v, _mm_set1_ps( 1.0f ) ) );
+
+	return e + detail::log2Poly( m );
+}
+
+#else
+
+inline simd::float4 exp2( const simd::float4 &x )
+{
+	return simd::float4( exp2( x.v[0] ), exp2( x.v[1] ), exp2( x.v[2] ), exp2( x.v[3] ) );
+}
+
+inline simd::float4 log2( const simd::float4 &x )
+{
+	return simd::float4( log2( x.v[0] ), log2( x.v[1] ), log2( x.v[2] ), log2( x.v[3] ) );
+}
+
+#endif
+
+inline simd::float4 decibelsToLinear( const simd::float4 &decibels )
+{
+	return exp2( decibels * detail::LOG2_10_OVER_20 );
+}
+
+inline simd::float4 linearToDecibels( const simd::float4 &linear )
+{
+	return log2( linear ) * detail::DB_PER_LOG2;
+}
+
+} } } // namespace mason::audio::fastmath
@@ -0,0 +1,456 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/audio/FeatureExtractor.h"
+
+#include "cinder/audio/Utilities.h"
+#include "cinder/CinderAssert.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+const float MIN_POWER = 1e-12f; // avoids log( 0 ) in flatness and MFCCs
+
+float hzToMel( float hz )
+{
+	return 2595.0f * log10f( 1.0f + hz / 700.0f );
+}
+
+float melToHz( float mel )
+{
+	return 700.0f * ( powf( 10.0f, mel / 2595.0f ) - 1.0f );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// FeatureHistory
+// ----------------------------------------------------------------------------------------------------
+
+void FeatureHistory::allocate( size_t numFrames, size_t numMfccCoeffs, size_t numBins )
+{
+	// one extra slot so that the frame being written is never handed out to readers
+	mCapacity = numFrames + 1;
+	mNumMfccCoeffs = numMfccCoeffs;
+	mNumBins = numBins;
+
+	for( auto &values : mScalars )
+		values.assign( mCapacity, 0.0f );
+
+	mMfcc.assign( mCapacity * mNumMfccCoeffs, 0.0f );
+	mChroma.assign( mCapacity * 12, 0.0f );
+	mMagSpectrum.assign( mCapacity * mNumBins, 0.0f );
+
+	reset();
+}
+
+void FeatureHistory::reset()
+{
+	mNumFramesWritten = 0;
+}
+
+size_t FeatureHistory::getNumFrames() const
+{
+	return (size_t)min<uint64_t>( getNumFramesWritten(), getCapacity() );
+}
+
+int64_t FeatureHistory::readSlot( size_t framesAgo ) const
+{
+	uint64_t numWritten = getNumFramesWritten();
+	if( framesAgo >= min<uint64_t>( numWritten, getCapacity() ) )
+		return -1;
+
+	return int64_t( ( numWritten - 1 - framesAgo ) % mCapacity );
+}
+
+float FeatureHistory::getValue( Feature feature, size_t framesAgo ) const
+{
+	CI_ASSERT( feature < Feature::NUM_SCALAR_FEATURES );
+
+	int64_t slot = readSlot( framesAgo );
+	if( slot < 0 )
+		return 0;
+
+	return mScalars[(size_t)feature][(size_t)slot];
+}
+
+size_t FeatureHistory::copyRecent( Feature feature, float *dest, size_t count ) const
+{
+	CI_ASSERT( feature < Feature::NUM_SCALAR_FEATURES );
+
+	uint64_t numWritten = getNumFramesWritten();
+	size_t numFrames = (size_t)min<uint64_t>( { numWritten, getCapacity(), count } );
+	const auto &values = mScalars[(size_t)feature];
+
+	for( size_t i = 0; i < numFrames; i++ ) {
+		size_t framesAgo = numFrames - 1 - i;
+		dest[i] = values[( numWritten - 1 - framesAgo ) % mCapacity];
+	}
+
+	return numFrames;
+}
+
+const float* FeatureHistory::getMfcc( size_t framesAgo ) const
+{
+	int64_t slot = readSlot( framesAgo );
+	if( slot < 0 || mNumMfccCoeffs == 0 )
+		return nullptr;
+
+	return &mMfcc[(size_t)slot * mNumMfccCoeffs];
+}
+
+const float* FeatureHistory::getChroma( size_t framesAgo ) const
+{
+	int64_t slot = readSlot( framesAgo );
+	if( slot < 0 )
+		return nullptr;
+
+	return &mChroma[(size_t)slot * 12];
+}
+
+const float* FeatureHistory::getMagSpectrum( size_t framesAgo ) const
+{
+	int64_t slot = readSlot( framesAgo );
+	if( slot < 0 || mNumBins == 0 )
+		return nullptr;
+
+	return &mMagSpectrum[(size_t)slot * mNumBins];
+}
+
+// ----------------------------------------------------------------------------------------------------
+// FeatureExtractorNode
+// ----------------------------------------------------------------------------------------------------
+
+FeatureExtractorNode::FeatureExtractorNode( const Format &format )
+	: NodeAutoPullable( format ), mFormat( format )
+{
+}
+
+FeatureExtractorNode::~FeatureExtractorNode()
+{
+}
+
+float FeatureExtractorNode::getFrameRate() const
+{
+	return mHopSize ? float( getSampleRate() ) / float( mHopSize ) : 0.0f;
+}
+
+void FeatureExtractorNode::initialize()
+{
+	size_t windowSize = mFormat.getWindowSize();
+	CI_ASSERT_MSG( windowSize > 0, "window size must be greater than zero" );
+
+	mFftSize = max( mFormat.getFftSize(), windowSize );
+	if( ! ci::audio::isPowerOf2( mFftSize ) )
+		mFftSize = ci::audio::nextPowerOf2( static_cast<uint32_t>( mFftSize ) );
+
+	mHopSize = mFormat.getHopSize() ? mFormat.getHopSize() : windowSize / 2;
+	mHopSize = glm::clamp<size_t>( mHopSize, 1, windowSize );
+
+	mBinWidth = float( getSampleRate() ) / float( mFftSize );
+
+	mFft.reset( new ci::audio::dsp::Fft( mFftSize ) );
+	mFftBuffer = ci::audio::Buffer( mFftSize );
+	mBufferSpectral = ci::audio::BufferSpectral( mFftSize );
+
+	mWindowingTable = ci::audio::makeAlignedArray<float>( windowSize );
+	ci::audio::dsp::generateWindow( mFormat.getWindowType(), mWindowingTable.get(), windowSize );
+
+	mInputRing.assign( windowSize, 0.0f );
+	mInputWritePos = 0;
+	mSamplesUntilHop = mHopSize;
+
+	size_t numBins = getNumBins();
+	mMagSpectrum.assign( numBins, 0.0f );
+	mPrevMagSpectrum.assign( numBins, 0.0f );
+	mCumulativePower.assign( numBins, 0.0f );
+
+	initMelFilters();
+	initChromaMap();
+
+	size_t numMfccCoeffs = isFeatureEnabled( Feature::MFCC ) ? mFormat.getNumMfccCoeffs() : 0;
+	size_t numStoredBins = mFormat.getStoreMagSpectrum() ? numBins : 0;
+	mHistory.allocate( mFormat.getHistorySize(), numMfccCoeffs, numStoredBins );
+}
+
+void FeatureExtractorNode::initMelFilters()
+{
+	mMelBinBegin.clear();
+	mMelOffsets.clear();
+	mMelWeights.clear();
+	mMelEnergies.clear();
+	mDctMatrix.clear();
+
+	if( ! isFeatureEnabled( Feature::MFCC ) )
+		return;
+
+	const size_t numBands = mFormat.getNumMelBands();
+	const size_t numCoeffs = mFormat.getNumMfccCoeffs();
+	const size_t numBins = getNumBins();
+	const float melMax = hzToMel( float( getSampleRate() ) / 2.0f );
+
+	// numBands + 2 evenly spaced points on the mel scale define the triangle edges
+	vector<float> edgesHz( numBands + 2 );
+	for( size_t i = 0; i < edgesHz.size(); i++ )
+		edgesHz[i] = melToHz( melMax * float( i ) / float( numBands + 1 ) );
+
+	mMelBinBegin.resize( numBands );
+	mMelOffsets.resize( numBands + 1 );
+	for( size_t b = 0; b < numBands; b++ ) {
+		float lower = edgesHz[b];
+		float center = edgesHz[b + 1];
+		float upper = edgesHz[b + 2];
+
+		size_t binBegin = min<size_t>( (size_t)ceil( lower / mBinWidth ), numBins - 1 );
+		size_t binEnd = min<size_t>( (size_t)floor( upper / mBinWidth ) + 1, numBins );
+
+		mMelBinBegin[b] = binBegin;
+		mMelOffsets[b] = mMelWeights.size();
+		for( size_t bin = binBegin; bin < binEnd; bin++ ) {
+			float freq = bin * mBinWidth;
+			float weight = freq <= center ? ( freq - lower ) / ( center - lower ) : ( upper - freq ) / ( upper - center );
+			mMelWeights.push_back( glm::max( 0.0f, weight ) );
+		}
+	}
+	mMelOffsets[numBands] = mMelWeights.size();
+	mMelEnergies.assign( numBands, 0.0f );
+
+	// orthonormal DCT-II
+	mDctMatrix.resize( numCoeffs * numBands );
+	for( size_t c = 0; c < numCoeffs; c++ ) {
+		float scale = c == 0 ? sqrtf( 1.0f / numBands ) : sqrtf( 2.0f / numBands );
+		for( size_t b = 0; b < numBands; b++ )
+			mDctMatrix[c * numBands + b] = scale * cosf( float( M_PI ) * float( c ) * ( float( b ) + 0.5f ) / float( numBands ) );
+	}
+}
+
+void FeatureExtractorNode::initChromaMap()
+{
+	mChromaClass.assign( getNumBins(), -1 );
+	mChroma.fill( 0 );
+
+	if( ! isFeatureEnabled( Feature::CHROMA ) )
+		return;
+
+	const float minFreq = 27.5f; // A0, anything below is too coarse to resolve pitch
+	for( size_t bin = 1; bin < mChromaClass.size(); bin++ ) {
+		float freq = bin * mBinWidth;
+		if( freq < minFreq )
+			continue;
+
+		// midi note 60 is C, which maps to pitch class 0
+		int midi = (int)lroundf( 69.0f + 12.0f * log2f( freq / 440.0f ) );
+		mChromaClass[bin] = int8_t( midi % 12 );
+	}
+}
+
+void FeatureExtractorNode::process( ci::audio::Buffer *buffer )
+{
+	const size_t numFrames = buffer->getNumFrames();
+	const size_t numChannels = buffer->getNumChannels();
+	const size_t windowSize = mInputRing.size();
+	const float channelScale = 1.0f / float( numChannels );
+
+	// input is passed through untouched, only copied into our analysis ring
+	for( size_t i = 0; i < numFrames; i++ ) {
+		float sample = 0;
+		for( size_t ch = 0; ch < numChannels; ch++ )
+			sample += buffer->getChannel( ch )[i];
+
+		mInputRing[mInputWritePos] = sample * channelScale;
+		if( ++mInputWritePos == windowSize )
+			mInputWritePos = 0;
+
+		if( --mSamplesUntilHop == 0 ) {
+			analyzeWindow();
+			mSamplesUntilHop = mHopSize;
+		}
+	}
+}
+
+void FeatureExtractorNode::analyzeWindow()
+{
+	const size_t windowSize = mInputRing.size();
+	const size_t numBins = getNumBins();
+	float *fftData = mFftBuffer.getData();
+
+	const bool calcRms = isFeatureEnabled( Feature::RMS );
+	const bool calcZeroCrossings = isFeatureEnabled( Feature::ZERO_CROSSING_RATE );
+
+	// Unroll the ring so the oldest sample is first, collecting time-domain features as we go
+	float sumSquares = 0;
+	size_t zeroCrossings = 0;
+	float prevSample = mInputRing[mInputWritePos];
+	for( size_t i = 0; i < windowSize; i++ ) {
+		size_t readPos = mInputWritePos + i;
+		if( readPos >= windowSize )
+			readPos -= windowSize;
+
+		float s = mInputRing[readPos];
+		if( calcRms )
+			sumSquares += s * s;
+		if( calcZeroCrossings ) {
+			zeroCrossings += ( s >= 0 ) != ( prevSample >= 0 );
+			prevSample = s;
+		}
+		fftData[i] = s;
+	}
+
+	if( mFftSize > windowSize )
+		memset( fftData + windowSize, 0, ( mFftSize - windowSize ) * sizeof( float ) );
+
+	ci::audio::dsp::mul( fftData, mWindowingTable.get(), fftData, windowSize );
+	mFft->forward( &mFftBuffer, &mBufferSpectral );
+
+	float *real = mBufferSpectral.getReal();
+	float *imag = mBufferSpectral.getImag();
+
+	// imag[0] is packed with the nyquist value
+	imag[0] = 0;
+
+	const bool calcMoments = isFeatureEnabled( Feature::CENTROID ) || isFeatureEnabled( Feature::SPREAD );
+	const bool calcFlux = isFeatureEnabled( Feature::FLUX );
+	const bool calcFlatness = isFeatureEnabled( Feature::FLATNESS );
+	const bool calcRolloff = isFeatureEnabled( Feature::ROLLOFF );
+	const bool calcChroma = isFeatureEnabled( Feature::CHROMA );
+	const float magScale = 1.0f / float( mFftSize );
+
+	float sumMag = 0, sumFreqMag = 0, sumFreqSquaredMag = 0;
+	float sumPower = 0, sumLogPower = 0, flux = 0;
+	mChroma.fill( 0 );
+
+	// One pass over the spectrum computes everything but the mel filterbank, which reads back from mMagSpectrum
+	for( size_t bin = 0; bin < numBins; bin++ ) {
+		float re = real[bin];
+		float im = imag[bin];
+		float power = ( re * re + im * im ) * magScale * magScale;
+		float mag = sqrtf( power );
+
+		if( calcMoments ) {
+			float freq = float( bin ) * mBinWidth;
+			sumMag += mag;
+			sumFreqMag += freq * mag;
+			sumFreqSquaredMag += freq * freq * mag;
+		}
+
+		sumPower += power;
+		if( calcRolloff )
+			mCumulativePower[bin] = sumPower;
+
+		if( calcFlux ) {
+			float diff = mag - mPrevMagSpectrum[bin];
+			if( diff > 0 )
+				flux += diff;
+		}
+
+		if( calcFlatness )
+			sumLogPower += logf( power + MIN_POWER );
+
+		if( calcChroma ) {
+			int8_t pitchClass = mChromaClass[bin];
+			if( pitchClass >= 0 )
+				mChroma[pitchClass] += power;
+		}
+
+		mMagSpectrum[bin] = mag;
+	}
+
+	size_t slot = mHistory.writeSlot();
+	auto &scalars = mHistory.mScalars;
+
+	// disabled features are left at 0, the sums above are only accumulated for enabled ones
+	float centroid = sumMag > 0 ? sumFreqMag / sumMag : 0;
+	float spreadSquared = sumMag > 0 ? sumFreqSquaredMag / sumMag - centroid * centroid : 0;
+
+	scalars[(size_t)Feature::RMS][slot] = sqrtf( sumSquares / float( windowSize ) );
+	scalars[(size_t)Feature::ZERO_CROSSING_RATE][slot] = float( zeroCrossings ) / float( windowSize );
+	scalars[(size_t)Feature::CENTROID][slot] = isFeatureEnabled( Feature::CENTROID ) ? centroid : 0;
+	scalars[(size_t)Feature::SPREAD][slot] = isFeatureEnabled( Feature::SPREAD ) ? sqrtf( glm::max( 0.0f, spreadSquared ) ) : 0;
+	scalars[(size_t)Feature::FLUX][slot] = flux;
+
+	float flatness = 0;
+	if( calcFlatness && sumPower > 0 ) {
+		float geometricMean = expf( sumLogPower / float( numBins ) );
+		float arithmeticMean = sumPower / float( numBins );
+		flatness = glm::min( 1.0f, geometricMean / arithmeticMean );
+	}
+	scalars[(size_t)Feature::FLATNESS][slot] = flatness;
+
+	float rolloff = 0;
+	if( calcRolloff && sumPower > 0 ) {
+		float threshold = sumPower * mFormat.getRolloffPercent();
+		auto it = lower_bound( mCumulativePower.begin(), mCumulativePower.end(), threshold );
+		rolloff = float( it - mCumulativePower.begin() ) * mBinWidth;
+	}
+	scalars[(size_t)Feature::ROLLOFF][slot] = rolloff;
+
+	if( ! mMelEnergies.empty() ) {
+		const size_t numBands = mMelEnergies.size();
+		for( size_t b = 0; b < numBands; b++ ) {
+			const float *weights = &mMelWeights[mMelOffsets[b]];
+			const size_t count = mMelOffsets[b + 1] - mMelOffsets[b];
+			const float *mags = &mMagSpectrum[mMelBinBegin[b]];
+
+			float energy = 0;
+			for( size_t i = 0; i < count; i++ )
+				energy += weights[i] * mags[i] * mags[i];
+
+			mMelEnergies[b] = logf( energy + MIN_POWER );
+		}
+
+		const size_t numCoeffs = mHistory.mNumMfccCoeffs;
+		float *mfcc = &mHistory.mMfcc[slot * numCoeffs];
+		for( size_t c = 0; c < numCoeffs; c++ ) {
+			const float *dctRow = &mDctMatrix[c * numBands];
+			float sum = 0;
+			for( size_t b = 0; b < numBands; b++ )
+				sum += dctRow[b] * mMelEnergies[b];
+
+			mfcc[c] = sum;
+		}
+	}
+
+	if( calcChroma ) {
+		float maxChroma = *max_element( mChroma.begin(), mChroma.end() );
+		float chromaScale = maxChroma > 0 ? 1.0f / maxChroma : 0.0f;
+		float *chroma = &mHistory.mChroma[slot * 12];
+		for( size_t i = 0; i < 12; i++ )
+			chroma[i] = mChroma[i] * chromaScale;
+	}
+
+	if( mHistory.mNumBins )
+		memcpy( &mHistory.mMagSpectrum[slot * numBins], mMagSpectrum.data(), numBins * sizeof( float ) );
+
+	mHistory.commitWrite();
+
+	// swap without reallocating, current magnitudes are needed as the previous frame for flux
+	mMagSpectrum.swap( mPrevMagSpectrum );
+}
+
+} } // namespace mason::audio
@@ -0,0 +1,223 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/audio/Node.h"
+#include "cinder/audio/Buffer.h"
+#include "cinder/audio/dsp/Dsp.h"
+#include "cinder/audio/dsp/Fft.h"
+
+#include "mason/Export.h"
+
+#include <array>
+#include <atomic>
+
+namespace mason { namespace audio {
+
+using FeatureExtractorNodeRef = std::shared_ptr<class FeatureExtractorNode>;
+
+//! Audio features computed by FeatureExtractorNode. Scalar features come first, followed by the vector features (MFCC and chroma).
+enum class Feature : uint32_t {
+	RMS,					//! Root-mean-square of the time-domain signal before windowing (linear)
+	ZERO_CROSSING_RATE,		//! Number of sign changes per sample, range 0:1
+	CENTROID,				//! Spectral center of mass, in hertz
+	SPREAD,					//! Standard deviation of the spectrum around the centroid, in hertz
+	FLATNESS,				//! Geometric mean / arithmetic mean of the power spectrum, range 0:1 (1 = noise-like, 0 = tonal)
+	ROLLOFF,				//! Frequency below which Format::rolloffPercent() of the spectral energy lies, in hertz
+	FLUX,					//! Sum of positive magnitude changes since the previous frame
+	NUM_SCALAR_FEATURES,
+	MFCC = NUM_SCALAR_FEATURES, //! Mel-frequency cepstral coefficients, Format::numMfccCoeffs() per frame
+	CHROMA,					//! 12 pitch class energies, normalized so the largest is 1
+	NUM_FEATURES
+};
+
+//! Bitmask of Features, used to configure which ones FeatureExtractorNode computes.
+using FeatureMask = uint32_t;
+
+inline constexpr FeatureMask featureBit( Feature feature )	{ return 1u << (uint32_t)feature; }
+
+const FeatureMask FEATURE_MASK_ALL = ( 1u << (uint32_t)Feature::NUM_FEATURES ) - 1;
+
+//! \brief Struct-of-arrays ring buffer holding the last N frames of each Feature.
+//!
+//! Written to on the audio thread by FeatureExtractorNode, read from any other thread. Each feature is stored contiguously so visuals
+//! can cheaply sample (or upload) a time series of one feature. The slot currently being written is never handed out to readers.
+class MA_API FeatureHistory {
+  public:
+	//! Returns the maximum number of frames that can be read back.
+	size_t		getCapacity() const				{ return mCapacity > 0 ? mCapacity - 1 : 0; }
+	//! Returns the number of frames currently available for reading, at most getCapacity().
+	size_t		getNumFrames() const;
+	//! Returns the total number of frames that have been written since the last reset.
+	uint64_t	getNumFramesWritten() const		{ return mNumFramesWritten.load( std::memory_order_acquire ); }
+	//! Returns the number of MFCC coefficients stored per frame.
+	size_t		getNumMfccCoeffs() const		{ return mNumMfccCoeffs; }
+
+	//! Returns the value of a scalar \a feature \a framesAgo frames back in time (0 is the newest frame). Returns 0 if no frames are available.
+	float	getValue( Feature feature, size_t framesAgo = 0 ) const;
+	//! Copies the most recent \a count values of a scalar \a feature into \a dest, ordered from oldest to newest. Returns the number of values copied.
+	size_t	copyRecent( Feature feature, float *dest, size_t count ) const;
+	//! Returns a pointer to the MFCC coefficients of the frame \a framesAgo back in time, or nullptr if it isn't available.
+	const float*	getMfcc( size_t framesAgo = 0 ) const;
+	//! Returns a pointer to the 12 chroma values of the frame \a framesAgo back in time, or nullptr if it isn't available.
+	const float*	getChroma( size_t framesAgo = 0 ) const;
+	//! Returns a pointer to the linear magnitude spectrum of the frame \a framesAgo back in time, or nullptr if it isn't available. \see FeatureExtractorNode::Format::storeMagSpectrum()
+	const float*	getMagSpectrum( size_t framesAgo = 0 ) const;
+	//! Returns the number of bins stored per frame by getMagSpectrum(), or 0 if spectra aren't being stored.
+	size_t			getNumBins() const		{ return mNumBins; }
+
+  private:
+	void	allocate( size_t numFrames, size_t numMfccCoeffs, size_t numBins );
+	void	reset();
+	//! Returns the ring slot for the frame \a framesAgo back, or -1 if it isn't available.
+	int64_t	readSlot( size_t framesAgo ) const;
+	size_t	writeSlot() const	{ return size_t( mNumFramesWritten.load( std::memory_order_relaxed ) % mCapacity ); }
+	void	commitWrite()		{ mNumFramesWritten.fetch_add( 1, std::memory_order_release ); }
+
+	size_t		mCapacity = 0;
+	size_t		mNumMfccCoeffs = 0;
+	size_t		mNumBins = 0;
+	std::array<std::vector<float>, (size_t)Feature::NUM_SCALAR_FEATURES>	mScalars;
+	std::vector<float>		mMfcc;		// mCapacity * mNumMfccCoeffs
+	std::vector<float>		mChroma;	// mCapacity * 12
+	std::vector<float>		mMagSpectrum;	// mCapacity * mNumBins
+	std::atomic<uint64_t>	mNumFramesWritten = { 0 };
+
+	friend class FeatureExtractorNode;
+};
+
+//! \brief Computes a configurable set of audio features from its input on the audio thread.
+//!
+//! Samples are summed to mono and collected into overlapping windows of Format::windowSize() frames, advancing by Format::hopSize().
+//! Every window is transformed with one FFT and all enabled features are calculated in one pass over the magnitude spectrum, using
+//! only buffers allocated in initialize(). Results are published to a FeatureHistory that can be read from the main thread.
+class MA_API FeatureExtractorNode : public ci::audio::NodeAutoPullable {
+  public:
+	struct Format : public ci::audio::Node::Format {
+		Format()	{}
+
+		//! Sets the FFT size, rounded up to the nearest power of two. Defaults to windowSize().
+		Format&		fftSize( size_t size )				{ mFftSize = size; return *this; }
+		//! Sets the number of samples analyzed per frame. Defaults to 1024.
+		Format&		windowSize( size_t size )			{ mWindowSize = size; return *this; }
+		//! Sets the number of samples between successive analysis frames. Defaults to windowSize() / 2.
+		Format&		hopSize( size_t size )				{ mHopSize = size; return *this; }
+		//! Sets the window function applied before the FFT. Defaults to Blackman.
+		Format&		windowType( ci::audio::dsp::WindowType type )	{ mWindowType = type; return *this; }
+		//! Sets which features are computed. Defaults to all of them. Features that aren't in \a mask read back as 0.
+		Format&		features( FeatureMask mask )		{ mFeatures = mask; return *this; }
+		//! Sets the number of frames kept in the FeatureHistory. Defaults to 128.
+		Format&		historySize( size_t size )			{ mHistorySize = size; return *this; }
+		//! Sets the number of MFCC coefficients computed per frame. Defaults to 13.
+		Format&		numMfccCoeffs( size_t count )		{ mNumMfccCoeffs = count; return *this; }
+		//! Sets the number of mel filters used when computing MFCCs. Defaults to 26.
+		Format&		numMelBands( size_t count )			{ mNumMelBands = count; return *this; }
+		//! Sets the fraction of spectral energy used to compute Feature::ROLLOFF. Defaults to 0.85.
+		Format&		rolloffPercent( float percent )		{ mRolloffPercent = percent; return *this; }
+		//! Sets whether the magnitude spectrum of each frame is also stored in the FeatureHistory, for use in offline analysis. Defaults to false.
+		Format&		storeMagSpectrum( bool b = true )	{ mStoreMagSpectrum = b; return *this; }
+
+		size_t		getFftSize() const			{ return mFftSize; }
+		size_t		getWindowSize() const		{ return mWindowSize; }
+		size_t		getHopSize() const			{ return mHopSize; }
+		ci::audio::dsp::WindowType	getWindowType() const	{ return mWindowType; }
+		FeatureMask	getFeatures() const			{ return mFeatures; }
+		size_t		getHistorySize() const		{ return mHistorySize; }
+		size_t		getNumMfccCoeffs() const	{ return mNumMfccCoeffs; }
+		size_t		getNumMelBands() const		{ return mNumMelBands; }
+		float		getRolloffPercent() const	{ return mRolloffPercent; }
+		bool		getStoreMagSpectrum() const	{ return mStoreMagSpectrum; }
+
+		// reimpl Node::Format
+		Format&		channels( size_t ch )							{ Node::Format::channels( ch ); return *this; }
+		Format&		channelMode( ChannelMode mode )					{ Node::Format::channelMode( mode ); return *this; }
+		Format&		autoEnable( bool autoEnable = true )			{ Node::Format::autoEnable( autoEnable ); return *this; }
+
+	  protected:
+		size_t		mFftSize = 0;
+		size_t		mWindowSize = 1024;
+		size_t		mHopSize = 0;
+		ci::audio::dsp::WindowType	mWindowType = ci::audio::dsp::WindowType::BLACKMAN;
+		FeatureMask	mFeatures = FEATURE_MASK_ALL;
+		size_t		mHistorySize = 128;
+		size_t		mNumMfccCoeffs = 13;
+		size_t		mNumMelBands = 26;
+		float		mRolloffPercent = 0.85f;
+		bool		mStoreMagSpectrum = false;
+	};
+
+	FeatureExtractorNode( const Format &format = Format() );
+	virtual ~FeatureExtractorNode();
+
+	//! Returns the history of computed features, safe to read from a non-audio thread.
+	const FeatureHistory&	getHistory() const		{ return mHistory; }
+	//! Returns the set of features being computed.
+	FeatureMask		getFeatures() const		{ return mFormat.getFeatures(); }
+	//! Returns true if \a feature is being computed.
+	bool			isFeatureEnabled( Feature feature ) const	{ return ( mFormat.getFeatures() & featureBit( feature ) ) != 0; }
+
+	size_t	getFftSize() const		{ return mFftSize; }
+	size_t	getWindowSize() const	{ return mFormat.getWindowSize(); }
+	size_t	getHopSize() const		{ return mHopSize; }
+	size_t	getNumBins() const		{ return mFftSize / 2; }
+	//! Returns the number of analysis frames computed per second at the current samplerate.
+	float	getFrameRate() const;
+
+  protected:
+	void initialize()				override;
+	void process( ci::audio::Buffer *buffer )	override;
+
+  private:
+	void initMelFilters();
+	void initChromaMap();
+	void analyzeWindow();
+
+	Format		mFormat;
+	size_t		mFftSize = 0;
+	size_t		mHopSize = 0;
+	float		mBinWidth = 0; // hertz
+
+	std::unique_ptr<ci::audio::dsp::Fft>	mFft;
+	ci::audio::AlignedArrayPtr	mWindowingTable;
+	ci::audio::Buffer			mFftBuffer;
+	ci::audio::BufferSpectral	mBufferSpectral;
+
+	std::vector<float>	mInputRing;			// mono samples waiting to be analyzed, mWindowSize long
+	size_t				mInputWritePos = 0;
+	size_t				mSamplesUntilHop = 0;
+
+	std::vector<float>	mMagSpectrum, mPrevMagSpectrum;
+	std::vector<float>	mCumulativePower;	// used to find rolloff in the same pass as the other spectral features
+
+	// mel filterbank stored sparsely: mMelWeights[mMelOffsets[b] + i] applies to bin mMelBinBegin[b] + i
+	std::vector<size_t>	mMelBinBegin, mMelOffsets;
+	std::vector<float>	mMelWeights;
+	std::vector<float>	mMelEnergies;
+	std::vector<float>	mDctMatrix;			// numMfccCoeffs * numMelBands
+	std::vector<int8_t>	mChromaClass;		// pitch class per bin, -1 for bins that are ignored
+	std::array<float, 12>	mChroma;
+
+	FeatureHistory		mHistory;
+};
+
+} } // namespace mason::audio
@@ -20,101 +20,371 @@
 */
 
 #include "mason/audio/Gens.h"
-#include "cinder/Rand.h"
+#include "mason/audio/Simd.h"
+
+#include <atomic>
+#include <cmath>
 
 using namespace ci;
 using namespace std;
 
 namespace mason { namespace audio {
 
+using simd::float4;
+
+// ----------------------------------------------------------------------------------------------------
+// WhiteNoiseGenerator
+// ----------------------------------------------------------------------------------------------------
+
+namespace {
+
+std::atomic<uint32_t> sNextSeed( 1 );
+
+// PCG's RXS M XS output permutation, a bijection that spreads nearby seeds over the whole state space.
+uint32_t hashSeed( uint32_t x )
+{
+	x = x * 747796405u + 2891336453u;
+	uint32_t word = ( ( x >> ( ( x >> 28 ) + 4 ) ) ^ x ) * 277803737u;
+	return ( word >> 22 ) ^ word;
+}
+
+// Maps 23 random bits to [2, 4) by filling the mantissa, then shifts to [-1, 1).
+const uint32_t FLOAT_ONE_TO_TWO_BITS = 0x40000000;
+
+} // anonymous namespace
+
+WhiteNoiseGenerator::WhiteNoiseGenerator( uint32_t seed )
+{
+	this->seed( seed );
+}
+
+void WhiteNoiseGenerator::seed( uint32_t seed )
+{
+	if( seed == 0 )
+		seed = hashSeed( sNextSeed.fetch_add( 1, std::memory_order_relaxed ) ) ^ 0x5bd1e995;
+
+	for( uint32_t lane = 0; lane < 4; lane++ ) {
+		mState[lane] = hashSeed( seed + lane * 0x9e3779b9 );
+		// xorshift never leaves the all zero state
+		if( mState[lane] == 0 )
+			mState[lane] = 0x9e3779b9;
+	}
+}
+
+#if MA_SIMD_SSE
+
+void WhiteNoiseGenerator::fill( float *data, size_t count )
+{
+	__m128i x = _mm_loadu_si128( (const __m128i *)mState );
+	const __m128i oneToTwo = _mm_set1_epi32( FLOAT_ONE_TO_TWO_BITS );
+	const __m128 three = _mm_set1_ps( 3 );
+
+	auto next = [&]() {
+		x = _mm_xor_si128( x, _mm_slli_epi32( x, 13 ) );
+		x = _mm_xor_si128( x, _mm_srli_epi32( x, 17 ) );
+		x = _mm_xor_si128( x, _mm_slli_epi32( x, 5 ) );
+		return _mm_sub_ps( _mm_castsi128_ps( _mm_or_si128( _mm_srli_epi32( x, 9 ), oneToTwo ) ), three );
+	};
+
+	size_t i = 0;
+	for( ; i + simd::LANES <= count; i += simd::LANES )
+		_mm_storeu_ps( data + i, next() );
+
+	if( i < count ) {
+		float tail[simd::LANES];
+		_mm_storeu_ps( tail, next() );
+		std::copy( tail, tail + ( count - i ), data + i );
+	}
+
+	_mm_storeu_si128( (__m128i *)mState, x );
+}
+
+#else
+
+namespace {
+
+inline float bitsToFloat( uint32_t x )
+{
+	uint32_t bits = ( x >> 9 ) | FLOAT_ONE_TO_TWO_BITS;
+	float result;
+	memcpy( &result, &bits, sizeof( float ) );
+	return result - 3;
+}
+
+inline uint32_t xorshift32( uint32_t x )
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+} // anonymous namespace
+
+void WhiteNoiseGenerator::fill( float *data, size_t count )
+{
+	for( size_t i = 0; i < count; i += simd::LANES ) {
+		for( size_t lane = 0; lane < simd::LANES; lane++ ) {
+			mState[lane] = xorshift32( mState[lane] );
+			if( i + lane < count )
+				data[i + lane] = bitsToFloat( mState[lane] );
+		}
+	}
+}
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------
+// GenWhiteNoiseNode
+// ----------------------------------------------------------------------------------------------------
+
+void GenWhiteNoiseNode::process( ci::audio::Buffer *buffer )
+{
+	mWhite.fill( buffer->getData(), buffer->getSize() );
+}
+
 // ----------------------------------------------------------------------------------------------------
 // GenPinkNoiseNode
 // ----------------------------------------------------------------------------------------------------
 
+namespace {
+
+// One pole lowpass y[n] = pole * y[n-1] + gain * x[n], unrolled so four outputs are computed from the previous output and four inputs:
+// y[n+j] = pole^(j+1) * y[n-1] + sum( gain * pole^(j-i) * x[n+i] ), i <= j
+struct OnePoleBlock {
+	OnePoleBlock( float pole, float gain )
+		: mPole( pole ), mGain( gain )
+	{
+		const float p2 = pole * pole;
+		const float p3 = p2 * pole;
+		mPowers = float4( pole, p2, p3, p3 * pole );
+		mInput[0] = float4( 1, pole, p2, p3 ) * gain;
+		mInput[1] = float4( 0, 1, pole, p2 ) * gain;
+		mInput[2] = float4( 0, 0, 1, pole ) * gain;
+		mInput[3] = float4( 0, 0, 0, 1 ) * gain;
+	}
+
+	// state holds y[n-1] in all lanes, on return it holds y[n+3]. x0 - x3 are the inputs broadcast to all lanes.
+	float4 process( float4 *state, const float4 &x0, const float4 &x1, const float4 &x2, const float4 &x3 ) const
+	{
+		float4 y = mPowers * *state + mInput[0] * x0 + mInput[1] * x1 + mInput[2] * x2 + mInput[3] * x3;
+		*state = simd::splat<3>( y );
+		return y;
+	}
+
+	float	mPole, mGain;
+	float4	mPowers;
+	float4	mInput[4];
+};
+
+// from: http://www.musicdsp.org/files/pink.txt
+const float PINK_POLES[GenPinkNoiseNode::NUM_POLES] = { 0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f };
+const float PINK_GAINS[GenPinkNoiseNode::NUM_POLES] = { 0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f, 0.5329522f, -0.0168980f };
+const float PINK_WHITE_GAIN = 0.5362f;
+const float PINK_LAST_WHITE_GAIN = 0.115926f;
+const float PINK_GAIN_NORMALIZER = 0.105f;
+
+const OnePoleBlock* getPinkFilters()
+{
+	static const OnePoleBlock filters[GenPinkNoiseNode::NUM_POLES] = {
+		{ PINK_POLES[0], PINK_GAINS[0] }, { PINK_POLES[1], PINK_GAINS[1] }, { PINK_POLES[2], PINK_GAINS[2] },
+		{ PINK_POLES[3], PINK_GAINS[3] }, { PINK_POLES[4], PINK_GAINS[4] }, { PINK_POLES[5], PINK_GAINS[5] }
+	};
+
+	return filters;
+}
+
+} // anonymous namespace
+
 void GenPinkNoiseNode::initialize()
 {
-	mB0 = mB1 = mB2 = mB3 = mB4 = mB5 = mB6 = 0;
+	std::fill( mPoleState, mPoleState + NUM_POLES, 0.0f );
+	mLastWhite = 0;
 }
 
-// from: http://www.musicdsp.org/files/pink.txt
 void GenPinkNoiseNode::process( ci::audio::Buffer *buffer )
+{
+	processPink( buffer->getData(), buffer->getSize() );
+}
+
+// Runs in place: data is first filled with white noise, then each group of four samples is read before it is overwritten.
+void GenPinkNoiseNode::processPink( float *data, size_t count )
+{
+	mWhite.fill( data, count );
+
+	const OnePoleBlock *filters = getPinkFilters();
+
+	float4 state[NUM_POLES];
+	for( size_t k = 0; k < NUM_POLES; k++ )
+		state[k] = float4( mPoleState[k] );
+
+	float lastWhite = mLastWhite;
+
+	size_t i = 0;
+	for( ; i + simd::LANES <= count; i += simd::LANES ) {
+		const float4 white = float4::load( data + i );
+		const float4 delayedWhite( lastWhite, data[i], data[i + 1], data[i + 2] );
+		const float4 x0 = simd::splat<0>( white );
+		const float4 x1 = simd::splat<1>( white );
+		const float4 x2 = simd::splat<2>( white );
+		const float4 x3 = simd::splat<3>( white );
+		lastWhite = data[i + 3];
+
+		float4 sum = white * PINK_WHITE_GAIN + delayedWhite * PINK_LAST_WHITE_GAIN;
+		for( size_t k = 0; k < NUM_POLES; k++ )
+			sum = sum + filters[k].process( &state[k], x0, x1, x2, x3 );
+
+		( sum * PINK_GAIN_NORMALIZER ).store( data + i );
+	}
+
+	for( size_t k = 0; k < NUM_POLES; k++ ) {
+		float lanes[simd::LANES];
+		state[k].store( lanes );
+		mPoleState[k] = lanes[0];
+	}
+
+	// remaining frames when count isn't a multiple of four
+	for( ; i < count; i++ ) {
+		const float white = data[i];
+		float sum = white * PINK_WHITE_GAIN + lastWhite * PINK_LAST_WHITE_GAIN;
+		for( size_t k = 0; k < NUM_POLES; k++ ) {
+			mPoleState[k] = PINK_POLES[k] * mPoleState[k] + PINK_GAINS[k] * white;
+			sum += mPoleState[k];
+		}
+
+		data[i] = sum * PINK_GAIN_NORMALIZER;
+		lastWhite = white;
+	}
+
+	mLastWhite = lastWhite;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// GenBrownNoiseNode
+// ----------------------------------------------------------------------------------------------------
+
+namespace {
+
+// Leaky integrator with a corner around 8 Hz at 48 kHz, below that the spectrum flattens instead of growing without bound.
+// The gain puts its RMS level close to GenPinkNoiseNode.
+const float BROWN_POLE = 0.999f;
+const float BROWN_GAIN = 0.015f;
+
+} // anonymous namespace
+
+void GenBrownNoiseNode::initialize()
+{
+	mState = 0;
+}
+
+void GenBrownNoiseNode::process( ci::audio::Buffer *buffer )
 {
 	float *data = buffer->getData();
-	size_t count = buffer->getSize();
+	const size_t count = buffer->getSize();
+
+	mWhite.fill( data, count );
+
+	static const OnePoleBlock filter( BROWN_POLE, BROWN_GAIN );
 
-	float b0 = mB0;
-	float b1 = mB1;
-	float b2 = mB2;
-	float b3 = mB3;
-	float b4 = mB4;
-	float b5 = mB5;
-	float b6 = mB6;
-
-	const float gainNormalizer = 0.105f;
-
-	while( count-- ) {
-		float white = randFloat( -1, 1 );
-
-		b0 = 0.99886f * b0 + white * 0.0555179f;
-		b1 = 0.99332f * b1 + white * 0.0750759f;
-		b2 = 0.96900f * b2 + white * 0.1538520f;
-		b3 = 0.86650f * b3 + white * 0.3104856f;
-		b4 = 0.55000f * b4 + white * 0.5329522f;
-		b5 = -0.7616f * b5 - white * 0.0168980f;
-		*data++ = ( b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f ) * gainNormalizer;
-		b6 = white * 0.115926f;
+	float4 state( mState );
+	size_t i = 0;
+	for( ; i + simd::LANES <= count; i += simd::LANES ) {
+		const float4 white = float4::load( data + i );
+		filter.process( &state, simd::splat<0>( white ), simd::splat<1>( white ), simd::splat<2>( white ), simd::splat<3>( white ) ).store( data + i );
 	}
 
-	mB0 = b0;
-	mB1 = b1;
-	mB2 = b2;
-	mB3 = b3;
-	mB4 = b4;
-	mB5 = b5;
-	mB6 = b6;
+	float lanes[simd::LANES];
+	state.store( lanes );
+	mState = lanes[0];
+
+	for( ; i < count; i++ ) {
+		mState = BROWN_POLE * mState + BROWN_GAIN * data[i];
+		data[i] = mState;
+	}
 }
 
 // ----------------------------------------------------------------------------------------------------
-// PeriodicNoiseNode
+// GenBlueNoiseNode
 // ----------------------------------------------------------------------------------------------------
 
 namespace {
 
-// source: http://www.iquilezles.org/apps/soundtoy/soundtoy.js
+// brings the differenced pink noise back to about the same RMS level as GenPinkNoiseNode
+const float BLUE_GAIN_NORMALIZER = 1.7f;
 
-float grad( int n, float x )
+} // anonymous namespace
+
+void GenBlueNoiseNode::initialize()
 {
-	n = (n << 13) ^ n;
-	n = (n * (n * n * 15731 + 789221) + 1376312589);
-	float res = x;
-	if( n & 0x20000000 )
-		res = -x;
-	return res;
+	GenPinkNoiseNode::initialize();
+	mLastPink = 0;
 }
 
-float iq_noise( float x )
+void GenBlueNoiseNode::process( ci::audio::Buffer *buffer )
 {
-	int i = floor( x );
-	float f = x - i;
-	float w = f * f * f * ( f * ( f * 6.0 - 15.0 ) + 10.0 );
-	float a = grad( i + 0, f + 0.0 );
-	float b = grad( i + 1, f - 1.0 );
-	return a + ( b - a ) * w;
+	float *data = buffer->getData();
+	const size_t count = buffer->getSize();
+
+	processPink( data, count );
+
+	// differentiating adds +6 dB / octave, so the -3 dB / octave pink spectrum becomes +3 dB / octave
+	float lastPink = mLastPink;
+	for( size_t i = 0; i < count; i++ ) {
+		const float pink = data[i];
+		data[i] = ( pink - lastPink ) * BLUE_GAIN_NORMALIZER;
+		lastPink = pink;
+	}
+
+	mLastPink = lastPink;
 }
-	
+
+// ----------------------------------------------------------------------------------------------------
+// PeriodicNoiseNode
+// ----------------------------------------------------------------------------------------------------
+
+namespace {
+
+// source: http://www.iquilezles.org/apps/soundtoy/soundtoy.js
+// The gradient at each integer lattice point is +/- 1, it only changes when the integer part of the position does.
+// Computed with unsigned arithmetic so the hash wraps instead of overflowing, the bits are the same as the original.
+float gradSign( uint32_t n )
+{
+	n = (n << 13) ^ n;
+	n = (n * (n * n * 15731 + 789221) + 1376312589);
+	return ( n & 0x20000000 ) ? -1.0f : 1.0f;
 }
 
+} // anonymous namespace
+
 void PeriodicNoiseNode::process( ci::audio::Buffer *buffer )
 {
 	float *data = buffer->getData();
 	size_t count = buffer->getSize();
 	const float noiseFreq = mNoiseFreq;
 
+	uint32_t index = mIndex;
+	float frac = mFrac;
+	float signA = gradSign( index );
+	float signB = gradSign( index + 1 );
+
 	for( size_t i = 0; i < count; i++ ) {
-		data[i] = iq_noise( mV );
+		float w = frac * frac * frac * ( frac * ( frac * 6 - 15 ) + 10 );
+		float a = signA * frac;
+		float b = signB * ( frac - 1 );
+		data[i] = a + ( b - a ) * w;
 
-		mV += noiseFreq;
+		frac += noiseFreq;
+		if( frac >= 1 || frac < 0 ) {
+			float whole = floorf( frac );
+			frac -= whole;
+			index += uint32_t( int32_t( whole ) );
+			signA = gradSign( index );
+			signB = gradSign( index + 1 );
+		}
 	}
+
+	mIndex = index;
+	mFrac = frac;
 }
 
 } } // namespace mason::audio
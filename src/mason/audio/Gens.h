@@ -24,20 +24,101 @@
 #include "cinder/Cinder.h"
 #include "cinder/audio/GenNode.h"
 
+#include <cstdint>
+
 namespace mason { namespace audio {
 
-class GenPinkNoiseNode : public ci::audio::GenNode {
-public:
-	GenPinkNoiseNode( const Format &format = Format() )
+//! \brief Uniform white noise from four interleaved xorshift32 generators, so blocks are filled four samples at a time.
+//!
+//! Each instance owns its state, so unlike ci::randFloat() there is no shared generator between Nodes. Not thread-safe.
+class WhiteNoiseGenerator {
+  public:
+	//! Seeds the generator with \a seed, or with a seed unique to this instance if \a seed is 0.
+	explicit WhiteNoiseGenerator( uint32_t seed = 0 );
+
+	//! Restarts the sequence from \a seed, or from a new unique seed if \a seed is 0.
+	void	seed( uint32_t seed );
+	//! Fills \a data with \a count samples uniformly distributed in [-1, 1). When \a count isn't a multiple of four the unused values are dropped, so the sequence depends on the block size.
+	void	fill( float *data, size_t count );
+
+  private:
+	uint32_t	mState[4];
+};
+
+//! Base class for the noise generators below. Each Node has its own WhiteNoiseGenerator, process() doesn't lock or allocate.
+class GenNoiseBaseNode : public ci::audio::GenNode {
+  public:
+	GenNoiseBaseNode( const Format &format = Format() )
 		: GenNode( format )
 	{}
 
-protected:
+	//! Restarts the noise sequence from \a seed, so renders can be reproduced. Passing 0 picks a new unique seed. Not thread-safe, call before enabling the Node.
+	void setSeed( uint32_t seed )	{ mWhite.seed( seed ); }
+
+  protected:
+	WhiteNoiseGenerator	mWhite;
+};
+
+//! Uniform white noise in [-1, 1).
+class GenWhiteNoiseNode : public GenNoiseBaseNode {
+  public:
+	GenWhiteNoiseNode( const Format &format = Format() )
+		: GenNoiseBaseNode( format )
+	{}
+
+  protected:
+	void process( ci::audio::Buffer *buffer ) override;
+};
+
+//! Pink noise (-3 dB / octave), using Paul Kellet's refined filter. The filters are evaluated four samples at a time.
+class GenPinkNoiseNode : public GenNoiseBaseNode {
+  public:
+	GenPinkNoiseNode( const Format &format = Format() )
+		: GenNoiseBaseNode( format )
+	{}
+
+	static const size_t NUM_POLES = 6;
+
+  protected:
 	void initialize() override;
 	void process( ci::audio::Buffer *buffer ) override;
 
-private:
-	float mB0, mB1, mB2, mB3, mB4, mB5, mB6;
+	//! Fills \a data with \a count samples of pink noise.
+	void processPink( float *data, size_t count );
+
+  private:
+	float	mPoleState[NUM_POLES];
+	float	mLastWhite;
+};
+
+//! Brown noise (-6 dB / octave), white noise through a leaky integrator.
+class GenBrownNoiseNode : public GenNoiseBaseNode {
+  public:
+	GenBrownNoiseNode( const Format &format = Format() )
+		: GenNoiseBaseNode( format )
+	{}
+
+  protected:
+	void initialize() override;
+	void process( ci::audio::Buffer *buffer ) override;
+
+  private:
+	float	mState;
+};
+
+//! Blue noise (+3 dB / octave), the first difference of pink noise.
+class GenBlueNoiseNode : public GenPinkNoiseNode {
+  public:
+	GenBlueNoiseNode( const Format &format = Format() )
+		: GenPinkNoiseNode( format )
+	{}
+
+  protected:
+	void initialize() override;
+	void process( ci::audio::Buffer *buffer ) override;
+
+  private:
+	float	mLastPink;
 };
 
 // I'm not really sure what to call this. It wraps the noise function from Inigo Quilez's soundtoy.
@@ -47,17 +128,16 @@ public:
 		: GenNode( format )
 	{}
 
-	PeriodicNoiseNode() : GenNode(), mNoiseFreq( 0.002f ), mV( 0 )	{}
-
 	void setNoiseFreq( float freq )	{ mNoiseFreq = freq; }
 
 protected:
 	void process( ci::audio::Buffer *buffer ) override;
 
 private:
-	float				mV;
-	std::atomic<float>	mNoiseFreq;
+	// position is kept as separate integer and fractional parts, so it doesn't lose precision as it grows
+	uint32_t			mIndex = 0;
+	float				mFrac = 0;
+	std::atomic<float>	mNoiseFreq = { 0.002f };
 };
 
 } } // namespace mason::audio
-
@@ -0,0 +1,138 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mason/audio/MultichannelSpectralNode.h"
+
+#include "cinder/audio/Utilities.h"
+#include "cinder/CinderAssert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+MultichannelSpectralNode::MultichannelSpectralNode( const Format &format )
+	: NodeAutoPullable( format ), mFormat( format )
+{
+	CI_ASSERT_MSG( mFormat.getWindowSize() > 0, "window size must be greater than zero" );
+
+	// resolved here rather than in initialize(), so that readers can size their buffers before the node is connected
+	mFftSize = max( mFormat.getFftSize(), mFormat.getWindowSize() );
+	if( ! ci::audio::isPowerOf2( mFftSize ) )
+		mFftSize = ci::audio::nextPowerOf2( static_cast<uint32_t>( mFftSize ) );
+}
+
+MultichannelSpectralNode::~MultichannelSpectralNode()
+{
+}
+
+void MultichannelSpectralNode::initialize()
+{
+	const size_t windowSize = mFormat.getWindowSize();
+	const size_t numChannels = getNumChannels();
+
+	mFft.reset( new ci::audio::dsp::Fft( mFftSize ) );
+	mFftBuffer = ci::audio::Buffer( mFftSize );
+	mBufferSpectral = ci::audio::BufferSpectral( mFftSize );
+
+	mWindowingTable = ci::audio::makeAlignedArray<float>( windowSize );
+	ci::audio::dsp::generateWindow( mFormat.getWindowType(), mWindowingTable.get(), windowSize );
+
+	// Extra space for two blocks, so the window being read in update() isn't overwritten by the audio thread
+	mHistoryFrames = ci::audio::nextPowerOf2( static_cast<uint32_t>( windowSize + 2 * getFramesPerBlock() ) );
+	mHistoryChannels = numChannels;
+	mHistory.assign( mHistoryFrames * numChannels, 0.0f );
+	mNumFramesWritten = 0;
+	mNumFramesAnalyzed = 0;
+
+	mMagSpectra.assign( getNumBins() * numChannels, 0.0f );
+	mVolumes.assign( numChannels, 0.0f );
+}
+
+void MultichannelSpectralNode::process( ci::audio::Buffer *buffer )
+{
+	const size_t numFrames = buffer->getNumFrames();
+	const size_t numChannels = min( buffer->getNumChannels(), mHistoryChannels );
+	const uint64_t numFramesWritten = mNumFramesWritten.load( memory_order_relaxed );
+	const size_t writePos = size_t( numFramesWritten & ( mHistoryFrames - 1 ) );
+
+	// input is passed through untouched, each channel is copied into its history in at most two segments
+	const size_t firstSegment = min( numFrames, mHistoryFrames - writePos );
+	for( size_t ch = 0; ch < numChannels; ch++ ) {
+		const float *channel = buffer->getChannel( ch );
+		float *history = mHistory.data() + ch * mHistoryFrames;
+		memcpy( history + writePos, channel, firstSegment * sizeof( float ) );
+		memcpy( history, channel + firstSegment, ( numFrames - firstSegment ) * sizeof( float ) );
+	}
+
+	mNumFramesWritten.store( numFramesWritten + numFrames, memory_order_release );
+}
+
+bool MultichannelSpectralNode::update()
+{
+	const uint64_t numFramesWritten = mNumFramesWritten.load( memory_order_acquire );
+	if( numFramesWritten == mNumFramesAnalyzed || mHistory.empty() )
+		return false;
+
+	mNumFramesAnalyzed = numFramesWritten;
+
+	const size_t windowSize = mFormat.getWindowSize();
+	const size_t numBins = getNumBins();
+	const size_t readPos = size_t( ( numFramesWritten - windowSize ) & ( mHistoryFrames - 1 ) ); // wraps correctly before a full window is written
+	const size_t firstSegment = min( windowSize, mHistoryFrames - readPos );
+	const float magScale = 1.0f / float( mFftSize );
+	float *fftData = mFftBuffer.getData();
+	float *real = mBufferSpectral.getReal();
+	float *imag = mBufferSpectral.getImag();
+
+	// One channel at a time through the same Fft, windowing table and scratch buffers, so they stay in cache across channels
+	for( size_t ch = 0; ch < mHistoryChannels; ch++ ) {
+		const float *history = mHistory.data() + ch * mHistoryFrames;
+		memcpy( fftData, history + readPos, firstSegment * sizeof( float ) );
+		memcpy( fftData + firstSegment, history, ( windowSize - firstSegment ) * sizeof( float ) );
+
+		if( mFftSize > windowSize )
+			memset( fftData + windowSize, 0, ( mFftSize - windowSize ) * sizeof( float ) );
+
+		mVolumes[ch] = ci::audio::dsp::rms( fftData, windowSize );
+
+		ci::audio::dsp::mul( fftData, mWindowingTable.get(), fftData, windowSize );
+		mFft->forward( &mFftBuffer, &mBufferSpectral );
+
+		// imag[0] is packed with the nyquist value
+		imag[0] = 0;
+
+		float *mags = mMagSpectra.data() + ch * numBins;
+		for( size_t i = 0; i < numBins; i++ ) {
+			const float re = real[i];
+			const float im = imag[i];
+			mags[i] = sqrtf( re * re + im * im ) * magScale;
+		}
+	}
+
+	return true;
+}
+
+} } // namespace mason::audio
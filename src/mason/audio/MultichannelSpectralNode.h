@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/audio/Node.h"
+#include "cinder/audio/Buffer.h"
+#include "cinder/audio/dsp/Dsp.h"
+#include "cinder/audio/dsp/Fft.h"
+
+#include "mason/Export.h"
+
+#include <atomic>
+#include <vector>
+
+namespace mason { namespace audio {
+
+using MultichannelSpectralNodeRef = std::shared_ptr<class MultichannelSpectralNode>;
+
+//! \brief Computes the magnitude spectrum and volume of every input channel in one batched pass.
+//!
+//! The audio thread only copies each block into a per-channel history, no locks are taken. update() then windows and transforms
+//! the latest Format::windowSize() frames of every channel with a single Fft and windowing table, storing the results contiguously
+//! so that any number of readers (for example all Tracks sharing one input device) can use them without further processing.
+class MA_API MultichannelSpectralNode : public ci::audio::NodeAutoPullable {
+  public:
+	struct Format : public ci::audio::Node::Format {
+		Format()	{}
+
+		//! Sets the FFT size, rounded up to the nearest power of two. Defaults to windowSize().
+		Format&		fftSize( size_t size )				{ mFftSize = size; return *this; }
+		//! Sets the number of samples analyzed per channel. Defaults to 1024.
+		Format&		windowSize( size_t size )			{ mWindowSize = size; return *this; }
+		//! Sets the window function applied before the FFT. Defaults to Blackman.
+		Format&		windowType( ci::audio::dsp::WindowType type )	{ mWindowType = type; return *this; }
+
+		size_t		getFftSize() const			{ return mFftSize; }
+		size_t		getWindowSize() const		{ return mWindowSize; }
+		ci::audio::dsp::WindowType	getWindowType() const	{ return mWindowType; }
+
+		// reimpl Node::Format
+		Format&		channels( size_t ch )							{ Node::Format::channels( ch ); return *this; }
+		Format&		channelMode( ChannelMode mode )					{ Node::Format::channelMode( mode ); return *this; }
+		Format&		autoEnable( bool autoEnable = true )			{ Node::Format::autoEnable( autoEnable ); return *this; }
+
+	  protected:
+		size_t		mFftSize = 0;
+		size_t		mWindowSize = 1024;
+		ci::audio::dsp::WindowType	mWindowType = ci::audio::dsp::WindowType::BLACKMAN;
+	};
+
+	MultichannelSpectralNode( const Format &format = Format() );
+	virtual ~MultichannelSpectralNode();
+
+	//! Analyzes the latest window of every channel. Returns false if no new audio arrived since the last call. Call this from one non-audio thread, usually once per frame.
+	bool	update();
+
+	size_t	getFftSize() const		{ return mFftSize; }
+	size_t	getWindowSize() const	{ return mFormat.getWindowSize(); }
+	size_t	getNumBins() const		{ return mFftSize / 2; }
+
+	//! Returns the number of channels that were analyzed by the last update().
+	size_t			getNumAnalyzedChannels() const			{ return mVolumes.size(); }
+	//! Returns the linear magnitude spectrum of \a channel computed by the last update(), getNumBins() long. Unlike ci::audio::MonitorSpectralNode, no smoothing is applied.
+	const float*	getMagSpectrum( size_t channel ) const	{ return mMagSpectra.data() + channel * getNumBins(); }
+	//! Returns the RMS volume (linear) of \a channel computed by the last update().
+	float			getVolume( size_t channel ) const		{ return mVolumes[channel]; }
+
+  protected:
+	void initialize()				override;
+	void process( ci::audio::Buffer *buffer )	override;
+
+  private:
+	Format		mFormat;
+	size_t		mFftSize = 0;
+
+	std::unique_ptr<ci::audio::dsp::Fft>	mFft;
+	ci::audio::AlignedArrayPtr	mWindowingTable;
+	ci::audio::Buffer			mFftBuffer;
+	ci::audio::BufferSpectral	mBufferSpectral;
+
+	std::vector<float>		mHistory;				// channel-major, mHistoryFrames per channel
+	size_t					mHistoryFrames = 0;		// power of two, leaves room for blocks written while update() reads
+	size_t					mHistoryChannels = 0;
+	std::atomic<uint64_t>	mNumFramesWritten = { 0 };
+	uint64_t				mNumFramesAnalyzed = 0;
+
+	std::vector<float>		mMagSpectra;			// getNumBins() per channel
+	std::vector<float>		mVolumes;
+};
+
+} } // namespace mason::audio
@@ -21,12 +21,193 @@
 
 #include "mason/audio/OfflineContext.h"
 
+#include "cinder/audio/Target.h"
+#include "cinder/audio/dsp/Converter.h"
+#include "cinder/audio/dsp/Dsp.h"
+#include "cinder/Log.h"
+
+#include <condition_variable>
+#include <thread>
+
 using namespace std;
 using namespace ci;
 using namespace ci::audio;
 
 namespace mason { namespace audio {
 
+namespace {
+
+void collectUpstreamNodes( const NodeRef &node, set<Node *> *result )
+{
+	if( ! result->insert( node.get() ).second )
+		return;
+
+	for( const auto &input : node->getInputs() )
+		collectUpstreamNodes( input, result );
+}
+
+//! Returns true if none of the \a subgraphs share a Node.
+bool areSubgraphsIndependent( const vector<NodeRef> &subgraphs )
+{
+	set<Node *> visited;
+	for( const auto &subgraph : subgraphs ) {
+		set<Node *> nodes;
+		collectUpstreamNodes( subgraph, &nodes );
+		for( Node *node : nodes ) {
+			if( ! visited.insert( node ).second )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//! Returns the Nodes that are pulled on worker threads ahead of the output each block. These are the output's inputs, unless
+//! there is only one. Then the graph is split further up, at the inputs of the first Node that sums several of them. Those
+//! inputs can only be pulled ahead if they keep their result for the rest of the block, which Nodes that aren't processed in
+//! place do, so chains of in-place Nodes are followed up to one that isn't. Chains that end in an in-place source are left for
+//! the output's own pull.
+vector<NodeRef> findParallelNodes( const NodeRef &output )
+{
+	auto followInPlaceChain = []( NodeRef node ) {
+		while( node->getProcessesInPlace() && ! node->getInputs().empty() )
+			node = *node->getInputs().begin();
+
+		return node;
+	};
+
+	vector<NodeRef> result( output->getInputs().begin(), output->getInputs().end() );
+	while( result.size() == 1 ) {
+		NodeRef summing = followInPlaceChain( result.front() );
+		if( summing->getInputs().size() < 2 )
+			break;
+
+		vector<NodeRef> roots;
+		for( const auto &input : summing->getInputs() ) {
+			NodeRef root = followInPlaceChain( input );
+			if( ! root->getProcessesInPlace() )
+				roots.push_back( root );
+		}
+
+		if( roots.empty() )
+			break;
+
+		result = roots;
+	}
+
+	return result;
+}
+
+//! Adds \a numFrames of \a source to \a dest starting at \a frameOffset, up or down-mixing the channels like dsp::mixBuffers().
+void mixBuffersAt( const Buffer *source, Buffer *dest, size_t numFrames, size_t frameOffset )
+{
+	const size_t sourceChannels = source->getNumChannels();
+	const size_t destChannels = dest->getNumChannels();
+
+	for( size_t ch = 0; ch < destChannels; ch++ ) {
+		float *destChannel = dest->getChannel( ch ) + frameOffset;
+		if( sourceChannels == 1 ) {
+			// mono is added to every channel
+			dsp::add( source->getChannel( 0 ), destChannel, destChannel, numFrames );
+		}
+		else if( destChannels == 1 ) {
+			for( size_t sourceCh = 0; sourceCh < sourceChannels; sourceCh++ )
+				dsp::add( source->getChannel( sourceCh ), destChannel, destChannel, numFrames );
+		}
+		else if( ch < sourceChannels ) {
+			dsp::add( source->getChannel( ch ), destChannel, destChannel, numFrames );
+		}
+	}
+}
+
+//! Persistent threads that each pull a fixed set of independent subgraphs once per block.
+class RenderWorkers {
+  public:
+	RenderWorkers( const vector<NodeRef> &subgraphs, size_t numThreads, size_t framesPerBlock )
+		: mSubgraphs( subgraphs )
+	{
+		for( const auto &subgraph : mSubgraphs )
+			mScratchBuffers.emplace_back( framesPerBlock, subgraph->getNumChannels() );
+
+		numThreads = min( numThreads, mSubgraphs.size() );
+		for( size_t i = 0; i < numThreads; i++ )
+			mThreads.emplace_back( &RenderWorkers::run, this, i, numThreads );
+	}
+
+	~RenderWorkers()
+	{
+		{
+			lock_guard<mutex> lock( mMutex );
+			mQuit = true;
+		}
+		mCondStart.notify_all();
+
+		for( auto &t : mThreads )
+			t.join();
+	}
+
+	//! Pulls every subgraph for the current block, returns once all of them are processed.
+	void pullAll()
+	{
+		unique_lock<mutex> lock( mMutex );
+		mGeneration++;
+		mNumPending = mThreads.size();
+		mCondStart.notify_all();
+		mCondDone.wait( lock, [this] { return mNumPending == 0; } );
+	}
+
+	//! Returns the buffer holding the result of \a node for the last block, or null if it isn't one of the subgraphs.
+	const Buffer* getProcessedBuffer( const Node *node )
+	{
+		for( size_t i = 0; i < mSubgraphs.size(); i++ ) {
+			const auto &subgraph = mSubgraphs[i];
+			if( subgraph.get() == node )
+				return subgraph->getProcessesInPlace() ? &mScratchBuffers[i] : subgraph->getInternalBuffer();
+		}
+
+		return nullptr;
+	}
+
+  private:
+	void run( size_t threadIndex, size_t numThreads )
+	{
+		uint64_t lastGeneration = 0;
+		while( true ) {
+			{
+				unique_lock<mutex> lock( mMutex );
+				mCondStart.wait( lock, [&] { return mQuit || mGeneration != lastGeneration; } );
+				if( mQuit )
+					return;
+
+				lastGeneration = mGeneration;
+			}
+
+			for( size_t i = threadIndex; i < mSubgraphs.size(); i += numThreads ) {
+				mScratchBuffers[i].zero();
+				mSubgraphs[i]->pullInputs( &mScratchBuffers[i] );
+			}
+
+			{
+				lock_guard<mutex> lock( mMutex );
+				if( --mNumPending == 0 )
+					mCondDone.notify_one();
+			}
+		}
+	}
+
+	vector<NodeRef>		mSubgraphs;
+	vector<Buffer>		mScratchBuffers;
+	vector<thread>		mThreads;
+
+	mutex				mMutex;
+	condition_variable	mCondStart, mCondDone;
+	uint64_t			mGeneration = 0;
+	size_t				mNumPending = 0;
+	bool				mQuit = false;
+};
+
+} // anonymous namespace
+
 OutputOfflineNode::OutputOfflineNode( ci::audio::Node::Format &format )
 	: ci::audio::OutputNode( format )
 {
@@ -73,8 +254,12 @@ void OfflineContext::setFramesPerBlock( size_t numFrames )
 void OfflineContext::setOuputNumChannels( size_t numChannels )
 {
 	if( numChannels != getOutput()->getNumChannels() ) {
-		// recreate output node with correct number of channels
+		// recreate output node with correct number of channels, keeping the samplerate and block size already set on it
+		const size_t sampleRate = mOutputOffline->mSampleRate;
+		const size_t framesPerBlock = mOutputOffline->mFramesPerBlock;
 		mOutputOffline = makeNode<OutputOfflineNode>( ci::audio::Node::Format().channels( numChannels ) );
+		mOutputOffline->mSampleRate = sampleRate;
+		mOutputOffline->mFramesPerBlock = framesPerBlock;
 		setOutput( mOutputOffline );
 	}
 }
@@ -107,4 +292,85 @@ void OfflineContext::pull( ci::audio::Buffer *buffer )
 	}
 }
 
+void OfflineContext::renderImpl( size_t numFrames, size_t numThreads, Buffer *dest, const RenderBlockFn &blockFn )
+{
+	getOutput();
+
+	lock_guard<mutex> lock( getMutex() );
+
+	auto output = mOutputOffline;
+
+	unique_ptr<RenderWorkers> workers;
+	if( numThreads > 1 ) {
+		auto subgraphs = findParallelNodes( output );
+		if( subgraphs.size() > 1 ) {
+			if( areSubgraphsIndependent( subgraphs ) )
+				workers.reset( new RenderWorkers( subgraphs, numThreads, getFramesPerBlock() ) );
+			else
+				CI_LOG_W( "subgraphs of the output share Nodes, rendering on one thread." );
+		}
+	}
+
+	// the output's inputs are summed here rather than by pulling the output, so that they can be summed straight into dest.
+	// Inputs that are processed in place need a buffer to process in, like the output Node's own pull would give them.
+	Buffer inPlaceBuffer( getFramesPerBlock(), output->getNumChannels() );
+
+	size_t numFramesWritten = 0;
+	while( numFramesWritten < numFrames ) {
+		preProcess();
+
+		if( workers )
+			workers->pullAll();
+
+		const size_t blockFrames = min( getFramesPerBlock(), numFrames - numFramesWritten );
+		Buffer *block = dest ? dest : output->getInternalBuffer();
+		const size_t frameOffset = dest ? numFramesWritten : 0;
+		if( ! dest )
+			block->zero();
+
+		for( const auto &input : output->getInputs() ) {
+			const Buffer *processed = workers ? workers->getProcessedBuffer( input.get() ) : nullptr;
+			if( ! processed ) {
+				inPlaceBuffer.zero();
+				input->pullInputs( &inPlaceBuffer );
+				processed = input->getProcessesInPlace() ? &inPlaceBuffer : input->getInternalBuffer();
+			}
+
+			mixBuffersAt( processed, block, blockFrames, frameOffset );
+		}
+
+		if( blockFn )
+			blockFn( *block, blockFrames, numFramesWritten );
+
+		numFramesWritten += blockFrames;
+
+		postProcess();
+	}
+}
+
+void OfflineContext::renderBlocks( size_t numFrames, const RenderBlockFn &blockFn, size_t numThreads )
+{
+	renderImpl( numFrames, numThreads, nullptr, blockFn );
+}
+
+void OfflineContext::render( double seconds, ci::audio::BufferDynamic *buffer, size_t numThreads )
+{
+	size_t numFrames = (size_t)lround( seconds * (double)getSampleRate() );
+	buffer->setSize( numFrames, getOutput()->getNumChannels() );
+	buffer->zero();
+
+	renderImpl( numFrames, numThreads, buffer, nullptr );
+}
+
+void OfflineContext::renderToFile( double seconds, const ci::fs::path &filePath, size_t numThreads )
+{
+	size_t numFrames = (size_t)lround( seconds * (double)getSampleRate() );
+	auto target = ci::audio::TargetFile::create( filePath, getSampleRate(), getOutput()->getNumChannels(), ci::audio::SampleType::FLOAT_32 );
+
+	// blocks are written straight from the output Node's buffer, so no render-length buffer is needed
+	renderBlocks( numFrames, [&target]( const Buffer &block, size_t blockFrames, size_t frameOffset ) {
+		target->write( &block, blockFrames );
+	}, numThreads );
+}
+
 } } // namespace mason::audio
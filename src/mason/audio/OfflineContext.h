@@ -22,8 +22,11 @@
 #pragma once
 
 #include "cinder/Cinder.h"
+#include "cinder/Filesystem.h"
 #include "cinder/audio/Context.h"
 
+#include <functional>
+
 namespace mason { namespace audio {
 
 using OfflineContextRef = std::shared_ptr<class OfflineContext>;
@@ -55,6 +58,8 @@ class OfflineContext : public ci::audio::Context {
 	void disable() override;
 
 	void setSampleRate( size_t sampleRate );
+	//! Sets the number of frames processed per block. Must be called before Nodes are created, as their buffers are sized from this.
+	//! Offline rendering benefits from large blocks (ex. 4096 - 16384), as the per-block overhead of traversing the graph is amortized.
 	void setFramesPerBlock( size_t numFrames );
 	void setOuputNumChannels( size_t numChannels );
 	
@@ -66,10 +71,34 @@ class OfflineContext : public ci::audio::Context {
 
 	void pull( ci::audio::Buffer *buffer );
 
+	//! Called for each rendered block with the output Node's buffer, the number of valid frames in it, and the frame offset into the render.
+	using RenderBlockFn = std::function<void ( const ci::audio::Buffer &block, size_t numFrames, size_t frameOffset )>;
+
+	//! \brief Renders \a seconds of the graph into \a buffer, which is resized once up front.
+	//!
+	//! The inputs of the output Node are summed straight into \a buffer, rather than into the output Node's buffer and then
+	//! copied. Unlike pull(), blocks that clip aren't zeroed, as there is no device to protect.
+	//!
+	//! If \a numThreads is greater than one, independent subgraphs (they share no Nodes) are pulled on worker threads. These are the
+	//! inputs of the output Node, or if there is only one, the inputs of the first Node upstream that sums several of them (ex.
+	//! a GainNode used as a mixer). There, only inputs that end in a Node that isn't processed in place can be pulled ahead, as
+	//! only those keep their result until the summing Node pulls them. Nodes that drive Params of another subgraph (ex. with
+	//! Param::setProcessor()) are not detected as shared, so in that case render with one thread.
+	void render( double seconds, ci::audio::BufferDynamic *buffer, size_t numThreads = 1 );
+	//! Renders \a seconds of the graph, streaming each block to a 32-bit float audio file at \a filePath (format from extension, ex. '.wav').
+	void renderToFile( double seconds, const ci::fs::path &filePath, size_t numThreads = 1 );
+	//! Renders \a numFrames frames, passing each block to \a blockFn without copying it. \see render() for details on \a numThreads.
+	void renderBlocks( size_t numFrames, const RenderBlockFn &blockFn, size_t numThreads = 1 );
+
 	// TODO: this is pretty hacky, but I need to keep both an OutputNodeRef and OutputOfflineNodeRef
 	// - reason being is that the virtual getOutput() returns a const ref to OutputNodeRef, which will slice the shared_ptr when it converts
 	// - also pretty hack that I need to lazy load it still, as you can't use Context::makeNode<> from the Context's constructor
 	OutputOfflineNodeRef		mOutputOffline;
+
+  private:
+	//! Renders \a numFrames, summing each block into \a dest at its frame offset if it isn't null, otherwise into the output
+	//! Node's buffer. \a blockFn, if set, is called with the block after it's rendered.
+	void renderImpl( size_t numFrames, size_t numThreads, ci::audio::Buffer *dest, const RenderBlockFn &blockFn );
 };
 
 } } // namespace mason::audio
@@ -21,11 +21,19 @@
 
 #include "mason/audio/ProfilerNode.h"
 
+#include "cinder/audio/ChannelRouterNode.h"
 #include "cinder/audio/Context.h"
 #include "cinder/Log.h"
 
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <unordered_map>
+
 using namespace ci;
 using namespace ci::audio;
+using namespace std;
 
 namespace mason { namespace audio {
 
@@ -78,4 +86,431 @@ void ProfilerNode::process( ci::audio::Buffer *buffer )
 	}
 }
 
+// ----------------------------------------------------------------------------------------------------
+// GraphProfiler::ProbeNode
+// ----------------------------------------------------------------------------------------------------
+
+// Passes its input through unchanged, timing how long it takes to pull.
+class GraphProfiler::ProbeNode : public ci::audio::Node {
+  public:
+	ProbeNode( GraphProfiler *profiler, size_t slotIndex, bool isRoot )
+		: Node( Format().channelMode( ChannelMode::MATCHES_INPUT ) ), mProfiler( profiler ), mSlotIndex( slotIndex ), mIsRoot( isRoot )
+	{}
+
+	bool isRoot() const	{ return mIsRoot; }
+
+  protected:
+	void pullInputs( ci::audio::Buffer *inPlaceBuffer ) override
+	{
+		// a Node with several outputs is pulled once for each, only the first pull per block does any work
+		const uint64_t processedFrames = getContext()->getNumProcessedFrames();
+		if( processedFrames == mLastProcessedFrames ) {
+			Node::pullInputs( inPlaceBuffer );
+			return;
+		}
+
+		mLastProcessedFrames = processedFrames;
+		size_t depth = mProfiler->beginSection();
+		Node::pullInputs( inPlaceBuffer );
+		mProfiler->endSection( depth, mSlotIndex, mIsRoot );
+	}
+
+  private:
+	GraphProfiler*	mProfiler;
+	size_t			mSlotIndex;
+	bool			mIsRoot;
+	uint64_t		mLastProcessedFrames = std::numeric_limits<uint64_t>::max();
+};
+
+// ----------------------------------------------------------------------------------------------------
+// GraphProfiler
+// ----------------------------------------------------------------------------------------------------
+
+namespace {
+
+shared_ptr<GraphProfiler> sGraphProfiler;
+
+// Histogram bins are a quarter octave wide: the bin index is 4 * log2( ns ) plus the two bits below the most significant one.
+size_t histogramBin( uint64_t ns )
+{
+	size_t msb = 0;
+	for( uint64_t v = ns; v > 1; v >>= 1 )
+		msb++;
+
+	size_t sub = msb >= 2 ? size_t( ( ns >> ( msb - 2 ) ) & 3 ) : 0;
+	return msb * 4 + sub;
+}
+
+// Returns the geometric center of \a bin, in nanoseconds.
+double histogramBinCenterNs( size_t bin )
+{
+	const size_t msb = bin / 4;
+	const size_t sub = bin % 4;
+	if( msb < 2 )
+		return double( uint64_t( 1 ) << msb );
+
+	const double lower = double( ( 4 + sub ) << ( msb - 2 ) );
+	const double upper = double( ( 5 + sub ) << ( msb - 2 ) );
+	return sqrt( lower * upper );
+}
+
+// The outputs of a Node are either NodeRefs or weak_ptrs, depending on the Cinder version.
+NodeRef lockNode( const NodeRef &node )				{ return node; }
+NodeRef lockNode( const std::weak_ptr<Node> &node )	{ return node.lock(); }
+
+vector<NodeRef> getOutputNodes( const NodeRef &node )
+{
+	vector<NodeRef> result;
+	for( const auto &output : node->getOutputs() ) {
+		auto outputRef = lockNode( output );
+		if( outputRef )
+			result.push_back( outputRef );
+	}
+
+	return result;
+}
+
+string escapeJson( const string &str )
+{
+	string result;
+	for( char c : str ) {
+		if( c == '"' || c == '\\' )
+			result += '\\';
+		result += c;
+	}
+
+	return result;
+}
+
+} // anonymous namespace
+
+GraphProfiler* graphProfiler()
+{
+	return sGraphProfiler.get();
+}
+
+void setGraphProfilerInstance( const std::shared_ptr<GraphProfiler> &profiler )
+{
+	sGraphProfiler = profiler;
+}
+
+GraphProfiler::GraphProfiler( size_t traceCapacity )
+	: mEpoch( std::chrono::steady_clock::now() )
+{
+	size_t capacity = 1;
+	while( capacity < traceCapacity )
+		capacity <<= 1;
+
+	mTrace.resize( capacity );
+}
+
+GraphProfiler::~GraphProfiler()
+{
+	uninstrument();
+}
+
+std::shared_ptr<GraphProfiler::ProbeNode> GraphProfiler::makeProbe( const std::string &name, bool isRoot )
+{
+	mSlots.emplace_back( new Slot( name ) );
+	auto probe = mContext->makeNode( new ProbeNode( this, mSlots.size() - 1, isRoot ) );
+	mProbes.push_back( probe );
+	return probe;
+}
+
+void GraphProfiler::instrument( ci::audio::Context *context )
+{
+	uninstrument();
+
+	mContext = context;
+	mDeadlineNs = uint64_t( 1e9 * context->getFramesPerBlock() / context->getSampleRate() );
+	mDepth = 0;
+
+	const bool wasEnabled = context->isEnabled();
+	context->disable();
+
+	// collect every Node connected to the output, walking both inputs and outputs so that monitors hanging off the graph are found too
+	const NodeRef output = context->getOutput();
+	vector<NodeRef> nodes;
+	{
+		vector<NodeRef> stack = { output };
+		set<Node *> visited = { output.get() };
+		while( ! stack.empty() ) {
+			auto node = stack.back();
+			stack.pop_back();
+			nodes.push_back( node );
+
+			auto neighbors = getOutputNodes( node );
+			const auto inputs = node->getInputs();
+			neighbors.insert( neighbors.end(), inputs.begin(), inputs.end() );
+			for( const auto &neighbor : neighbors ) {
+				if( visited.insert( neighbor.get() ).second )
+					stack.push_back( neighbor );
+			}
+		}
+	}
+
+	// names are only for display, number duplicates so they can be told apart
+	unordered_map<string, size_t> nameCounts;
+
+	for( const auto &node : nodes ) {
+		if( node == output )
+			continue;
+
+		string name = node->getName();
+		size_t count = ++nameCounts[name];
+		if( count > 1 )
+			name += " #" + to_string( count );
+
+		auto outputs = getOutputNodes( node );
+		if( outputs.empty() ) {
+			// a sink pulled by the Context, ex. a MonitorNode. The probe takes its place in the auto-pulled list and pulls it instead.
+			if( ! dynamic_pointer_cast<NodeAutoPullable>( node ) )
+				continue;
+
+			auto probe = makeProbe( name, false );
+			node->connect( probe );
+			lock_guard<mutex> lock( context->getMutex() );
+			context->removeAutoPulledNode( node );
+			context->addAutoPulledNode( probe );
+			continue;
+		}
+
+		outputs.erase( remove_if( outputs.begin(), outputs.end(), []( const NodeRef &n ) { return (bool)dynamic_pointer_cast<ChannelRouterNode>( n ); } ), outputs.end() );
+		if( outputs.empty() )
+			continue;
+
+		auto probe = makeProbe( name, false );
+		for( const auto &out : outputs )
+			probe->connect( out );
+
+		node->connect( probe );
+		for( const auto &out : outputs )
+			node->disconnect( out );
+	}
+
+	// the root probe times the entire block
+	auto root = makeProbe( "graph", true );
+	const auto outputInputs = output->getInputs();
+	root->connect( output );
+	for( const auto &input : outputInputs ) {
+		input->connect( root );
+		input->disconnect( output );
+	}
+
+	if( wasEnabled )
+		context->enable();
+}
+
+void GraphProfiler::uninstrument()
+{
+	if( ! mContext )
+		return;
+
+	const bool wasEnabled = mContext->isEnabled();
+	mContext->disable();
+
+	// reconnect from the probes' current connections, so changes made to the graph while instrumented are kept
+	for( const auto &probe : mProbes ) {
+		const auto inputs = probe->getInputs();
+		auto outputs = getOutputNodes( probe );
+
+		for( const auto &input : inputs ) {
+			for( const auto &out : outputs )
+				input->connect( out );
+		}
+
+		probe->disconnectAll();
+
+		if( outputs.empty() && ! probe->isRoot() ) {
+			lock_guard<mutex> lock( mContext->getMutex() );
+			mContext->removeAutoPulledNode( probe );
+			for( const auto &input : inputs ) {
+				if( dynamic_pointer_cast<NodeAutoPullable>( input ) && getOutputNodes( input ).empty() )
+					mContext->addAutoPulledNode( input );
+			}
+		}
+	}
+
+	if( wasEnabled )
+		mContext->enable();
+
+	mProbes.clear();
+	mSlots.clear();
+	mContext = nullptr;
+}
+
+uint64_t GraphProfiler::nowNs() const
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - mEpoch ).count();
+}
+
+size_t GraphProfiler::beginSection()
+{
+	if( mDepth < MAX_DEPTH )
+		mSections[mDepth] = { nowNs(), 0 };
+
+	return mDepth++;
+}
+
+void GraphProfiler::endSection( size_t depth, size_t slotIndex, bool isRoot )
+{
+	mDepth--;
+	if( depth >= MAX_DEPTH )
+		return;
+
+	const Section &section = mSections[depth];
+	const uint64_t elapsedNs = nowNs() - section.mStartNs;
+	if( depth > 0 )
+		mSections[depth - 1].mChildNs += elapsedNs;
+
+	// the root reports the whole block, the others only their own processing
+	const uint64_t ns = isRoot ? elapsedNs : elapsedNs - std::min( elapsedNs, section.mChildNs );
+
+	Slot &slot = *mSlots[slotIndex];
+	slot.mHistogram[std::min( histogramBin( ns ), HISTOGRAM_BINS - 1 )].fetch_add( 1, memory_order_relaxed );
+	slot.mCount.fetch_add( 1, memory_order_relaxed );
+	slot.mTotalNs.fetch_add( ns, memory_order_relaxed );
+	if( ns > slot.mMaxNs.load( memory_order_relaxed ) )
+		slot.mMaxNs.store( ns, memory_order_relaxed );
+
+	if( isRoot && elapsedNs > mDeadlineNs )
+		mNumDeadlineMisses.fetch_add( 1, memory_order_relaxed );
+
+	const uint64_t writeIndex = mTraceWriteIndex.load( memory_order_relaxed );
+	mTrace[writeIndex & ( mTrace.size() - 1 )] = { uint32_t( slotIndex ), section.mStartNs, elapsedNs };
+	mTraceWriteIndex.store( writeIndex + 1, memory_order_release );
+}
+
+GraphProfiler::NodeStats GraphProfiler::makeNodeStats( const Slot &slot ) const
+{
+	NodeStats result;
+	result.mName = slot.mName;
+
+	array<uint32_t, HISTOGRAM_BINS> histogram;
+	uint64_t total = 0;
+	for( size_t i = 0; i < HISTOGRAM_BINS; i++ ) {
+		histogram[i] = slot.mHistogram[i].load( memory_order_relaxed );
+		total += histogram[i];
+	}
+
+	if( total == 0 )
+		return result;
+
+	const double maxNs = (double)slot.mMaxNs.load( memory_order_relaxed );
+	auto percentileMs = [&]( double percentile ) {
+		const uint64_t rank = uint64_t( ceil( percentile * total ) );
+		uint64_t count = 0;
+		for( size_t i = 0; i < HISTOGRAM_BINS; i++ ) {
+			count += histogram[i];
+			if( count >= rank )
+				return std::min( histogramBinCenterNs( i ), maxNs ) * 1e-6;
+		}
+
+		return maxNs * 1e-6;
+	};
+
+	result.mNumBlocks = total;
+	result.mMeanMs = slot.mTotalNs.load( memory_order_relaxed ) * 1e-6 / std::max<uint64_t>( 1, slot.mCount.load( memory_order_relaxed ) );
+	result.mP50Ms = percentileMs( 0.5 );
+	result.mP99Ms = percentileMs( 0.99 );
+	result.mMaxMs = maxNs * 1e-6;
+	return result;
+}
+
+GraphProfiler::Stats GraphProfiler::getStats() const
+{
+	Stats result;
+	result.mDeadlineMs = mDeadlineNs * 1e-6;
+	result.mNumDeadlineMisses = mNumDeadlineMisses.load( memory_order_relaxed );
+
+	for( size_t i = 0; i < mSlots.size(); i++ ) {
+		if( mProbes[i]->isRoot() )
+			result.mGraph = makeNodeStats( *mSlots[i] );
+		else
+			result.mNodes.push_back( makeNodeStats( *mSlots[i] ) );
+	}
+
+	return result;
+}
+
+void GraphProfiler::reset()
+{
+	for( auto &slot : mSlots ) {
+		for( auto &bin : slot->mHistogram )
+			bin.store( 0, memory_order_relaxed );
+
+		slot->mCount = 0;
+		slot->mTotalNs = 0;
+		slot->mMaxNs = 0;
+	}
+
+	mNumDeadlineMisses = 0;
+	mTraceWriteIndex = 0;
+}
+
+bool GraphProfiler::writeCsv( const ci::fs::path &filePath ) const
+{
+	ofstream stream( filePath.string() );
+	if( ! stream.is_open() ) {
+		CI_LOG_E( "failed to open file for writing: " << filePath );
+		return false;
+	}
+
+	auto stats = getStats();
+	stream << "node,blocks,mean_ms,p50_ms,p99_ms,max_ms,deadline_misses\n";
+
+	auto writeRow = [&stream]( const NodeStats &nodeStats, const string &deadlineMisses ) {
+		stream << "\"" << nodeStats.mName << "\"," << nodeStats.mNumBlocks << "," << nodeStats.mMeanMs << "," << nodeStats.mP50Ms << ","
+			<< nodeStats.mP99Ms << "," << nodeStats.mMaxMs << "," << deadlineMisses << "\n";
+	};
+
+	writeRow( stats.mGraph, to_string( stats.mNumDeadlineMisses ) );
+	for( const auto &nodeStats : stats.mNodes )
+		writeRow( nodeStats, "" );
+
+	return stream.good();
+}
+
+bool GraphProfiler::writeChromeTrace( const ci::fs::path &filePath ) const
+{
+	// copy out the events that are still in the ring, dropping any that the audio thread overwrote during the copy
+	const uint64_t capacity = mTrace.size();
+	const uint64_t end = mTraceWriteIndex.load( memory_order_acquire );
+	uint64_t begin = end > capacity ? end - capacity : 0;
+
+	vector<TraceEvent> events;
+	events.reserve( size_t( end - begin ) );
+	for( uint64_t i = begin; i < end; i++ )
+		events.push_back( mTrace[i & ( capacity - 1 )] );
+
+	const uint64_t endAfterCopy = mTraceWriteIndex.load( memory_order_acquire );
+	if( endAfterCopy > capacity && endAfterCopy - capacity > begin ) {
+		const size_t overwritten = size_t( std::min( endAfterCopy - capacity - begin, (uint64_t)events.size() ) );
+		events.erase( events.begin(), events.begin() + overwritten );
+	}
+
+	ofstream stream( filePath.string() );
+	if( ! stream.is_open() ) {
+		CI_LOG_E( "failed to open file for writing: " << filePath );
+		return false;
+	}
+
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for( const auto &event : events ) {
+		if( event.mSlot >= mSlots.size() )
+			continue;
+
+		if( ! first )
+			stream << ",\n";
+
+		first = false;
+		stream << "{\"name\":\"" << escapeJson( mSlots[event.mSlot]->mName ) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+			<< event.mStartNs / 1000.0 << ",\"dur\":" << event.mDurationNs / 1000.0 << "}";
+	}
+
+	stream << "\n]}\n";
+	return stream.good();
+}
+
 } } // namespace mason::audio
@@ -21,12 +21,20 @@
 
 #pragma once
 
+#include "mason/Export.h"
+
 #include "cinder/Cinder.h"
+#include "cinder/Filesystem.h"
 #include "cinder/audio/Node.h"
 
 #include "cinder/Timer.h"
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace mason { namespace audio {
 
@@ -58,4 +66,113 @@ private:
 	std::atomic<double>		mSecondsInSection = { -1 };
 };
 
+// ----------------------------------------------------------------------------------------------------
+// GraphProfiler
+// ----------------------------------------------------------------------------------------------------
+
+//! \brief Measures how long each Node in a ci::audio::Context's graph takes to process, without changes to the Nodes themselves.
+//!
+//! instrument() inserts a pass-through probe after every Node reachable from the Context's output. Each probe times the pull of its input,
+//! minus the time spent in the probes beneath it. That gives the Node's own processing time, which goes into a histogram for p50 / p99 / max.
+//! One more probe in front of the output times the whole block. When that takes longer than the block's duration, it is counted as a deadline miss (xrun).
+//!
+//! The audio thread only writes atomics and a trace ring buffer, so getStats() can be called from the UI thread at any time without locking.
+//! Connections into a ChannelRouterNode aren't probed because the router keys its routes by input Node. Nodes that drive a Param with
+//! Param::setProcessor() aren't connected to the graph either. Time spent in either is counted towards the Node they feed.
+class MA_API GraphProfiler {
+  public:
+	struct NodeStats {
+		std::string	mName;
+		uint64_t	mNumBlocks = 0;
+		double		mMeanMs = 0;
+		double		mP50Ms = 0;
+		double		mP99Ms = 0;
+		double		mMaxMs = 0;
+	};
+
+	struct Stats {
+		//! Timing of the whole block, as pulled by the output Node.
+		NodeStats				mGraph;
+		std::vector<NodeStats>	mNodes;
+		uint64_t				mNumDeadlineMisses = 0;
+		double					mDeadlineMs = 0;
+	};
+
+	//! \a traceCapacity is the number of timing events kept for writeChromeTrace(), rounded up to a power of two.
+	GraphProfiler( size_t traceCapacity = 1 << 16 );
+	~GraphProfiler();
+
+	//! Inserts probes into \a context's graph. The context is disabled while connections change, then re-enabled if it was enabled before.
+	void	instrument( ci::audio::Context *context );
+	//! Removes the probes and restores the connections they replaced.
+	void	uninstrument();
+	bool	isInstrumented() const	{ return mContext != nullptr; }
+
+	//! Returns the current statistics. Percentiles are estimated from histogram bins a quarter octave wide, so they are accurate to about 10%.
+	Stats	getStats() const;
+	//! Clears the histograms, deadline misses and trace.
+	void	reset();
+
+	//! Writes getStats() as CSV to \a filePath, one row per Node. Returns false on failure.
+	bool	writeCsv( const ci::fs::path &filePath ) const;
+	//! Writes the recent timing events to \a filePath in the Chrome trace event format (load in chrome://tracing or Perfetto). Returns false on failure.
+	bool	writeChromeTrace( const ci::fs::path &filePath ) const;
+
+  private:
+	class ProbeNode;
+	friend class ProbeNode;
+
+	static const size_t HISTOGRAM_BINS = 128;
+	static const size_t MAX_DEPTH = 256;
+
+	struct Slot {
+		Slot( const std::string &name ) : mName( name )	{}
+
+		std::string				mName;
+		std::array<std::atomic<uint32_t>, HISTOGRAM_BINS>	mHistogram = {};
+		std::atomic<uint64_t>	mCount = { 0 };
+		std::atomic<uint64_t>	mTotalNs = { 0 };
+		std::atomic<uint64_t>	mMaxNs = { 0 };
+	};
+
+	struct TraceEvent {
+		uint32_t	mSlot;
+		uint64_t	mStartNs;
+		uint64_t	mDurationNs;
+	};
+
+	struct Section {
+		uint64_t	mStartNs;
+		uint64_t	mChildNs;
+	};
+
+	std::shared_ptr<ProbeNode>	makeProbe( const std::string &name, bool isRoot );
+	NodeStats	makeNodeStats( const Slot &slot ) const;
+	uint64_t	nowNs() const;
+
+	// called on the audio thread by ProbeNode
+	size_t	beginSection();
+	void	endSection( size_t depth, size_t slotIndex, bool isRoot );
+
+	ci::audio::Context*						mContext = nullptr;
+	std::vector<std::shared_ptr<ProbeNode>>	mProbes;
+	std::vector<std::unique_ptr<Slot>>		mSlots;
+	uint64_t								mDeadlineNs = 0;
+	std::atomic<uint64_t>					mNumDeadlineMisses = { 0 };
+
+	// audio thread only
+	std::array<Section, MAX_DEPTH>	mSections;
+	size_t							mDepth = 0;
+
+	// single producer ring buffer, read by writeChromeTrace()
+	std::vector<TraceEvent>	mTrace;
+	std::atomic<uint64_t>	mTraceWriteIndex = { 0 };
+	std::chrono::steady_clock::time_point	mEpoch;
+};
+
+//! Returns the GraphProfiler shown in imx::Profiling(), or nullptr if none has been set.
+MA_API GraphProfiler* graphProfiler();
+//! Sets the GraphProfiler shown in imx::Profiling().
+MA_API void setGraphProfilerInstance( const std::shared_ptr<GraphProfiler> &profiler );
+
 } } // namespace mason::audio
@@ -0,0 +1,165 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+//! \file Simd.h
+//! Minimal 4-lane float vector used by DSP code that processes several channels or samples at once.
+//! Maps to SSE where available and to plain arrays elsewhere, so the same kernels build on every platform.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define MA_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define MA_SIMD_SSE 0
+#endif
+
+namespace mason { namespace audio { namespace simd {
+
+#if MA_SIMD_SSE
+
+struct float4 {
+	__m128	v;
+
+	float4() = default;
+	float4( __m128 v ) : v( v )									{}
+	explicit float4( float x ) : v( _mm_set1_ps( x ) )			{}
+	float4( float a, float b, float c, float d ) : v( _mm_setr_ps( a, b, c, d ) )	{}
+
+	static float4	load( const float *p )		{ return _mm_loadu_ps( p ); }
+	static float4	zero()						{ return _mm_setzero_ps(); }
+	void			store( float *p ) const		{ _mm_storeu_ps( p, v ); }
+};
+
+inline float4 operator+( const float4 &a, const float4 &b )	{ return _mm_add_ps( a.v, b.v ); }
+inline float4 operator-( const float4 &a, const float4 &b )	{ return _mm_sub_ps( a.v, b.v ); }
+inline float4 operator*( const float4 &a, const float4 &b )	{ return _mm_mul_ps( a.v, b.v ); }
+inline float4 operator/( const float4 &a, const float4 &b )	{ return _mm_div_ps( a.v, b.v ); }
+inline float4 min( const float4 &a, const float4 &b )		{ return _mm_min_ps( a.v, b.v ); }
+inline float4 max( const float4 &a, const float4 &b )		{ return _mm_max_ps( a.v, b.v ); }
+
+// comparisons return a mask with all bits set in lanes where the comparison is true
+inline float4 operator<( const float4 &a, const float4 &b )		{ return _mm_cmplt_ps( a.v, b.v ); }
+inline float4 operator<=( const float4 &a, const float4 &b )	{ return _mm_cmple_ps( a.v, b.v ); }
+inline float4 operator>( const float4 &a, const float4 &b )		{ return _mm_cmpgt_ps( a.v, b.v ); }
+
+//! Returns \a a in lanes where \a mask is set, otherwise \a b.
+inline float4 select( const float4 &mask, const float4 &a, const float4 &b )
+{
+	return _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) );
+}
+
+//! Returns a float4 with every lane set to lane \a Lane of \a a.
+template <int Lane>
+inline float4 splat( const float4 &a )
+{
+	return _mm_shuffle_ps( a.v, a.v, _MM_SHUFFLE( Lane, Lane, Lane, Lane ) );
+}
+
+//! Transposes the 4x4 matrix whose rows are \a a, \a b, \a c and \a d.
+inline void transpose( float4 &a, float4 &b, float4 &c, float4 &d )
+{
+	_MM_TRANSPOSE4_PS( a.v, b.v, c.v, d.v );
+}
+
+#else
+
+struct float4 {
+	float	v[4];
+
+	float4() = default;
+	explicit float4( float x ) : v{ x, x, x, x }					{}
+	float4( float a, float b, float c, float d ) : v{ a, b, c, d }	{}
+
+	static float4	load( const float *p )		{ return float4( p[0], p[1], p[2], p[3] ); }
+	static float4	zero()						{ return float4( 0.0f ); }
+	void			store( float *p ) const		{ std::copy( v, v + 4, p ); }
+};
+
+inline float4 operator+( const float4 &a, const float4 &b )	{ return float4( a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] ); }
+inline float4 operator-( const float4 &a, const float4 &b )	{ return float4( a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] ); }
+inline float4 operator*( const float4 &a, const float4 &b )	{ return float4( a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] ); }
+inline float4 operator/( const float4 &a, const float4 &b )	{ return float4( a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] ); }
+inline float4 min( const float4 &a, const float4 &b )		{ return float4( std::min( a.v[0], b.v[0] ), std::min( a.v[1], b.v[1] ), std::min( a.v[2], b.v[2] ), std::min( a.v[3], b.v[3] ) ); }
+inline float4 max( const float4 &a, const float4 &b )		{ return float4( std::max( a.v[0], b.v[0] ), std::max( a.v[1], b.v[1] ), std::max( a.v[2], b.v[2] ), std::max( a.v[3], b.v[3] ) ); }
+
+namespace detail {
+
+inline float maskFromBool( bool b )
+{
+	uint32_t bits = b ? 0xffffffff : 0;
+	float result;
+	memcpy( &result, &bits, sizeof( float ) );
+	return result;
+}
+
+inline bool boolFromMask( float mask )
+{
+	uint32_t bits;
+	memcpy( &bits, &mask, sizeof( float ) );
+	return bits != 0;
+}
+
+} // namespace detail
+
+inline float4 operator<( const float4 &a, const float4 &b )		{ return float4( detail::maskFromBool( a.v[0] < b.v[0] ), detail::maskFromBool( a.v[1] < b.v[1] ), detail::maskFromBool( a.v[2] < b.v[2] ), detail::maskFromBool( a.v[3] < b.v[3] ) ); }
+inline float4 operator<=( const float4 &a, const float4 &b )	{ return float4( detail::maskFromBool( a.v[0] <= b.v[0] ), detail::maskFromBool( a.v[1] <= b.v[1] ), detail::maskFromBool( a.v[2] <= b.v[2] ), detail::maskFromBool( a.v[3] <= b.v[3] ) ); }
+inline float4 operator>( const float4 &a, const float4 &b )		{ return b < a; }
+
+inline float4 select( const float4 &mask, const float4 &a, const float4 &b )
+{
+	float4 result;
+	for( int i = 0; i < 4; i++ )
+		result.v[i] = detail::boolFromMask( mask.v[i] ) ? a.v[i] : b.v[i];
+
+	return result;
+}
+
+template <int Lane>
+inline float4 splat( const float4 &a )
+{
+	return float4( a.v[Lane] );
+}
+
+inline void transpose( float4 &a, float4 &b, float4 &c, float4 &d )
+{
+	std::swap( a.v[1], b.v[0] );
+	std::swap( a.v[2], c.v[0] );
+	std::swap( a.v[3], d.v[0] );
+	std::swap( b.v[2], c.v[1] );
+	std::swap( b.v[3], d.v[1] );
+	std::swap( c.v[3], d.v[2] );
+}
+
+#endif
+
+inline float4 operator*( const float4 &a, float b )	{ return a * float4( b ); }
+inline float4 operator+( const float4 &a, float b )	{ return a + float4( b ); }
+inline float4 operator-( const float4 &a, float b )	{ return a - float4( b ); }
+inline float4 operator/( const float4 &a, float b )	{ return a / float4( b ); }
+
+//! Number of lanes in a float4.
+const size_t LANES = 4;
+
+} } } // namespace mason::audio::simd
@@ -0,0 +1,312 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/audio/SpectrogramCache.h"
+
+#include "cinder/Log.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+inline uint64_t rotl64( uint64_t x, int r )
+{
+	return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+inline uint64_t fmix64( uint64_t k )
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+// Mixes 8 bytes at a time so hashing a large audio file is bound by memory bandwidth rather than per-byte work.
+uint64_t hashBytes( const uint8_t *data, size_t size )
+{
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ ( size * c1 );
+
+	const size_t numWords = size / 8;
+	for( size_t i = 0; i < numWords; i++ ) {
+		uint64_t k;
+		memcpy( &k, data + i * 8, 8 );
+		k *= c1;
+		k = rotl64( k, 31 );
+		k *= c2;
+		h ^= k;
+		h = rotl64( h, 27 ) * 5 + 0x52dce729;
+	}
+
+	uint64_t tail = 0;
+	const size_t tailSize = size - numWords * 8;
+	if( tailSize ) {
+		memcpy( &tail, data + numWords * 8, tailSize );
+		h ^= rotl64( tail * c1, 31 ) * c2;
+	}
+
+	return fmix64( h );
+}
+
+// ci::fs is std::filesystem, only used to tell whether a file changed so the clock's epoch doesn't matter
+int64_t toTicks( const fs::file_time_type &t )
+{
+	return (int64_t)t.time_since_epoch().count();
+}
+
+string toHex( uint64_t x )
+{
+	stringstream str;
+	str << hex << setw( 16 ) << setfill( '0' ) << x;
+	return str.str();
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// SpectrogramKey
+// ----------------------------------------------------------------------------------------------------
+
+bool SpectrogramKey::operator==( const SpectrogramKey &other ) const
+{
+	return mContentHash == other.mContentHash && mSampleRate == other.mSampleRate && mFftSize == other.mFftSize
+		&& mWindowSize == other.mWindowSize && mHopSize == other.mHopSize;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// SpectrogramCache
+// ----------------------------------------------------------------------------------------------------
+
+// static
+SpectrogramCacheRef SpectrogramCache::open( const fs::path &path, const SpectrogramKey &key )
+{
+	std::error_code ec;
+	if( ! fs::exists( path, ec ) )
+		return nullptr;
+
+	auto result = SpectrogramCacheRef( new SpectrogramCache );
+	if( ! result->mFile.open( path ) )
+		return nullptr;
+
+	if( result->mFile.getSize() < sizeof( SpectrogramCacheHeader ) ) {
+		CI_LOG_W( "spectrogram cache file too small, ignoring: " << path );
+		return nullptr;
+	}
+
+	SpectrogramCacheHeader header;
+	memcpy( &header, result->mFile.getData(), sizeof( header ) );
+
+	if( header.mMagic != SpectrogramCacheHeader::MAGIC || header.mVersion != SpectrogramCacheHeader::VERSION ) {
+		CI_LOG_W( "spectrogram cache has unknown format or version " << header.mVersion << ", ignoring: " << path );
+		return nullptr;
+	}
+
+	SpectrogramKey fileKey;
+	fileKey.mContentHash = header.mContentHash;
+	fileKey.mSampleRate = header.mSampleRate;
+	fileKey.mFftSize = header.mFftSize;
+	fileKey.mWindowSize = header.mWindowSize;
+	fileKey.mHopSize = header.mHopSize;
+	if( fileKey != key ) {
+		CI_LOG_I( "spectrogram cache params don't match, ignoring: " << path );
+		return nullptr;
+	}
+
+	const size_t expectedSize = sizeof( SpectrogramCacheHeader ) + size_t( header.mNumFrames ) * header.mNumBins * sizeof( float );
+	if( result->mFile.getSize() < expectedSize || header.mNumFrames == 0 || header.mNumBins == 0 ) {
+		CI_LOG_W( "spectrogram cache is truncated, ignoring: " << path );
+		return nullptr;
+	}
+
+	result->mFilePath = path;
+	result->mKey = fileKey;
+	result->mNumFrames = header.mNumFrames;
+	result->mNumBins = header.mNumBins;
+	result->mFrames = reinterpret_cast<const float *>( result->mFile.getData() + sizeof( SpectrogramCacheHeader ) );
+	return result;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// SpectrogramCacheWriter
+// ----------------------------------------------------------------------------------------------------
+
+SpectrogramCacheWriter::SpectrogramCacheWriter( const fs::path &path, const SpectrogramKey &key, size_t numBins )
+	: mPath( path ), mNumBins( numBins )
+{
+	mTempPath = path;
+	mTempPath += ".tmp";
+
+	// a failure here shows up as the stream failing to open below
+	std::error_code ec;
+	if( ! path.parent_path().empty() && ! fs::exists( path.parent_path(), ec ) ) {
+		fs::create_directories( path.parent_path(), ec );
+	}
+
+	mHeader.mContentHash = key.mContentHash;
+	mHeader.mSampleRate = key.mSampleRate;
+	mHeader.mFftSize = key.mFftSize;
+	mHeader.mWindowSize = key.mWindowSize;
+	mHeader.mHopSize = key.mHopSize;
+	mHeader.mNumBins = (uint32_t)numBins;
+
+	mStream.open( mTempPath.string(), ios::binary | ios::trunc );
+	if( ! mStream.is_open() ) {
+		CI_LOG_E( "failed to open spectrogram cache for writing: " << mTempPath );
+		return;
+	}
+
+	mStream.write( reinterpret_cast<const char *>( &mHeader ), sizeof( mHeader ) );
+}
+
+SpectrogramCacheWriter::~SpectrogramCacheWriter()
+{
+	if( ! mFinished && mStream.is_open() ) {
+		mStream.close();
+		std::error_code ec;
+		fs::remove( mTempPath, ec );
+	}
+}
+
+void SpectrogramCacheWriter::writeFrame( const float *magSpectrum )
+{
+	if( ! mStream.is_open() )
+		return;
+
+	mStream.write( reinterpret_cast<const char *>( magSpectrum ), mNumBins * sizeof( float ) );
+	mNumFrames += 1;
+}
+
+bool SpectrogramCacheWriter::finish()
+{
+	if( ! mStream.is_open() || mFinished )
+		return false;
+
+	mHeader.mNumFrames = (uint32_t)mNumFrames;
+	mStream.seekp( 0 );
+	mStream.write( reinterpret_cast<const char *>( &mHeader ), sizeof( mHeader ) );
+	mStream.close();
+	mFinished = true;
+
+	// this runs on the analysis thread, so filesystem errors are logged rather than thrown (ex. the old cache is still mapped)
+	std::error_code ec;
+	if( mStream.fail() || mNumFrames == 0 ) {
+		CI_LOG_E( "failed to write spectrogram cache: " << mTempPath );
+		fs::remove( mTempPath, ec );
+		return false;
+	}
+
+	// rename() won't replace an existing file on all platforms
+	if( fs::exists( mPath, ec ) ) {
+		fs::remove( mPath, ec );
+		if( ec ) {
+			CI_LOG_E( "failed to remove old spectrogram cache: " << mPath << ", error: " << ec.message() );
+			fs::remove( mTempPath, ec );
+			return false;
+		}
+	}
+
+	fs::rename( mTempPath, mPath, ec );
+	if( ec ) {
+		CI_LOG_E( "failed to rename spectrogram cache: " << mTempPath << " -> " << mPath << ", error: " << ec.message() );
+		fs::remove( mTempPath, ec );
+		return false;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Free functions
+// ----------------------------------------------------------------------------------------------------
+
+uint64_t hashFileContents( const fs::path &path, const fs::path &cacheDir )
+{
+	// runs on worker threads, so filesystem errors return 0 (no hash) rather than throwing
+	std::error_code ec;
+	if( ! fs::exists( path, ec ) )
+		return 0;
+
+	const uint64_t fileSize = (uint64_t)fs::file_size( path, ec );
+	if( ec )
+		return 0;
+
+	const int64_t modifiedTicks = toTicks( fs::last_write_time( path, ec ) );
+	if( ec )
+		return 0;
+
+	// sidecar name includes a hash of the full path so files with the same name in different folders don't collide
+	fs::path absolutePath = fs::absolute( path, ec );
+	if( ec )
+		absolutePath = path;
+
+	const string pathStr = absolutePath.string();
+	const auto sidecarPath = cacheDir / ( path.filename().string() + "_" + toHex( hashBytes( reinterpret_cast<const uint8_t *>( pathStr.data() ), pathStr.size() ) ) + ".hash" );
+
+	if( fs::exists( sidecarPath, ec ) ) {
+		ifstream sidecar( sidecarPath.string() );
+		uint64_t cachedSize = 0, cachedHash = 0;
+		int64_t cachedTicks = 0;
+		if( sidecar >> cachedSize >> cachedTicks >> hex >> cachedHash ) {
+			if( cachedSize == fileSize && cachedTicks == modifiedTicks )
+				return cachedHash;
+		}
+	}
+
+	MappedFile file;
+	if( ! file.open( path ) )
+		return 0;
+
+	const uint64_t result = hashBytes( file.getData(), file.getSize() );
+
+	// the sidecar only saves hashing next time, so it is fine if it can't be written
+	if( ! fs::exists( cacheDir, ec ) ) {
+		fs::create_directories( cacheDir, ec );
+		if( ec ) {
+			CI_LOG_W( "failed to create cache directory: " << cacheDir << ", error: " << ec.message() );
+			return result;
+		}
+	}
+
+	ofstream sidecar( sidecarPath.string(), ios::trunc );
+	sidecar << fileSize << " " << modifiedTicks << " " << toHex( result ) << endl;
+
+	return result;
+}
+
+fs::path getSpectrogramCachePath( const fs::path &cacheDir, const SpectrogramKey &key )
+{
+	return cacheDir / ( toHex( key.mContentHash ) + "_" + to_string( key.mSampleRate ) + "_" + to_string( key.mFftSize )
+		+ "_" + to_string( key.mWindowSize ) + "_" + to_string( key.mHopSize ) + ".stft" );
+}
+
+} } // namespace mason::audio
@@ -0,0 +1,131 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "cinder/Filesystem.h"
+#include "mason/Export.h"
+#include "mason/MappedFile.h"
+
+#include <fstream>
+#include <memory>
+
+namespace mason { namespace audio {
+
+using SpectrogramCacheRef = std::shared_ptr<class SpectrogramCache>;
+
+//! Parameters that a cached spectrogram was computed with. A cache file is only reused if all of these match.
+struct SpectrogramKey {
+	uint64_t	mContentHash = 0;
+	uint32_t	mSampleRate = 0;
+	uint32_t	mFftSize = 0;
+	uint32_t	mWindowSize = 0;
+	uint32_t	mHopSize = 0;
+
+	bool operator==( const SpectrogramKey &other ) const;
+	bool operator!=( const SpectrogramKey &other ) const	{ return ! ( *this == other ); }
+};
+
+//! \brief Binary layout of a spectrogram cache file, all values little-endian.
+//!
+//! The 64 byte header is followed by numFrames * numBins float32 linear magnitudes, frame-major.
+struct SpectrogramCacheHeader {
+	static const uint32_t MAGIC = 0x5446534d; // "MSFT"
+	static const uint32_t VERSION = 1;
+
+	uint32_t	mMagic = MAGIC;
+	uint32_t	mVersion = VERSION;
+	uint64_t	mContentHash = 0;
+	uint32_t	mSampleRate = 0;
+	uint32_t	mFftSize = 0;
+	uint32_t	mWindowSize = 0;
+	uint32_t	mHopSize = 0;
+	uint32_t	mNumFrames = 0;
+	uint32_t	mNumBins = 0;
+	uint32_t	mReserved[6] = {};
+};
+
+static_assert( sizeof( SpectrogramCacheHeader ) == 64, "SpectrogramCacheHeader must stay 64 bytes so frame data is aligned" );
+
+//! \brief Read-only, memory mapped view of a spectrogram cache file.
+//!
+//! Opening only validates the header, frame data is paged in from disk as it is accessed.
+class MA_API SpectrogramCache {
+  public:
+	//! Returns a mapped cache if \a path exists and was written with \a key, otherwise nullptr.
+	static SpectrogramCacheRef open( const ci::fs::path &path, const SpectrogramKey &key );
+
+	size_t	getNumFrames() const	{ return mNumFrames; }
+	size_t	getNumBins() const		{ return mNumBins; }
+	//! Returns the parameters this cache was computed with.
+	const SpectrogramKey&	getKey() const	{ return mKey; }
+
+	//! Returns a pointer to getNumBins() linear magnitudes for \a frame.
+	const float*	getFrame( size_t frame ) const	{ return mFrames + frame * mNumBins; }
+	//! Returns the linear magnitude at \a frame and \a bin.
+	float			getValue( size_t frame, size_t bin ) const	{ return mFrames[frame * mNumBins + bin]; }
+
+	const ci::fs::path&	getFilePath() const	{ return mFilePath; }
+
+  private:
+	SpectrogramCache() = default;
+
+	MappedFile		mFile;
+	ci::fs::path	mFilePath;
+	SpectrogramKey	mKey;
+	const float*	mFrames = nullptr;
+	size_t			mNumFrames = 0;
+	size_t			mNumBins = 0;
+};
+
+//! \brief Streams spectrogram frames to a cache file.
+//!
+//! Frames are written to a temporary file that is moved into place by finish(), so a partially written cache is never picked up by SpectrogramCache::open().
+class MA_API SpectrogramCacheWriter {
+  public:
+	SpectrogramCacheWriter( const ci::fs::path &path, const SpectrogramKey &key, size_t numBins );
+	~SpectrogramCacheWriter();
+
+	bool	isOpen() const	{ return mStream.is_open(); }
+
+	//! Appends one frame of getNumBins() linear magnitudes.
+	void	writeFrame( const float *magSpectrum );
+	//! Patches the header with the final frame count and moves the file into place. Returns false on failure.
+	bool	finish();
+
+	size_t	getNumFrames() const	{ return mNumFrames; }
+	size_t	getNumBins() const		{ return mNumBins; }
+
+  private:
+	ci::fs::path	mPath, mTempPath;
+	std::ofstream	mStream;
+	SpectrogramCacheHeader	mHeader;
+	size_t			mNumFrames = 0;
+	size_t			mNumBins = 0;
+	bool			mFinished = false;
+};
+
+//! Returns a 64-bit hash of the contents of \a path, or 0 if it can't be read.
+//! The result is remembered in a sidecar file within \a cacheDir keyed by file size and modification time, so unchanged files are only hashed once.
+MA_API uint64_t	hashFileContents( const ci::fs::path &path, const ci::fs::path &cacheDir );
+//! Returns the path within \a cacheDir where a spectrogram for \a key is stored.
+MA_API ci::fs::path	getSpectrogramCachePath( const ci::fs::path &cacheDir, const SpectrogramKey &key );
+
+} } // namespace mason::audio
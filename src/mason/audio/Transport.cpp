@@ -0,0 +1,285 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mason/audio/Transport.h"
+
+#include "cinder/audio/Context.h"
+#include "cinder/CinderAssert.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace ci;
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+int64_t hostNanos()
+{
+	return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Transport positions don't wrap, looping players need to be moved into their loop
+size_t toReadFrame( const ci::audio::SamplePlayerNodeRef &player, double seconds )
+{
+	size_t frame = size_t( seconds * player->getSampleRate() );
+	const size_t loopBegin = player->getLoopBegin();
+	const size_t loopEnd = player->getLoopEnd();
+	if( player->isLoopEnabled() && frame >= loopEnd && loopEnd > loopBegin )
+		frame = loopBegin + ( frame - loopBegin ) % ( loopEnd - loopBegin );
+
+	return frame;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// AudioClock
+// ----------------------------------------------------------------------------------------------------
+
+void AudioClock::setFormat( size_t sampleRate, size_t framesPerBlock )
+{
+	mSampleRate = sampleRate;
+	mFramesPerBlock = framesPerBlock;
+}
+
+void AudioClock::publish( uint64_t processedFrame )
+{
+	const int64_t nanos = hostNanos();
+
+	mSequence.fetch_add( 1, memory_order_acq_rel );
+	mProcessedFrame.store( processedFrame, memory_order_relaxed );
+	mHostNanos.store( nanos, memory_order_relaxed );
+	mSequence.fetch_add( 1, memory_order_release );
+}
+
+void AudioClock::read( uint64_t *processedFrame, int64_t *nanos ) const
+{
+	uint32_t sequence;
+	do {
+		sequence = mSequence.load( memory_order_acquire );
+		*processedFrame = mProcessedFrame.load( memory_order_relaxed );
+		*nanos = mHostNanos.load( memory_order_relaxed );
+		atomic_thread_fence( memory_order_acquire );
+	} while( ( sequence & 1 ) || sequence != mSequence.load( memory_order_relaxed ) );
+}
+
+uint64_t AudioClock::getProcessedFrame() const
+{
+	return mProcessedFrame.load( memory_order_acquire );
+}
+
+uint64_t AudioClock::getFrame() const
+{
+	uint64_t processedFrame;
+	int64_t nanos;
+	read( &processedFrame, &nanos );
+
+	if( processedFrame == 0 )
+		return 0;
+
+	// interpolate up to the end of the next block, which hasn't been rendered yet
+	const double sampleRate = double( mSampleRate );
+	const double elapsedFrames = max( 0.0, double( hostNanos() - nanos ) * sampleRate * 1e-9 );
+	double frame = double( processedFrame ) + min( elapsedFrames, double( mFramesPerBlock ) );
+	frame = max( 0.0, frame - mLatencySeconds * sampleRate );
+
+	uint64_t result = max( (uint64_t)frame, mLastFrame.load( memory_order_relaxed ) );
+	mLastFrame.store( result, memory_order_relaxed );
+	return result;
+}
+
+double AudioClock::getSeconds() const
+{
+	return double( getFrame() ) / double( mSampleRate );
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Transport::ClockNode
+// ----------------------------------------------------------------------------------------------------
+
+//! Auto-pulled after every block, publishes the frame the block ended on.
+class Transport::ClockNode : public ci::audio::NodeAutoPullable {
+  public:
+	ClockNode( AudioClock *clock )
+		: NodeAutoPullable( Format() ), mClock( clock )
+	{
+		setName( "Transport clock" );
+	}
+
+  protected:
+	void initialize() override
+	{
+		mClock->setFormat( getSampleRate(), getFramesPerBlock() );
+	}
+
+	void process( ci::audio::Buffer *buffer ) override
+	{
+		// auto-pulled nodes are processed before the Context counts the block as processed
+		mClock->publish( getContext()->getNumProcessedFrames() + buffer->getNumFrames() );
+	}
+
+  private:
+	AudioClock*	mClock;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Transport
+// ----------------------------------------------------------------------------------------------------
+
+Transport::Transport( const ci::audio::NodeRef &clockSource )
+{
+	CI_ASSERT( clockSource );
+
+	auto ctx = clockSource->getContext();
+	mClock.setFormat( ctx->getSampleRate(), ctx->getFramesPerBlock() );
+	mClockNode = ctx->makeNode( new ClockNode( &mClock ) );
+	clockSource >> mClockNode;
+}
+
+Transport::~Transport()
+{
+	mClockNode->disconnectAll();
+}
+
+void Transport::setPlayers( const vector<ci::audio::SamplePlayerNodeRef> &players )
+{
+	mPlayers = players;
+	for( const auto &player : mPlayers )
+		syncPlayer( player );
+}
+
+void Transport::syncPlayer( const ci::audio::SamplePlayerNodeRef &player )
+{
+	if( ! isRunning() && ! isStopPending() ) {
+		player->seek( toReadFrame( player, getPosition() ) );
+		return;
+	}
+
+	const uint64_t eventFrame = max( nextEventFrame( 0 ), mAnchorFrame );
+	const double when = frameToTime( eventFrame );
+	const size_t readFrame = toReadFrame( player, getPositionAt( eventFrame ) );
+
+	mClockNode->getContext()->schedule( when, player, true, [player, readFrame] { player->seek( readFrame ); } );
+	if( isRunning() )
+		player->enable( when );
+}
+
+uint64_t Transport::nextEventFrame( double delaySeconds ) const
+{
+	auto ctx = mClockNode->getContext();
+	const uint64_t framesPerBlock = ctx->getFramesPerBlock();
+	const uint64_t earliest = ctx->getNumProcessedFrames() + uint64_t( std::ceil( ( mScheduleAheadSeconds + max( delaySeconds, 0.0 ) ) * ctx->getSampleRate() ) );
+
+	// on a block boundary, so that seeks happen on the event frame rather than the start of the block containing it
+	return ( ( earliest + framesPerBlock - 1 ) / framesPerBlock ) * framesPerBlock;
+}
+
+bool Transport::isStopPending() const
+{
+	return ! isRunning() && mEndFrame > mClockNode->getContext()->getNumProcessedFrames();
+}
+
+double Transport::frameToTime( uint64_t frame ) const
+{
+	return double( frame ) / double( mClockNode->getContext()->getSampleRate() );
+}
+
+double Transport::getPositionAt( uint64_t frame ) const
+{
+	const uint64_t clamped = min( max( frame, mAnchorFrame ), mEndFrame );
+	return mAnchorPosition + frameToTime( clamped - mAnchorFrame );
+}
+
+double Transport::getPosition() const
+{
+	return getPositionAt( mClock.getFrame() );
+}
+
+double Transport::start( double delaySeconds )
+{
+	if( isRunning() )
+		return frameToTime( mAnchorFrame );
+
+	// let a pending stop finish first, enabling before it would have the stop silence the players again
+	const uint64_t eventFrame = max( nextEventFrame( delaySeconds ), isStopPending() ? mEndFrame : mAnchorFrame );
+	const double when = frameToTime( eventFrame );
+
+	mAnchorPosition = getPositionAt( eventFrame );
+	mAnchorFrame = eventFrame;
+	mEndFrame = numeric_limits<uint64_t>::max();
+
+	for( const auto &player : mPlayers )
+		player->enable( when );
+
+	return when;
+}
+
+double Transport::stop( double delaySeconds )
+{
+	if( ! isRunning() )
+		return frameToTime( mEndFrame );
+
+	const uint64_t eventFrame = max( nextEventFrame( delaySeconds ), mAnchorFrame );
+	const double when = frameToTime( eventFrame );
+
+	mEndFrame = eventFrame;
+
+	for( const auto &player : mPlayers )
+		player->disable( when );
+
+	return when;
+}
+
+double Transport::seek( double positionSeconds )
+{
+	positionSeconds = max( positionSeconds, 0.0 );
+
+	auto ctx = mClockNode->getContext();
+	if( ! isRunning() && ! isStopPending() ) {
+		for( const auto &player : mPlayers )
+			player->seek( toReadFrame( player, positionSeconds ) );
+
+		mAnchorPosition = positionSeconds;
+		mAnchorFrame = mEndFrame = ctx->getNumProcessedFrames();
+		return ctx->getNumProcessedSeconds();
+	}
+
+	// all players jump on the same frame. The functions are called on the audio thread, before the block that starts at eventFrame is processed
+	const uint64_t eventFrame = max( nextEventFrame( 0 ), mAnchorFrame );
+	const double when = frameToTime( eventFrame );
+	for( const auto &player : mPlayers ) {
+		const size_t readFrame = toReadFrame( player, positionSeconds );
+		ctx->schedule( when, player, true, [player, readFrame] { player->seek( readFrame ); } );
+	}
+
+	// a pending stop that comes first leaves the players parked at positionSeconds after the jump
+	mAnchorPosition = positionSeconds;
+	mAnchorFrame = eventFrame;
+	mEndFrame = max( mEndFrame, eventFrame );
+
+	return when;
+}
+
+} } // namespace mason::audio
@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "mason/Export.h"
+
+#include "cinder/Cinder.h"
+#include "cinder/audio/Node.h"
+#include "cinder/audio/SamplePlayerNode.h"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace mason { namespace audio {
+
+using TransportRef = std::shared_ptr<class Transport>;
+
+//! \brief Monotonic audio clock, published from the audio thread once per processed block.
+//!
+//! getFrame() interpolates between blocks using the host clock, so visuals polled at any rate see a smoothly increasing position.
+//! It never runs past the block that will be rendered next and never goes backwards. Subtracting setLatencySeconds() gives the frame
+//! that is audible now rather than the one being rendered.
+class MA_API AudioClock {
+  public:
+	//! Returns the interpolated, latency compensated frame that is audible now. Should be called from a single (usually the main) thread.
+	uint64_t	getFrame() const;
+	//! Returns getFrame() in seconds.
+	double		getSeconds() const;
+	//! Returns the context frame at the end of the most recently processed block, without interpolation or latency compensation.
+	uint64_t	getProcessedFrame() const;
+
+	//! Sets how far behind rendering the audible output is, for example the output device's buffer. Defaults to 0.
+	void		setLatencySeconds( double seconds )	{ mLatencySeconds = seconds; }
+	double		getLatencySeconds() const			{ return mLatencySeconds; }
+
+	size_t		getSampleRate() const				{ return mSampleRate; }
+
+  private:
+	void	setFormat( size_t sampleRate, size_t framesPerBlock );
+	void	publish( uint64_t processedFrame ); // audio thread
+	void	read( uint64_t *processedFrame, int64_t *hostNanos ) const;
+
+	// seqlock so that the frame and its host time are always read as a pair
+	std::atomic<uint32_t>	mSequence = { 0 };
+	std::atomic<uint64_t>	mProcessedFrame = { 0 };
+	std::atomic<int64_t>	mHostNanos = { 0 };
+
+	std::atomic<size_t>		mSampleRate = { 44100 };
+	std::atomic<size_t>		mFramesPerBlock = { 512 };
+	std::atomic<double>		mLatencySeconds = { 0 };
+	mutable std::atomic<uint64_t>	mLastFrame = { 0 }; // keeps getFrame() monotonic
+
+	friend class Transport;
+};
+
+//! \brief Starts, stops and seeks a group of SamplePlayerNodes together on exact sample frames.
+//!
+//! Every event is scheduled on the Context for one frame shared by all players, on the first block boundary at least
+//! getScheduleAheadSeconds() in the future. Starts and stops use the Context's sample accurate enable / disable scheduling. Seeks
+//! while running are applied on the audio thread right before the block that begins on the event frame, so all players jump in the
+//! same block and can't drift apart. While stopped, seeks are applied right away.
+//!
+//! Also provides the AudioClock that the schedule is based on, and the timeline position interpolated with it, for syncing visuals.
+class MA_API Transport {
+  public:
+	//! Creates a Transport whose clock is driven by \a clockSource, which must be pulled every block (for example the master gain).
+	Transport( const ci::audio::NodeRef &clockSource );
+	~Transport();
+
+	//! Sets the players that are controlled by this Transport. Each is synced with syncPlayer().
+	void	setPlayers( const std::vector<ci::audio::SamplePlayerNodeRef> &players );
+	//! Moves \a player to the current position and starts it if running, for example after its Buffer or SourceFile was replaced.
+	void	syncPlayer( const ci::audio::SamplePlayerNodeRef &player );
+	const std::vector<ci::audio::SamplePlayerNodeRef>&	getPlayers() const	{ return mPlayers; }
+
+	//! Starts all players from the current position, at least \a delaySeconds from now and not before a pending stop. Returns the context time (seconds) it happens at.
+	double	start( double delaySeconds = 0 );
+	//! Stops all players at least \a delaySeconds from now, keeping their position. Returns the context time (seconds) it happens at.
+	double	stop( double delaySeconds = 0 );
+	//! Moves all players to \a positionSeconds, wrapped into the loop of players that have looping enabled. Returns the context time (seconds)
+	//! it happens at, which is now if stopped and no stop is pending.
+	double	seek( double positionSeconds );
+
+	//! Returns true if the players have been started and no stop has been scheduled since.
+	bool	isRunning() const	{ return mEndFrame == std::numeric_limits<uint64_t>::max(); }
+	//! Returns the timeline position in seconds that is audible now, interpolated with the clock. Doesn't wrap when players loop.
+	double	getPosition() const;
+
+	//! Sets the minimum time between scheduling an event and it happening. Must cover the time until the audio thread picks it up. Defaults to 0.02.
+	void	setScheduleAheadSeconds( double seconds )	{ mScheduleAheadSeconds = seconds; }
+	double	getScheduleAheadSeconds() const				{ return mScheduleAheadSeconds; }
+
+	const AudioClock&	getClock() const	{ return mClock; }
+	AudioClock&			getClock()			{ return mClock; }
+
+  private:
+	class ClockNode;
+
+	uint64_t	nextEventFrame( double delaySeconds ) const;
+	bool		isStopPending() const;
+	double		frameToTime( uint64_t frame ) const;
+	double		getPositionAt( uint64_t frame ) const;
+
+	AudioClock							mClock;
+	std::shared_ptr<ClockNode>			mClockNode;
+	std::vector<ci::audio::SamplePlayerNodeRef>	mPlayers;
+	double		mScheduleAheadSeconds = 0.02;
+
+	// the position is mAnchorPosition at mAnchorFrame, advancing in realtime until mEndFrame
+	double		mAnchorPosition = 0;
+	uint64_t	mAnchorFrame = 0;
+	uint64_t	mEndFrame = 0;
+};
+
+} } // namespace mason::audio
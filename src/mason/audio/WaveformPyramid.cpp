@@ -0,0 +1,241 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mason/audio/WaveformPyramid.h"
+#include "mason/audio/Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+namespace mason { namespace audio {
+
+namespace {
+
+// Computes min, max and sum of squares for one block, four samples at a time with simd::float4.
+void summarizeBlock( const float *samples, size_t numSamples, float *resultMin, float *resultMax, float *resultSumSquares )
+{
+	if( numSamples == 0 ) {
+		*resultMin = *resultMax = *resultSumSquares = 0;
+		return;
+	}
+
+	float minValue = FLT_MAX;
+	float maxValue = -FLT_MAX;
+	float sumSquares = 0;
+	size_t i = 0;
+
+	if( numSamples >= simd::LANES ) {
+		simd::float4 vmin( FLT_MAX );
+		simd::float4 vmax( -FLT_MAX );
+		simd::float4 vsum = simd::float4::zero();
+		for( ; i + simd::LANES <= numSamples; i += simd::LANES ) {
+			simd::float4 x = simd::float4::load( samples + i );
+			vmin = simd::min( vmin, x );
+			vmax = simd::max( vmax, x );
+			vsum = vsum + x * x;
+		}
+
+		float lanesMin[simd::LANES], lanesMax[simd::LANES], lanesSum[simd::LANES];
+		vmin.store( lanesMin );
+		vmax.store( lanesMax );
+		vsum.store( lanesSum );
+		for( size_t lane = 0; lane < simd::LANES; lane++ ) {
+			minValue = std::min( minValue, lanesMin[lane] );
+			maxValue = std::max( maxValue, lanesMax[lane] );
+			sumSquares += lanesSum[lane];
+		}
+	}
+
+	for( ; i < numSamples; i++ ) {
+		float x = samples[i];
+		minValue = std::min( minValue, x );
+		maxValue = std::max( maxValue, x );
+		sumSquares += x * x;
+	}
+
+	*resultMin = minValue;
+	*resultMax = maxValue;
+	*resultSumSquares = sumSquares;
+}
+
+// Number of samples covered by entry \a index when each entry has \a samplesPerEntry samples, the last entry may be partial.
+inline size_t entrySampleCount( size_t index, size_t samplesPerEntry, size_t numSamples )
+{
+	return std::min( samplesPerEntry, numSamples - index * samplesPerEntry );
+}
+
+} // anonymous namespace
+
+// static
+WaveformPyramidRef WaveformPyramid::create( const float *samples, size_t numSamples, size_t baseSamplesPerEntry, size_t numThreads )
+{
+	auto result = WaveformPyramidRef( new WaveformPyramid );
+	result->mSamples = samples;
+	result->mNumSamples = numSamples;
+	result->mBaseSamplesPerEntry = std::max<size_t>( 1, baseSamplesPerEntry );
+
+	if( ! samples || numSamples == 0 )
+		return result;
+
+	const size_t base = result->mBaseSamplesPerEntry;
+
+	// level 0 is the only level that touches every sample, split it across threads
+	Level level0;
+	level0.mSamplesPerEntry = base;
+	const size_t numEntries = ( numSamples + base - 1 ) / base;
+	level0.mMin.resize( numEntries );
+	level0.mMax.resize( numEntries );
+	level0.mRms.resize( numEntries );
+
+	auto computeEntries = [&]( size_t beginEntry, size_t endEntry ) {
+		for( size_t i = beginEntry; i < endEntry; i++ ) {
+			const size_t count = entrySampleCount( i, base, numSamples );
+			float sumSquares;
+			summarizeBlock( samples + i * base, count, &level0.mMin[i], &level0.mMax[i], &sumSquares );
+			level0.mRms[i] = sqrtf( sumSquares / (float)count );
+		}
+	};
+
+	if( numThreads == 0 )
+		numThreads = std::max<size_t>( 1, thread::hardware_concurrency() );
+
+	// not worth spinning up threads for short buffers
+	const size_t minEntriesPerThread = 4096;
+	numThreads = std::min( numThreads, std::max<size_t>( 1, numEntries / minEntriesPerThread ) );
+
+	if( numThreads <= 1 ) {
+		computeEntries( 0, numEntries );
+	}
+	else {
+		vector<thread> threads;
+		const size_t entriesPerThread = ( numEntries + numThreads - 1 ) / numThreads;
+		for( size_t t = 0; t < numThreads; t++ ) {
+			size_t beginEntry = t * entriesPerThread;
+			size_t endEntry = std::min( numEntries, beginEntry + entriesPerThread );
+			if( beginEntry < endEntry )
+				threads.emplace_back( computeEntries, beginEntry, endEntry );
+		}
+		for( auto &t : threads )
+			t.join();
+	}
+
+	result->mLevels.push_back( move( level0 ) );
+
+	// each following level reduces pairs of entries from the previous one
+	while( result->mLevels.back().getNumEntries() > 1 ) {
+		const Level &child = result->mLevels.back();
+		const size_t childEntries = child.getNumEntries();
+
+		Level parent;
+		parent.mSamplesPerEntry = child.mSamplesPerEntry * 2;
+		const size_t parentEntries = ( childEntries + 1 ) / 2;
+		parent.mMin.resize( parentEntries );
+		parent.mMax.resize( parentEntries );
+		parent.mRms.resize( parentEntries );
+
+		for( size_t i = 0; i < parentEntries; i++ ) {
+			const size_t a = i * 2;
+			const size_t b = std::min( a + 1, childEntries - 1 );
+			parent.mMin[i] = std::min( child.mMin[a], child.mMin[b] );
+			parent.mMax[i] = std::max( child.mMax[a], child.mMax[b] );
+
+			if( a == b ) {
+				parent.mRms[i] = child.mRms[a];
+			}
+			else {
+				const float countA = (float)entrySampleCount( a, child.mSamplesPerEntry, numSamples );
+				const float countB = (float)entrySampleCount( b, child.mSamplesPerEntry, numSamples );
+				const float sumSquares = child.mRms[a] * child.mRms[a] * countA + child.mRms[b] * child.mRms[b] * countB;
+				parent.mRms[i] = sqrtf( sumSquares / ( countA + countB ) );
+			}
+		}
+
+		result->mLevels.push_back( move( parent ) );
+	}
+
+	return result;
+}
+
+int WaveformPyramid::getLevelForSamplesPerPixel( double samplesPerPixel ) const
+{
+	if( mLevels.empty() || samplesPerPixel < (double)mBaseSamplesPerEntry )
+		return -1;
+
+	int level = (int)floor( log2( samplesPerPixel / (double)mBaseSamplesPerEntry ) );
+	return std::min( level, (int)mLevels.size() - 1 );
+}
+
+WaveformSummary WaveformPyramid::getSummary( size_t beginSample, size_t endSample ) const
+{
+	// aim for at least two entries across the range so its edges are resolved
+	return getSummary( beginSample, endSample, getLevelForSamplesPerPixel( double( endSample - std::min( beginSample, endSample ) ) / 2.0 ) );
+}
+
+WaveformSummary WaveformPyramid::getSummary( size_t beginSample, size_t endSample, int level ) const
+{
+	WaveformSummary result;
+	endSample = std::min( endSample, mNumSamples );
+	if( beginSample >= endSample )
+		return result;
+
+	if( level < 0 || mLevels.empty() ) {
+		float sumSquares;
+		const size_t count = endSample - beginSample;
+		summarizeBlock( mSamples + beginSample, count, &result.mMin, &result.mMax, &sumSquares );
+		result.mRms = sqrtf( sumSquares / (float)count );
+		return result;
+	}
+
+	const Level &lvl = mLevels[std::min<size_t>( level, mLevels.size() - 1 )];
+	const size_t samplesPerEntry = lvl.mSamplesPerEntry;
+	const size_t beginEntry = beginSample / samplesPerEntry;
+	const size_t endEntry = std::min( lvl.getNumEntries(), ( endSample + samplesPerEntry - 1 ) / samplesPerEntry );
+
+	result.mMin = FLT_MAX;
+	result.mMax = -FLT_MAX;
+	float sumSquares = 0;
+	float totalCount = 0;
+	for( size_t i = beginEntry; i < endEntry; i++ ) {
+		result.mMin = std::min( result.mMin, lvl.mMin[i] );
+		result.mMax = std::max( result.mMax, lvl.mMax[i] );
+
+		const float count = (float)entrySampleCount( i, samplesPerEntry, mNumSamples );
+		sumSquares += lvl.mRms[i] * lvl.mRms[i] * count;
+		totalCount += count;
+	}
+
+	result.mRms = totalCount > 0 ? sqrtf( sumSquares / totalCount ) : 0;
+	return result;
+}
+
+size_t WaveformPyramid::getMemoryBytes() const
+{
+	size_t result = 0;
+	for( const auto &level : mLevels )
+		result += level.getNumEntries() * 3 * sizeof( float );
+
+	return result;
+}
+
+} } // namespace mason::audio
@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "mason/Export.h"
+
+#include <memory>
+#include <vector>
+
+namespace mason { namespace audio {
+
+using WaveformPyramidRef = std::shared_ptr<class WaveformPyramid>;
+
+//! Min, max and RMS of a range of samples.
+struct WaveformSummary {
+	float	mMin = 0;
+	float	mMax = 0;
+	float	mRms = 0;
+};
+
+//! \brief Min / max / RMS mipmap of one channel of audio.
+//!
+//! Level 0 summarizes blocks of getBaseSamplesPerEntry() samples, each following level halves the number of entries.
+//! Drawing code picks the level that matches its pixels-per-sample with getLevelForSamplesPerPixel(), so the work per frame
+//! depends on the number of pixels rather than the length of the audio.
+class MA_API WaveformPyramid {
+  public:
+	struct Level {
+		size_t				mSamplesPerEntry = 0;
+		std::vector<float>	mMin, mMax, mRms;
+
+		size_t	getNumEntries() const	{ return mMin.size(); }
+	};
+
+	//! Builds the pyramid for \a numSamples of \a samples, splitting level 0 across \a numThreads (0 uses the hardware concurrency).
+	//! \a samples is not copied, it must outlive the pyramid for calls to getSummary() that fall below level 0.
+	static WaveformPyramidRef create( const float *samples, size_t numSamples, size_t baseSamplesPerEntry = 64, size_t numThreads = 0 );
+
+	size_t			getNumSamples() const			{ return mNumSamples; }
+	size_t			getBaseSamplesPerEntry() const	{ return mBaseSamplesPerEntry; }
+	size_t			getNumLevels() const			{ return mLevels.size(); }
+	const Level&	getLevel( size_t level ) const	{ return mLevels.at( level ); }
+
+	//! Returns the coarsest level whose entries are no larger than \a samplesPerPixel, or -1 if the raw samples should be used.
+	int	getLevelForSamplesPerPixel( double samplesPerPixel ) const;
+	//! Returns the summary of samples [\a beginSample, \a endSample), reading from the coarsest level that still resolves the range.
+	WaveformSummary	getSummary( size_t beginSample, size_t endSample ) const;
+	//! Returns the summary of samples [\a beginSample, \a endSample) using \a level, or the raw samples if \a level is negative.
+	WaveformSummary	getSummary( size_t beginSample, size_t endSample, int level ) const;
+
+	//! Returns the total memory used by all levels, in bytes.
+	size_t	getMemoryBytes() const;
+
+  private:
+	WaveformPyramid() = default;
+
+	const float*		mSamples = nullptr;
+	size_t				mNumSamples = 0;
+	size_t				mBaseSamplesPerEntry = 0;
+	std::vector<Level>	mLevels;
+};
+
+} } // namespace mason::audio
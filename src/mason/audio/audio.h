@@ -23,7 +23,14 @@
 
 #include "mason/audio/CompressorNode.h"
 #include "mason/audio/Effects.h"
+#include "mason/audio/FeatureExtractor.h"
 #include "mason/audio/Gens.h"
+#include "mason/audio/MultichannelSpectralNode.h"
 #include "mason/audio/AudioAnalyzer.h"
+#include "mason/audio/AudioFileLoader.h"
+#include "mason/audio/BatchAnalysis.h"
 #include "mason/audio/OfflineContext.h"
 #include "mason/audio/ProfilerNode.h"
+#include "mason/audio/SpectrogramCache.h"
+#include "mason/audio/Transport.h"
+#include "mason/audio/WaveformPyramid.h"
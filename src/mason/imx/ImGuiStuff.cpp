@@ -24,6 +24,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mason/Notifications.h"
 #include "mason/glutils.h"
 #include "mason/Profiling.h"
+#include "mason/audio/ProfilerNode.h"
 
 #include "cinder/audio/Context.h"
 
@@ -759,6 +760,43 @@ void Profiling( bool *open )
 		}
 	}
 
+	Columns( 1 );
+	auto audioProfiler = ma::audio::graphProfiler();
+	if( audioProfiler && audioProfiler->isInstrumented() && CollapsingHeader( "audio graph (ms)", nullptr, ImGuiTreeNodeFlags_DefaultOpen ) ) {
+		auto stats = audioProfiler->getStats();
+		Text( "block: %6.3f p50, %6.3f p99, %6.3f max, deadline: %6.3f", (float)stats.mGraph.mP50Ms, (float)stats.mGraph.mP99Ms, (float)stats.mGraph.mMaxMs, (float)stats.mDeadlineMs );
+		Text( "deadline misses: %d / %d blocks", (int)stats.mNumDeadlineMisses, (int)stats.mGraph.mNumBlocks );
+		if( Button( "reset##audio graph" ) ) {
+			audioProfiler->reset();
+		}
+		SameLine();
+		if( Button( "write csv" ) ) {
+			audioProfiler->writeCsv( "audio_graph_profile.csv" );
+		}
+		SameLine();
+		if( Button( "write trace" ) ) {
+			audioProfiler->writeChromeTrace( "audio_graph_trace.json" );
+		}
+
+		if( sortTimes ) {
+			stable_sort( stats.mNodes.begin(), stats.mNodes.end(), [] ( const auto &a, const auto &b ) { return a.mP99Ms > b.mP99Ms; } );
+		}
+
+		Columns( 4, "audio graph columns", true );
+		Text( "node" );			NextColumn();
+		Text( "p50" );			NextColumn();
+		Text( "p99" );			NextColumn();
+		Text( "max" );			NextColumn();
+		Separator();
+		for( const auto &node : stats.mNodes ) {
+			Text( "%s", node.mName.c_str() );	NextColumn();
+			Text( "%6.3f", (float)node.mP50Ms );	NextColumn();
+			Text( "%6.3f", (float)node.mP99Ms );	NextColumn();
+			Text( "%6.3f", (float)node.mMaxMs );	NextColumn();
+		}
+		Columns( 1 );
+	}
+
 	EndChild();
 
 	End(); // "Profiling"
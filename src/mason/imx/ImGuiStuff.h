@@ -69,7 +69,7 @@ void HoverTooltip(const char* tip, float delay = 1.0f);
 
 //! Shows the ci::logs output in a new Window.
 void Logs( const char* label, bool* open = nullptr );
-//! Shows profiling information using Cinder-Profiler
+//! Shows profiling information using Cinder-Profiler, plus per-Node audio timings when a GraphProfiler is set with ma::audio::setGraphProfilerInstance()
 void Profiling( bool *open = nullptr );
 
 } // namespace imx
@@ -1,5 +1,6 @@
 #include "mason/imx/ImGuiTexture.h"
 #include "mason/Assets.h"
+#include "mason/PixelReadback.h"
 #include "mason/glutils.h"
 
 #include "cinder/gl/gl.h"
@@ -39,6 +40,7 @@ public:
 
 private:
 	void viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &texture );
+	void updateDebugPixel( const gl::TextureBaseRef &texture );
 
 	void renderColor( const gl::Texture2dRef &texture, const Rectf &destRect );
 	void renderDepth( const gl::Texture2dRef &texture, const Rectf &destRect );
@@ -57,6 +59,8 @@ private:
 	vec4		mDebugPixel;
 	ivec3		mDebugPixelCoord;
 	bool        mDebugPixelNeedsUpdate = false;
+	ma::PixelReadback	mDebugPixelReadback;
+	weak_ptr<gl::TextureBase>	mDebugPixelTexture; // texture of the requests in flight, weak so the viewer doesn't keep it alive
 
 	TextureViewerOptions mOptions;
 };
@@ -194,6 +198,8 @@ void TextureViewer::viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &tex )
 		}
 	}
 
+	updateDebugPixel( tex );
+
 	if( mOptions.mExtendedUI ) {
 
 		//Checkbox( "debug pixel", &options.mDebugPixelEnabled );
@@ -215,6 +221,8 @@ void TextureViewer::viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &tex )
 		}
 		DragFloat4( "pixel", &mDebugPixel );
 
+		const auto &stats = mDebugPixelReadback.getStats();
+		Text( "readback latency: %d frames (%0.2f ms), stall: %0.3f ms", stats.mLatencyFrames, stats.mLatencySeconds * 1000.0, stats.mStallSeconds * 1000.0 );
 	}
 
 	// show texture that we've rendered to
@@ -235,7 +243,7 @@ void TextureViewer::viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &tex )
 		const float tiles = (float)mNumTiles;
 		vec2 mouseNorm = ( vec2( GetMousePos() ) - vec2( GetItemRectMin() ) ) / vec2( GetItemRectSize() );
 		vec3 pixelCoord;
-		if( mTiledAtlasMode ) {
+		if( mType == Type::Texture3d && mTiledAtlasMode ) {
 			pixelCoord.x = fmodf( mouseNorm.x * (float)tex->getWidth() * tiles, (float)tex->getWidth() );
 			pixelCoord.y = fmodf( mouseNorm.y * (float)tex->getHeight() * tiles, (float)tex->getHeight() );
 
@@ -243,11 +251,17 @@ void TextureViewer::viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &tex )
 			pixelCoord.z = cellId.y * tiles + cellId.x;
 
 		}
-		else {
+		else if( mType == Type::Texture3d ) {
 			pixelCoord.x = lround( mouseNorm.x * (float)tex->getWidth() );
 			pixelCoord.y = lround( mouseNorm.y * (float)tex->getHeight() );
 			pixelCoord.z = mFocusedLayer;
 		}
+		else {
+			// the image is displayed top-down, textures have their origin at the bottom left
+			pixelCoord.x = floorf( mouseNorm.x * (float)tex->getWidth() );
+			pixelCoord.y = floorf( ( 1 - mouseNorm.y ) * (float)tex->getHeight() );
+			pixelCoord.z = 0;
+		}
 		mDebugPixelCoord = glm::clamp( ivec3( pixelCoord ), ivec3( 0 ), ivec3( tex->getWidth(), tex->getHeight(), tex->getDepth() ) - ivec3( 1 ) );
 	}
 
@@ -297,6 +311,31 @@ void TextureViewer::viewImpl( gl::FboRef &fbo, const gl::TextureBaseRef &tex )
 	}
 }
 
+void TextureViewer::updateDebugPixel( const gl::TextureBaseRef &texture )
+{
+	// depth textures can't be read back as RGBA
+	if( mType == Type::TextureDepth ) {
+		return;
+	}
+
+	// results from the previous texture would be shown as if they were read from this one
+	if( mDebugPixelTexture.lock() != texture ) {
+		mDebugPixelReadback.clear();
+		mDebugPixelTexture = texture;
+		mDebugPixel = vec4( 0 );
+		mDebugPixelNeedsUpdate = true;
+	}
+
+	// results arrive a frame or two after they are requested, reading back synchronously would stall until the GPU catches up
+	if( mDebugPixelReadback.update() && mDebugPixelReadback.getResult().mCoord == mDebugPixelCoord ) {
+		mDebugPixel = mDebugPixelReadback.getPixel();
+	}
+
+	if( mDebugPixelNeedsUpdate && mDebugPixelReadback.request( texture, mDebugPixelCoord ) ) {
+		mDebugPixelNeedsUpdate = false;
+	}
+}
+
 void TextureViewer::renderColor( const gl::Texture2dRef &texture, const Rectf &destRect )
 {
 	if( ! texture ) {
@@ -435,48 +474,6 @@ void TextureViewer::render3d( const gl::Texture3dRef &texture, const Rectf &dest
 		}
 	}
 
-	// TODO: not yet sure if this should live here or in viewImpl(), but I need it first for debugging texture3ds
-	if( mDebugPixelNeedsUpdate == true ) {
-		gl::ScopedTextureBind scopedTex0( texture, 0 );
-		//gl::ScopedTextureBind texScope( texture->getTarget(), texture->getId() );
-
-		//glPixelStorei( GL_PACK_ALIGNMENT, 1 ); // TODO: needed?
-		//glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-
-		ivec3 pixelCoord = mDebugPixelCoord; // TODO: probably want to clamp this to actual texture coords just to be safe
-		
-		vec4 pixel;
-		const ivec3 pixelSize = { 1, 1, 1 };
-		const GLint level = 0;
-		const GLenum format = GL_RGBA;
-		const GLenum dataType = GL_FLOAT;
-
-#if 1
-		// fetch one pixel from texture
-		glGetTextureSubImage( texture->getId(), level,
-			pixelCoord.x, pixelCoord.y, pixelCoord.z, pixelSize.x, pixelSize.y, pixelSize.z,
-			format, dataType, sizeof( pixel ), &pixel.x );
-
-#else
-		// fetch all pixels from texture
-		const size_t numPixels = texture->getWidth() * texture->getHeight() * texture->getDepth();
-		vector<ColorA>	buffer( numPixels );
-
-		glGetTexImage( texture->getTarget(), level, format, dataType, buffer.data() );
-
-		// TODO: verify this is correct by writing specific values in the compute shader
-		size_t index = pixelCoord.z * texture->getWidth() * texture->getHeight() + pixelCoord.y * texture->getHeight() + pixelCoord.x;
-		if( index >= buffer.size() ) {
-			CI_LOG_E( "index out of range: " << index );
-		}
-		else {
-			pixel = buffer[index];
-		}
-#endif
-		mDebugPixel = pixel;
-		mDebugPixelNeedsUpdate = false;
-	}
-
 	if( mOptions.mExtendedUI ) {
 		// TODO: make this a dropdown to select mode (may have more than two)
 		Checkbox( "atlas mode", &mTiledAtlasMode );
@@ -24,7 +24,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mason/Assets.h"
 
 #include "mason/imx/ImGuiStuff.h"
-#include "mason/imx/ImGuiTexture.h"
 #include "mason/Profiling.h"
 
 #include "cinder/Log.h"
@@ -39,6 +38,13 @@ namespace mason::scene {
 namespace {
 
 const float kFilmHeight = 0.024f;
+// in half resolution pixels, also the size of the work the tiled passes skip at a time
+const int kTileSize = 16;
+// texture units for the tile map, which the tiled passes bind next to their own textures
+const int kTileMapUnit = 5;
+// In-focus tiles are cleared to zero. The disk blur covers one more ring of tiles than need it, so the tent filter's taps at
+// the edge of a blurred tile read valid blur. The tent filter also covers that ring, for the composition's bilinear taps.
+const int kTileDilation = 1;
 
 const char* kernelSizeToString( DepthOfFieldBokehEffect::KernelSize size )
 {
@@ -91,177 +97,305 @@ void DepthOfFieldBokehEffect::loadShaders()
 			mGlslComposition = glsl;
 		}
 	);
+
+	// tiled variants
+	mConnections += assets()->getShader( "mason/passthrough.vert", "mason/post/depthOfFieldBokeh/tileClassify.frag",
+		gl::GlslProg::Format().label( "Bokeh tile classify" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexPrefiltered", 0 );
+			mGlslTileClassify = glsl;
+		}
+	);
+	mConnections += assets()->getShader( "mason/post/depthOfFieldBokeh/tiled.vert", "mason/post/depthOfFieldBokeh/bokeh2_diskblur.frag",
+		gl::GlslProg::Format().define( kernelSizeToString( mKernelSize ) ).label( "Bokeh disk blur (tiled)" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexTiles", kTileMapUnit );
+			mGlslDiskBlurTiled = glsl;
+		}
+	);
+	mConnections += assets()->getShader( "mason/post/depthOfFieldBokeh/tiled.vert", "mason/post/depthOfFieldBokeh/bokeh3_tentfiler.frag",
+		gl::GlslProg::Format().label( "Bokeh tent filter (tiled)" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexTiles", kTileMapUnit );
+			mGlslTentFilterTiled = glsl;
+		}
+	);
+	mConnections += assets()->getShader( "mason/passthrough.vert", "mason/post/depthOfFieldBokeh/temporal.frag",
+		gl::GlslProg::Format().label( "Bokeh temporal" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexCurrent", 0 );
+			glsl->uniform( "uTexHistory", 1 );
+			glsl->uniform( "uTexVelocity", 2 );
+			glsl->uniform( "uTexTiles", kTileMapUnit );
+			mGlslTemporal = glsl;
+		}
+	);
 }
 
-void DepthOfFieldBokehEffect::initBuffers( const ci::ivec2 &size )
+float DepthOfFieldBokehEffect::getMaxCoC( int height ) const
 {
-	CI_LOG_I( "size: " << size );
-
-	auto halfRes = size / 2;
-	auto texFmt = gl::Texture2d::Format()
-		.internalFormat( GL_RGBA16F )
-		.dataType( GL_HALF_FLOAT )
-		.magFilter( GL_LINEAR )
-		.minFilter( GL_LINEAR )
-		.wrap( GL_CLAMP_TO_EDGE )
-		.mipmap( false )
-	;
-
-	if( !mFbo1 || halfRes != mFbo1->getSize() ) {
-		auto fmt = gl::Fbo::Format().label( "FboBokeh1" ).colorTexture( texFmt ).disableDepth();
-		mFbo1 = gl::Fbo::create( halfRes.x, halfRes.y, fmt );
-	}
-	auto fmt = gl::Fbo::Format().label( "FboBokeh2" ).colorTexture( texFmt ).disableDepth();
-	if( !mFbo2 || halfRes != mFbo2->getSize() ) {
-		mFbo2 = gl::Fbo::create( halfRes.x, halfRes.y, fmt );
-	}
-
-	if( ! mBaseFbo || size != mBaseFbo->getSize() ) {
-		auto texFmt = gl::Texture2d::Format()
-			.internalFormat( GL_RGBA16F )
-			.dataType( GL_HALF_FLOAT )
-			.magFilter( GL_NEAREST )
-			.minFilter( GL_NEAREST )
-			.wrap( GL_CLAMP_TO_EDGE )
-			.mipmap( false );
-		auto fmt = gl::Fbo::Format().label( "FboBokehMain" );
-		fmt.setColorTextureFormat( texFmt );
-		fmt.disableDepth();
-		mBaseFbo = gl::Fbo::create( size.x, size.y, fmt );
-	}
+	float radiusInPixels = float( mKernelSize ) * 4 + 6.0f;
+	return glm::min( 0.05f, radiusInPixels / (float)height );
 }
 
-void DepthOfFieldBokehEffect::process( const ci::gl::FboRef &source )
+int DepthOfFieldBokehEffect::getSampleRadius() const
 {
 	if( ! mIsActive )
-		return;
+		return 0;
+
+	const int height = mPostProcess->getSize().y;
+	return (int)ceil( getMaxCoC( height ) * (float)height ) + 4;
+}
+
+void DepthOfFieldBokehEffect::setTileUniforms( const gl::GlslProgRef &glsl, int tileRadius, float cocThreshold, bool checkerboard ) const
+{
+	glsl->uniform( "uTileSize", kTileSize );
+	glsl->uniform( "uTileRadius", tileRadius );
+	glsl->uniform( "uTileDilation", kTileDilation );
+	glsl->uniform( "uCoCThreshold", cocThreshold );
+	glsl->uniform( "uCheckerboard", checkerboard );
+	glsl->uniform( "uFrameIndex", mFrameIndex );
+}
+
+void DepthOfFieldBokehEffect::drawTiles( const gl::GlslProgRef &glsl, const ivec2 &numTiles, const ivec2 &targetSize ) const
+{
+	glsl->uniform( "uNumTiles", numTiles );
+	glsl->uniform( "uTargetSize", vec2( targetSize ) );
+
+	// positions are generated from gl_VertexID, 6 per tile
+	gl::ScopedVao scopedVao( mVaoTiles );
+	gl::ScopedGlslProg scopedGlsl( glsl );
+	gl::setDefaultShaderVars();
+	gl::drawArrays( GL_TRIANGLES, 0, numTiles.x * numTiles.y * 6 );
+}
 
-	if( ! mBaseFbo || mBaseFbo->getSize() != source->getSize() ) {
-		initBuffers( source->getSize() );
+FrameGraph::ResourceId DepthOfFieldBokehEffect::addPasses( FrameGraph &graph, FrameGraph::ResourceId color )
+{
+	mFrameIndex++;
+
+	if( ! mIsActive || ! mGlslPrefilter || ! mGlslDiskBlur || ! mGlslTentFilter || ! mGlslComposition ) {
+		mHistoryValid = false;
+		return color;
 	}
 
-	float aspectRatio = (float)mFbo1->getHeight() / (float)mFbo1->getWidth();
+	const ivec2 size = graph.getSize( color );
+	const ivec2 halfRes = size / 2;
+
+	const bool tiled = mTiled && mGlslTileClassify && mGlslDiskBlurTiled && mGlslTentFilterTiled;
+	auto velocityTex = mPostProcess->getTexture( PostProcess::COLOR_ATTACHMENT_VELOCITY );
+	const bool temporal = tiled && mTemporal && mGlslTemporal && velocityTex;
+
+	// the prefilter and tent filter results have the same format and their lifetimes don't overlap, so the frame graph may alias them
+	auto halfResFormat = FrameGraph::TextureFormat( halfRes, GL_RGBA16F ).filter( GL_LINEAR );
+	auto prefiltered = graph.createTexture( "Bokeh prefilter", halfResFormat );
+	auto blurred = graph.createTexture( "Bokeh disk blur", halfResFormat );
+	auto filtered = graph.createTexture( "Bokeh tent filter", halfResFormat );
+	auto composited = graph.createTexture( "Bokeh composition", FrameGraph::TextureFormat( size, GL_RGBA16F ).filter( GL_NEAREST ) );
+
+	float aspectRatio = (float)halfRes.y / (float)halfRes.x;
 	float s1 = mFocusDistance;
 	float f = mFocalLength / 1000.0f;
 	s1 = glm::max( s1, f );
 	float coeff = f * f / ( mFStop * ( s1 - f ) * kFilmHeight * 2.0f );
-	float radiusInPixels = float( mKernelSize ) * 4 + 6.0f;
+	float maxCoC = getMaxCoC( size.y );
 
-	//float maxCoC = glm::min( 0.05f, radiusInPixels / (float) mFg->getResource( mInputs.at(0) )->getHeight() );
-	float maxCoC = glm::min( 0.05f, radiusInPixels / (float) source->getHeight() );
+	// tiles whose CoC stays below one full resolution pixel are composited sharp, the near field can spread over maxCoC
+	const ivec2 numTiles = ( halfRes + ivec2( kTileSize - 1 ) ) / kTileSize;
+	const int tileRadius = (int)ceil( maxCoC * (float)halfRes.y / (float)kTileSize );
+	const float cocThreshold = 1.0f / (float)size.y;
+
+	// with dynamic resolution only the rendered part of the buffers is processed, tiles outside of it are left in focus
+	const ivec2 region = getRegionSize( size );
+	const ivec2 halfResRegion = getRegionSize( halfRes );
+	const ivec2 numTilesRegion = glm::min( ( halfResRegion + ivec2( kTileSize - 1 ) ) / kTileSize, numTiles );
 
 	//1st pass - downres & prefilter
-	{
+	graph.addPass( "Bokeh prefilter", { color }, { prefiltered }, [this, color, prefiltered, s1, coeff, maxCoC, halfResRegion]( const FrameGraph &graph ) {
 		mGlslPrefilter->uniform( "uDistance", s1 );
 		mGlslPrefilter->uniform( "uLensCoeff", coeff );
 		mGlslPrefilter->uniform( "uMaxCoC", maxCoC );
 		mGlslPrefilter->uniform( "uRcpMaxCoc", 1.0f / maxCoC );
 		mGlslPrefilter->uniform( "uCameraRange", vec2( mPostProcess->getCamera().getNearClip(),  mPostProcess->getCamera().getFarClip() ) );
 
-		gl::ScopedFramebuffer pushFbo{ mFbo1 };
-		gl::ScopedViewport viewport( 0, 0, mFbo1->getWidth(), mFbo1->getHeight() );
+		const auto &fbo = graph.getFbo( prefiltered );
+		gl::ScopedFramebuffer pushFbo{ fbo };
+		gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
 		gl::ScopedMatrices matrices;
-		gl::setMatricesWindow( mFbo1->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 		gl::clear();
 
-		//blit( mFbo1->getSize(), mInputs, mGlslPrefilter );
-
 		gl::ScopedGlslProg scopedGlsl( mGlslPrefilter );
-		gl::ScopedTextureBind scopedTex0( source->getColorTexture(), 0 );
+		gl::ScopedTextureBind scopedTex0( graph.getTexture( color ), 0 );
 		gl::ScopedTextureBind scopedTex1( mPostProcess->getDepthTexture(), 1 );
 
-		gl::drawSolidRect( mFbo1->getBounds() );
+		drawRegion( fbo->getSize(), halfResRegion );
+	} );
+
+	// classify tiles by their largest near and far CoC, so the blur passes can skip the ones in focus
+	auto tiles = FrameGraph::INVALID_RESOURCE;
+	if( tiled ) {
+		if( ! mVaoTiles )
+			mVaoTiles = gl::Vao::create();
+
+		tiles = graph.createTexture( "Bokeh tiles", FrameGraph::TextureFormat( numTiles, GL_RG16F ).filter( GL_NEAREST ) );
+		graph.addPass( "Bokeh tile classify", { prefiltered }, { tiles }, [this, prefiltered, tiles, numTilesRegion]( const FrameGraph &graph ) {
+			const auto &fbo = graph.getFbo( tiles );
+			gl::ScopedFramebuffer pushFbo{ fbo };
+			gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+			gl::ScopedMatrices matrices;
+			gl::setMatricesWindow( fbo->getSize() );
+			gl::clear();
+
+			mGlslTileClassify->uniform( "uTileSize", kTileSize );
+
+			gl::ScopedGlslProg scopedGlsl( mGlslTileClassify );
+			gl::ScopedTextureBind scopedTex( graph.getTexture( prefiltered ), 0 );
+
+			drawRegion( fbo->getSize(), numTilesRegion );
+		} );
 	}
 
+	if( temporal && ( ! mFboHistory[0] || mFboHistory[0]->getSize() != halfRes ) ) {
+		auto format = gl::Fbo::Format().colorTexture( gl::Texture2d::Format().internalFormat( GL_RGBA16F ).minFilter( GL_LINEAR ).magFilter( GL_LINEAR ).wrap( GL_CLAMP_TO_EDGE ) ).disableDepth();
+		for( size_t i = 0; i < 2; i++ ) {
+			mFboHistory[i] = gl::Fbo::create( halfRes.x, halfRes.y, format.label( "Bokeh history " + to_string( i ) ) );
+		}
+		mHistoryValid = false;
+	}
+
+	// the history is reprojected from the render scale it was accumulated at, to the current one
+	const vec2 historyScale = mHistoryRenderScale / mRenderScale;
+	const vec2 historyCoordMax = mHistoryRenderScale - vec2( 0.5f ) / vec2( halfRes );
+	mHistoryRenderScale = mRenderScale;
+
+	// in checkerboard mode only half of the tiles are blurred each frame, which needs a valid history for the other half
+	const bool historyValid = temporal && mHistoryValid;
+	const bool checkerboard = historyValid && mCheckerboard;
+
 	//2nd pass - disk blur
-	{
-		gl::ScopedFramebuffer pushFbo{ mFbo2 };
-		gl::ScopedViewport viewport( 0, 0, mFbo2->getWidth(), mFbo2->getHeight() );
+	vector<FrameGraph::ResourceId> diskBlurReads = { prefiltered };
+	if( tiled )
+		diskBlurReads.push_back( tiles );
+
+	graph.addPass( "Bokeh disk blur", diskBlurReads, { blurred }, [this, prefiltered, tiles, blurred, tiled, aspectRatio, maxCoC, tileRadius, cocThreshold, checkerboard, numTiles, halfResRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( blurred );
+		gl::ScopedFramebuffer pushFbo{ fbo };
+		gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
 		gl::ScopedMatrices matrices;
-		gl::setMatricesWindow( mFbo2->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 		gl::clear();
 
-		mGlslDiskBlur->uniform( "uRcpAspect", aspectRatio );
-		mGlslDiskBlur->uniform( "uMaxCoC", maxCoC );
-
-		//blit( mFbo2->getSize(), { mFbo1->getColorTexture() }, mGlslDiskBlur );
+		auto glsl = tiled ? mGlslDiskBlurTiled : mGlslDiskBlur;
+		glsl->uniform( "uRcpAspect", aspectRatio );
+		glsl->uniform( "uMaxCoC", maxCoC );
 
-		gl::ScopedGlslProg scopedGlsl( mGlslDiskBlur );
-		gl::ScopedTextureBind scopedTex( mFbo1->getColorTexture(), 0 );
+		gl::ScopedTextureBind scopedTex( graph.getTexture( prefiltered ), 0 );
 
-		gl::drawSolidRect( mFbo2->getBounds() );
+		if( tiled ) {
+			gl::ScopedTextureBind scopedTexTiles( graph.getTexture( tiles ), kTileMapUnit );
+			setTileUniforms( glsl, tileRadius, cocThreshold, checkerboard );
+			drawTiles( glsl, numTiles, fbo->getSize() );
+		}
+		else {
+			gl::ScopedGlslProg scopedGlsl( glsl );
+			drawRegion( fbo->getSize(), halfResRegion );
+		}
+	} );
+
+	// accumulate the disk blur with the reprojected history, which also fills in the tiles skipped by the checkerboard
+	auto tentInput = blurred;
+	if( temporal ) {
+		auto historyPrev = graph.importFbo( "Bokeh history (previous)", mFboHistory[mHistoryIndex ^ 1] );
+		auto history = graph.importFbo( "Bokeh history", mFboHistory[mHistoryIndex] );
+		graph.addPass( "Bokeh temporal", { blurred, historyPrev, tiles }, { history }, [this, blurred, historyPrev, tiles, history, velocityTex, tileRadius, cocThreshold, checkerboard, historyValid, historyScale, historyCoordMax, halfResRegion]( const FrameGraph &graph ) {
+			const auto &fbo = graph.getFbo( history );
+			gl::ScopedFramebuffer pushFbo{ fbo };
+			gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+			gl::ScopedMatrices matrices;
+			gl::setMatricesWindow( fbo->getSize() );
+
+			setTileUniforms( mGlslTemporal, tileRadius, cocThreshold, checkerboard );
+			mGlslTemporal->uniform( "uFeedback", mTemporalFeedback );
+			mGlslTemporal->uniform( "uHistoryValid", historyValid );
+			mGlslTemporal->uniform( "uHistoryScale", historyScale );
+			mGlslTemporal->uniform( "uHistoryCoordMax", historyCoordMax );
+
+			gl::ScopedGlslProg scopedGlsl( mGlslTemporal );
+			gl::ScopedTextureBind scopedTex0( graph.getTexture( blurred ), 0 );
+			gl::ScopedTextureBind scopedTex1( graph.getTexture( historyPrev ), 1 );
+			gl::ScopedTextureBind scopedTex2( velocityTex, 2 );
+			gl::ScopedTextureBind scopedTexTiles( graph.getTexture( tiles ), kTileMapUnit );
+
+			drawRegion( fbo->getSize(), halfResRegion );
+		} );
+
+		tentInput = history;
+		mHistoryIndex ^= 1;
+		mHistoryValid = true;
+	}
+	else {
+		mHistoryValid = false;
 	}
 
 	//3rd pass - Tent filter
-	{
-		gl::ScopedFramebuffer pushFbo{ mFbo1 };
-		gl::ScopedViewport viewport( 0, 0, mFbo1->getWidth(), mFbo1->getHeight() );
+	vector<FrameGraph::ResourceId> tentReads = { tentInput };
+	if( tiled )
+		tentReads.push_back( tiles );
+
+	graph.addPass( "Bokeh tent filter", tentReads, { filtered }, [this, tentInput, tiles, filtered, tiled, tileRadius, cocThreshold, numTiles, halfResRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( filtered );
+		gl::ScopedFramebuffer pushFbo{ fbo };
+		gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
 		gl::ScopedMatrices matrices;
-		gl::setMatricesWindow( mFbo1->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 		gl::clear();
 
-		//blit( mFbo1->getSize(), { mFbo2->getColorTexture() }, mGlslTentFilter );
+		gl::ScopedTextureBind scopedTex( graph.getTexture( tentInput ), 0 );
 
-		gl::ScopedGlslProg scopedGlsl( mGlslTentFilter );
-		gl::ScopedTextureBind scopedTex( mFbo2->getColorTexture(), 0 );
-
-		gl::drawSolidRect( mFbo1->getBounds() );
-	}
+		if( tiled ) {
+			gl::ScopedTextureBind scopedTexTiles( graph.getTexture( tiles ), kTileMapUnit );
+			setTileUniforms( mGlslTentFilterTiled, tileRadius, cocThreshold, false );
+			drawTiles( mGlslTentFilterTiled, numTiles, fbo->getSize() );
+		}
+		else {
+			gl::ScopedGlslProg scopedGlsl( mGlslTentFilter );
+			drawRegion( fbo->getSize(), halfResRegion );
+		}
+	} );
 
 	//4th pass - Composition
-	{
-		gl::ScopedFramebuffer pushFbo{ mBaseFbo };
-		gl::ScopedViewport viewport( 0, 0, mBaseFbo->getWidth(), mBaseFbo->getHeight() );
+	graph.addPass( "Bokeh composition", { color, filtered }, { composited }, [this, color, filtered, composited, region]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( composited );
+		gl::ScopedFramebuffer pushFbo{ fbo };
+		gl::ScopedViewport viewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
 		gl::ScopedMatrices matrices;
-		gl::setMatricesWindow( mBaseFbo->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 		gl::clear();
 
-		//blit( mBaseFbo->getSize(), { mFg->getResource( mInputs.at( 0 ) ), mFbo1->getColorTexture() }, mGlslComposition );
-
 		gl::ScopedGlslProg scopedGlsl( mGlslComposition );
-		gl::ScopedTextureBind scopedTex0( source->getColorTexture(), 0 );
-		gl::ScopedTextureBind scopedTex1( mFbo1->getColorTexture(), 1 ); // TODO: check this
+		gl::ScopedTextureBind scopedTex0( graph.getTexture( color ), 0 );
+		gl::ScopedTextureBind scopedTex1( graph.getTexture( filtered ), 1 ); // TODO: check this
 
-		gl::drawSolidRect( mBaseFbo->getBounds() );
-	}
+		drawRegion( fbo->getSize(), region );
+	} );
+
+	return composited;
 }
 
 void DepthOfFieldBokehEffect::updateUI()
 {
-	if( im::Checkbox( "Active", &mIsActive ) ) {
-		//if( mIsActive ) {
-		//	mFg->setResource( getOutput( 0 ), mBaseFbo->getColorTexture() );
-		//}
-		//else{
-		//	mFg->setResource( getOutput( 0 ), mFg->getResource( mInputs.at( 0 ) ) );
-		//}
-
-	}
+	im::Checkbox( "Active", &mIsActive );
 
 	im::DragFloat( "Focus Distance", &mFocusDistance, 0.05f, 0.1f, 100.0f );
 	im::DragFloat( "Aperture (f-stop)", &mFStop, 0.01f, 1.0f, 20.0f );
 	im::DragFloat( "Focal Length (mm)", &mFocalLength, 1.0f, 10.0f, 300.0f );
 
-	if( im::CollapsingHeader( "buffers" ) ) {
-		imx::TextureViewerOptions opts;
-		opts.mTreeNodeFlags = ImGuiTreeNodeFlags_DefaultOpen;
-		if( mFbo1 ) {
-			imx::Texture2d( "fbo1", mFbo1->getColorTexture(), opts );
-		}
-		else {
-			im::Text( "null mFbo1" );
-		}
-		if( mFbo2 ) {
-			imx::Texture2d( "fbo2", mFbo2->getColorTexture(), opts );
-		}
-		else {
-			im::Text( "null mFbo2" );
-		}
-		if( mBaseFbo ) {
-			imx::Texture2d( "base", mBaseFbo->getColorTexture(), opts );
-		}
-		else {
-			im::Text( "null mBaseFbo" );
+	im::Checkbox( "Tiled", &mTiled );
+	if( mTiled ) {
+		im::Checkbox( "Temporal", &mTemporal );
+		if( mTemporal ) {
+			im::Checkbox( "Checkerboard", &mCheckerboard );
+			im::SliderFloat( "Feedback", &mTemporalFeedback, 0, 0.98f );
 		}
 	}
 }
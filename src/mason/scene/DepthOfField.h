@@ -22,6 +22,7 @@ POSSIBILITY OF SUCH DAMAGE.
 // TODO: references
 
 #include "mason/scene/PostEffects.h"
+#include "cinder/gl/Vao.h"
 
 namespace mason::scene {
 
@@ -30,11 +31,26 @@ public:
 	DepthOfFieldBokehEffect( PostProcess *postProcess );
 	~DepthOfFieldBokehEffect();
 
-	void process( const ci::gl::FboRef &source ) override;
+	//! Returns \a color unchanged while inactive or until all shaders are loaded.
+	FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId color ) override;
+	//! The disk blur reaches the max CoC, the other passes a few pixels more.
+	int getSampleRadius() const override;
 
 	void updateUI();
 
-	ci::gl::FboRef	getDestFbo() const	{ return mBaseFbo; }
+	//! Sets whether the disk blur and tent filter only run on tiles that are out of focus. The tiles are classified from the CoC
+	//! that the prefilter shader writes to alpha, as a signed fraction of the screen height. Defaults to false.
+	void setTiledEnabled( bool enabled )	{ mTiled = enabled; }
+	bool isTiledEnabled() const				{ return mTiled; }
+	//! Sets whether the disk blur is accumulated over frames, reprojected with the velocity buffer. Requires tiling. Defaults to false.
+	void setTemporalEnabled( bool enabled )	{ mTemporal = enabled; }
+	bool isTemporalEnabled() const			{ return mTemporal; }
+	//! Sets whether the temporal mode only blurs every other tile each frame, reusing the history for the rest. Defaults to true.
+	void setCheckerboardEnabled( bool enabled )	{ mCheckerboard = enabled; }
+	bool isCheckerboardEnabled() const			{ return mCheckerboard; }
+	//! Sets the weight of the history when accumulating temporally, from 0 to 1. Defaults to 0.8.
+	void setTemporalFeedback( float feedback )	{ mTemporalFeedback = feedback; }
+	float getTemporalFeedback() const			{ return mTemporalFeedback; }
 
 	enum class KernelSize {
 		SMALL = 0,
@@ -45,12 +61,22 @@ public:
 
 private:
 	void loadShaders();
-	void initBuffers( const ci::ivec2 &size );
+	//! Returns the largest CoC as a fraction of \a height, which the disk blur kernel is scaled to.
+	float getMaxCoC( int height ) const;
+	void setTileUniforms( const ci::gl::GlslProgRef &glsl, int tileRadius, float cocThreshold, bool checkerboard ) const;
+	void drawTiles( const ci::gl::GlslProgRef &glsl, const ci::ivec2 &numTiles, const ci::ivec2 &targetSize ) const;
 
 	ci::signals::ConnectionList		mConnections;
 
 	ci::gl::GlslProgRef mGlslPrefilter, mGlslDiskBlur, mGlslTentFilter, mGlslComposition;
-	ci::gl::FboRef mBaseFbo, mFbo1, mFbo2;
+	ci::gl::GlslProgRef mGlslTileClassify, mGlslDiskBlurTiled, mGlslTentFilterTiled, mGlslTemporal;
+	ci::gl::VaoRef		mVaoTiles;
+
+	ci::gl::FboRef		mFboHistory[2];
+	size_t				mHistoryIndex = 0;
+	bool				mHistoryValid = false;
+	ci::vec2			mHistoryRenderScale = ci::vec2( 1 );
+	int					mFrameIndex = 0;
 
 	//TODO: Add point of focus transform
 	float mFocusDistance = 3;
@@ -58,6 +84,11 @@ private:
 	float mFocalLength = 70;
 	KernelSize mKernelSize = KernelSize::LARGE;
 
+	bool mTiled = false;
+	bool mTemporal = false;
+	bool mCheckerboard = true;
+	float mTemporalFeedback = 0.8f;
+
 	bool mIsActive = true; // TODO: remove, use PostEfect::mIsEnabled
 };
 
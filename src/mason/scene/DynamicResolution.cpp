@@ -0,0 +1,179 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mason/scene/DynamicResolution.h"
+#include "mason/imx/ImGuiStuff.h"
+
+#include "cinder/gl/gl.h"
+
+using namespace ci;
+using namespace std;
+namespace im = ImGui;
+
+namespace mason::scene {
+
+DynamicResolution::DynamicResolution( size_t numQueries )
+	: mFrames( max<size_t>( 2, numQueries ) )
+{
+	for( auto &frame : mFrames ) {
+		glGenQueries( 2, frame.mQueries );
+	}
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	for( auto &frame : mFrames ) {
+		glDeleteQueries( 2, frame.mQueries );
+	}
+}
+
+void DynamicResolution::beginFrame()
+{
+	// if the GPU is so far behind that all queries are still in flight, this frame goes untimed
+	auto &frame = mFrames[mFrameIndex];
+	if( frame.mPending ) {
+		mInFrame = false;
+		return;
+	}
+
+	// timestamps rather than GL_TIME_ELAPSED, which can't be nested in other timer queries issued while rendering the scene
+	glQueryCounter( frame.mQueries[0], GL_TIMESTAMP );
+	mInFrame = true;
+}
+
+void DynamicResolution::endFrame()
+{
+	if( mInFrame ) {
+		auto &frame = mFrames[mFrameIndex];
+		glQueryCounter( frame.mQueries[1], GL_TIMESTAMP );
+		frame.mPending = true;
+
+		mFrameIndex = ( mFrameIndex + 1 ) % mFrames.size();
+		mInFrame = false;
+	}
+
+	pollQueries();
+}
+
+void DynamicResolution::reset()
+{
+	for( auto &frame : mFrames ) {
+		frame.mPending = false;
+	}
+
+	mScale = mMaxScale;
+	mGpuMilliseconds = 0;
+	mFramesUntilAdjust = 0;
+}
+
+void DynamicResolution::pollQueries()
+{
+	// queries complete in the order they were issued, starting from the oldest which is the next one to be reused
+	size_t index = mFrameIndex;
+	for( size_t i = 0; i < mFrames.size(); i++, index = ( index + 1 ) % mFrames.size() ) {
+		auto &frame = mFrames[index];
+		if( ! frame.mPending )
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv( frame.mQueries[1], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( ! available )
+			break;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v( frame.mQueries[0], GL_QUERY_RESULT, &begin );
+		glGetQueryObjectui64v( frame.mQueries[1], GL_QUERY_RESULT, &end );
+		frame.mPending = false;
+
+		updateScale( double( end - begin ) / 1000000.0 );
+	}
+}
+
+void DynamicResolution::updateScale( double gpuMilliseconds )
+{
+	// smooth out single frame spikes, while still reacting within a few frames
+	mGpuMilliseconds = mGpuMilliseconds > 0 ? glm::mix( mGpuMilliseconds, gpuMilliseconds, 0.25 ) : gpuMilliseconds;
+
+	// timings that were in flight when the scale changed were measured at the old scale
+	if( mFramesUntilAdjust > 0 ) {
+		mFramesUntilAdjust--;
+		return;
+	}
+
+	float scale = mScale;
+	if( mGpuMilliseconds > mTargetMilliseconds ) {
+		// GPU time is roughly proportional to the number of pixels, which goes with the square of the scale
+		scale = mScale * (float)sqrt( mTargetMilliseconds / mGpuMilliseconds );
+	}
+	else if( mGpuMilliseconds < mTargetMilliseconds * ( 1 - mHeadroom ) ) {
+		scale = mScale + mIncreaseStep;
+	}
+
+	scale = glm::clamp( scale, mMinScale, mMaxScale );
+	if( scale != mScale ) {
+		mScale = scale;
+		mGpuMilliseconds = 0;
+		mFramesUntilAdjust = (int)mFrames.size();
+	}
+}
+
+ivec2 DynamicResolution::getRenderSize( const ivec2 &maxSize ) const
+{
+	return glm::max( ivec2( 1 ), ivec2( glm::round( vec2( maxSize ) * mScale ) ) );
+}
+
+void DynamicResolution::setMinScale( float scale )
+{
+	mMinScale = glm::clamp( scale, 0.1f, 1.0f );
+	mMaxScale = max( mMaxScale, mMinScale );
+	mScale = glm::clamp( mScale, mMinScale, mMaxScale );
+}
+
+void DynamicResolution::setMaxScale( float scale )
+{
+	mMaxScale = glm::clamp( scale, 0.1f, 1.0f );
+	mMinScale = min( mMinScale, mMaxScale );
+	mScale = glm::clamp( mScale, mMinScale, mMaxScale );
+}
+
+void DynamicResolution::updateUI()
+{
+	im::Text( "gpu: %0.2f ms, scale: %0.3f", mGpuMilliseconds, mScale );
+	im::DragFloat( "target ms", &mTargetMilliseconds, 0.1f, 1, 100 );
+
+	float minScale = mMinScale;
+	if( im::DragFloat( "min scale", &minScale, 0.01f, 0.1f, 1 ) ) {
+		setMinScale( minScale );
+	}
+	float maxScale = mMaxScale;
+	if( im::DragFloat( "max scale", &maxScale, 0.01f, 0.1f, 1 ) ) {
+		setMaxScale( maxScale );
+	}
+
+	im::DragFloat( "increase step", &mIncreaseStep, 0.001f, 0.001f, 0.2f );
+	im::DragFloat( "headroom", &mHeadroom, 0.01f, 0, 0.9f );
+
+	if( im::Button( "reset" ) ) {
+		reset();
+	}
+}
+
+} // namespace mason::scene
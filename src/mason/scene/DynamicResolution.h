@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/gl/platform.h"
+#include "cinder/Vector.h"
+
+#include <vector>
+
+namespace mason::scene {
+
+//! \brief Picks the resolution to render at so the GPU time of a frame stays under a target.
+//!
+//! beginFrame() and endFrame() record GPU timestamps around the work that scales with resolution. Results are polled without
+//! waiting, so they arrive a few frames late. The controller lowers the scale quickly when a frame goes over the target,
+//! and raises it slowly once there is headroom, so it doesn't oscillate.
+class DynamicResolution {
+  public:
+	DynamicResolution( size_t numQueries = 4 );
+	~DynamicResolution();
+
+	//! Records the GPU timestamp where the frame starts.
+	void	beginFrame();
+	//! Records the GPU timestamp where the frame ends, then updates the scale from any frames whose timings are available.
+	void	endFrame();
+	//! Goes back to the max scale and discards pending timings.
+	void	reset();
+
+	//! Returns the size to render at, given the size of the buffers. Always at least one pixel.
+	ci::ivec2	getRenderSize( const ci::ivec2 &maxSize ) const;
+	//! Returns the current scale of each render dimension, between the min and max scales.
+	float		getScale() const	{ return mScale; }
+
+	//! Sets the GPU time in milliseconds that a frame should stay under. Default is 14ms.
+	void	setTargetMilliseconds( float ms )	{ mTargetMilliseconds = ms; }
+	float	getTargetMilliseconds() const		{ return mTargetMilliseconds; }
+	//! Sets the lowest scale of each render dimension. Default is 0.5.
+	void	setMinScale( float scale );
+	float	getMinScale() const			{ return mMinScale; }
+	//! Sets the highest scale of each render dimension. Default is 1.
+	void	setMaxScale( float scale );
+	float	getMaxScale() const			{ return mMaxScale; }
+
+	//! Returns the smoothed GPU time of recent frames in milliseconds.
+	double	getGpuMilliseconds() const		{ return mGpuMilliseconds; }
+
+	void	updateUI();
+
+  private:
+	struct Frame {
+		GLuint	mQueries[2] = { 0, 0 };	//!< begin and end timestamps
+		bool	mPending = false;
+	};
+
+	void	pollQueries();
+	void	updateScale( double gpuMilliseconds );
+
+	std::vector<Frame>	mFrames;
+	size_t				mFrameIndex = 0;
+	bool				mInFrame = false;
+
+	float	mScale = 1;
+	float	mTargetMilliseconds = 14;
+	float	mMinScale = 0.5f;
+	float	mMaxScale = 1;
+	float	mIncreaseStep = 0.02f;		//!< how much the scale grows per adjustment when under the target
+	float	mHeadroom = 0.15f;			//!< the scale only grows when frames are this fraction under the target
+	double	mGpuMilliseconds = 0;
+	int		mFramesUntilAdjust = 0;		//!< frames to wait after a change, until timings reflect the new scale
+};
+
+} // namespace mason::scene
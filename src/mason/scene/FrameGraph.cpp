@@ -0,0 +1,433 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mason/scene/FrameGraph.h"
+#include "mason/Profiling.h"
+#include "mason/imx/ImGuiStuff.h"
+#include "mason/imx/ImGuiTexture.h"
+
+#include "cinder/Log.h"
+#include "cinder/gl/gl.h"
+
+using namespace ci;
+using namespace std;
+namespace im = ImGui;
+
+namespace mason::scene {
+
+namespace {
+
+// pooled textures that haven't been used for this many frames are released, for example after a resize
+const int MAX_FRAMES_UNUSED = 3;
+
+size_t bytesPerPixel( GLint internalFormat )
+{
+	switch( internalFormat ) {
+		case GL_R8:			return 1;
+		case GL_RG8:		return 2;
+		case GL_RGB8:		return 3;
+		case GL_RGBA8:		return 4;
+		case GL_R16F:		return 2;
+		case GL_RG16F:		return 4;
+		case GL_RGB16F:		return 6;
+		case GL_RGBA16F:	return 8;
+		case GL_R32F:		return 4;
+		case GL_RG32F:		return 8;
+		case GL_RGB32F:		return 12;
+		case GL_RGBA32F:	return 16;
+		default: break;
+	}
+
+	return 4;
+}
+
+const gl::Texture2dRef	sNullTexture;
+const gl::FboRef		sNullFbo;
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// FrameGraph::TextureFormat
+// ----------------------------------------------------------------------------------------------------
+
+size_t FrameGraph::TextureFormat::getNumBytes() const
+{
+	return size_t( mSize.x ) * size_t( mSize.y ) * bytesPerPixel( mInternalFormat );
+}
+
+bool FrameGraph::TextureFormat::operator==( const TextureFormat &other ) const
+{
+	return mSize == other.mSize && mInternalFormat == other.mInternalFormat && mMinFilter == other.mMinFilter
+		&& mMagFilter == other.mMagFilter && mWrap == other.mWrap;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// FrameGraph
+// ----------------------------------------------------------------------------------------------------
+
+FrameGraph::FrameGraph()
+{
+}
+
+FrameGraph::~FrameGraph()
+{
+}
+
+FrameGraph::ResourceId FrameGraph::addResource( Resource &&resource )
+{
+	mCompiled = false;
+	mResources.push_back( move( resource ) );
+	return mResources.size() - 1;
+}
+
+FrameGraph::ResourceId FrameGraph::importTexture( const string &name, const gl::Texture2dRef &texture )
+{
+	CI_ASSERT( texture );
+
+	Resource resource;
+	resource.mName = name;
+	resource.mFormat = TextureFormat( texture->getSize(), texture->getInternalFormat() );
+	resource.mTexture = texture;
+	resource.mImported = true;
+	return addResource( move( resource ) );
+}
+
+FrameGraph::ResourceId FrameGraph::importFbo( const string &name, const gl::FboRef &fbo )
+{
+	CI_ASSERT( fbo );
+
+	auto id = importTexture( name, fbo->getColorTexture() );
+	mResources[id].mFbo = fbo;
+	return id;
+}
+
+FrameGraph::ResourceId FrameGraph::createTexture( const string &name, const TextureFormat &format )
+{
+	Resource resource;
+	resource.mName = name;
+	resource.mFormat = format;
+	return addResource( move( resource ) );
+}
+
+void FrameGraph::addPass( Pass &&pass )
+{
+	const size_t index = mPasses.size();
+	for( ResourceId id : pass.mReads ) {
+		CI_ASSERT( id < mResources.size() );
+		// a transient resource must be written before it's read, which keeps the passes in a valid order
+		CI_ASSERT( mResources[id].mImported || mResources[id].mProducer < index );
+	}
+	for( ResourceId id : pass.mWrites ) {
+		CI_ASSERT( id < mResources.size() );
+		auto &resource = mResources[id];
+		if( ! resource.mImported ) {
+			CI_ASSERT_MSG( resource.mProducer == INVALID_RESOURCE, "transient resources can only be written by one pass" );
+			resource.mProducer = index;
+		}
+	}
+
+	mCompiled = false;
+	mPasses.push_back( move( pass ) );
+}
+
+void FrameGraph::addPass( const string &name, const vector<ResourceId> &reads, const vector<ResourceId> &writes, const ExecuteFn &execute )
+{
+	Pass pass;
+	pass.mName = name;
+	pass.mReads = reads;
+	pass.mWrites = writes;
+	pass.mExecute = execute;
+	addPass( move( pass ) );
+}
+
+void FrameGraph::addOutputPass( const string &name, const vector<ResourceId> &reads, const ExecuteFn &execute )
+{
+	Pass pass;
+	pass.mName = name;
+	pass.mReads = reads;
+	pass.mExecute = execute;
+	pass.mOutput = true;
+	addPass( move( pass ) );
+}
+
+void FrameGraph::reset()
+{
+	mResources.clear();
+	mPasses.clear();
+	mCompiled = false;
+}
+
+// Reference counting as in Frostbite's FrameGraph: a pass is culled once none of its transient writes are read, which
+// releases its own reads in turn. Output passes and passes that write imported resources are always kept.
+void FrameGraph::cullPasses()
+{
+	vector<ResourceId> unreferenced;
+
+	for( auto &resource : mResources )
+		resource.mRefCount = 0;
+
+	for( auto &pass : mPasses ) {
+		pass.mCulled = false;
+		pass.mRefCount = 0;
+		for( ResourceId id : pass.mWrites ) {
+			if( mResources[id].mImported )
+				pass.mOutput = true;
+			else
+				pass.mRefCount++;
+		}
+		for( ResourceId id : pass.mReads )
+			mResources[id].mRefCount++;
+	}
+
+	auto cullPass = [this, &unreferenced]( Pass &pass ) {
+		pass.mCulled = true;
+		for( ResourceId id : pass.mReads ) {
+			auto &resource = mResources[id];
+			if( --resource.mRefCount == 0 && ! resource.mImported )
+				unreferenced.push_back( id );
+		}
+	};
+
+	for( ResourceId id = 0; id < mResources.size(); id++ ) {
+		const auto &resource = mResources[id];
+		if( ! resource.mImported && resource.mRefCount == 0 )
+			unreferenced.push_back( id );
+	}
+	for( auto &pass : mPasses ) {
+		if( ! pass.mOutput && pass.mRefCount == 0 )
+			cullPass( pass );
+	}
+
+	while( ! unreferenced.empty() ) {
+		const auto &resource = mResources[unreferenced.back()];
+		unreferenced.pop_back();
+
+		if( resource.mProducer == INVALID_RESOURCE )
+			continue;
+
+		auto &producer = mPasses[resource.mProducer];
+		if( producer.mOutput || producer.mCulled )
+			continue;
+
+		if( --producer.mRefCount == 0 )
+			cullPass( producer );
+	}
+}
+
+size_t FrameGraph::acquirePooledTexture( const TextureFormat &format, const string &name )
+{
+	for( size_t i = 0; i < mPool.size(); i++ ) {
+		auto &pooled = mPool[i];
+		if( ! pooled.mInUse && pooled.mFormat == format ) {
+			pooled.mInUse = true;
+			pooled.mFramesUnused = 0;
+			return i;
+		}
+	}
+
+	const string label = "FrameGraph " + to_string( mPool.size() ) + " (" + name + ")";
+	auto texFormat = gl::Texture2d::Format()
+		.internalFormat( format.mInternalFormat )
+		.minFilter( format.mMinFilter ).magFilter( format.mMagFilter )
+		.wrap( format.mWrap )
+		.label( label )
+	;
+
+	auto texture = gl::Texture2d::create( format.mSize.x, format.mSize.y, texFormat );
+	auto fbo = gl::Fbo::create( format.mSize.x, format.mSize.y, gl::Fbo::Format().attachment( GL_COLOR_ATTACHMENT0, texture ).disableDepth().label( label ) );
+
+	CI_LOG_I( "allocated " << label << ", size: " << format.mSize );
+
+	mPool.push_back( { format, texture, fbo, true, 0 } );
+	return mPool.size() - 1;
+}
+
+void FrameGraph::purgePool()
+{
+	for( auto &pooled : mPool ) {
+		pooled.mInUse = false;
+		pooled.mFramesUnused++;
+	}
+
+	mPool.erase( remove_if( mPool.begin(), mPool.end(), []( const PooledTexture &pooled ) {
+		return pooled.mFramesUnused > MAX_FRAMES_UNUSED;
+	} ), mPool.end() );
+}
+
+void FrameGraph::compile()
+{
+	cullPasses();
+	purgePool();
+
+	// lifetime of each transient resource, from its producer to the last pass that reads it
+	for( size_t i = 0; i < mPasses.size(); i++ ) {
+		const auto &pass = mPasses[i];
+		if( pass.mCulled )
+			continue;
+
+		for( ResourceId id : pass.mWrites )
+			mResources[id].mLastPass = i;
+		for( ResourceId id : pass.mReads )
+			mResources[id].mLastPass = i;
+	}
+
+	for( auto &resource : mResources )
+		resource.mPoolIndex = INVALID_RESOURCE;
+
+	// resources whose lifetimes ended are released after each pass, so the following passes can alias their textures
+	for( size_t i = 0; i < mPasses.size(); i++ ) {
+		const auto &pass = mPasses[i];
+		if( pass.mCulled )
+			continue;
+
+		for( ResourceId id : pass.mWrites ) {
+			auto &resource = mResources[id];
+			if( ! resource.mImported )
+				resource.mPoolIndex = acquirePooledTexture( resource.mFormat, resource.mName );
+		}
+
+		auto release = [this, i]( ResourceId id ) {
+			const auto &resource = mResources[id];
+			if( ! resource.mImported && resource.mLastPass == i )
+				mPool[resource.mPoolIndex].mInUse = false;
+		};
+
+		for( ResourceId id : pass.mReads )
+			release( id );
+		for( ResourceId id : pass.mWrites )
+			release( id );
+	}
+
+	mCompiled = true;
+}
+
+void FrameGraph::execute()
+{
+	CI_ASSERT_MSG( mCompiled, "compile() must be called before execute()" );
+
+	for( const auto &pass : mPasses ) {
+		if( pass.mCulled )
+			continue;
+
+		MA_PROFILE( pass.mName );
+		pass.mExecute( *this );
+	}
+}
+
+const gl::Texture2dRef& FrameGraph::getTexture( ResourceId id ) const
+{
+	CI_ASSERT( id < mResources.size() );
+
+	const auto &resource = mResources[id];
+	if( resource.mImported )
+		return resource.mTexture;
+
+	CI_ASSERT_MSG( resource.mPoolIndex < mPool.size(), "resource has no texture, was its pass culled?" );
+	return resource.mPoolIndex < mPool.size() ? mPool[resource.mPoolIndex].mTexture : sNullTexture;
+}
+
+const gl::FboRef& FrameGraph::getFbo( ResourceId id ) const
+{
+	CI_ASSERT( id < mResources.size() );
+
+	const auto &resource = mResources[id];
+	if( resource.mImported ) {
+		CI_ASSERT_MSG( resource.mFbo, "imported textures have no Fbo" );
+		return resource.mFbo;
+	}
+
+	CI_ASSERT_MSG( resource.mPoolIndex < mPool.size(), "resource has no Fbo, was its pass culled?" );
+	return resource.mPoolIndex < mPool.size() ? mPool[resource.mPoolIndex].mFbo : sNullFbo;
+}
+
+ivec2 FrameGraph::getSize( ResourceId id ) const
+{
+	CI_ASSERT( id < mResources.size() );
+	return mResources[id].mFormat.getSize();
+}
+
+size_t FrameGraph::getNumCulledPasses() const
+{
+	return (size_t)count_if( mPasses.begin(), mPasses.end(), []( const Pass &pass ) { return pass.mCulled; } );
+}
+
+size_t FrameGraph::getNumTransientBytes() const
+{
+	size_t result = 0;
+	for( const auto &resource : mResources ) {
+		if( ! resource.mImported && resource.mPoolIndex != INVALID_RESOURCE )
+			result += resource.mFormat.getNumBytes();
+	}
+
+	return result;
+}
+
+size_t FrameGraph::getNumPooledBytes() const
+{
+	size_t result = 0;
+	for( const auto &pooled : mPool )
+		result += pooled.mFormat.getNumBytes();
+
+	return result;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// ImGui
+// ----------------------------------------------------------------------------------------------------
+
+void FrameGraph::updateUI() const
+{
+	const float mb = 1.0f / ( 1024 * 1024 );
+	im::Text( "passes: %d, culled: %d", (int)getNumPasses(), (int)getNumCulledPasses() );
+	im::Text( "transient: %0.2f MB, pooled: %0.2f MB", getNumTransientBytes() * mb, getNumPooledBytes() * mb );
+
+	if( im::TreeNode( "passes" ) ) {
+		for( const auto &pass : mPasses ) {
+			string reads, writes;
+			for( ResourceId id : pass.mReads )
+				reads += ( reads.empty() ? "" : ", " ) + mResources[id].mName;
+			for( ResourceId id : pass.mWrites ) {
+				const auto &resource = mResources[id];
+				writes += ( writes.empty() ? "" : ", " ) + resource.mName;
+				if( resource.mPoolIndex < mPool.size() )
+					writes += " [" + to_string( resource.mPoolIndex ) + "]";
+			}
+
+			const auto color = pass.mCulled ? ImVec4( 0.5f, 0.5f, 0.5f, 1 ) : im::GetStyleColorVec4( ImGuiCol_Text );
+			im::TextColored( color, "%s%s", pass.mName.c_str(), pass.mCulled ? " (culled)" : "" );
+			im::Indent();
+			im::TextColored( color, "reads: %s", reads.c_str() );
+			im::TextColored( color, "writes: %s", pass.mOutput && writes.empty() ? "(output)" : writes.c_str() );
+			im::Unindent();
+		}
+		im::TreePop();
+	}
+
+	if( im::TreeNode( "textures" ) ) {
+		// aliased textures hold whatever the last pass that used them wrote
+		for( const auto &pooled : mPool ) {
+			imx::Texture2d( pooled.mTexture->getLabel().c_str(), pooled.mTexture );
+		}
+		im::TreePop();
+	}
+}
+
+} // namespace mason::scene
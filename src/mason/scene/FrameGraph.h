@@ -0,0 +1,159 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/gl/Fbo.h"
+#include "cinder/gl/Texture.h"
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace mason::scene {
+
+//! \brief Schedules the passes of a frame and the transient textures they render into.
+//!
+//! The graph is rebuilt every frame: resources are imported (textures owned elsewhere, like the scene buffers) or created as
+//! transient textures, and passes are added along with the resources they read and write. compile() culls passes whose results
+//! are never used by an output pass, then assigns textures to the transient resources of the remaining passes. Transient resources
+//! with the same TextureFormat and non-overlapping lifetimes share a texture, and textures are pooled between frames so rebuilding
+//! the graph doesn't allocate unless the formats change.
+//!
+//! Passes execute in the order they were added. A pass can only use resources that already exist, so that order always
+//! satisfies the dependencies.
+class FrameGraph {
+  public:
+	using ResourceId = size_t;
+	static constexpr ResourceId INVALID_RESOURCE = std::numeric_limits<size_t>::max();
+
+	//! Describes a transient texture. Resources only share a texture when their formats are equal.
+	struct TextureFormat {
+		TextureFormat( const ci::ivec2 &size, GLint internalFormat )
+			: mSize( size ), mInternalFormat( internalFormat )
+		{}
+
+		TextureFormat& filter( GLenum filter )	{ mMinFilter = mMagFilter = filter; return *this; }
+		TextureFormat& wrap( GLenum wrap )		{ mWrap = wrap; return *this; }
+
+		const ci::ivec2&	getSize() const				{ return mSize; }
+		GLint				getInternalFormat() const	{ return mInternalFormat; }
+		//! Returns the approximate size of a texture with this format.
+		size_t				getNumBytes() const;
+
+		bool operator==( const TextureFormat &other ) const;
+		bool operator!=( const TextureFormat &other ) const	{ return ! ( *this == other ); }
+
+	  private:
+		ci::ivec2	mSize;
+		GLint		mInternalFormat;
+		GLenum		mMinFilter = GL_LINEAR;
+		GLenum		mMagFilter = GL_LINEAR;
+		GLenum		mWrap = GL_CLAMP_TO_EDGE;
+
+		friend class FrameGraph;
+	};
+
+	//! Called with the graph once its textures are assigned, to render a pass.
+	using ExecuteFn = std::function<void( const FrameGraph &graph )>;
+
+	FrameGraph();
+	~FrameGraph();
+
+	//! Adds \a texture to the graph, for example a scene buffer. Imported resources are never aliased.
+	ResourceId	importTexture( const std::string &name, const ci::gl::Texture2dRef &texture );
+	//! Adds \a fbo to the graph, getTexture() returns its color texture.
+	ResourceId	importFbo( const std::string &name, const ci::gl::FboRef &fbo );
+	//! Declares a transient texture, which must be written by exactly one pass.
+	ResourceId	createTexture( const std::string &name, const TextureFormat &format );
+
+	//! Adds a pass that samples \a reads and renders into \a writes. The pass is culled if nothing uses what it writes.
+	void	addPass( const std::string &name, const std::vector<ResourceId> &reads, const std::vector<ResourceId> &writes, const ExecuteFn &execute );
+	//! Adds a pass that renders into the current framebuffer, which is never culled.
+	void	addOutputPass( const std::string &name, const std::vector<ResourceId> &reads, const ExecuteFn &execute );
+
+	//! Culls unused passes and assigns textures to transient resources.
+	void	compile();
+	//! Executes the passes that weren't culled, in order. compile() must be called first.
+	void	execute();
+	//! Removes all passes and resources. Pooled textures are kept for the next frame.
+	void	reset();
+
+	//! Returns the texture of \a id. Only valid while executing a pass that reads or writes it.
+	const ci::gl::Texture2dRef&	getTexture( ResourceId id ) const;
+	//! Returns an Fbo with the texture of \a id as its only color attachment. Only valid while executing a pass that writes it.
+	const ci::gl::FboRef&		getFbo( ResourceId id ) const;
+	//! Returns the size of \a id's texture, which is known for transient resources before compile().
+	ci::ivec2					getSize( ResourceId id ) const;
+
+	size_t	getNumPasses() const			{ return mPasses.size(); }
+	size_t	getNumCulledPasses() const;
+	//! Returns the bytes transient resources would need without aliasing.
+	size_t	getNumTransientBytes() const;
+	//! Returns the bytes of all pooled textures.
+	size_t	getNumPooledBytes() const;
+
+	void	updateUI() const;
+
+  private:
+	struct Resource {
+		std::string				mName;
+		TextureFormat			mFormat = TextureFormat( ci::ivec2( 0 ), GL_RGBA8 );
+		ci::gl::Texture2dRef	mTexture;	// imported only
+		ci::gl::FboRef			mFbo;		// imported only
+		bool					mImported = false;
+		size_t					mProducer = INVALID_RESOURCE;
+		size_t					mRefCount = 0;
+		size_t					mLastPass = 0;
+		size_t					mPoolIndex = INVALID_RESOURCE;
+	};
+
+	struct Pass {
+		std::string				mName;
+		std::vector<ResourceId>	mReads, mWrites;
+		ExecuteFn				mExecute;
+		bool					mOutput = false;
+		bool					mCulled = false;
+		size_t					mRefCount = 0;
+	};
+
+	struct PooledTexture {
+		TextureFormat			mFormat;
+		ci::gl::Texture2dRef	mTexture;
+		ci::gl::FboRef			mFbo;
+		bool					mInUse = false;
+		int						mFramesUnused = 0;
+	};
+
+	ResourceId	addResource( Resource &&resource );
+	void		addPass( Pass &&pass );
+	void		cullPasses();
+	size_t		acquirePooledTexture( const TextureFormat &format, const std::string &name );
+	void		purgePool();
+
+	std::vector<Resource>		mResources;
+	std::vector<Pass>			mPasses;
+	std::vector<PooledTexture>	mPool;
+	bool						mCompiled = false;
+};
+
+} // namespace mason::scene
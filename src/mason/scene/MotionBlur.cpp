@@ -33,7 +33,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mason/Profiling.h"
 
 #include "mason/imx/ImGuiStuff.h"
-#include "mason/imx/ImGuiTexture.h"
 
 #include "cinder/gl/gl.h"
 #include "cinder/Log.h"
@@ -77,6 +76,36 @@ MotionBlurEffect::MotionBlurEffect( PostProcess *postProcess )
 			mGlslReconstruct = glsl;
 		}
 	);
+
+#if defined( CINDER_GL_HAS_COMPUTE_SHADER )
+	mConnections += ma::assets()->getShader( "mason/post/motionBlur/tileMinMax.comp",
+		gl::GlslProg::Format().label( "MotionBlur_tileMinMax (compute)" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uVelocityMap", 0 );
+			mGlslTileMinMaxCompute = glsl;
+		}
+	);
+
+	mConnections += ma::assets()->getShader( "mason/post/motionBlur/neighborMinMax.comp",
+		gl::GlslProg::Format().label( "MotionBlur_neighborMinMax (compute)" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTileMinMaxMap", 0 );
+			mGlslNeighborMinMaxCompute = glsl;
+		}
+	);
+
+	mConnections += ma::assets()->getShader( "mason/post/motionBlur/reconstruct.comp",
+		gl::GlslProg::Format().define( "DEPTH_IN_COLOR_ALPHA_CHANNEL", to_string( depthInColorAlphaChannel ) ).label( "MotionBlur_reconstruct (compute)" ),
+		[this, depthInColorAlphaChannel]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uColorMap", 0 );
+			glsl->uniform( "uVelocityMap", 1 );
+			glsl->uniform( "uNeighborMinMaxMap", 2 );
+			if( ! depthInColorAlphaChannel )
+				glsl->uniform( "uTexDepth", 3 );
+			mGlslReconstructCompute = glsl;
+		}
+	);
+#endif
 }
 
 void MotionBlurEffect::setNumSamples( int samples )
@@ -84,81 +113,113 @@ void MotionBlurEffect::setNumSamples( int samples )
 	mNumSamples = nextOdd( samples );
 }
 
+void MotionBlurEffect::setMinSamples( int samples )
+{
+	mMinSamples = nextOdd( samples );
+}
+
+bool MotionBlurEffect::isComputeActive() const
+{
+	return mComputeEnabled && mGlslTileMinMaxCompute && mGlslNeighborMinMaxCompute && mGlslReconstructCompute;
+}
+
+int MotionBlurEffect::getMaxBlurRadius() const
+{
+	const ivec2 size = mPostProcess->getSize();
+	const int dimension = size.x < size.y ? size.x : size.y;
+	return max( 4, (int)ceil( float( dimension ) * mMaxBlurDiameterFraction / 2.0f ) );
+}
+
+int MotionBlurEffect::getSampleRadius() const
+{
+	return getMaxBlurRadius() * 2 + 1;
+}
+
 namespace {
 
 // TODO: figure out what to do about this in PostProcess, or remove
 // - g3d MotionBlurUpdate uses a different size for the cached color buffer than the input color buffer to apply()
 ivec2 trimBandThickness = ivec2( 0 ); // ivec2( 64 );
 
+FrameGraph::TextureFormat bufferFormat( const ivec2 &size )
+{
+	// TODO: these settings make the tex format match g3d's, but probably don't want repeat on here.
+	return FrameGraph::TextureFormat( size, GL_RGB16F ).filter( GL_NEAREST ).wrap( GL_REPEAT );
 }
 
-void MotionBlurEffect::updateBuffers( const ivec2 &size, int maxBlurRadiusPixels )
+#if defined( CINDER_GL_HAS_COMPUTE_SHADER )
+
+// images need a four channel format, there is no rgb16f image format
+FrameGraph::TextureFormat computeBufferFormat( const ivec2 &size )
 {
-	const int w = size.x - trimBandThickness.x * 2;
-	const int h = size.y - trimBandThickness.y * 2;
+	return FrameGraph::TextureFormat( size, GL_RGBA16F ).filter( GL_NEAREST );
+}
 
-	// Tile boundaries will appear if the tiles are not radius x radius
-	const ivec2 smallSize  = ivec2( ceil( w / (float)maxBlurRadiusPixels ), ceil( h / (float)maxBlurRadiusPixels ) );
-	auto texFormat = gl::Texture::Format().internalFormat( GL_RGB16F );
+void bindImage( GLuint unit, const gl::Texture2dRef &texture, GLenum access )
+{
+	glBindImageTexture( unit, texture->getId(), 0, GL_FALSE, 0, access, texture->getInternalFormat() );
+}
 
-	// TODO: these settings make the tex format match g3d's, but probably don't want repeat on here.
-	texFormat.wrap( GL_REPEAT );
-	texFormat.magFilter( GL_NEAREST );
-	texFormat.minFilter( GL_NEAREST );
-
-	if( ! mFboTileMinMax || mFboTileMinMax->getSize() != smallSize ) {
-		CI_LOG_I( "creating interim Fbos of size: " << smallSize );
-		{
-			auto texTileMinMaxTemp = gl::Texture2d::create( h, smallSize.x, texFormat );
-			texTileMinMaxTemp->setLabel( "MotionBlur_tileMinMaxTemp" );
-			mFboTileMinMaxTemp = gl::Fbo::create( texTileMinMaxTemp->getWidth(), texTileMinMaxTemp->getHeight(), gl::Fbo::Format().attachment( GL_COLOR_ATTACHMENT0, texTileMinMaxTemp ).disableDepth() );
-		}
-		{
-			auto texTileMinMax = gl::Texture2d::create( smallSize.x, smallSize.y, texFormat );
-			texTileMinMax->setLabel( "MotionBlur_tileMinMax" );
-			mFboTileMinMax = gl::Fbo::create( texTileMinMax->getWidth(), texTileMinMax->getHeight(), gl::Fbo::Format().attachment( GL_COLOR_ATTACHMENT0, texTileMinMax ).disableDepth() );
-		}
-		{
-			auto texNeighborMinMax = gl::Texture2d::create( smallSize.x, smallSize.y, texFormat );
-			texNeighborMinMax->setLabel( "MotionBlur_neighborMinMax" );
-			mFboNeighborMinMax = gl::Fbo::create( texNeighborMinMax->getWidth(), texNeighborMinMax->getHeight(), gl::Fbo::Format().attachment( GL_COLOR_ATTACHMENT0, texNeighborMinMax ).disableDepth() );
-		}
-	}
+// Makes the image writes visible to later passes, which may sample the texture or, as the frame graph pools transient textures,
+// attach it to an fbo. The image unit is unbound so the texture isn't left bound as an image once it is handed to another pass.
+void finishImageWrites( GLuint unit )
+{
+	gl::memoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT );
+	glBindImageTexture( unit, 0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F );
+}
 
-	// TODO: rename FboReconstruct -> FboGather for consistency with G3D (review their arrangment again)
-	// - this name came from the previous impl (wicks)
-	if( ! mFboReconstruct || mFboReconstruct->getSize() != ivec2( w, h ) ) {
-		CI_LOG_I( "creating mFboReconstruct of size: " << ivec2( w, h ) );
-		auto texReconstruct	= gl::Texture2d::create( w, h, texFormat );
-		texReconstruct->setLabel( "MotionBlur_reconstruct" );
-		mFboReconstruct = gl::Fbo::create( texReconstruct->getWidth(), texReconstruct->getHeight(), gl::Fbo::Format().attachment( GL_COLOR_ATTACHMENT0, texReconstruct ).disableDepth() );
-	}
+ivec2 numGroups( const ivec2 &size, int groupSize )
+{
+	return ( size + ivec2( groupSize - 1 ) ) / groupSize;
 }
 
-void MotionBlurEffect::process( const ci::gl::FboRef &source )
+#endif
+
+} // anonymous namespace
+
+FrameGraph::ResourceId MotionBlurEffect::addPasses( FrameGraph &graph, FrameGraph::ResourceId color )
 {
 	CI_ASSERT( mNumSamples % 2 == 1 );
 	auto velocityTex = mPostProcess->getTexture( PostProcess::COLOR_ATTACHMENT_VELOCITY );
 	CI_ASSERT( velocityTex );
 	if( ! velocityTex )
-		return;
-
-	MA_PROFILE( "MotionBlur process" );
+		return color;
 
 	const ivec2 size = mPostProcess->getSize();
-	const int dimension = size.x < size.y ? size.x : size.y;
-	const int maxBlurRadiusPixels     = max( 4, (int)ceil( float( dimension ) * mMaxBlurDiameterFraction / 2.0f ) );
+	const int maxBlurRadiusPixels = getMaxBlurRadius();
 
+	if( isComputeActive() )
+		return addComputePasses( graph, color, velocityTex, maxBlurRadiusPixels );
+
+	if( ! mGlslTileMinMaxHorizontal || ! mGlslTileMinMax || ! mGlslNeighborMinMax || ! mGlslReconstruct )
+		return color;
+
+	const int w = size.x - trimBandThickness.x * 2;
+	const int h = size.y - trimBandThickness.y * 2;
+
+	// Tile boundaries will appear if the tiles are not radius x radius
+	const ivec2 smallSize  = ivec2( ceil( w / (float)maxBlurRadiusPixels ), ceil( h / (float)maxBlurRadiusPixels ) );
+
+	auto tileMinMaxTemp = graph.createTexture( "MotionBlur_tileMinMaxTemp", bufferFormat( ivec2( h, smallSize.x ) ) );
+	auto tileMinMax = graph.createTexture( "MotionBlur_tileMinMax", bufferFormat( smallSize ) );
+	auto neighborMinMax = graph.createTexture( "MotionBlur_neighborMinMax", bufferFormat( smallSize ) );
+	// TODO: rename reconstruct -> gather for consistency with G3D (review their arrangment again)
+	// - this name came from the previous impl (wicks)
+	auto reconstruct = graph.createTexture( "MotionBlur_reconstruct", bufferFormat( ivec2( w, h ) ) );
 
-	updateBuffers( size, maxBlurRadiusPixels );
+	// with dynamic resolution only the rendered part of each buffer is processed, the horizontal pass's buffer is transposed
+	const ivec2 tileMinMaxTempRegion = getRegionSize( ivec2( smallSize.x, h ) );
+	const ivec2 tileRegion = getRegionSize( smallSize );
+	const ivec2 reconstructRegion = getRegionSize( ivec2( w, h ) );
 
 	// TileMax: Each tile stores the dominant (i.e. highest magnitude) velocity for all the original values within that tile.
 	// horizontal pass
-	if( mGlslTileMinMaxHorizontal ) {
-		gl::ScopedFramebuffer scopedFbo( mFboTileMinMaxTemp );
-		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), mFboTileMinMaxTemp->getSize() );
+	graph.addPass( "MotionBlur tileMinMax (H)", {}, { tileMinMaxTemp }, [this, tileMinMaxTemp, velocityTex, maxBlurRadiusPixels, tileMinMaxTempRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( tileMinMaxTemp );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), fbo->getSize() );
 		gl::ScopedMatrices	matrices;
-		gl::setMatricesWindow( mFboTileMinMaxTemp->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 
 		mGlslTileMinMaxHorizontal->uniform( "maxBlurRadius", (int)maxBlurRadiusPixels );
 		mGlslTileMinMaxHorizontal->uniform( "inputShift", vec2( trimBandThickness ) );
@@ -166,55 +227,56 @@ void MotionBlurEffect::process( const ci::gl::FboRef &source )
 		gl::ScopedTextureBind scopedTex( velocityTex );
 		gl::ScopedGlslProg prog( mGlslTileMinMaxHorizontal );
 
-		gl::drawSolidRect( mFboTileMinMaxTemp->getBounds() );
-	}
+		drawRegion( fbo->getSize(), ivec2( tileMinMaxTempRegion.y, tileMinMaxTempRegion.x ) );
+	} );
 	// vertical pass
-	// TODO: simplify these passes into a base method such as renderToBuffer( fbo, glsl );
-	// - not sure yet if that will work for the reconstruct but will try
-	if( mGlslTileMinMax ) {
-		gl::ScopedFramebuffer scopedFbo( mFboTileMinMax );
-		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), mFboTileMinMax->getSize() );
+	graph.addPass( "MotionBlur tileMinMax (V)", { tileMinMaxTemp }, { tileMinMax }, [this, tileMinMaxTemp, tileMinMax, maxBlurRadiusPixels, tileRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( tileMinMax );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), fbo->getSize() );
 		gl::ScopedMatrices	matrices;
-		gl::setMatricesWindow( mFboTileMinMax->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 
 		mGlslTileMinMax->uniform( "maxBlurRadius", (int)maxBlurRadiusPixels );
 		mGlslTileMinMax->uniform( "inputShift", vec2( 0 ) );
 
-		gl::ScopedTextureBind scopedTex( mFboTileMinMaxTemp->getColorTexture() );
+		gl::ScopedTextureBind scopedTex( graph.getTexture( tileMinMaxTemp ) );
 		gl::ScopedGlslProg prog( mGlslTileMinMax );
 
-		gl::drawSolidRect( mFboTileMinMax->getBounds() );
-	}
+		drawRegion( fbo->getSize(), tileRegion );
+	} );
 
 	// NeighborMax: Each tile's dominant half-velocity is compared against its neighbors', and it stores the highest
 	// dominant velocity found. This effectively "smears" the highest velocities onto other neighboring tiles
-	if( mGlslNeighborMinMax ) {
-		gl::ScopedFramebuffer scopedFbo( mFboNeighborMinMax );
-		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), mFboNeighborMinMax->getSize() );
+	graph.addPass( "MotionBlur neighborMinMax", { tileMinMax }, { neighborMinMax }, [this, tileMinMax, neighborMinMax, tileRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( neighborMinMax );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), fbo->getSize() );
 		gl::ScopedMatrices	matrices;
-		gl::setMatricesWindow( mFboNeighborMinMax->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 
-		gl::ScopedTextureBind scopedTex( mFboTileMinMax->getColorTexture() );
+		gl::ScopedTextureBind scopedTex( graph.getTexture( tileMinMax ) );
 		gl::ScopedGlslProg prog( mGlslNeighborMinMax );
 
-		gl::drawSolidRect( mFboTileMinMax->getBounds() );
-	}
+		drawRegion( fbo->getSize(), tileRegion );
+	} );
 
 	// Reconstruct
-	if( mGlslReconstruct ) {
-		gl::ScopedFramebuffer scopedFbo( mFboReconstruct );
-		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), mFboReconstruct->getSize() );
+	graph.addPass( "MotionBlur reconstruct", { color, neighborMinMax }, { reconstruct }, [this, color, neighborMinMax, reconstruct, velocityTex, maxBlurRadiusPixels, reconstructRegion]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( reconstruct );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( ivec2( 0, 0 ), fbo->getSize() );
 		gl::ScopedMatrices	matrices;
-		gl::setMatricesWindow( mFboReconstruct->getSize() );
+		gl::setMatricesWindow( fbo->getSize() );
 
-		gl::ScopedTextureBind scopedTex0( source->getColorTexture(), 0 );
+		gl::ScopedTextureBind scopedTex0( graph.getTexture( color ), 0 );
 		gl::ScopedTextureBind scopedTex1( velocityTex, 1 );
 
-		gl::ScopedTextureBind scopedTex2( mFboNeighborMinMax->getColorTexture(), 2 );
+		gl::ScopedTextureBind scopedTex2( graph.getTexture( neighborMinMax ), 2 );
 
 		gl::TextureRef depthTex;
 		if( mPostProcess->getDepthSource() == DepthSource::Z_BUFFER ) {
-			depthTex = source->getDepthTexture();
+			depthTex = mPostProcess->getDepthTexture();
 			gl::context()->pushTextureBinding( depthTex->getTarget(), depthTex->getId(), 3 );
 		}
 		else {
@@ -234,13 +296,91 @@ void MotionBlurEffect::process( const ci::gl::FboRef &source )
 		mGlslReconstruct->uniform( "trimBandThickness", trimBandThickness );
 		mGlslReconstruct->uniform( "exposureTime", mExposureTimeFraction );
 
-		gl::drawSolidRect( source->getBounds() );
+		drawRegion( fbo->getSize(), reconstructRegion );
 
 		if( depthTex ) {
-			auto depthTex = source->getDepthTexture();
 			gl::context()->popTextureBinding( depthTex->getTarget(), 3 );
 		}
-	}
+	} );
+
+	return reconstruct;
+}
+
+FrameGraph::ResourceId MotionBlurEffect::addComputePasses( FrameGraph &graph, FrameGraph::ResourceId color, const gl::Texture2dRef &velocityTex, int maxBlurRadiusPixels )
+{
+#if defined( CINDER_GL_HAS_COMPUTE_SHADER )
+	// must match GROUP_SIZE in the compute shaders
+	const int neighborGroupSize = 8;
+	const int reconstructGroupSize = 16;
+
+	const ivec2 size = graph.getSize( color ) - trimBandThickness * 2;
+	const ivec2 smallSize = numGroups( size, maxBlurRadiusPixels );
+
+	auto tileMinMax = graph.createTexture( "MotionBlur_tileMinMax", computeBufferFormat( smallSize ) );
+	auto neighborMinMax = graph.createTexture( "MotionBlur_neighborMinMax", computeBufferFormat( smallSize ) );
+	auto reconstruct = graph.createTexture( "MotionBlur_reconstruct", computeBufferFormat( size ) );
+
+	// with dynamic resolution only the work groups covering the rendered part of each buffer are dispatched
+	const ivec2 tileRegion = getRegionSize( smallSize );
+	const ivec2 reconstructRegion = getRegionSize( size );
+
+	// TileMax: one work group per tile reduces both dimensions in shared memory, replacing the horizontal and vertical passes
+	graph.addPass( "MotionBlur tileMinMax (compute)", {}, { tileMinMax }, [this, tileMinMax, velocityTex, tileRegion, maxBlurRadiusPixels]( const FrameGraph &graph ) {
+		gl::ScopedGlslProg prog( mGlslTileMinMaxCompute );
+		gl::ScopedTextureBind scopedTex( velocityTex, 0 );
+		bindImage( 0, graph.getTexture( tileMinMax ), GL_WRITE_ONLY );
+
+		mGlslTileMinMaxCompute->uniform( "uMaxBlurRadius", maxBlurRadiusPixels );
+		mGlslTileMinMaxCompute->uniform( "uExposureTime", mExposureTimeFraction );
+		mGlslTileMinMaxCompute->uniform( "uInputShift", trimBandThickness );
+
+		gl::dispatchCompute( tileRegion.x, tileRegion.y );
+		finishImageWrites( 0 );
+	} );
+
+	graph.addPass( "MotionBlur neighborMinMax (compute)", { tileMinMax }, { neighborMinMax }, [this, tileMinMax, neighborMinMax, tileRegion, neighborGroupSize]( const FrameGraph &graph ) {
+		gl::ScopedGlslProg prog( mGlslNeighborMinMaxCompute );
+		gl::ScopedTextureBind scopedTex( graph.getTexture( tileMinMax ), 0 );
+		bindImage( 0, graph.getTexture( neighborMinMax ), GL_WRITE_ONLY );
+
+		const ivec2 groups = numGroups( tileRegion, neighborGroupSize );
+		gl::dispatchCompute( groups.x, groups.y );
+		finishImageWrites( 0 );
+	} );
+
+	graph.addPass( "MotionBlur reconstruct (compute)", { color, neighborMinMax }, { reconstruct }, [this, color, neighborMinMax, reconstruct, velocityTex, reconstructRegion, maxBlurRadiusPixels, reconstructGroupSize]( const FrameGraph &graph ) {
+		gl::ScopedGlslProg prog( mGlslReconstructCompute );
+		gl::ScopedTextureBind scopedTex0( graph.getTexture( color ), 0 );
+		gl::ScopedTextureBind scopedTex1( velocityTex, 1 );
+		gl::ScopedTextureBind scopedTex2( graph.getTexture( neighborMinMax ), 2 );
+		bindImage( 0, graph.getTexture( reconstruct ), GL_WRITE_ONLY );
+
+		unique_ptr<gl::ScopedTextureBind> scopedDepthTex;
+		if( mPostProcess->getDepthSource() == DepthSource::Z_BUFFER ) {
+			scopedDepthTex = make_unique<gl::ScopedTextureBind>( mPostProcess->getDepthTexture(), 3 );
+			mGlslReconstructCompute->uniform( "uCameraRange", vec2( mPostProcess->getCamera().getNearClip(), mPostProcess->getCamera().getFarClip() ) );
+		}
+		else {
+			// require that depth is provided via color alpha channel
+			CI_ASSERT( mPostProcess->getDepthSource() == DepthSource::COLOR_ALPHA_CHANNEL );
+		}
+
+		mGlslReconstructCompute->uniform( "uMaxBlurRadius", maxBlurRadiusPixels );
+		mGlslReconstructCompute->uniform( "uExposureTime", mExposureTimeFraction );
+		mGlslReconstructCompute->uniform( "uNumSamples", mNumSamples );
+		mGlslReconstructCompute->uniform( "uMinSamples", min( mMinSamples, mNumSamples ) );
+		mGlslReconstructCompute->uniform( "uAdaptiveSamples", mAdaptiveSamples );
+		mGlslReconstructCompute->uniform( "uSoftZExtent", mSoftZExtent );
+
+		const ivec2 groups = numGroups( reconstructRegion, reconstructGroupSize );
+		gl::dispatchCompute( groups.x, groups.y );
+		finishImageWrites( 0 );
+	} );
+
+	return reconstruct;
+#else
+	return color;
+#endif
 }
 
 void MotionBlurEffect::updateUI()
@@ -259,17 +399,21 @@ void MotionBlurEffect::updateUI()
 	// in fraction of frame duration
 	im::DragFloat( "exposure", &mExposureTimeFraction, 0.01f, 0, 3 );
 
-	if( im::CollapsingHeader( "buffers" ) ) {
-		imx::TextureViewerOptions opts;
-		opts.mTreeNodeFlags = ImGuiTreeNodeFlags_DefaultOpen;
-		if( mFboTileMinMax ) {
-			imx::Texture2d( "tileMinMax", mFboTileMinMax->getColorTexture(), opts );
-			imx::Texture2d( "neighborMinMax", mFboNeighborMinMax->getColorTexture(), opts );
-		}
-		if( mFboReconstruct ) {
-			imx::Texture2d( "reconstruct", mFboReconstruct->getColorTexture(), opts );
+#if defined( CINDER_GL_HAS_COMPUTE_SHADER )
+	im::Checkbox( "compute", &mComputeEnabled );
+	if( mComputeEnabled && ! isComputeActive() ) {
+		im::SameLine();
+		im::TextColored( ImVec4( 1, 0.5f, 0, 1 ), "(shaders not loaded)" );
+	}
+	if( isComputeActive() ) {
+		im::Checkbox( "adaptive samples", &mAdaptiveSamples );
+		int minSamples = mMinSamples;
+		if( mAdaptiveSamples && im::DragInt( "min samples", &minSamples, 0.05f, 1, mNumSamples ) ) {
+			setMinSamples( minSamples );
 		}
+		im::DragFloat( "soft z extent", &mSoftZExtent, 0.001f, 0.001f, 10 );
 	}
+#endif
 }
 
 } // namespace mason::scene
\ No newline at end of file
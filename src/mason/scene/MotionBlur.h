@@ -33,25 +33,34 @@ class MotionBlurEffect : public PostEffect {
 public:
 	MotionBlurEffect( PostProcess *postProcess );
 
-	void process( const ci::gl::FboRef &source ) override;
+	//! Returns \a color unchanged until all shaders are loaded.
+	FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId color ) override;
+	//! Reconstruct gathers up to the max blur radius along the dominant velocity of a tile's neighborhood, which reaches one tile further.
+	int getSampleRadius() const override;
 
 	void updateUI();
 
-	ci::gl::Texture2dRef	getTextureTileMinMaxHorizontal() const	{ return mFboTileMinMaxTemp->getColorTexture(); }
-	ci::gl::Texture2dRef	getTextureTileMinMax() const	{ return mFboTileMinMax->getColorTexture(); }
-	ci::gl::Texture2dRef	getTextureNeighorMinMax() const	{ return mFboNeighborMinMax->getColorTexture(); }
-	ci::gl::Texture2dRef	getTextureReconstruct() const	{ return mFboReconstruct->getColorTexture(); }
-
-	ci::gl::FboRef	getDestFbo() const	{ return mFboReconstruct; }
-
 	int getNumSamples() const	{ return mNumSamples; }
 	void setNumSamples( int samples );
 
+	//! Sets whether the tile, neighbor and reconstruct passes run as compute shaders when available. Defaults to true.
+	void setComputeEnabled( bool enabled )	{ mComputeEnabled = enabled; }
+	//! Returns true if the compute shader path is enabled and its shaders are loaded.
+	bool isComputeActive() const;
+	//! Sets whether reconstruct scales its number of samples with the tile velocity (compute path only). Defaults to true.
+	void setAdaptiveSamplesEnabled( bool enabled )	{ mAdaptiveSamples = enabled; }
+	bool isAdaptiveSamplesEnabled() const	{ return mAdaptiveSamples; }
+	//! Sets the number of samples used for the slowest tiles that are still blurred when adaptive samples are enabled.
+	void setMinSamples( int samples );
+	int getMinSamples() const	{ return mMinSamples; }
+
 private:
-	void updateBuffers( const ci::ivec2 &size, int maxBlurRadiusPixels );
+	//! Returns the max blur radius in pixels, which is also the tile size
+	int getMaxBlurRadius() const;
+	FrameGraph::ResourceId addComputePasses( FrameGraph &graph, FrameGraph::ResourceId color, const ci::gl::Texture2dRef &velocityTex, int maxBlurRadiusPixels );
 
-	ci::gl::FboRef					mFboTileMinMaxTemp, mFboTileMinMax, mFboNeighborMinMax, mFboReconstruct;
 	ci::gl::GlslProgRef				mGlslTileMinMaxHorizontal, mGlslTileMinMax, mGlslNeighborMinMax, mGlslReconstruct;
+	ci::gl::GlslProgRef				mGlslTileMinMaxCompute, mGlslNeighborMinMaxCompute, mGlslReconstructCompute;
 	ci::signals::ConnectionList		mConnections;
 
 	// ------------
@@ -64,6 +73,12 @@ private:
 	float	mMaxBlurDiameterFraction = 0.1f;
 	// Fraction of the frame interval during which the shutter is open. Larger values create more motion blur.
 	float	mExposureTimeFraction    = 0.75f;
+	// Depth range over which reconstruct fades samples between foreground and background (compute path only)
+	float	mSoftZExtent = 0.1f;
+
+	bool	mComputeEnabled = true;
+	bool	mAdaptiveSamples = true;
+	int		mMinSamples = 5;
 };
 
 } // namespace mason::scene
\ No newline at end of file
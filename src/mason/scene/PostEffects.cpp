@@ -53,80 +53,157 @@ PostEffect::~PostEffect()
 {
 }
 
+void PostEffect::drawRegion( const ivec2 &size, const ivec2 &regionSize )
+{
+	// window coordinates start at the upper left, so the lower left region spans to the bottom of the window
+	const vec2 texCoordMax = vec2( regionSize ) / vec2( size );
+	const Rectf rect( 0, float( size.y - regionSize.y ), float( regionSize.x ), float( size.y ) );
+	gl::drawSolidRect( rect, vec2( 0, texCoordMax.y ), vec2( texCoordMax.x, 0 ) );
+}
 
-// ----------------------------------------------------------------------------------------------------
-// BloomEffect
-// ----------------------------------------------------------------------------------------------------
-
-BloomEffect::BloomEffect( PostProcess *postProcess, const ivec2 &size )
-	: PostEffect( postProcess )
+ivec2 PostEffect::getRegionSize( const ivec2 &size, bool withMargin ) const
 {
-	// TODO: add method that returns gl color format instead (when 8 and 16-bit support is added)
-	GLint internalFormat = postProcess->getColorFormat() == ColorFormat::RGBA32 ? GL_RGBA32F : GL_RGB32F;
+	if( mRenderScale == vec2( 1 ) )
+		return size;
 
-	auto texFormat = gl::Texture::Format()
-		.internalFormat( internalFormat )
-		.wrap( GL_CLAMP_TO_EDGE )
-	;
+	// the epsilon keeps a buffer of the scene's size from rounding up past the render size
+	vec2 region = vec2( size ) * mRenderScale - vec2( 0.001f );
+	if( withMargin )
+		region += float( mRenderMargin ) * vec2( size ) / vec2( mPostProcess->getSize() );
 
-	auto fboFormat1 = gl::Fbo::Format().disableDepth();
-	auto fboFormat2 = fboFormat1; // need a second copy as we create two Textures
-	fboFormat1.attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( size.x, size.y, texFormat.label( "BloomEffect blur 1" ) ) );
-	fboFormat2.attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( size.x, size.y, texFormat.label( "BloomEffect blur 2" ) ) );
+	return glm::clamp( ivec2( glm::ceil( region ) ), ivec2( 1 ), size );
+}
 
-	mFboBlur1 = gl::Fbo::create( size.x, size.y, fboFormat1.label( "BloomEffect blur 1" ) );
-	mFboBlur2 = gl::Fbo::create( size.x, size.y, fboFormat2.label( "BloomEffect blur 1" ) );
 
-	mConnGlsl = ma::assets()->getShader( "mason/passthrough.vert", "mason/post/blur.frag", [this]( gl::GlslProgRef glsl ) {
-		glsl->uniform( "uTexColor", 0 );
+// ----------------------------------------------------------------------------------------------------
+// BloomEffect
+// ----------------------------------------------------------------------------------------------------
 
-		mGlslBlur = glsl;
-	} );
-}
+namespace {
 
-void BloomEffect::process( const ci::gl::FboRef &source )
+void drawLevel( const gl::FboRef &fbo, const gl::GlslProgRef &glsl, const ivec2 &regionSize )
 {
-	if( ! mGlslBlur )
-		return;
-
-	// first pass: horizontal
-	{
-		gl::ScopedFramebuffer scopedFbo( mFboBlur1 );
-		gl::ScopedViewport scopedViewport( 0, 0, mFboBlur1->getWidth(), mFboBlur1->getHeight() );
-		gl::ScopedMatrices scopedMatrices;
-		gl::setMatricesWindow( mFboBlur1->getSize() );
+	gl::ScopedFramebuffer scopedFbo( fbo );
+	gl::ScopedViewport scopedViewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+	gl::ScopedMatrices scopedMatrices;
+	gl::setMatricesWindow( fbo->getSize() );
 
-		gl::ScopedGlslProg glslScope( mGlslBlur );
+	gl::ScopedGlslProg glslScope( glsl );
+	PostEffect::drawRegion( fbo->getSize(), regionSize );
+}
 
-		// blur horizontally and the size of 1 pixel
-		mGlslBlur->uniform( "uSampleOffset", vec2( 1.0f / mFboBlur1->getWidth(), 0.0f ) );
+// texture coordinate of the center of the last texel in \a regionSize, the taps of a level clamp to it so they don't read
+// past the render size
+vec2 coordMax( const ivec2 &size, const ivec2 &regionSize )
+{
+	return ( vec2( regionSize ) - vec2( 0.5f ) ) / vec2( size );
+}
 
-# if SCENE_GLOW_ENABLED
-		auto glowTex = mPostProcess->getTexture( PostProcess::COLOR_ATTACHMENT_GLOW );
-		gl::ScopedTextureBind scopedTex0( glowTex, 0 );
-#endif
+} // anonymous namespace
 
-		gl::clear();
-		gl::drawSolidRect( mFboBlur1->getBounds() );
-	}
+BloomEffect::BloomEffect( PostProcess *postProcess, const ivec2 &size )
+	: PostEffect( postProcess ), mSize( size )
+{
+	mConnections += ma::assets()->getShader( "mason/passthrough.vert", "mason/post/bloom/downsample.frag",
+		gl::GlslProg::Format().define( "PREFILTER" ).label( "Bloom prefilter" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexColor", 0 );
+			mGlslPrefilter = glsl;
+		}
+	);
 
-	// second pass: vertical
-	{
-		gl::ScopedFramebuffer scopedFbo( mFboBlur2 );
-		gl::ScopedViewport scopedViewport( 0, 0, mFboBlur2->getWidth(), mFboBlur2->getHeight() );
-		gl::ScopedMatrices scopedMatrices;
-		gl::setMatricesWindow( mFboBlur2->getSize() );
+	mConnections += ma::assets()->getShader( "mason/passthrough.vert", "mason/post/bloom/downsample.frag",
+		gl::GlslProg::Format().label( "Bloom downsample" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexColor", 0 );
+			mGlslDownsample = glsl;
+		}
+	);
+
+	mConnections += ma::assets()->getShader( "mason/passthrough.vert", "mason/post/bloom/upsample.frag",
+		gl::GlslProg::Format().label( "Bloom upsample" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexLower", 0 );
+			glsl->uniform( "uTexColor", 1 );
+			mGlslUpsample = glsl;
+		}
+	);
+}
 
-		gl::ScopedGlslProg glslScope( mGlslBlur );
+void BloomEffect::setNumLevels( int levels )
+{
+	mNumLevels = glm::clamp( levels, 2, 10 );
+}
 
-		// blur vertically the size of 1 pixel
-		mGlslBlur->uniform( "uSampleOffset", vec2( 0.0f, 1.0f / mFboBlur2->getHeight() ) );
+FrameGraph::ResourceId BloomEffect::addPasses( FrameGraph &graph, FrameGraph::ResourceId color )
+{
+#if SCENE_GLOW_ENABLED
+	if( ! mGlslPrefilter || ! mGlslDownsample || ! mGlslUpsample )
+		return FrameGraph::INVALID_RESOURCE;
 
-		gl::ScopedTextureBind tex0( mFboBlur1->getColorTexture(), 0 );
+	// TODO: add method that returns gl color format instead (when 8 and 16-bit support is added)
+	GLint internalFormat = mPostProcess->getColorFormat() == ColorFormat::RGBA32 ? GL_RGBA32F : GL_RGB32F;
+
+	auto glow = graph.importTexture( "PostProcess Glow", mPostProcess->getTexture( PostProcess::COLOR_ATTACHMENT_GLOW ) );
+
+	// downsample, thresholding into the first level. Each level is a separate pass so it's profiled separately
+	vector<FrameGraph::ResourceId> levels;
+	auto source = glow;
+	ivec2 levelSize = mSize;
+	for( int i = 0; i < mNumLevels; i++ ) {
+		levelSize = glm::max( levelSize / 2, ivec2( 1 ) );
+
+		const string name = "Bloom down " + to_string( i );
+		auto level = graph.createTexture( name, FrameGraph::TextureFormat( levelSize, internalFormat ) );
+		auto glsl = i == 0 ? mGlslPrefilter : mGlslDownsample;
+
+		graph.addPass( name, { source }, { level }, [this, glsl, source, level, i]( const FrameGraph &graph ) {
+			const ivec2 sourceSize = graph.getSize( source );
+			glsl->uniform( "uHalfTexel", 0.5f / vec2( sourceSize ) );
+			glsl->uniform( "uCoordMax", coordMax( sourceSize, getRegionSize( sourceSize, false ) ) );
+			if( i == 0 ) {
+				glsl->uniform( "uThreshold", mThreshold );
+				glsl->uniform( "uKnee", mKnee );
+			}
+
+			gl::ScopedTextureBind scopedTex0( graph.getTexture( source ), 0 );
+			drawLevel( graph.getFbo( level ), glsl, getRegionSize( graph.getSize( level ), false ) );
+		} );
+
+		levels.push_back( level );
+		source = level;
+
+		if( levelSize.x == 1 || levelSize.y == 1 )
+			break;
+	}
 
-		gl::clear();
-		gl::drawSolidRect( mFboBlur2->getBounds() );
+	// upsample back to the first level, adding the downsampled level of the same size
+	auto lower = levels.back();
+	for( int i = (int)levels.size() - 2; i >= 0; i-- ) {
+		const string name = "Bloom up " + to_string( i );
+		auto current = levels[i];
+		auto level = graph.createTexture( name, FrameGraph::TextureFormat( graph.getSize( current ), internalFormat ) );
+		// each upsample adds a level, so the sum is divided by their number to keep the brightness of the glow buffer
+		const float scale = i == 0 ? mIntensity / float( levels.size() ) : 1.0f;
+
+		graph.addPass( name, { lower, current }, { level }, [this, lower, current, level, scale]( const FrameGraph &graph ) {
+			const ivec2 lowerSize = graph.getSize( lower );
+			mGlslUpsample->uniform( "uHalfTexel", 0.5f / vec2( lowerSize ) );
+			mGlslUpsample->uniform( "uCoordMax", coordMax( lowerSize, getRegionSize( lowerSize, false ) ) );
+			mGlslUpsample->uniform( "uScale", scale );
+
+			gl::ScopedTextureBind scopedTex0( graph.getTexture( lower ), 0 );
+			gl::ScopedTextureBind scopedTex1( graph.getTexture( current ), 1 );
+			drawLevel( graph.getFbo( level ), mGlslUpsample, getRegionSize( graph.getSize( level ), false ) );
+		} );
+
+		lower = level;
 	}
+
+	return lower;
+#else
+	return FrameGraph::INVALID_RESOURCE;
+#endif
 }
 
 // ----------------------------------------------------------------------------------------------------
@@ -398,34 +475,75 @@ void SMAA::draw( const gl::Texture2dRef &source, const Area &bounds )
 	createBuffers( width, height );
 
 	// Apply first two passes.
-	doEdgePass( source );
-	doBlendPass();
+	doEdgePass( source, mFboEdgePass );
+	doBlendPass( mFboEdgePass->getColorTexture(), mFboBlendPass );
 
 	// Apply SMAA.
-	{
-		gl::ScopedTextureBind tex0( source );
-		gl::ScopedTextureBind tex1( mFboBlendPass->getColorTexture(), 1 );
-		mBatchThirdPass->getGlslProg()->uniform( "SMAA_RT_METRICS", mMetrics );
-		mBatchThirdPass->getGlslProg()->uniform( "uColorTex", 0 );
-		mBatchThirdPass->getGlslProg()->uniform( "uBlendTex", 1 );
-
-		gl::ScopedModelMatrix modelScope;
-		gl::translate( bounds.getUL() );
-		gl::scale( bounds.getWidth(), bounds.getHeight(), 1.0f );
-
-		mBatchThirdPass->draw();
-	}
+	doNeighborhoodBlendPass( source, mFboBlendPass->getColorTexture(), bounds );
+}
+
+FrameGraph::ResourceId SMAA::addEdgeAndBlendPasses( FrameGraph &graph, FrameGraph::ResourceId source )
+{
+	if( ! mBatchFirstPass || ! mBatchSecondPass || ! mBatchThirdPass )
+		return FrameGraph::INVALID_RESOURCE;
+
+	const ivec2 size = graph.getSize( source );
+	mMetrics = vec4( 1.0f / size.x, 1.0f / size.y, (float)size.x, (float)size.y );
+
+	auto format = FrameGraph::TextureFormat( size, GL_RGBA8 );
+	auto edges = graph.createTexture( "SMAA edges", format );
+	auto blend = graph.createTexture( "SMAA blend", format );
+
+	graph.addPass( "SMAA edge detection", { source }, { edges }, [this, source, edges]( const FrameGraph &graph ) {
+		doEdgePass( graph.getTexture( source ), graph.getFbo( edges ) );
+	} );
+	graph.addPass( "SMAA blending weights", { edges }, { blend }, [this, edges, blend]( const FrameGraph &graph ) {
+		doBlendPass( graph.getTexture( edges ), graph.getFbo( blend ) );
+	} );
+
+	return blend;
 }
 
-void SMAA::doEdgePass( const gl::Texture2dRef &source )
+void SMAA::addPasses( FrameGraph &graph, FrameGraph::ResourceId source, const Area &bounds )
+{
+	auto blend = addEdgeAndBlendPasses( graph, source );
+	if( blend == FrameGraph::INVALID_RESOURCE )
+		return;
+
+	graph.addOutputPass( "SMAA neighborhood blending", { source, blend }, [this, source, blend, bounds]( const FrameGraph &graph ) {
+		doNeighborhoodBlendPass( graph.getTexture( source ), graph.getTexture( blend ), bounds );
+	} );
+}
+
+FrameGraph::ResourceId SMAA::addPasses( FrameGraph &graph, FrameGraph::ResourceId source )
+{
+	auto blend = addEdgeAndBlendPasses( graph, source );
+	if( blend == FrameGraph::INVALID_RESOURCE )
+		return source;
+
+	auto result = graph.createTexture( "SMAA result", FrameGraph::TextureFormat( graph.getSize( source ), GL_RGBA8 ) );
+	graph.addPass( "SMAA neighborhood blending", { source, blend }, { result }, [this, source, blend, result]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( result );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+		gl::ScopedMatrices scopedMatrices;
+		gl::setMatricesWindow( fbo->getSize() );
+
+		doNeighborhoodBlendPass( graph.getTexture( source ), graph.getTexture( blend ), fbo->getBounds() );
+	} );
+
+	return result;
+}
+
+void SMAA::doEdgePass( const gl::Texture2dRef &source, const gl::FboRef &dest )
 {
 	// Enable frame buffer, bind textures and shader.
-	gl::ScopedFramebuffer fbo( mFboEdgePass );
+	gl::ScopedFramebuffer fbo( dest );
 
-	gl::ScopedViewport viewportScope( 0, 0, mFboEdgePass->getWidth(), mFboEdgePass->getHeight() );
+	gl::ScopedViewport viewportScope( 0, 0, dest->getWidth(), dest->getHeight() );
 
 	gl::ScopedMatrices matScope;
-	gl::setMatricesWindow( mFboEdgePass->getSize() );
+	gl::setMatricesWindow( dest->getSize() );
 
 	gl::clear( ColorA( 0, 0, 0, 0 ) );
 
@@ -434,17 +552,23 @@ void SMAA::doEdgePass( const gl::Texture2dRef &source )
 	mBatchFirstPass->getGlslProg()->uniform( "uColorTex", 0 );
 
 	gl::ScopedModelMatrix modelScope;
-	gl::scale( mFboEdgePass->getWidth(), mFboEdgePass->getHeight(), 1.0f );
+	gl::scale( dest->getWidth(), dest->getHeight(), 1.0f );
 
 	mBatchFirstPass->draw();
 }
 
-void SMAA::doBlendPass()
+void SMAA::doBlendPass( const gl::Texture2dRef &edges, const gl::FboRef &dest )
 {
-	gl::ScopedFramebuffer fbo( mFboBlendPass );
+	gl::ScopedFramebuffer fbo( dest );
+
+	gl::ScopedViewport viewportScope( 0, 0, dest->getWidth(), dest->getHeight() );
+
+	gl::ScopedMatrices matScope;
+	gl::setMatricesWindow( dest->getSize() );
+
 	gl::clear( ColorA( 0, 0, 0, 0 ) );
 
-	gl::ScopedTextureBind tex0( mFboEdgePass->getColorTexture() );
+	gl::ScopedTextureBind tex0( edges );
 	gl::ScopedTextureBind tex1( mAreaTex, 1 );
 	gl::ScopedTextureBind tex2( mSearchTex, 2 );
 	mBatchSecondPass->getGlslProg()->uniform( "SMAA_RT_METRICS", mMetrics );
@@ -453,11 +577,26 @@ void SMAA::doBlendPass()
 	mBatchSecondPass->getGlslProg()->uniform( "uSearchTex", 2 );
 
 	gl::ScopedModelMatrix modelScope;
-	gl::scale( mFboBlendPass->getWidth(), mFboBlendPass->getHeight(), 1.0f );
+	gl::scale( dest->getWidth(), dest->getHeight(), 1.0f );
 
 	mBatchSecondPass->draw();
 }
 
+void SMAA::doNeighborhoodBlendPass( const gl::Texture2dRef &source, const gl::Texture2dRef &blend, const Area &bounds )
+{
+	gl::ScopedTextureBind tex0( source );
+	gl::ScopedTextureBind tex1( blend, 1 );
+	mBatchThirdPass->getGlslProg()->uniform( "SMAA_RT_METRICS", mMetrics );
+	mBatchThirdPass->getGlslProg()->uniform( "uColorTex", 0 );
+	mBatchThirdPass->getGlslProg()->uniform( "uBlendTex", 1 );
+
+	gl::ScopedModelMatrix modelScope;
+	gl::translate( bounds.getUL() );
+	gl::scale( bounds.getWidth(), bounds.getHeight(), 1.0f );
+
+	mBatchThirdPass->draw();
+}
+
 
 void SMAA::updateUI()
 {
@@ -471,7 +610,8 @@ void SMAA::updateUI()
 		setPreset( (Preset)t );
 	}
 
-	if( im::CollapsingHeader( "buffers" ) ) {
+	// buffers only exist when drawing with draw(), PostProcess uses transient buffers from its FrameGraph
+	if( mFboEdgePass && im::CollapsingHeader( "buffers" ) ) {
 		imx::TextureViewerOptions opts;
 		opts.mTreeNodeFlags = ImGuiTreeNodeFlags_DefaultOpen;
 
@@ -485,4 +625,128 @@ void SMAA::updateUI()
 	}
 }
 
+// ----------------------------------------------------------------------------------------------------
+// TAA
+// ----------------------------------------------------------------------------------------------------
+
+namespace {
+
+float halton( size_t index, size_t base )
+{
+	float result = 0;
+	float f = 1;
+	while( index > 0 ) {
+		f /= (float)base;
+		result += f * (float)( index % base );
+		index /= base;
+	}
+
+	return result;
+}
+
+} // anonymous namespace
+
+TAA::TAA()
+{
+	mConnections += ma::assets()->getShader( "mason/passthrough.vert", "mason/aa/taa/taa.frag",
+		gl::GlslProg::Format().label( "TAA resolve" ),
+		[this]( gl::GlslProgRef glsl ) {
+			glsl->uniform( "uTexColor", 0 );
+			glsl->uniform( "uTexHistory", 1 );
+			glsl->uniform( "uTexVelocity", 2 );
+			mGlslResolve = glsl;
+		}
+	);
+}
+
+vec2 TAA::getJitter() const
+{
+	if( ! mJitterEnabled )
+		return vec2( 0 );
+
+	// skip index 0, which is zero in both dimensions
+	const size_t index = ( mFrameIndex % mNumJitterSamples ) + 1;
+	return vec2( halton( index, 2 ), halton( index, 3 ) ) - vec2( 0.5f );
+}
+
+void TAA::jitterCamera( CameraPersp *camera, const ivec2 &size ) const
+{
+	// lens shift is in normalized device coordinates, which span two units over the viewport
+	vec2 shift = 2.0f * getJitter() / vec2( size );
+	camera->setLensShift( camera->getLensShift() + shift );
+}
+
+void TAA::setNumJitterSamples( int samples )
+{
+	mNumJitterSamples = glm::clamp( samples, 1, 64 );
+}
+
+FrameGraph::ResourceId TAA::addPasses( FrameGraph &graph, FrameGraph::ResourceId source, const gl::Texture2dRef &velocity )
+{
+	if( ! mGlslResolve || ! velocity ) {
+		mHistoryValid = false;
+		return source;
+	}
+
+	const ivec2 size = graph.getSize( source );
+	if( ! mFboHistory[0] || mFboHistory[0]->getSize() != size ) {
+		auto texFormat = gl::Texture2d::Format().internalFormat( GL_RGBA8 ).minFilter( GL_LINEAR ).magFilter( GL_LINEAR ).wrap( GL_CLAMP_TO_EDGE );
+		for( size_t i = 0; i < 2; i++ ) {
+			mFboHistory[i] = gl::Fbo::create( size.x, size.y, gl::Fbo::Format().colorTexture( texFormat ).disableDepth().label( "TAA history " + to_string( i ) ) );
+		}
+		mHistoryValid = false;
+	}
+
+	auto historyPrev = graph.importFbo( "TAA history (previous)", mFboHistory[mHistoryIndex ^ 1] );
+	auto history = graph.importFbo( "TAA history", mFboHistory[mHistoryIndex] );
+	const bool historyValid = mHistoryValid;
+
+	graph.addPass( "TAA resolve", { source, historyPrev }, { history }, [this, source, historyPrev, history, velocity, historyValid]( const FrameGraph &graph ) {
+		const auto &fbo = graph.getFbo( history );
+		gl::ScopedFramebuffer scopedFbo( fbo );
+		gl::ScopedViewport scopedViewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+		gl::ScopedMatrices scopedMatrices;
+		gl::setMatricesWindow( fbo->getSize() );
+
+		mGlslResolve->uniform( "uFeedbackMin", mFeedbackMin );
+		mGlslResolve->uniform( "uFeedbackMax", mFeedbackMax );
+		mGlslResolve->uniform( "uHistoryValid", historyValid );
+		mGlslResolve->uniform( "uRenderScale", mRenderScale );
+
+		gl::ScopedGlslProg scopedGlsl( mGlslResolve );
+		gl::ScopedTextureBind scopedTex0( graph.getTexture( source ), 0 );
+		gl::ScopedTextureBind scopedTex1( graph.getTexture( historyPrev ), 1 );
+		gl::ScopedTextureBind scopedTex2( velocity, 2 );
+
+		gl::drawSolidRect( fbo->getBounds() );
+	} );
+
+	mHistoryIndex ^= 1;
+	mHistoryValid = true;
+	return history;
+}
+
+void TAA::nextFrame()
+{
+	mFrameIndex++;
+}
+
+void TAA::updateUI()
+{
+	im::Checkbox( "jitter", &mJitterEnabled );
+	int samples = mNumJitterSamples;
+	if( im::SliderInt( "jitter samples", &samples, 1, 64 ) ) {
+		setNumJitterSamples( samples );
+	}
+	vec2 jitter = getJitter();
+	im::Text( "jitter: [%0.3f, %0.3f]", jitter.x, jitter.y );
+
+	im::SliderFloat( "feedback min", &mFeedbackMin, 0, 1 );
+	im::SliderFloat( "feedback max", &mFeedbackMax, 0, 1 );
+
+	if( im::Button( "reset history" ) ) {
+		resetHistory();
+	}
+}
+
 } // namespace mason::scene
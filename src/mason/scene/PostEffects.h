@@ -21,8 +21,11 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include "mason/scene/FrameGraph.h"
+
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/Batch.h"
+#include "cinder/Camera.h"
 #include "cinder/Signals.h"
 #include "cinder/Exception.h"
 
@@ -35,26 +38,68 @@ class PostEffect {
 	PostEffect( PostProcess *postProcess );
 	virtual ~PostEffect();
 
-	//! Processes \t source's color buffer, placing the result in \t dest.
-	virtual void process( const ci::gl::FboRef &source ) = 0;
+	//! Adds the passes that process \a color to \a graph, returning the resource that holds the result. Buffers the passes
+	//! render into should be created with the graph, so they can be shared with other effects.
+	virtual FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId color ) = 0;
+
+	//! Returns how far past a pixel the passes sample their input, in pixels of the scene buffers. When the scene is rendered at a
+	//! lower resolution, PostProcess replicates the edge of the render size that far so these samples read what they would at
+	//! the edge of the full buffers. Effects that clamp to the render size themselves return 0, which is the default.
+	virtual int getSampleRadius() const	{ return 0; }
+	//! Sets the part of the scene buffers that was rendered to relative to their size, and the \a margin in pixels past it that
+	//! was replicated from its edge. Passes only process that part of their buffers. Called by PostProcess every frame.
+	void	setRenderRegion( const ci::vec2 &scale, int margin )	{ mRenderScale = scale; mRenderMargin = margin; }
+	const ci::vec2&	getRenderScale() const	{ return mRenderScale; }
+
+	//! Draws the lower left \a regionSize of a framebuffer of \a size, where the render viewport is, with texture coordinates
+	//! covering the same fraction of the buffer. Expects the matrices to be set to the window of \a size.
+	static void	drawRegion( const ci::ivec2 &size, const ci::ivec2 &regionSize );
 
   protected:
-	  PostProcess* mPostProcess = nullptr;
+	//! Returns the lower left part of a buffer of \a size that covers the render region, including the margin if \a withMargin is true.
+	ci::ivec2	getRegionSize( const ci::ivec2 &size, bool withMargin = true ) const;
+
+	PostProcess*	mPostProcess = nullptr;
+	ci::vec2		mRenderScale = ci::vec2( 1 );
+	int				mRenderMargin = 0;
 };
 
+//! \brief Mip-chain bloom of the glow buffer, using the dual filter.
+//!
+//! The glow buffer is thresholded and downsampled into a chain of levels that each halve the size, then upsampled back through
+//! the chain, adding each level along the way. Every pass samples a small, fixed kernel so the bloom gets wider with more levels
+//! rather than with more samples, and most of the work happens at low resolutions. With dynamic resolution the levels only cover
+//! the render size, and taps past its edge are clamped to it.
 class BloomEffect : public PostEffect {
   public:
 	// TODO: get rid of size param, match what motion blur does
 	BloomEffect( PostProcess *postProcess, const ci::ivec2 &size );
 
-	void process( const ci::gl::FboRef &source ) override;
-
-	ci::gl::Texture2dRef	getTexture() const	{ return mFboBlur2->getColorTexture(); }
+	//! Blooms the glow buffer, \a color isn't used. Returns the bloom at half of size, or FrameGraph::INVALID_RESOURCE if the shaders aren't loaded.
+	FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId color ) override;
+
+	//! Sets the number of levels in the chain, the first being half of size. More levels give a wider bloom. Clamped to [2:10], defaults to 5.
+	void	setNumLevels( int levels );
+	int		getNumLevels() const				{ return mNumLevels; }
+	//! Sets the brightness where bloom starts. Defaults to 0, which blooms everything in the glow buffer.
+	void	setThreshold( float threshold )		{ mThreshold = threshold; }
+	float	getThreshold() const				{ return mThreshold; }
+	//! Sets the width of the soft transition below the threshold as a fraction of the threshold, clamped to [0:1]. 0 is a hard cut-off. Defaults to 0.5.
+	void	setKnee( float knee )				{ mKnee = glm::clamp( knee, 0.0f, 1.0f ); }
+	float	getKnee() const						{ return mKnee; }
+	//! Scales the result, which is normalized by the number of levels so it doesn't get brighter with more of them. Defaults to 1.
+	void	setIntensity( float intensity )		{ mIntensity = intensity; }
+	float	getIntensity() const				{ return mIntensity; }
 
   private:
-	ci::gl::FboRef					mFboBlur1, mFboBlur2;
-	ci::gl::GlslProgRef				mGlslBlur;
-	ci::signals::ScopedConnection	mConnGlsl;
+	ci::ivec2						mSize;
+	ci::gl::GlslProgRef				mGlslPrefilter, mGlslDownsample, mGlslUpsample;
+	ci::signals::ConnectionList		mConnections;
+
+	int		mNumLevels = 5;
+	float	mThreshold = 0;
+	float	mKnee = 0.5f;
+	float	mIntensity = 1;
 };
 
 // TODO: either inherit from PostEffect or move to a separate file (anti-alias routines)
@@ -80,6 +125,10 @@ class SMAA {
 
 	//! Processes \t source and draws it at \a bounds directly to the current renderbuffer.
 	void draw( const ci::gl::Texture2dRef &source, const ci::Area &bounds );
+	//! Adds the edge and blend passes to \a graph, followed by an output pass that draws \a source at \a bounds to the current renderbuffer.
+	void addPasses( FrameGraph &graph, FrameGraph::ResourceId source, const ci::Area &bounds );
+	//! Adds the edge, blend and neighborhood blending passes to \a graph, returning the anti-aliased result. Returns \a source until the shaders are loaded.
+	FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId source );
 	//! Processes \t source's color buffer, placing the result in \t dest.
 	void apply( const ci::gl::FboRef &source, const ci::gl::FboRef &dest );
 
@@ -104,9 +153,11 @@ class SMAA {
   private:
 	void	loadGlsl();
 	void	createBuffers( int width, int height );
+	FrameGraph::ResourceId	addEdgeAndBlendPasses( FrameGraph &graph, FrameGraph::ResourceId source );
 
-	void	doEdgePass( const ci::gl::Texture2dRef &source );
-	void	doBlendPass();
+	void	doEdgePass( const ci::gl::Texture2dRef &source, const ci::gl::FboRef &dest );
+	void	doBlendPass( const ci::gl::Texture2dRef &edges, const ci::gl::FboRef &dest );
+	void	doNeighborhoodBlendPass( const ci::gl::Texture2dRef &source, const ci::gl::Texture2dRef &blend, const ci::Area &bounds );
 
 	  
 	ci::gl::Fbo::Format   mFboFormat;
@@ -130,6 +181,55 @@ class SMAA {
 	ci::signals::ConnectionList	mConnections;
 };
 
+//! \brief Temporal anti-aliasing, used by AntiAliasType::SMAA_T2x to accumulate SMAA over frames.
+//!
+//! The scene is rendered with a camera whose projection is offset by a different subpixel jitter each frame (see jitterCamera()).
+//! The resolve pass blends each frame with the history, reprojected with the velocity buffer and clipped to the current
+//! neighborhood, so that the jittered frames converge to a supersampled image while moving objects don't leave trails.
+class TAA {
+  public:
+	TAA();
+
+	//! Returns the subpixel offset of the current frame, in pixels within [-0.5:0.5]. Zero if jitter is disabled.
+	ci::vec2	getJitter() const;
+	//! Offsets the projection of \a camera by getJitter(), for a viewport of \a size. Velocities should be computed with the camera before jittering.
+	void		jitterCamera( ci::CameraPersp *camera, const ci::ivec2 &size ) const;
+
+	//! Adds the resolve pass of \a source to \a graph, returning the result, which is kept as the next frame's history.
+	//! Returns \a source until the shader is loaded or if \a velocity is null.
+	FrameGraph::ResourceId addPasses( FrameGraph &graph, FrameGraph::ResourceId source, const ci::gl::Texture2dRef &velocity );
+	//! Advances the jitter sequence. Call once per frame, after the passes have executed.
+	void	nextFrame();
+	//! Discards the history, for example after a camera cut.
+	void	resetHistory()	{ mHistoryValid = false; }
+
+	//! Sets the number of jitter offsets, taken from the Halton (2, 3) sequence. Defaults to 8.
+	void	setNumJitterSamples( int samples );
+	int		getNumJitterSamples() const			{ return mNumJitterSamples; }
+	//! Sets the history weights where the current frame disagrees and agrees with it, from 0 to 1. Defaults to 0.88 and 0.97.
+	void	setFeedback( float feedbackMin, float feedbackMax )	{ mFeedbackMin = feedbackMin; mFeedbackMax = feedbackMax; }
+	//! Sets the part of the velocity buffer that was rendered to, relative to its size. Less than one when the scene is rendered
+	//! at a lower resolution than it is resolved at, in which case velocities are also in those smaller pixels. Defaults to 1.
+	void	setRenderScale( const ci::vec2 &scale )	{ mRenderScale = scale; }
+
+	void updateUI();
+
+  private:
+	ci::gl::GlslProgRef			mGlslResolve;
+	ci::signals::ConnectionList	mConnections;
+
+	ci::gl::FboRef	mFboHistory[2];
+	size_t			mHistoryIndex = 0;
+	bool			mHistoryValid = false;
+	size_t			mFrameIndex = 0;
+
+	bool	mJitterEnabled = true;
+	int		mNumJitterSamples = 8;
+	float	mFeedbackMin = 0.88f;
+	float	mFeedbackMax = 0.97f;
+	ci::vec2	mRenderScale = ci::vec2( 1 );
+};
+
 class PostEffectExc : public ci::Exception {
 public:
 	PostEffectExc( const std::string &description )
@@ -24,6 +24,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "mason/scene/PostProcess.h"
 #include "mason/scene/DepthOfField.h"
+#include "mason/scene/DynamicResolution.h"
 #include "mason/scene/MotionBlur.h"
 #include "mason/Assets.h"
 #include "mason/Common.h"
@@ -52,6 +53,7 @@ const uint8_t TEXTURE_UNIT_COLOR = 0;
 const uint8_t TEXTURE_UNIT_DEPTH = 1;
 const uint8_t TEXTURE_UNIT_GLOW = 2;
 const uint8_t TEXTURE_UNIT_VELOCITY = 3;
+const uint8_t TEXTURE_UNIT_LUT = 4;
 
 
 const char *antiAliasTypeToString( AntiAliasType type )
@@ -61,6 +63,7 @@ const char *antiAliasTypeToString( AntiAliasType type )
 		case AntiAliasType::MSAA:	return "msaa";
 		case AntiAliasType::FXAA:	return "fxaa";
 		case AntiAliasType::SMAA:	return "smaa";
+		case AntiAliasType::SMAA_T2x:	return "smaa t2x";
 		default: break;
 
 	}
@@ -75,6 +78,7 @@ AntiAliasType antiAliasTypeFromString( const std::string &str )
 	else if( str == "msaa" )	return AntiAliasType::MSAA;
 	else if( str == "fxaa" )	return AntiAliasType::FXAA;
 	else if( str == "smaa" )	return AntiAliasType::SMAA;
+	else if( str == "smaa t2x" )	return AntiAliasType::SMAA_T2x;
 
 	//CI_ASSERT_NOT_REACHABLE();
 	return AntiAliasType::NumTypes;
@@ -141,6 +145,10 @@ PostProcess::Options &PostProcess::Options::config( const ma::Info &config )
 	mEnabled = config.get( "enabled", mEnabled );
 	mUIEnabled = config.get( "ui", mUIEnabled );
 	mGamma = config.get( "gamma", mGamma );
+	mToneMap = config.get( "toneMap", mToneMap );
+	mColorGradingLut = config.get<string>( "colorGradingLut", mColorGradingLut.string() );
+	mFusedComposite = config.get( "fusedComposite", mFusedComposite );
+	mFusedFxaa = config.get( "fusedFxaa", mFusedFxaa );
 	mGlowBuffer = config.get( "glowBuffer", mGlowBuffer );
 	mVelocityBuffer = config.get( "velocityBuffer", mVelocityBuffer );
 	mDebugBuffer = config.get( "debugBuffer", mDebugBuffer );
@@ -195,6 +203,16 @@ PostProcess::Options &PostProcess::Options::config( const ma::Info &config )
 	mSunFromCamera = config.get( "sunFromCamera", mSunFromCamera );
 
 	mBloomDownsampleFactor = config.get( "bloomDownsampleFactor", mBloomDownsampleFactor );
+	mBloomLevels = config.get( "bloomLevels", mBloomLevels );
+	mBloomThreshold = config.get( "bloomThreshold", mBloomThreshold );
+	mBloomKnee = config.get( "bloomKnee", mBloomKnee );
+	mBloomIntensity = config.get( "bloomIntensity", mBloomIntensity );
+
+	// Dynamic resolution
+	mDynamicResolution = config.get( "dynamicResolution", mDynamicResolution );
+	mDynamicResolutionTarget = config.get( "dynamicResolutionTarget", mDynamicResolutionTarget );
+	mDynamicResolutionMinScale = config.get( "dynamicResolutionMinScale", mDynamicResolutionMinScale );
+	mUpscaleSharpness = config.get( "upscaleSharpness", mUpscaleSharpness );
 
 	return *this;
 }
@@ -209,6 +227,10 @@ void PostProcess::Options::save( ma::Info &info ) const
 	info["motionBlur"] = mMotionBlur;
 	info["depthOfField"] = mDepthOfField;
 	info["gamma"] = mGamma;
+	info["toneMap"] = mToneMap;
+	info["colorGradingLut"] = mColorGradingLut.string();
+	info["fusedComposite"] = mFusedComposite;
+	info["fusedFxaa"] = mFusedFxaa;
 	info["bloom"] = mBloom;
 	info["sunRays"] = mSunRays;
 	info["sunBoost"] = mSunBoost;
@@ -218,6 +240,14 @@ void PostProcess::Options::save( ma::Info &info ) const
 	info["glowBuffer"] = mGlowBuffer;
 	info["debugBuffer"] = mDebugBuffer;
 	info["bloomDownsampleFactor"] = mBloomDownsampleFactor;
+	info["bloomLevels"] = mBloomLevels;
+	info["bloomThreshold"] = mBloomThreshold;
+	info["bloomKnee"] = mBloomKnee;
+	info["bloomIntensity"] = mBloomIntensity;
+	info["dynamicResolution"] = mDynamicResolution;
+	info["dynamicResolutionTarget"] = mDynamicResolutionTarget;
+	info["dynamicResolutionMinScale"] = mDynamicResolutionMinScale;
+	info["upscaleSharpness"] = mUpscaleSharpness;
 	info["colorFormat"] = colorFormatToString( mColorFormat );
 	info["depthSource"] = mDepthSource == DepthSource::Z_BUFFER ? "z buffer" : mDepthSource == DepthSource::COLOR_ALPHA_CHANNEL ? "color alpha" : "disabled";
 }
@@ -226,11 +256,13 @@ PostProcess::PostProcess( const Options &options )
 	: mOptions( options )
 {
 	loadGlsl();
+	loadColorGradingLut();
 
 	// set to none at startup since AA hasn't yet been initialized, then we will init AA if needed
 	auto aa = mOptions.mAntiAliasType;
 	mOptions.mAntiAliasType = AntiAliasType::None;
 	setAntiAliasType( aa );
+	setDynamicResolutionEnabled( mOptions.mDynamicResolution );
 
 	markBuffersNeedConfigure();
 }
@@ -248,11 +280,19 @@ void PostProcess::load( const ma::Info &info )
 {
 	mOptions = info;
 	loadGlsl();
+	loadColorGradingLut();
+	mDynamicResolution = nullptr;
+	setDynamicResolutionEnabled( mOptions.mDynamicResolution );
 	markBuffersNeedConfigure();
 }
 
 void PostProcess::save( ma::Info &info ) const
 {
+	if( mDynamicResolution ) {
+		mOptions.mDynamicResolutionTarget = mDynamicResolution->getTargetMilliseconds();
+		mOptions.mDynamicResolutionMinScale = mDynamicResolution->getMinScale();
+	}
+
 	mOptions.save( info );
 }
 
@@ -263,18 +303,34 @@ void PostProcess::setSize( const ci::ivec2 &size )
 	}
 
 	mSize = size;
+	mRenderSize = mDynamicResolution ? mDynamicResolution->getRenderSize( mSize ) : mSize;
 	markBuffersNeedConfigure();
 }
 
+void PostProcess::setDynamicResolutionEnabled( bool enable )
+{
+	mOptions.mDynamicResolution = enable;
+	if( ! enable ) {
+		mDynamicResolution = nullptr;
+		mRenderSize = mSize;
+		return;
+	}
+
+	if( ! mDynamicResolution ) {
+		mDynamicResolution = make_unique<DynamicResolution>();
+		mDynamicResolution->setTargetMilliseconds( mOptions.mDynamicResolutionTarget );
+		mDynamicResolution->setMinScale( mOptions.mDynamicResolutionMinScale );
+	}
+}
+
 void PostProcess::markBuffersNeedConfigure()
 {
 	mBuffersNeedConfigure = true;
 
-	if( mFboScene || mFboComposite ) {
+	if( mFboScene ) {
 		LOG_BUFFERS( "deleting buffers" );
 	}
 	mFboScene = nullptr;
-	mFboComposite = nullptr;
 }
 
 vector<GLenum> drawBuffers;
@@ -319,6 +375,10 @@ void PostProcess::configureBuffers()
 		mOptions.mBloomDownsampleFactor = max( 0.01f, mOptions.mBloomDownsampleFactor );
 		bloomSize /= mOptions.mBloomDownsampleFactor;
 		mBloom = make_unique<BloomEffect>( this, bloomSize );
+		mBloom->setNumLevels( mOptions.mBloomLevels );
+		mBloom->setThreshold( mOptions.mBloomThreshold );
+		mBloom->setKnee( mOptions.mBloomKnee );
+		mBloom->setIntensity( mOptions.mBloomIntensity );
 
 		CI_LOG_I( "mSize: " << mSize << ", bloomSize: " << bloomSize );
 	}
@@ -348,6 +408,10 @@ void PostProcess::configureBuffers()
 		mMotionBlur = make_unique<MotionBlurEffect>( this );
 	}
 
+	if( mOptions.mAntiAliasType == AntiAliasType::SMAA_T2x ) {
+		mOptions.mVelocityBuffer = true; // needed to reproject the TAA history
+	}
+
 	if( mOptions.mVelocityBuffer ) {
 		// add attachment for velocity buffer
 		auto format = gl::Texture::Format()
@@ -421,24 +485,6 @@ void PostProcess::configureBuffers()
 		gl::drawBuffers( drawBuffers.size(), drawBuffers.data() );
 	}
 
-	// Create compositing Fbo
-	{
-		auto fboFormatComposite = gl::Fbo::Format()
-			.disableDepth();
-		;
-
-		auto texFormat = gl::Texture::Format()
-			//.internalFormat( GL_RGB8 ) // TODO: can save memory in some cases with GL_RGB8 if both alpha and FXAA / SMAA are disabled
-			.label( "PostProcess Composite" )
-			.minFilter( GL_LINEAR ).magFilter( GL_LINEAR )
-		;
-
-		fboFormatComposite.attachment( GL_COLOR_ATTACHMENT0, gl::Texture2d::create( mSize.x, mSize.y, texFormat ) );
-
-		mFboComposite = gl::Fbo::create( mSize.x, mSize.y, fboFormatComposite );
-		mFboComposite->setLabel( "PostProcess Composite Fbo" );
-	}
-	
 	mBuffersNeedConfigure = false;
 
 	mSignalBuffersChanged.emit();
@@ -465,15 +511,69 @@ void PostProcess::clear()
 	CI_LOG_I( "complete." );
 }
 
+void PostProcess::extendRenderEdges( int margin )
+{
+	const ivec2 end = glm::min( mRenderSize + ivec2( margin ), mFboScene->getSize() );
+	if( end == mRenderSize )
+		return;
+
+	// resolves a multisampled fbo, so that the blits extend the textures the effects sample
+	mFboScene->getColorTexture();
+
+	vector<GLenum> attachments = { COLOR_ATTACHMENT_COLOR };
+#if SCENE_GLOW_ENABLED
+	if( mOptions.mGlowBuffer ) {
+		attachments.push_back( COLOR_ATTACHMENT_GLOW );
+	}
+#endif
+	if( mOptions.mVelocityBuffer ) {
+		attachments.push_back( COLOR_ATTACHMENT_VELOCITY );
+	}
+
+	// the last column is stretched over the margin on the right, then the last row, including that corner, over the margin on top
+	auto extend = [this, &end]( GLbitfield mask ) {
+		const ivec2 &r = mRenderSize;
+		if( end.x > r.x ) {
+			glBlitFramebuffer( r.x - 1, 0, r.x, r.y, r.x, 0, end.x, r.y, mask, GL_NEAREST );
+		}
+		if( end.y > r.y ) {
+			glBlitFramebuffer( 0, r.y - 1, end.x, r.y, 0, r.y, end.x, end.y, mask, GL_NEAREST );
+		}
+	};
+
+	gl::ScopedFramebuffer scopedFbo( GL_FRAMEBUFFER, mFboScene->getResolveId() );
+	for( GLenum attachment : attachments ) {
+		glReadBuffer( attachment );
+		glDrawBuffer( attachment );
+		extend( GL_COLOR_BUFFER_BIT );
+	}
+
+	if( mOptions.mDepthSource == DepthSource::Z_BUFFER && getDepthTexture() ) {
+		extend( GL_DEPTH_BUFFER_BIT );
+	}
+
+	glReadBuffer( COLOR_ATTACHMENT_COLOR );
+	gl::drawBuffers( drawBuffers.size(), drawBuffers.data() );
+}
+
 
 void PostProcess::loadGlsl()
 {
 	auto format = gl::GlslProg::Format();
 
-	if( mOptions.mGamma ) // TODO: should also defnie if AA is FXAA / SMAA (though currently this define isn't being used in composite.frag
+	// each combination of defines is a separate variant, so features that are disabled cost nothing in the composite pass
+	if( mOptions.mGamma )
 		format.define( "GAMMA_ENABLED" );
 	if( mOptions.mBloom )
 		format.define( "BLOOM_ENABLED" );
+	if( mOptions.mToneMap )
+		format.define( "TONE_MAP_ENABLED" );
+	if( mTextureColorGradingLut )
+		format.define( "LUT_ENABLED" );
+	if( mOptions.mUpscaleSharpness >= 0 )
+		format.define( "SHARPEN_ENABLED" );
+	if( isCompositeFused() && mOptions.mAntiAliasType == AntiAliasType::FXAA )
+		format.define( "FXAA_ENABLED" );
 
 	format.define( "AA_TYPE", to_string( (int)mOptions.mAntiAliasType ) );
 
@@ -486,6 +586,12 @@ void PostProcess::loadGlsl()
 		if( mOptions.mBloom ) {
 			glsl->uniform( "uTexGlow", TEXTURE_UNIT_GLOW );
 		}
+		if( mOptions.mUpscaleSharpness >= 0 ) {
+			glsl->uniform( "uSharpness", mOptions.mUpscaleSharpness );
+		}
+		if( mTextureColorGradingLut ) {
+			glsl->uniform( "uTexLut", TEXTURE_UNIT_LUT );
+		}
 
 #if SCENE_MOTION_BLUR_ENABLED
 		glsl->uniform( "uTexVelocity", TEXTURE_UNIT_VELOCITY );
@@ -500,6 +606,44 @@ void PostProcess::loadGlsl()
 	} );
 }
 
+void PostProcess::loadColorGradingLut()
+{
+	const bool hadLut = mTextureColorGradingLut != nullptr;
+	mTextureColorGradingLut = nullptr;
+	mConnColorGradingLut.disconnect();
+
+	if( mOptions.mColorGradingLut.empty() ) {
+		if( hadLut ) {
+			loadGlsl();
+		}
+		return;
+	}
+
+	mConnColorGradingLut = ma::assets()->getTexture( mOptions.mColorGradingLut, [this]( gl::Texture2dRef tex ) {
+		tex->setMinFilter( GL_LINEAR );
+		tex->setMagFilter( GL_LINEAR );
+		tex->setWrap( GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+		if( tex->getWidth() != tex->getHeight() * tex->getHeight() ) {
+			CI_LOG_W( "color grading LUT " << mOptions.mColorGradingLut << " should be N * N x N texels, size: " << tex->getSize() );
+		}
+
+		// the shader variant with LUT_ENABLED is only used once there is a LUT to sample
+		const bool reload = ! mTextureColorGradingLut;
+		mTextureColorGradingLut = tex;
+		if( reload ) {
+			loadGlsl();
+		}
+	} );
+}
+
+bool PostProcess::isCompositeFused() const
+{
+	// SMAA needs the composited buffer to find edges, and TAA needs it as history. FXAA is only fused when asked for, since the
+	// fused version is lower quality than the FXAA pass
+	const auto aa = mOptions.mAntiAliasType;
+	return mOptions.mFusedComposite && ( aa == AntiAliasType::None || aa == AntiAliasType::MSAA || ( aa == AntiAliasType::FXAA && mOptions.mFusedFxaa ) );
+}
+
 void PostProcess::preDraw()
 {
 	if( ! mOptions.mEnabled )
@@ -508,24 +652,32 @@ void PostProcess::preDraw()
 	if( mBuffersNeedConfigure && mSize.x != 0 && mSize.y != 0 )
 		configureBuffers();
 
-	if( ! mFboScene || ! mFboComposite )
+	if( ! mFboScene )
 		return;
 
+	// the buffers stay at full size, the scene is rendered into the lower left of them at the size picked from GPU timings
+	mRenderSize = mFboScene->getSize();
+	if( mDynamicResolution ) {
+		mDynamicResolution->beginFrame();
+		mRenderSize = mDynamicResolution->getRenderSize( mRenderSize );
+	}
+
 	gl::context()->pushFramebuffer( mFboScene );
 
 	// TODO: figure if it's indeed best to call glDrawBuffers() every frame
 	// - seems to be fixing the issue with msaa + motion blur and no glow buffer attachment
 	gl::drawBuffers( drawBuffers.size(), drawBuffers.data() );
 
-	gl::pushViewport( 0, 0, mFboScene->getWidth(), mFboScene->getHeight() );
+	gl::pushViewport( 0, 0, mRenderSize.x, mRenderSize.y );
 
+	// window coordinates stay at the full size, the viewport scales them down to the render size
 	gl::pushMatrices();
 	gl::setMatricesWindow( mFboScene->getSize() );
 }
 
 void PostProcess::postDraw()
 {
-	if( ! mOptions.mEnabled || ! mFboScene || ! mFboComposite ) {
+	if( ! mOptions.mEnabled || ! mFboScene ) {
 		return;
 	}
 
@@ -534,7 +686,7 @@ void PostProcess::postDraw()
 
 void PostProcess::postDraw( const Rectf &destRect )
 {
-	if( ! mOptions.mEnabled || ! mFboScene || ! mFboComposite ) {
+	if( ! mOptions.mEnabled || ! mFboScene ) {
 		return;
 	}
 
@@ -542,115 +694,194 @@ void PostProcess::postDraw( const Rectf &destRect )
 	gl::popViewport();
 	gl::popMatrices();
 
-	auto srcFbo = mFboScene;
+	if( mOptions.mDebugBuffer )
+		mDebugPixelReadback.update();
+
+	const vec2 renderScale = vec2( mRenderSize ) / vec2( mFboScene->getSize() );
 
+	// Effects only process the rendered part of the buffers. Past it they read its edge, replicated over a margin as wide as they
+	// sample. Each effect samples the result of the previous one, so their margins add up.
+	vector<PostEffect *> effects;
 #if SCENE_MOTION_BLUR_ENABLED
-	if( mMotionBlur ) {
-		MA_PROFILE( "PostProcess - Motion Blur" );
+	effects.push_back( mMotionBlur.get() );
+#endif
+	effects.push_back( mDepthOfField.get() );
+	effects.push_back( mBloom.get() );
+
+	int margin = 0;
+	for( auto effect : effects ) {
+		if( effect ) {
+			margin += effect->getSampleRadius();
+		}
+	}
+	for( auto effect : effects ) {
+		if( effect ) {
+			effect->setRenderRegion( renderScale, margin );
+		}
+	}
+	if( margin > 0 && mRenderSize != mFboScene->getSize() ) {
+		extendRenderEdges( margin );
+	}
+
+	mFrameGraph.reset();
+	auto color = mFrameGraph.importFbo( "PostProcess Scene", mFboScene );
 
-		mMotionBlur->process( srcFbo );
-		srcFbo = mMotionBlur->getDestFbo();
+#if SCENE_MOTION_BLUR_ENABLED
+	if( mMotionBlur ) {
+		color = mMotionBlur->addPasses( mFrameGraph, color );
 	}
 #endif
 
 	if( mDepthOfField ) {
-		MA_PROFILE( "PostProcess - Depth of Field" );
-		mDepthOfField->process( srcFbo );
-		srcFbo = mDepthOfField->getDestFbo();
+		color = mDepthOfField->addPasses( mFrameGraph, color );
 	}
 
+	auto glow = FrameGraph::INVALID_RESOURCE;
 	if( mBloom ) {
-		MA_PROFILE( "PostProcess - Bloom" );
-
-		mBloom->process( srcFbo );
+		glow = mBloom->addPasses( mFrameGraph, color );
 	}
 
 #if SCENE_GODRAYS_ENABLED
 
 	if( mSunRays ) {
-		MA_PROFILE( "PostProcess - SunRays" );
-
-		mSunRays->setCamera( mCam );
-		mSunRays->process( srcFbo );
-		srcFbo = mSunRays->getFbo();
+		auto sunRays = mFrameGraph.importFbo( "SunRays", mSunRays->getFbo() );
+		mFrameGraph.addPass( "PostProcess - SunRays", { color }, { sunRays }, [this, color]( const FrameGraph &graph ) {
+			mSunRays->setCamera( mCam );
+			mSunRays->process( graph.getFbo( color ) );
+		} );
+		color = sunRays;
 	}
 #endif
 
-	// disable blending and depth, for both composite and AA passes
+	auto compositeReads = vector<FrameGraph::ResourceId>{ color };
+	if( glow != FrameGraph::INVALID_RESOURCE ) {
+		compositeReads.push_back( glow );
+	}
+
+	if( mBatchComposite && isCompositeFused() ) {
+		// composite straight to the output, with Options::fusedFxaa() FXAA is done in the same pass
+		mFrameGraph.addOutputPass( "PostProcess - Composite", compositeReads, [this, color, glow, renderScale, destRect]( const FrameGraph &graph ) {
+			drawComposite( graph, color, glow, renderScale, destRect );
+		} );
+	}
+	else {
+		// Composite scene
+		if( mBatchComposite ) {
+			// GL_LINEAR is required by both FXAA and SMAA
+			auto composite = mFrameGraph.createTexture( "PostProcess Composite", FrameGraph::TextureFormat( mSize, GL_RGBA8 ).filter( GL_LINEAR ) );
+
+			mFrameGraph.addPass( "PostProcess - Composite", compositeReads, { composite }, [this, color, glow, composite, renderScale]( const FrameGraph &graph ) {
+				const auto &fbo = graph.getFbo( composite );
+				gl::ScopedFramebuffer scopedFbo( fbo );
+				gl::ScopedViewport    scopedViewport( 0, 0, fbo->getWidth(), fbo->getHeight() );
+				gl::ScopedMatrices    scopedMatrices;
+				gl::setMatricesWindow( fbo->getSize() );
+
+				drawComposite( graph, color, glow, renderScale, fbo->getBounds() );
+			} );
+
+			color = composite;
+		}
+
+		// Anti-Aliasing, drawn to the current framebuffer. Passes that don't lead here are culled.
+		if( mOptions.mAntiAliasType == AntiAliasType::None || mOptions.mAntiAliasType == AntiAliasType::MSAA ) {
+			mFrameGraph.addOutputPass( "PostProcess - Draw", { color }, [color, destRect]( const FrameGraph &graph ) {
+				gl::draw( graph.getTexture( color ), Area( destRect ) );
+			} );
+		}
+		else if( mOptions.mAntiAliasType == AntiAliasType::FXAA && mFXAA ) {
+			mFrameGraph.addOutputPass( "PostProcess - FXAA", { color }, [this, color, destRect]( const FrameGraph &graph ) {
+				gl::ScopedColor colorScope( Color::white() );
+				mFXAA->draw( graph.getTexture( color ), Area( destRect ) );
+			} );
+		}
+		else if( mOptions.mAntiAliasType == AntiAliasType::SMAA && mSMAA ) {
+			mSMAA->addPasses( mFrameGraph, color, Area( destRect ) );
+		}
+		else if( mOptions.mAntiAliasType == AntiAliasType::SMAA_T2x && mSMAA && mTAA ) {
+			color = mSMAA->addPasses( mFrameGraph, color );
+			mTAA->setRenderScale( renderScale );
+			color = mTAA->addPasses( mFrameGraph, color, mOptions.mVelocityBuffer ? getTexture( COLOR_ATTACHMENT_VELOCITY ) : nullptr );
+			mFrameGraph.addOutputPass( "PostProcess - Draw", { color }, [color, destRect]( const FrameGraph &graph ) {
+				gl::draw( graph.getTexture( color ), Area( destRect ) );
+			} );
+		}
+	}
+
+	// disable blending and depth for all passes
 	gl::ScopedBlend blendScope( false );
 	gl::ScopedDepth depthScope( false );
 
-	// Composite scene
-	if( mBatchComposite ) {
-		MA_PROFILE( "PostProcess - Composite" );
+	mFrameGraph.compile();
+	mFrameGraph.execute();
 
-		gl::ScopedFramebuffer scopedFbo( mFboComposite );
-		gl::ScopedViewport    scopedViewport( 0, 0, mFboComposite->getWidth(), mFboComposite->getHeight() );
-		gl::ScopedMatrices    scopedMatrices;
-		gl::setMatricesWindow( mFboComposite->getSize() );
+	if( mTAA ) {
+		mTAA->nextFrame();
+	}
 
-		gl::ScopedTextureBind texColorScope( srcFbo->getColorTexture(), TEXTURE_UNIT_COLOR );
+	if( mDynamicResolution ) {
+		mDynamicResolution->endFrame();
+	}
+}
 
-		// writeImage( "scene.png", destFbo->getColorTexture()->createSource() );
+void PostProcess::drawComposite( const FrameGraph &graph, FrameGraph::ResourceId color, FrameGraph::ResourceId glow, const vec2 &renderScale, const Rectf &destRect )
+{
+	gl::ScopedTextureBind texColorScope( graph.getTexture( color ), TEXTURE_UNIT_COLOR );
 
 #if SCENE_MOTION_BLUR_ENABLED
-		gl::Texture2dRef velocityTex;
-		if( mOptions.mVelocityBuffer ) {
-			// TODO: remove from compositing scene once the MotionBlur effect is finished
-			// - or perhaps: I could do the reconstruction in this shader too, perhaps as an include
-			// - this would match the same usage of BloomEffect and reduce one extra RGB16f fullscreen texture, which is alot in big apps
-			// - but should hold off on that until DoF is in here, too
-			velocityTex = mFboScene->getTexture2d( COLOR_ATTACHMENT_VELOCITY );
-			gl::context()->pushTextureBinding( velocityTex->getTarget(), velocityTex->getId(), TEXTURE_UNIT_VELOCITY );
-		}
+	gl::Texture2dRef velocityTex;
+	if( mOptions.mVelocityBuffer ) {
+		// TODO: remove from compositing scene once the MotionBlur effect is finished
+		// - or perhaps: I could do the reconstruction in this shader too, perhaps as an include
+		// - this would match the same usage of BloomEffect and reduce one extra RGB16f fullscreen texture, which is alot in big apps
+		// - but should hold off on that until DoF is in here, too
+		velocityTex = mFboScene->getTexture2d( COLOR_ATTACHMENT_VELOCITY );
+		gl::context()->pushTextureBinding( velocityTex->getTarget(), velocityTex->getId(), TEXTURE_UNIT_VELOCITY );
+	}
 #endif
 
-		if( mBloom ) {
-			gl::context()->pushTextureBinding( mBloom->getTexture()->getTarget(), mBloom->getTexture()->getId(), TEXTURE_UNIT_GLOW );
-		}
+	gl::Texture2dRef glowTex;
+	if( glow != FrameGraph::INVALID_RESOURCE ) {
+		glowTex = graph.getTexture( glow );
+		gl::context()->pushTextureBinding( glowTex->getTarget(), glowTex->getId(), TEXTURE_UNIT_GLOW );
+	}
 
-		// draw full-screen quad
-		{
-			gl::ScopedModelMatrix modelScope;
-			gl::scale( mSize.x, mSize.y, 0 );
-			mBatchComposite->draw();
-		}
+	if( mTextureColorGradingLut ) {
+		gl::context()->pushTextureBinding( mTextureColorGradingLut->getTarget(), mTextureColorGradingLut->getId(), TEXTURE_UNIT_LUT );
+	}
+
+	// draw full-screen quad, upscaling the rendered part of the scene buffers
+	mBatchComposite->getGlslProg()->uniform( "uRenderScale", renderScale );
+	{
+		gl::ScopedModelMatrix modelScope;
+		gl::translate( destRect.getUpperLeft() );
+		gl::scale( destRect.getWidth(), destRect.getHeight(), 0 );
+		mBatchComposite->draw();
+	}
 
 #if SCENE_MOTION_BLUR_ENABLED
-		if( mOptions.mVelocityBuffer ) {
-			gl::context()->popTextureBinding( velocityTex->getTarget(), TEXTURE_UNIT_VELOCITY );
-		}
+	if( velocityTex ) {
+		gl::context()->popTextureBinding( velocityTex->getTarget(), TEXTURE_UNIT_VELOCITY );
+	}
 #endif
 
-		if( mBloom ) {
-			gl::context()->popTextureBinding( mBloom->getTexture()->getTarget(), TEXTURE_UNIT_GLOW );
-		}
-
-		srcFbo = mFboComposite;
+	if( glowTex ) {
+		gl::context()->popTextureBinding( glowTex->getTarget(), TEXTURE_UNIT_GLOW );
 	}
 
-	// Anti-Aliasing
-	if( mOptions.mAntiAliasType == AntiAliasType::None || mOptions.mAntiAliasType == AntiAliasType::MSAA ) {
-		gl::draw( srcFbo->getColorTexture(), Area( destRect ) );
+	if( mTextureColorGradingLut ) {
+		gl::context()->popTextureBinding( mTextureColorGradingLut->getTarget(), TEXTURE_UNIT_LUT );
 	}
-	else {
-		gl::ScopedColor colorScope( Color::white() );
-
-		// Both FXAA and SMAA require source to use GL_LINEAR for min and mag filter
-		CI_ASSERT( srcFbo->getFormat().getColorTextureFormat().getMinFilter() == GL_LINEAR );
-		CI_ASSERT( srcFbo->getFormat().getColorTextureFormat().getMagFilter() == GL_LINEAR );
-
-		if( mOptions.mAntiAliasType == AntiAliasType::FXAA && mFXAA ) {
-			MA_PROFILE( "PostProcess - FXAA" );
-			mFXAA->draw( srcFbo->getColorTexture(), Area( destRect ) );
-		}
-		if( mOptions.mAntiAliasType == AntiAliasType::SMAA && mSMAA ) {
-			MA_PROFILE( "PostProcess - SMAA" );
-			mSMAA->draw( srcFbo->getColorTexture(), Area( destRect ) );
+}
 
-			//gl::draw( mSMAA->getEdgePass(), destRect );
-		}
+CameraPersp PostProcess::getRenderCamera() const
+{
+	CameraPersp cam = mCam;
+	if( mTAA ) {
+		mTAA->jitterCamera( &cam, mRenderSize );
 	}
+
+	return cam;
 }
 
 
@@ -664,16 +895,25 @@ void PostProcess::setAntiAliasType( AntiAliasType type )
 		case AntiAliasType::MSAA: {
 			mFXAA = nullptr;
 			mSMAA = nullptr;
+			mTAA = nullptr;
 		}
 		break;
 		case AntiAliasType::FXAA: {
 			mFXAA = make_unique<FXAA>();
 			mSMAA = nullptr;
+			mTAA = nullptr;
 		}
 		break;
 		case AntiAliasType::SMAA: {
 			mFXAA = nullptr;
 			mSMAA = make_unique<SMAA>();
+			mTAA = nullptr;
+		}
+		break;
+		case AntiAliasType::SMAA_T2x: {
+			mFXAA = nullptr;
+			mSMAA = make_unique<SMAA>();
+			mTAA = make_unique<TAA>();
 		}
 		break;
 		default:
@@ -698,14 +938,25 @@ vec4 PostProcess::getDebugPixel( const ci::ivec2 &pixel ) const
 	if( !mOptions.mDebugBuffer || !mFboScene )
 		return vec4( -1 );
 
-	auto area = Area( pixel, pixel + ivec2( 1 ) );
-	auto surface = mFboScene->readPixels32f( area, COLOR_ATTACHMENT_DEBUG );
-	return (vec4)surface.getPixel( ivec2( 0 ) );
+	// keep requesting and return the latest result, so the GPU never has to finish the frame before the value can be read.
+	// Results are collected once per frame in postDraw().
+	// pixel is in output coordinates, the scene may have been rendered at a lower resolution
+	const ivec2 size = mRenderSize;
+	const ivec2 scaled = ivec2( vec2( pixel ) * vec2( mRenderSize ) / vec2( mFboScene->getSize() ) );
+	const ivec2 coord = glm::clamp( ivec2( scaled.x, size.y - 1 - scaled.y ), ivec2( 0 ), size - ivec2( 1 ) ); // texture origin is at the bottom left
+	mDebugPixelReadback.request( mFboScene->getTexture2d( COLOR_ATTACHMENT_DEBUG ), ivec3( coord, 0 ) );
+
+	// a result for another pixel may still be the latest while the new requests are in flight
+	if( ! mDebugPixelReadback.hasResult() || mDebugPixelReadback.getResult().mCoord != ivec3( coord, 0 ) )
+		return vec4( -1 );
+
+	return mDebugPixelReadback.getPixel( vec4( -1 ) );
 }
 
 void PostProcess::blitTo( const gl::FboRef &fbo ) const
 {
-	mFboScene->blitTo( fbo, mFboScene->getBounds(), fbo->getBounds() );
+	const GLenum filter = mRenderSize == fbo->getSize() ? GL_NEAREST : GL_LINEAR;
+	mFboScene->blitTo( fbo, Area( 0, 0, mRenderSize.x, mRenderSize.y ), fbo->getBounds(), filter );
 }
 
 #if SCENE_GODRAYS_ENABLED
@@ -734,11 +985,22 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 		return;
 	}
 
-	im::Text( "size: [%d, %d], color format: %s", mSize.x, mSize.y, colorFormatToString( mOptions.mColorFormat ) );
+	im::Text( "size: [%d, %d], render size: [%d, %d], color format: %s", mSize.x, mSize.y, mRenderSize.x, mRenderSize.y, colorFormatToString( mOptions.mColorFormat ) );
 	im::Checkbox( "enabled", &mOptions.mEnabled );
 	if( im::Checkbox( "gamma", &mOptions.mGamma ) ) {
 		loadGlsl();
 	}
+	im::SameLine();
+	if( im::Checkbox( "tone map", &mOptions.mToneMap ) ) {
+		loadGlsl();
+	}
+	im::SameLine();
+	if( im::Checkbox( "fused composite", &mOptions.mFusedComposite ) ) {
+		loadGlsl();
+	}
+	if( ! mOptions.mColorGradingLut.empty() ) {
+		im::Text( "color grading LUT: %s%s", mOptions.mColorGradingLut.string().c_str(), mTextureColorGradingLut ? "" : " (not loaded)" );
+	}
 
 	im::Text( "buffers: " );
 	im::SameLine();
@@ -761,7 +1023,7 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 
 	// anti-aliasing
 	if( im::CollapsingHeader( "Anti-Aliasing" ) ) {
-		static vector<string> types = { "none", "msaa", "fxaa", "smaa" };
+		static vector<string> types = { "none", "msaa", "fxaa", "smaa", "smaa t2x" };
 		int                   t = (int)mOptions.mAntiAliasType;
 		if( im::Combo( "anti-alias", &t, types ) ) {
 			setAntiAliasType( (AntiAliasType)t );
@@ -790,12 +1052,45 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 				mOptions.mMSAASamples = msaaSamples;
 			}
 		}
-		else if( mOptions.mAntiAliasType == AntiAliasType::FXAA && mFXAA ) {
-			mFXAA->updateUI();
+		else if( mOptions.mAntiAliasType == AntiAliasType::FXAA ) {
+			if( im::Checkbox( "fused with composite", &mOptions.mFusedFxaa ) ) {
+				loadGlsl();
+			}
+			if( isCompositeFused() ) {
+				im::Text( "FXAA is done in the composite pass" );
+			}
+			else if( mFXAA ) {
+				mFXAA->updateUI();
+			}
 		}
 		else if( mOptions.mAntiAliasType == AntiAliasType::SMAA && mSMAA ) {
 			mSMAA->updateUI();
 		}
+		else if( mOptions.mAntiAliasType == AntiAliasType::SMAA_T2x && mSMAA && mTAA ) {
+			mSMAA->updateUI();
+			if( im::TreeNodeEx( "TAA", ImGuiTreeNodeFlags_DefaultOpen ) ) {
+				mTAA->updateUI();
+				im::TreePop();
+			}
+		}
+	}
+
+	if( im::CollapsingHeader( "Dynamic Resolution" ) ) {
+		bool enabled = mOptions.mDynamicResolution;
+		if( im::Checkbox( "enabled##dynamicresolution", &enabled ) ) {
+			setDynamicResolutionEnabled( enabled );
+		}
+		bool sharpen = mOptions.mUpscaleSharpness >= 0;
+		if( im::Checkbox( "sharpen", &sharpen ) ) {
+			mOptions.mUpscaleSharpness = sharpen ? 0.5f : -1;
+			loadGlsl();
+		}
+		if( sharpen && im::SliderFloat( "sharpness", &mOptions.mUpscaleSharpness, 0, 1 ) && mBatchComposite ) {
+			mBatchComposite->getGlslProg()->uniform( "uSharpness", mOptions.mUpscaleSharpness );
+		}
+		if( mDynamicResolution ) {
+			mDynamicResolution->updateUI();
+		}
 	}
 
 	if( mOptions.mDebugBuffer ) {
@@ -823,6 +1118,9 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 			}
 
 			im::DragFloat4( "debug value", &pixelValue.x );
+
+			const auto &stats = mDebugPixelReadback.getStats();
+			im::Text( "readback latency: %d frames (%0.2f ms), stall: %0.3f ms, dropped: %zu", stats.mLatencyFrames, stats.mLatencySeconds * 1000.0, stats.mStallSeconds * 1000.0, stats.mNumDropped );
 		}
 	}
 
@@ -846,7 +1144,19 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 				markBuffersNeedConfigure();
 			}
 			imx::EndDisabled();
-			//imx::TexturePreview( "final", mBloom->getTexture(), imageBounds );
+
+			if( im::SliderInt( "levels", &mOptions.mBloomLevels, 2, 10 ) ) {
+				mBloom->setNumLevels( mOptions.mBloomLevels );
+			}
+			if( im::DragFloat( "threshold", &mOptions.mBloomThreshold, 0.01f, 0, 20 ) ) {
+				mBloom->setThreshold( mOptions.mBloomThreshold );
+			}
+			if( im::DragFloat( "knee", &mOptions.mBloomKnee, 0.01f, 0, 1 ) ) {
+				mBloom->setKnee( mOptions.mBloomKnee );
+			}
+			if( im::DragFloat( "intensity", &mOptions.mBloomIntensity, 0.01f, 0, 10 ) ) {
+				mBloom->setIntensity( mOptions.mBloomIntensity );
+			}
 		}
 		else {
 			if( ! mOptions.mBloom ) {
@@ -944,6 +1254,10 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 	}
 #endif
 
+	if( im::CollapsingHeader( "Frame Graph" ) ) {
+		mFrameGraph.updateUI();
+	}
+
 	if( im::CollapsingHeader( "Scene Buffers" ) ) {
 		auto opts = imx::TextureViewerOptions().treeNodeFlags( ImGuiTreeNodeFlags_DefaultOpen );
 		if( mFboScene ) {
@@ -975,13 +1289,6 @@ void PostProcess::updateUI( int devFlags, const ci::Rectf &destRect )
 			imx::TexturePreview( "SunRays Effect", mSunRays->getTextureEffect(), imageBounds );
 		}
 #endif
-
-		if( mFboComposite ) {
-			imx::Texture2d( "composite", mFboComposite->getColorTexture() );
-		}
-		else {
-			im::Text( "null mFboComposite" );
-		}
 	}
 
 	im::End();
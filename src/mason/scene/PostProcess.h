@@ -36,7 +36,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #define SCENE_GLOW_ENABLED 1
 
 #include "mason/scene/PostEffects.h"
+#include "mason/scene/FrameGraph.h"
 #include "mason/Info.h"
+#include "mason/PixelReadback.h"
 
 // TODO: rename this to RadialBlur or whatever is appropriate
 #if SCENE_GODRAYS_ENABLED
@@ -50,18 +52,18 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace mason::scene {
 
 class DepthOfFieldBokehEffect;
+class DynamicResolution;
 class MotionBlurEffect;
 class FXAA;
 class SMAA;
-//class TAA;
+class TAA;
 
 enum class AntiAliasType {
 	None,
 	MSAA,
 	FXAA,
 	SMAA,
-	SMAA_T2x,
-	//TAA,
+	SMAA_T2x,	//!< SMAA accumulated temporally by TAA, render the scene with PostProcess::getRenderCamera()
 	NumTypes
 };
 
@@ -81,7 +83,10 @@ enum class DepthSource {
 	COLOR_ALPHA_CHANNEL
 };
 
-//! Manages the post-process effects of a scene
+//! \brief Manages the post-process effects of a scene.
+//!
+//! Each postDraw() rebuilds a FrameGraph from the enabled effects, so buffers that effects only need during the frame are
+//! transient and shared between them.
 class PostProcess {
 public:
 
@@ -91,6 +96,16 @@ public:
 
 		Options& gamma( bool b = true )	{ mGamma = b; return *this; }
 		Options& bloom( bool b = true )	{ mBloom = b; return *this; }
+		//! Applies filmic tone mapping in the composite pass.
+		Options& toneMap( bool b = true )	{ mToneMap = b; return *this; }
+		//! Grades the composited colors with the LUT at \a assetPath, a strip of N slices of N x N texels, blue increasing by slice. Empty disables grading.
+		Options& colorGradingLut( const ci::fs::path &assetPath )	{ mColorGradingLut = assetPath; return *this; }
+		//! Draws the composite pass straight to the output when no later pass needs its result, with AntiAliasType::None or MSAA.
+		//! Saves writing and reading back a full-screen buffer. Enabled by default.
+		Options& fusedComposite( bool b = true )	{ mFusedComposite = b; return *this; }
+		//! Also fuses the composite pass with AntiAliasType::FXAA, using a nine tap FXAA that composites each tap. This is lower quality
+		//! than the FXAA pass and ignores its settings, and the composite runs nine times per pixel. Disabled by default.
+		Options& fusedFxaa( bool b = true )			{ mFusedFxaa = b; return *this; }
 
 		Options& colorFormat( ColorFormat fmt )	{ mColorFormat = fmt; return *this; }
 		Options& depthSource( DepthSource d )	{ mDepthSource = d; return *this; }
@@ -103,6 +118,25 @@ public:
 		Options& debugBuffer( bool b = true )			{ mDebugBuffer = b; return *this; }
 
 		Options& bloomDownsampleFactor( float factor )	{ mBloomDownsampleFactor = factor; return *this; }
+		//! See BloomEffect::setNumLevels()
+		Options& bloomLevels( int levels )				{ mBloomLevels = levels; return *this; }
+		//! See BloomEffect::setThreshold()
+		Options& bloomThreshold( float threshold )		{ mBloomThreshold = threshold; return *this; }
+		//! See BloomEffect::setKnee()
+		Options& bloomKnee( float knee )				{ mBloomKnee = knee; return *this; }
+		//! See BloomEffect::setIntensity()
+		Options& bloomIntensity( float intensity )		{ mBloomIntensity = intensity; return *this; }
+
+		//! Renders the scene at a scale of the buffers picked from GPU timings, see DynamicResolution. The buffers are allocated
+		//! at the full size, so changing the scale never reallocates them, and the composite pass upscales the result. Bloom,
+		//! depth of field and motion blur only process the rendered part of the buffers, see PostEffect::setRenderRegion().
+		Options& dynamicResolution( bool b = true )				{ mDynamicResolution = b; return *this; }
+		//! See DynamicResolution::setTargetMilliseconds()
+		Options& dynamicResolutionTarget( float ms )			{ mDynamicResolutionTarget = ms; return *this; }
+		//! See DynamicResolution::setMinScale()
+		Options& dynamicResolutionMinScale( float scale )		{ mDynamicResolutionMinScale = scale; return *this; }
+		//! Sharpens the scene while upscaling it, from 0 to 1. Negative disables sharpening, which is the default.
+		Options& upscaleSharpness( float sharpness )			{ mUpscaleSharpness = sharpness; return *this; }
 
 		Options& config( const ma::Info &config );
 
@@ -113,6 +147,10 @@ public:
 		bool mUIEnabled = false;
 		bool mGamma = true;
 		bool mBloom = false;
+		bool mToneMap = false;
+		bool mFusedComposite = true;
+		bool mFusedFxaa = false;
+		ci::fs::path mColorGradingLut;
 		bool mDepthOfField = false;
 		bool mSunRays = true;
 
@@ -124,6 +162,15 @@ public:
 		bool mDebugBuffer = false;
 
 		float mBloomDownsampleFactor = 1;
+		int   mBloomLevels = 5;
+		float mBloomThreshold = 0;
+		float mBloomKnee = 0.5f;
+		float mBloomIntensity = 1;
+
+		bool  mDynamicResolution = false;
+		float mDynamicResolutionTarget = 14;
+		float mDynamicResolutionMinScale = 0.5f;
+		float mUpscaleSharpness = -1;
 
 		float mSunBoost = 10.0f;
 		float mSunPower = 2.0f;
@@ -168,6 +215,8 @@ public:
 	void setCamera( const ci::CameraPersp &camera )	{ mCam = camera; }
 	//!
 	const ci::CameraPersp&	getCamera() const	{ return mCam; }
+	//! Returns the camera to render the scene with, which has a subpixel jitter when using AntiAliasType::SMAA_T2x. Velocities should still be computed with getCamera().
+	ci::CameraPersp			getRenderCamera() const;
 
 	void			setAntiAliasType( AntiAliasType type );
 	AntiAliasType	getAntiAliasType() const	{ return mOptions.mAntiAliasType; }
@@ -177,6 +226,15 @@ public:
 	void postDraw( const ci::Rectf &destRect );
 
 	const ci::ivec2&	getSize() const		{ return mSize; }
+	//! Returns the size the scene is rendered at, which is getSize() unless dynamic resolution is enabled. Viewports set while
+	//! drawing the scene should use this size.
+	const ci::ivec2&	getRenderSize() const	{ return mRenderSize; }
+
+	//! Enables or disables dynamic resolution, see Options::dynamicResolution(). Doesn't reallocate the buffers.
+	void				setDynamicResolutionEnabled( bool enable );
+	bool				isDynamicResolutionEnabled() const	{ return mOptions.mDynamicResolution; }
+	//! Returns the controller that picks the render size, or null if dynamic resolution is disabled.
+	DynamicResolution*	getDynamicResolution() const		{ return mDynamicResolution.get(); }
 
 	//!
 	ci::gl::Texture2dRef getColorTexture() { return mFboScene ? mFboScene->getColorTexture() : nullptr; }
@@ -188,9 +246,11 @@ public:
 	DepthSource getDepthSource() const { return mOptions.mDepthSource; }
 	//!
 	ColorFormat getColorFormat() const { return mOptions.mColorFormat; }
-	//!
+	//! Requests the debug buffer value at \a pixel (origin at the upper left) and returns the latest value read back for it, which lags a frame or two behind. Returns -1 until a readback of \a pixel completes.
 	ci::vec4 getDebugPixel( const ci::ivec2 &pixel ) const;
-	//!
+	//! Returns the readback used by getDebugPixel(), for its latency and stall stats.
+	const PixelReadback&	getDebugPixelReadback() const	{ return mDebugPixelReadback; }
+	//! Blits the rendered part of the scene color buffer to \a fbo, scaling it to fill its bounds.
 	void blitTo(const ci::gl::FboRef &fbo ) const;
 	//!
 	void markAsDirty() const { mFboScene->markAsDirty(); }
@@ -207,6 +267,9 @@ public:
 
 	ci::signals::Signal<void()> &getBuffersChangedSignal() { return mSignalBuffersChanged; }
 
+	//! Returns the graph of the last postDraw(), which owns the transient buffers of all effects.
+	const FrameGraph&	getFrameGraph() const	{ return mFrameGraph; }
+
 private:
 	//! configuring buffers is deferred until next preDraw(), but this will flag them as needing configuration
 	//! - also deletes the existing framebuffers so they can't be used (eg. in ImGui views) until they are re-created
@@ -214,16 +277,27 @@ private:
 	//! Configure the framebuffers according to Options
 	void configureBuffers();
 	void loadGlsl();
+	void loadColorGradingLut();
+	//! Returns true if the composite pass draws to the output, which depends on Options::fusedComposite(), Options::fusedFxaa() and the anti-alias type
+	bool isCompositeFused() const;
+	//! Replicates the last rendered column and row of the scene buffers over \a margin pixels past the render size, for effects that sample past it
+	void extendRenderEdges( int margin );
+	//! Draws the composite of the scene \a color and \a glow to \a destRect in the current framebuffer
+	void drawComposite( const FrameGraph &graph, FrameGraph::ResourceId color, FrameGraph::ResourceId glow, const ci::vec2 &renderScale, const ci::Rectf &destRect );
 
 	ci::ivec2				mSize;
+	ci::ivec2				mRenderSize;
 	ci::gl::BatchRef		mBatchComposite;
-	ci::gl::FboRef			mFboScene, mFboComposite;
+	ci::gl::FboRef			mFboScene;
+	FrameGraph				mFrameGraph;
 	ci::gl::GlslProgRef		mGlslDepthTexturePreview;
+	ci::gl::Texture2dRef	mTextureColorGradingLut;
 
-	ci::signals::ScopedConnection mConnGlslPostProcess, mConnGlslDepthTexture;
+	ci::signals::ScopedConnection mConnGlslPostProcess, mConnGlslDepthTexture, mConnColorGradingLut;
 	ci::signals::Signal<void()>   mSignalBuffersChanged;
 
 	ci::CameraPersp			mCam;
+	mutable PixelReadback	mDebugPixelReadback;
 
 	// Defaults are set in Options
 	mutable Options mOptions;
@@ -242,6 +316,9 @@ private:
 
 	std::unique_ptr<FXAA>	mFXAA;
 	std::unique_ptr<SMAA>	mSMAA;
+	std::unique_ptr<TAA>	mTAA;
+
+	std::unique_ptr<DynamicResolution>	mDynamicResolution;
 	bool					mBuffersNeedConfigure = false;
 };
 
@@ -167,6 +167,12 @@ AudioTrackView::AudioTrackView( AudioAnalyzerView *parent, int trackIndex, const
 
 		mSpectrogramView->load( track ); // TEMPORARY: disabling as it takes a while to load currently
 	}
+	else {
+		// nothing to load for input devices, show the recent spectrum instead
+		mSpectrogramView = make_shared<AudioSpectrogramView>( trackIndex );
+		mSpectrogramView->setLiveEnabled( true );
+		addSubview( mSpectrogramView );
+	}
 
 	mSpectrumView = make_shared<AudioSpectrumView>();
 	addSubview( mSpectrumView );
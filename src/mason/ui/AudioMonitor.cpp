@@ -26,11 +26,11 @@
 #include "cinder/gl/gl.h"
 #include "cinder/gl/TextureFont.h"
 #include "cinder/gl/Shader.h"
-#include "cinder/PolyLine.h"
 #include "cinder/audio/Context.h"
-#include "cinder/audio/MonitorNode.h"
 #include "cinder/audio/Utilities.h"
-#include "cinder/audio/dsp/Dsp.h"
+
+#include <atomic>
+#include <limits>
 
 using namespace std;
 using namespace ci;
@@ -56,6 +56,118 @@ class ParamAdapterNode : public audio::Node {
 	audio::Param	*mParam;
 };
 
+//! \brief Reduces its input to the min, max and sum of squares of consecutive columns of samples, on the audio thread.
+//!
+//! Columns are written to a ring per channel that the main thread reads without locking. The ring holds twice the columns
+//! that can be read at once, so a column being overwritten during a read would have to be a whole window old.
+class WaveformMonitorNode : public audio::NodeAutoPullable {
+  public:
+	WaveformMonitorNode( size_t windowSize )
+		: NodeAutoPullable( audio::Node::Format() ), mWindowSize( windowSize )
+	{
+	}
+
+	//! Splits the window into about \a numColumns columns, for example one per pixel. Can be called from any thread, columns already written keep their size.
+	void setNumColumns( size_t numColumns )	{ mSamplesPerColumn = max<size_t>( mWindowSize / max<size_t>( numColumns, 1 ), 1 ); }
+	size_t getNumColumns() const				{ return mWindowSize / mSamplesPerColumn; }
+	size_t getSamplesPerColumn() const			{ return mSamplesPerColumn; }
+
+	//! Copies the last \a numColumns columns of \a channel as (min, max) pairs to \a minMax, oldest first. Columns that haven't been written yet are zero.
+	//! Returns the sum of squares of the samples in the copied columns.
+	float readColumns( size_t channel, size_t numColumns, vec2 *minMax ) const
+	{
+		CI_ASSERT( channel < mNumChannels && numColumns <= mCapacity / 2 );
+
+		const uint64_t numWritten = mNumColumnsWritten.load( memory_order_acquire );
+		const size_t numAvailable = (size_t)min<uint64_t>( numWritten, numColumns );
+		const size_t numMissing = numColumns - numAvailable;
+		const Column *ring = &mColumns[channel * mCapacity];
+
+		float sumSquares = 0;
+		for( size_t i = 0; i < numMissing; i++ )
+			minMax[i] = vec2( 0 );
+
+		for( size_t i = 0; i < numAvailable; i++ ) {
+			const Column &column = ring[( numWritten - numAvailable + i ) % mCapacity];
+			minMax[numMissing + i] = vec2( column.mMin, column.mMax );
+			sumSquares += column.mSumSquares;
+		}
+
+		return sumSquares;
+	}
+
+  protected:
+	void initialize() override
+	{
+		mNumChannels = getNumChannels();
+		mCapacity = 2 * mWindowSize;
+		mColumns.assign( mNumChannels * mCapacity, Column() );
+		mPartialColumns.assign( mNumChannels, Column() );
+		mLastSamples.assign( mNumChannels, 0.0f );
+		mNumPartialFrames = 0;
+		mNumColumnsWritten = 0;
+	}
+
+	void process( audio::Buffer *buffer ) override
+	{
+		const size_t samplesPerColumn = mSamplesPerColumn;
+		const size_t numFrames = buffer->getNumFrames();
+		uint64_t numWritten = mNumColumnsWritten.load( memory_order_relaxed );
+
+		size_t frame = 0;
+		while( frame < numFrames ) {
+			if( mNumPartialFrames < samplesPerColumn ) {
+				const size_t count = min( samplesPerColumn - mNumPartialFrames, numFrames - frame );
+				for( size_t ch = 0; ch < mNumChannels; ch++ ) {
+					const float *samples = buffer->getChannel( ch ) + frame;
+					Column &column = mPartialColumns[ch];
+					for( size_t i = 0; i < count; i++ ) {
+						const float sample = samples[i];
+						column.mMin = min( column.mMin, sample );
+						column.mMax = max( column.mMax, sample );
+						column.mSumSquares += sample * sample;
+					}
+					mLastSamples[ch] = samples[count - 1];
+				}
+
+				mNumPartialFrames += count;
+				frame += count;
+			}
+
+			if( mNumPartialFrames >= samplesPerColumn ) {
+				const size_t index = size_t( numWritten % mCapacity );
+				for( size_t ch = 0; ch < mNumChannels; ch++ ) {
+					mColumns[ch * mCapacity + index] = mPartialColumns[ch];
+					// starting at the previous sample makes neighbouring columns overlap, so the drawn segments connect
+					const float last = mLastSamples[ch];
+					mPartialColumns[ch] = { last, last, 0 };
+				}
+
+				mNumPartialFrames = 0;
+				mNumColumnsWritten.store( ++numWritten, memory_order_release );
+			}
+		}
+	}
+
+  private:
+	struct Column {
+		float mMin = 0;
+		float mMax = 0;
+		float mSumSquares = 0;
+	};
+
+	const size_t			mWindowSize;
+	std::atomic<size_t>		mSamplesPerColumn = { 1 };
+	std::atomic<uint64_t>	mNumColumnsWritten = { 0 };
+
+	size_t					mNumChannels = 0;
+	size_t					mCapacity = 0;
+	size_t					mNumPartialFrames = 0;
+	std::vector<Column>		mColumns;			// mCapacity columns per channel
+	std::vector<Column>		mPartialColumns;	// the columns still being accumulated
+	std::vector<float>		mLastSamples;
+};
+
 AudioMonitorView::AudioMonitorView( const Rectf &bounds, size_t windowSize )
 	: View( bounds )
 {
@@ -68,8 +180,7 @@ AudioMonitorView::AudioMonitorView( const Rectf &bounds, size_t windowSize )
 
 void AudioMonitorView::initMonitorNode()
 {
-	auto format = audio::MonitorNode::Format().windowSize( mWindowSize );
-	mMonitorNode = audio::master()->makeNode( new audio::MonitorNode( format ) );
+	mMonitorNode = audio::master()->makeNode( new WaveformMonitorNode( mWindowSize ) );
 }
 
 void AudioMonitorView::setNode( const ci::audio::NodeRef &node )
@@ -92,8 +203,6 @@ void AudioMonitorView::draw( vu::Renderer *ren )
 	if( ! mMonitorNode || ! mLabelText )
 		return;
 
-	const auto &buffer = mMonitorNode->getBuffer();
-
 	gl::ScopedGlslProg glslScope( getStockShader( gl::ShaderDef().color() ) );
 
 	float labelY = mLabelText->getAscent() + 2;
@@ -104,62 +213,91 @@ void AudioMonitorView::draw( vu::Renderer *ren )
 	gl::ScopedColor colorScope( ColorA( 0, 0, 0, 0.5 ) );
 	gl::drawSolidRect( waveformBounds );
 
-	if( mDrawVolumeMeters ) {
-		const float meterWidth = 20.0f;
+	const float meterWidth = 20.0f;
+	if( mDrawVolumeMeters )
 		waveformBounds.x2 -= meterWidth;
 
+	const float rms = updateWaveformVertices( waveformBounds );
+
+	if( mDrawVolumeMeters ) {
 		auto meterBounds = Rectf( getWidth() - meterWidth, labelY, getWidth(), getHeight() );
-		drawVolumeMeters( buffer, meterBounds );
+		drawVolumeMeters( rms, meterBounds );
 	}
 
-	drawWaveforms( buffer, waveformBounds );
+	drawWaveforms( waveformBounds );
 
 	mLabelText->drawString( getLabel(), vec2( 4, mLabelText->getAscent() ) );
 }
 
-// TODO: need to minimize the size of the polyline, average buffer samples according to number of pixels
-// - or maybe like 2 samples per pixel to let AA and resizing look nice
-void AudioMonitorView::drawWaveforms( const audio::Buffer &buffer, const ci::Rectf &rect ) const
+// Reads one min / max pair per pixel column, which is two vertices per column and channel. Returns the rms of all channels.
+float AudioMonitorView::updateWaveformVertices( const ci::Rectf &rect )
 {
-	const auto color = ci::ColorA( 0, 0.9f, 0, 1 );
+	// not initialized until it has an input
+	const size_t numChannels = mMonitorNode->isInitialized() ? mMonitorNode->getNumChannels() : 0;
+	if( ! numChannels ) {
+		mVertices.clear();
+		return 0;
+	}
 
-	gl::color( color );
+	mMonitorNode->setNumColumns( max<size_t>( (size_t)rect.getWidth(), 1 ) );
+	const size_t numColumns = mMonitorNode->getNumColumns();
+
+	mColumnMinMax.resize( numColumns );
+	mVertices.resize( numChannels * numColumns * 2 );
 
-	const float waveHeight = rect.getHeight() / (float)buffer.getNumChannels();
-	const float xScale = rect.getWidth() / (float)buffer.getNumFrames();
+	const float waveHeight = rect.getHeight() / (float)numChannels;
+	const float xScale = rect.getWidth() / (float)numColumns;
 
+	float sumSquares = 0;
 	float yOffset = rect.y1;
-	for( size_t ch = 0; ch < buffer.getNumChannels(); ch++ ) {
-		PolyLine2f polyline;
-		const float *channel = buffer.getChannel( ch );
-		float x = rect.x1;
-		for( size_t i = 0; i < buffer.getNumFrames(); i++ ) {
+	vec2 *vertex = mVertices.data();
+	for( size_t ch = 0; ch < numChannels; ch++ ) {
+		sumSquares += mMonitorNode->readColumns( ch, numColumns, mColumnMinMax.data() );
+
+		float x = rect.x1 + xScale * 0.5f;
+		for( const vec2 &minMax : mColumnMinMax ) {
+			// scale samples from min and max to 0:1, then flip on y axis and fit to wave bounds
+			*vertex++ = vec2( x, ( 1 - lmap<float>( minMax.x, mMinValue, mMaxValue, 0, 1 ) ) * waveHeight + yOffset );
+			*vertex++ = vec2( x, ( 1 - lmap<float>( minMax.y, mMinValue, mMaxValue, 0, 1 ) ) * waveHeight + yOffset );
 			x += xScale;
-			// scale sample from min and max to 0:1
-			float scaledSample = lmap<float>( channel[i], mMinValue, mMaxValue, 0, 1 );
-			// flip on y axis and fit to wave bounds
-			float y = ( 1 - scaledSample ) * waveHeight + yOffset;
-			polyline.push_back( vec2( x, y ) );
 		}
 
-		if( ! polyline.getPoints().empty() )
-			gl::draw( polyline );
-
 		yOffset += waveHeight;
 	}
 
+	const size_t numSamples = numChannels * numColumns * mMonitorNode->getSamplesPerColumn();
+	return numSamples ? sqrt( sumSquares / (float)numSamples ) : 0.0f;
+}
+
+void AudioMonitorView::drawWaveforms( const ci::Rectf &rect )
+{
+	const auto color = ci::ColorA( 0, 0.9f, 0, 1 );
+
+	gl::color( color );
+
+	if( ! mVertices.empty() ) {
+		const size_t numBytes = mVertices.size() * sizeof( vec2 );
+		if( ! mVbo || mVbo->getSize() < numBytes ) {
+			mVbo = gl::Vbo::create( GL_ARRAY_BUFFER, numBytes, nullptr, GL_DYNAMIC_DRAW );
+			mVboMesh.reset();
+		}
+		if( ! mVboMesh || mVboMesh->getNumVertices() != mVertices.size() ) {
+			auto layout = gl::VboMesh::Layout().usage( GL_DYNAMIC_DRAW ).attrib( geom::POSITION, 2 );
+			mVboMesh = gl::VboMesh::create( (uint32_t)mVertices.size(), GL_LINES, { { layout, mVbo } } );
+		}
+
+		mVbo->bufferSubData( 0, numBytes, mVertices.data() );
+		gl::draw( mVboMesh );
+	}
+
 	// draw frame
 	gl::color( color.r, color.g, color.b, color.a * 0.6f );
 	gl::drawStrokedRect( rect );
 }
 
-void AudioMonitorView::drawVolumeMeters( const audio::Buffer &buffer, const ci::Rectf &rect ) const
+void AudioMonitorView::drawVolumeMeters( float rms, const ci::Rectf &rect ) const
 {
 	// TODO: draw one meter per channel
-	const float *channel = buffer.getData();
-
-	float rms = audio::dsp::rms( channel, buffer.getSize() );
-
 	// FIXME: this is not at all matching to visuals.
 	// - need to approach this with something to compare to, such as in pd and with a simpler test app.
 //	float rmsDB = audio::linearToDecibel( rms );
@@ -28,23 +28,21 @@
 #include "cinder/audio/Node.h"
 #include "cinder/audio/GainNode.h"
 #include "cinder/audio/Param.h"
+#include "cinder/gl/VboMesh.h"
 
 #include "vu/View.h"
 #include "vu/Suite.h"
 #include "vu/TextManager.h"
 
-namespace cinder {
-
-namespace audio {
-	typedef std::shared_ptr<class MonitorNode>	MonitorNodeRef;
-}
-
-} // namespace cinder
-
 namespace mason { namespace mui {
 
 typedef std::shared_ptr<class AudioMonitorView> AudioMonitorViewRef;
+typedef std::shared_ptr<class WaveformMonitorNode> WaveformMonitorNodeRef;
 
+//! \brief Draws the waveform and volume of a Node or Param.
+//!
+//! Samples are reduced on the audio thread to a min / max pair per pixel column, so each frame uploads two vertices per column
+//! into a persistent VBO and draws every channel with one draw call, regardless of the window size.
 class AudioMonitorView : public vu::View {
   public:
 	AudioMonitorView( const ci::Rectf &bounds = ci::Rectf::zero(), size_t windowSize = 0 );
@@ -64,12 +62,18 @@ class AudioMonitorView : public vu::View {
 
   private:
 	void initMonitorNode();
-	void drawWaveforms( const ci::audio::Buffer &buffer, const ci::Rectf &rect ) const;
-	void drawVolumeMeters( const ci::audio::Buffer &buffer, const ci::Rectf &rect ) const;
+	float updateWaveformVertices( const ci::Rectf &rect );
+	void drawWaveforms( const ci::Rectf &rect );
+	void drawVolumeMeters( float rms, const ci::Rectf &rect ) const;
 
-	ci::audio::MonitorNodeRef	mMonitorNode;
+	WaveformMonitorNodeRef	mMonitorNode;
 	vu::TextRef				mLabelText;
 
+	std::vector<ci::vec2>	mColumnMinMax;	// scratch for reading one channel's columns
+	std::vector<ci::vec2>	mVertices;		// (x, min) and (x, max) per column, channels one after another
+	ci::gl::VboRef			mVbo;			// only reallocated when it needs to grow
+	ci::gl::VboMeshRef		mVboMesh;
+
 	bool			mDrawVolumeMeters = true;
 	float			mMinValue = -1;
 	float			mMaxValue = 1;
@@ -21,6 +21,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "mason/ui/AudioViews.h"
 #include "mason/audio/OfflineContext.h"
+#include "mason/Assets.h"
 #include "fmt/format.h"
 
 #include "cinder/Log.h"
@@ -28,14 +29,6 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "cinder/gl/gl.h"
 #include "cinder/audio/audio.h"
 #include "cinder/Timer.h"
-#include "cinder/Triangulate.h"
-
-#define CEREAL_ENABLED 0
-#if CEREAL_ENABLED
-#include "CinderCereal.h"
-#include <cereal/archives/binary.hpp>
-#include <cereal/types/vector.hpp>
-#endif
 
 using namespace ci;
 using namespace std;
@@ -54,33 +47,6 @@ gl::TextureFontRef getTrackViewFont()
 	return sTextFont;
 }
 
-void calcMinMaxForSection( const float *buffer, size_t samplesPerSection, float &max, float &min )
-{
-	max = 0;
-	min = 0;
-	for( size_t k = 0; k < samplesPerSection; k++ ) {
-		float s = buffer[k];
-		max = glm::max( max, s );
-		min = glm::min( min, s );
-	}
-}
-
-void calcAverageForSection( const float *buffer, size_t samplesPerSection, float &upper, float &lower )
-{
-	upper = 0;
-	lower = 0;
-	for( size_t k = 0; k < samplesPerSection; k++ ) {
-		float s = buffer[k];
-		if( s > 0 ) {
-			upper += s;
-		} else {
-			lower += s;
-		}
-	}
-	upper /= samplesPerSection;
-	lower /= samplesPerSection;
-}
-
 } // anonymous namespace
 
 // ----------------------------------------------------------------------------------------------------
@@ -100,50 +66,104 @@ AudioBufferView::AudioBufferView( const ci::Rectf &bounds )
 
 void AudioBufferView::load( const std::vector<float> &samples, size_t pixelsPerVertex )
 {
-	mWaveformVbos.clear();
+	auto buffer = make_shared<ci::audio::Buffer>( samples.size(), 1 );
+	copy( samples.begin(), samples.end(), buffer->getData() );
 
-	loadWaveform( samples.data(), samples.size(), getSize(), pixelsPerVertex, CalcMode::MIN_MAX );
-	loadWaveform( samples.data(), samples.size(), getSize(), pixelsPerVertex, CalcMode::AVERAGE );
+	load( buffer, pixelsPerVertex );
 }
 
 void AudioBufferView::load( const ci::audio::BufferRef &buffer, size_t pixelsPerVertex )
 {
+	mBuffer = buffer;
+	mPixelsPerVertex = max<size_t>( 1, pixelsPerVertex );
+	mPyramids.clear();
 	mWaveformVbos.clear();
 
-	size_t numChannels = buffer->getNumChannels();
-	ivec2 waveSize = getSize();
-	waveSize.y /= numChannels;
-	for( size_t ch = 0; ch < numChannels; ch++ ) {
-		loadWaveform( buffer->getChannel( ch ), buffer->getNumFrames(), waveSize, pixelsPerVertex, CalcMode::MIN_MAX );
-		loadWaveform( buffer->getChannel( ch ), buffer->getNumFrames(), waveSize, pixelsPerVertex, CalcMode::AVERAGE );
+	Timer timer( true );
+
+	for( size_t ch = 0; ch < buffer->getNumChannels(); ch++ ) {
+		mPyramids.push_back( ma::audio::WaveformPyramid::create( buffer->getChannel( ch ), buffer->getNumFrames() ) );
 	}
+
+	CI_LOG_V( "built waveform pyramids for " << buffer->getNumChannels() << " channels, " << buffer->getNumFrames() << " frames in " << timer.getSeconds() << " seconds." );
+
+	mVisibleBeginFrame = 0;
+	mVisibleEndFrame = buffer->getNumFrames();
+	mMeshesDirty = true;
 }
 
-void AudioBufferView::loadWaveform( const float *samples, size_t numSamples, const ci::vec2 &waveSize, size_t pixelsPerVertex, CalcMode mode )
+void AudioBufferView::setVisibleRange( size_t beginFrame, size_t endFrame )
 {
-	float height = waveSize.y / 2.0f;
-	size_t numSections = waveSize.x / pixelsPerVertex + 1;
-	size_t samplesPerSection = numSamples / numSections;
+	const size_t numFrames = getNumFrames();
+	endFrame = min( endFrame, numFrames );
+	if( endFrame <= beginFrame ) {
+		beginFrame = 0;
+		endFrame = numFrames;
+	}
 
-	ci::PolyLine2f polyLine;
-	vector<vec2> &points = polyLine.getPoints();
-	points.resize( numSections * 2 );
+	if( beginFrame != mVisibleBeginFrame || endFrame != mVisibleEndFrame ) {
+		mVisibleBeginFrame = beginFrame;
+		mVisibleEndFrame = endFrame;
+		mMeshesDirty = true;
+	}
+}
 
-	for( size_t i = 0; i < numSections; i++ ) {
-		float x = (float)i * pixelsPerVertex;
-		float yUpper, yLower;
-		if( mode == CalcMode::MIN_MAX ) {
-			calcMinMaxForSection( &samples[i * samplesPerSection], samplesPerSection, yUpper, yLower );
-		} else {
-			calcAverageForSection( &samples[i * samplesPerSection], samplesPerSection, yUpper, yLower );
-		}
-		points[i] = vec2( x, height - height * yUpper );
-		points[numSections * 2 - i - 1] = vec2( x, height - height * yLower );
+// Rebuilds one triangle strip per band and channel, with one pair of vertices per column.
+// Each column reads from the pyramid level that matches the samples per column, so the cost depends on the view's width rather than the length of the buffer.
+void AudioBufferView::updateWaveformMeshes()
+{
+	mMeshesDirty = false;
+
+	const size_t numChannels = mPyramids.size();
+	const size_t numVisibleFrames = mVisibleEndFrame - mVisibleBeginFrame;
+	if( ! numChannels || ! numVisibleFrames || getWidth() < 1 ) {
+		mWaveformVbos.clear();
+		return;
 	}
-	polyLine.setClosed();
 
-	auto mesh = gl::VboMesh::create( Triangulator( polyLine ).calcMesh() );
-	mWaveformVbos.push_back( mesh );
+	const size_t numColumns = size_t( getWidth() ) / mPixelsPerVertex + 1;
+	const double framesPerColumn = double( numVisibleFrames ) / double( numColumns );
+	const float channelHeight = getHeight() / float( numChannels );
+	const float halfHeight = channelHeight / 2.0f;
+
+	vector<ma::audio::WaveformSummary> summaries( numColumns );
+	mVertices.resize( numColumns * 2 );
+	mWaveformVbos.resize( numChannels * 2 );
+
+	auto bufferStrip = []( gl::VboMeshRef &mesh, const vector<vec2> &vertices ) {
+		if( ! mesh || mesh->getNumVertices() != vertices.size() ) {
+			auto layout = gl::VboMesh::Layout().usage( GL_DYNAMIC_DRAW ).attrib( geom::POSITION, 2 );
+			mesh = gl::VboMesh::create( (uint32_t)vertices.size(), GL_TRIANGLE_STRIP, { layout } );
+		}
+		mesh->bufferAttrib( geom::POSITION, vertices );
+	};
+
+	for( size_t ch = 0; ch < numChannels; ch++ ) {
+		const auto &pyramid = mPyramids[ch];
+		const int level = pyramid->getLevelForSamplesPerPixel( framesPerColumn );
+
+		for( size_t i = 0; i < numColumns; i++ ) {
+			size_t beginFrame = mVisibleBeginFrame + size_t( double( i ) * framesPerColumn );
+			size_t endFrame = max( beginFrame + 1, mVisibleBeginFrame + size_t( double( i + 1 ) * framesPerColumn ) );
+			summaries[i] = pyramid->getSummary( beginFrame, endFrame, level );
+		}
+
+		const float centerY = ch * channelHeight + halfHeight;
+
+		for( size_t i = 0; i < numColumns; i++ ) {
+			float x = float( i * mPixelsPerVertex );
+			mVertices[i * 2] = vec2( x, centerY - halfHeight * summaries[i].mMax );
+			mVertices[i * 2 + 1] = vec2( x, centerY - halfHeight * summaries[i].mMin );
+		}
+		bufferStrip( mWaveformVbos[ch * 2], mVertices );
+
+		for( size_t i = 0; i < numColumns; i++ ) {
+			float x = float( i * mPixelsPerVertex );
+			mVertices[i * 2] = vec2( x, centerY - halfHeight * summaries[i].mRms );
+			mVertices[i * 2 + 1] = vec2( x, centerY + halfHeight * summaries[i].mRms );
+		}
+		bufferStrip( mWaveformVbos[ch * 2 + 1], mVertices );
+	}
 }
 
 void AudioBufferView::setTitle( const std::string &title )
@@ -152,10 +172,10 @@ void AudioBufferView::setTitle( const std::string &title )
 	mTitleLabel->setText( title );
 }
 
-// TODO: figure out what to do when layout changes and a buffer has already been loaded
 void AudioBufferView::layout()
 {
 	mTitleLabel->setBounds( Rectf( 0, 0, getWidth(), 20 ) );
+	mMeshesDirty = true;
 }
 
 void AudioBufferView::update()
@@ -164,30 +184,22 @@ void AudioBufferView::update()
 
 void AudioBufferView::draw( ::vu::Renderer *ren )
 {
+	if( mMeshesDirty ) {
+		updateWaveformMeshes();
+	}
+
 	if( ! mWaveformVbos.empty() ) {
 
 		// TODO: use our own Vao + shader
 		gl::ScopedGlslProg glslScope( getStockShader( gl::ShaderDef().color() ) );
 
-		// evens are average values, odds are min/max
-		gl::color( mColorMinMax );
-		gl::draw( mWaveformVbos[0] );
-
-		gl::color( mColorAverage );
-		gl::draw( mWaveformVbos[1] );
-
-		// TODO: support N number channels
-		if( mWaveformVbos.size() > 2 ) {
-			gl::pushMatrices(); // TODO: use scoped mat
-			gl::translate( 0, getBounds().getHeight() / 2 );
-
+		// evens are min/max values, odds are RMS
+		for( size_t i = 0; i < mWaveformVbos.size(); i += 2 ) {
 			gl::color( mColorMinMax );
-			gl::draw( mWaveformVbos[2] );
-
-			gl::color( mColorAverage );
-			gl::draw( mWaveformVbos[3] );
+			gl::draw( mWaveformVbos[i] );
 
-			gl::popMatrices();
+			gl::color( mColorRms );
+			gl::draw( mWaveformVbos[i + 1] );
 		}
 	}
 
@@ -333,24 +345,32 @@ ma::ColorLUT<ci::ColorAf> makeLutSpectrogram()
 	return ColorLUT<ci::ColorAf>( 1000, stops );
 }
 
+// Holds one STFT frame of linear magnitudes per row. Rows are sampled nearest so that ring buffer wrapping doesn't blend the newest and oldest frames.
+gl::TextureRef createMagTexture( size_t numBins, size_t numRows )
+{
+	auto format = gl::Texture2d::Format().internalFormat( GL_R32F ).dataType( GL_FLOAT ).minFilter( GL_NEAREST ).magFilter( GL_NEAREST )
+		.wrapS( GL_CLAMP_TO_EDGE ).wrapT( GL_REPEAT ).label( "AudioSpectrogramView magnitudes" );
+
+	return gl::Texture2d::create( (int)numBins, (int)numRows, format );
+}
+
 AudioSpectrogramView::AudioSpectrogramView( int trackIndex, const ci::Rectf &bounds )
 	: View( bounds ), mTrackIndex( trackIndex )
 {
 	CI_LOG_I( "bang. this: " << hex << this << dec );
-	//initGl();
 	mLUT = makeLutSpectrogram();
+	mLutTex = gl::Texture2d::create( mLUT.makeSurface32a(), gl::Texture2d::Format().minFilter( GL_LINEAR ).magFilter( GL_LINEAR ).wrap( GL_CLAMP_TO_EDGE ) );
+
+	mConnGlsl = ma::assets()->getShader( "mason/passthrough.vert", "mason/audio/spectrogram.frag", gl::GlslProg::Format().label( "AudioSpectrogramView" ),
+		[this]( gl::GlslProgRef glsl ) {
+			mGlsl = glsl;
+		}
+	);
 }
 
 void AudioSpectrogramView::load( const audio::TrackRef &track )
 {
 	auto fileName = track->getSampleFilePath();
-	if( readSTFTFromDisk( fileName ) ) {
-		return;
-	}
-
-	auto ctx = make_shared<ma::audio::OfflineContext>();
-	ctx->setFramesPerBlock( 2048 );
-	ctx->setOuputNumChannels( 1 );
 
 	if( ! fs::exists( fileName ) ) {
 		// TODO: this is necessary at the moment because we're not going through AssetManager. Shouldn't be in the long run
@@ -364,11 +384,36 @@ void AudioSpectrogramView::load( const audio::TrackRef &track )
 		return;
 	}
 
+	auto ctx = make_shared<ma::audio::OfflineContext>();
+	ctx->setFramesPerBlock( 2048 );
+	ctx->setOuputNumChannels( 1 );
+
+	auto fftSize = track->getFftSize();
+	auto windowSize = track->getWindowSize();
+
+	// one spectrum is taken per pull, so the hop size is the block size
+	const fs::path cacheDir = "build/audio";
+	ma::audio::SpectrogramKey key;
+	key.mContentHash = ma::audio::hashFileContents( fileName, cacheDir );
+	key.mSampleRate = (uint32_t)ctx->getSampleRate();
+	key.mFftSize = (uint32_t)fftSize;
+	key.mWindowSize = (uint32_t)windowSize;
+	key.mHopSize = (uint32_t)ctx->getFramesPerBlock();
+
+	const auto cachePath = ma::audio::getSpectrogramCachePath( cacheDir, key );
+
+	Timer timerOpen( true );
+	mCache = ma::audio::SpectrogramCache::open( cachePath, key );
+	if( mCache ) {
+		CI_LOG_I( "mapped STFT cache: " << cachePath << " in " << timerOpen.getSeconds() << " seconds. STFT frames: " << mCache->getNumFrames() );
+		mTex.reset();
+		setVisibleFrameRange( mVisibleBeginFrame, mVisibleEndFrame );
+		return;
+	}
+
 	auto playerNode = ctx->makeNode<ci::audio::FilePlayerNode>( ci::audio::load( ci::loadFile( fileName ) ) );
 	playerNode->setName( "<offline> BufferPlayerNode (" + fileName.string() + ")" );
 
-	auto fftSize = track->getMonitorSpectralNode()->getFftSize();
-	auto windowSize = track->getMonitorSpectralNode()->getWindowSize();
 	auto monitorFormat = ci::audio::MonitorSpectralNode::Format().fftSize( fftSize ).windowSize( windowSize );
 
 	CI_LOG_I( "monitor window size: " << windowSize << ", fft size: " << fftSize );
@@ -387,137 +432,122 @@ void AudioSpectrogramView::load( const audio::TrackRef &track )
 
 	Timer timer1( true );
 
+	// frames are streamed straight to disk rather than held in memory, then the finished file is mapped
+	ma::audio::SpectrogramCacheWriter writer( cachePath, key, fftSize / 2 );
 	while( ! playerNode->isEof() ) {
 		ctx->pull( &buffer );
 
-		auto spec = monitor->getMagSpectrum();
-		mSTFT.push_back( spec );
+		const auto &spec = monitor->getMagSpectrum();
+		CI_ASSERT( spec.size() == writer.getNumBins() );
+		writer.writeFrame( spec.data() );
 	}
 
 	timer1.stop();
 
-	CI_LOG_I( "wrote " << mSTFT.size() << " STFT frames, memory occupuid: " << mSTFT.size() * mSTFT[0].size() * sizeof( float ) * 1e-6 << "mb" );
-
-
+	CI_LOG_I( "wrote " << writer.getNumFrames() << " STFT frames, size on disk: " << writer.getNumFrames() * writer.getNumBins() * sizeof( float ) * 1e-6 << "mb" );
 	CI_LOG_I( "seconds to compute STFT: " << timer1.getSeconds() );
-	writeSTFTToDisk( fileName );
-}
-
-fs::path makeSTFTFileName( const ci::fs::path &sampleName )
-{
-	string outFileName = sampleName.filename().string() + ".cereal";
-	//auto outFilePath = "build" / sampleName;
-	//outFilePath.replace_filename( outFileName );
 
-	auto outFilePath = fs::path( "build/audio/" + outFileName );
-	return outFilePath;
-}
-
-bool AudioSpectrogramView::readSTFTFromDisk( const ci::fs::path &sampleName )
-{
-	auto filePath = makeSTFTFileName( sampleName );
-	if( ! fs::exists( filePath ) ) {
-		return false;
+	if( ! writer.finish() ) {
+		return;
 	}
 
-#if	CEREAL_ENABLED
-	Timer timer( true );
-
-	std::ifstream is( filePath, std::ios::binary );
-	cereal::BinaryInputArchive iarchive( is );
-
-	iarchive( mSTFT );
-
-	CI_LOG_I( "read archive in file: " << filePath << " in " << timer.getSeconds() << " seconds. STFT frames loaded: " << mSTFT.size() );
-
-	return true;
-#else
-	return false;
-#endif
+	mCache = ma::audio::SpectrogramCache::open( cachePath, key );
+	mTex.reset();
+	setVisibleFrameRange( mVisibleBeginFrame, mVisibleEndFrame );
 }
 
-void AudioSpectrogramView::writeSTFTToDisk( const ci::fs::path &sampleName )
+void AudioSpectrogramView::setVisibleFrameRange( size_t beginFrame, size_t endFrame )
 {
-	if( mSTFT.empty() ) {
-		CI_LOG_E( "mSTFT empty, returning." );
-		return;
+	if( mCache ) {
+		const size_t numFrames = mCache->getNumFrames();
+		endFrame = min( endFrame, numFrames );
+		if( endFrame <= beginFrame ) {
+			beginFrame = 0;
+			endFrame = numFrames;
+		}
 	}
 
-#if	CEREAL_ENABLED
-	Timer timer( true );
-
-	auto filePath = makeSTFTFileName( sampleName );
-	if( ! fs::exists( filePath.parent_path() ) ) {
-		fs::create_directories( filePath.parent_path() );
+	if( beginFrame != mVisibleBeginFrame || endFrame != mVisibleEndFrame ) {
+		mVisibleBeginFrame = beginFrame;
+		mVisibleEndFrame = endFrame;
+		mTex.reset();
 	}
+}
 
-	std::ofstream os( filePath, std::ios::binary ); // TODO: is this the readable format?
-	cereal::BinaryOutputArchive archive( os );
-
-	archive( mSTFT );
-
-	CI_LOG_I( "wrote archive to file: " << filePath << " in " << timer.getSeconds() << " seconds." );
-#endif
+size_t AudioSpectrogramView::frameAtPos( float x ) const
+{
+	const size_t numVisibleFrames = mVisibleEndFrame - mVisibleBeginFrame;
+	return mVisibleBeginFrame + min<size_t>( size_t( glm::max( 0.0f, x / getWidth() ) * numVisibleFrames ), numVisibleFrames - 1 );
 }
 
-// TODO: think through how I can do this write progressively. Right now I don't know how wide it should be until EOF
-// - should I load it directly into Texture?
-// - going to want to render it inbetween anyway
-// FIXME NEXT: mags coming out zero only in release mode
-// - need to use double precision?
 void AudioSpectrogramView::makeTex()
 {
 	CI_ASSERT( getWidth() && getHeight() );
-	CI_ASSERT( ! mSTFT.empty() );
+	CI_ASSERT( mCache );
 
-	float numBins = mSTFT[0].size();
-	vec2 imgSize = getSize();
-	auto surface = Surface32f( imgSize.x, imgSize.y, true );
-	CI_LOG_I( "surface size: " << surface .getSize() );
+	// one row per column of the view, each read contiguously from the mapped file so that only visible frames get paged in
+	const size_t numBins = mCache->getNumBins();
+	const size_t numRows = (size_t)getWidth();
 
 	Timer timer( true );
 
-	auto iter = surface.getIter();
-	while( iter.line() ) {
-		size_t bin = min<size_t>( numBins - round( float( iter.y() / imgSize.y ) * numBins ), numBins - 1 );
-		while( iter.pixel() ) {
-			size_t frame = min<size_t>( float( iter.x() / imgSize.x ) * mSTFT.size(), mSTFT.size() - 1 );
+	vector<float> rows( numRows * numBins );
+	for( size_t x = 0; x < numRows; x++ ) {
+		memcpy( rows.data() + x * numBins, mCache->getFrame( frameAtPos( float( x ) ) ), numBins * sizeof( float ) );
+	}
 
-			float mag = mSTFT[frame][bin];
-			mag = ci::audio::linearToDecibel( mag ) / 100.0f; // TODO: consider storing this in DB within the mSTFT frames
+	mTex = createMagTexture( numBins, numRows );
+	mTex->update( rows.data(), GL_RED, GL_FLOAT, 0, (int)numBins, (int)numRows );
+	mTexWriteRow = 0;
+	mTexNumRows = numRows;
 
-			auto col = mLUT.lookup( mag );
-			iter.r() = col.r;
-			iter.g() = col.g;
-			iter.b() = col.b;
-			iter.a() = col.a;
-		}
-	}
+	CI_LOG_I( "tex size: " << mTex->getSize() << ", visible frames: [" << mVisibleBeginFrame << ", " << mVisibleEndFrame << "), seconds to upload: " << timer.getSeconds() );
+}
+
+void AudioSpectrogramView::setLiveEnabled( bool enable )
+{
+	if( mLiveEnabled == enable )
+		return;
 
-	timer.stop();
+	mLiveEnabled = enable;
+	mTex.reset();
+	mTexNumRows = 0;
+}
 
-	mTex = gl::Texture::create( surface );
+void AudioSpectrogramView::setNumLiveFrames( size_t numFrames )
+{
+	mNumLiveFrames = max<size_t>( numFrames, 1 );
+}
 
-	CI_LOG_I( "tex size: " << mTex->getSize() << ", bounds: " << getBounds() << ", seconds to pack into Surface: " << timer.getSeconds() );
+void AudioSpectrogramView::appendLiveFrame( const vector<float> &magSpectrum )
+{
+	if( magSpectrum.empty() )
+		return;
 
-	if( 0 ) {
-		size_t testFrame = 7547;
-		const auto &magSpectrum = mSTFT[testFrame];
-		CI_LOG_I( "frame: " << testFrame );
-		for( size_t bin = 0; bin < magSpectrum.size(); bin++ ) {
-			float mag = magSpectrum[bin];
-			float magDB = ci::audio::linearToDecibel( mag ) / 100.0f;
-			CI_LOG_I( "[" << bin << "] " << mag << ", " << magDB << " db" );
-		}
+	// rows that haven't been written yet are never sampled, so the texture doesn't need clearing
+	if( ! mTex || mTex->getWidth() != (int)magSpectrum.size() || mTex->getHeight() != (int)mNumLiveFrames ) {
+		mTex = createMagTexture( magSpectrum.size(), mNumLiveFrames );
+		mTexWriteRow = 0;
+		mTexNumRows = 0;
 	}
+
+	mTex->update( magSpectrum.data(), GL_RED, GL_FLOAT, 0, (int)magSpectrum.size(), 1, ivec2( 0, (int)mTexWriteRow ) );
+	mTexWriteRow = ( mTexWriteRow + 1 ) % mNumLiveFrames;
+	mTexNumRows = min( mTexNumRows + 1, mNumLiveFrames );
 }
 
 void AudioSpectrogramView::update( const audio::TrackRef &track )
 {
+	if( mLiveEnabled ) {
+		appendLiveFrame( track->getMagSpectrum() );
+		mBinUnderMouse = { -1, -1 };
+		return;
+	}
+
 	mTrackTimePercent = float( track->getSamplePlaybackTime() / track->getSampleDuration() );
 
 	// update band info under mouse
-	if( mDrawValueAtMouse && ! mSTFT.empty() ) {
+	if( mDrawValueAtMouse && mCache ) {
 		vec2 mousePos = app::App::get()->getMousePos() - app::getWindowPos();
 		Rectf worldBounds = getWorldBounds();
 
@@ -525,10 +555,10 @@ void AudioSpectrogramView::update( const audio::TrackRef &track )
 		if( worldBounds.contains( mousePos ) ) {
 			vec2 valuePos = mousePos - worldBounds.getUpperLeft();
 
-			float numBins = (float)mSTFT[0].size();
+			float numBins = (float)mCache->getNumBins();
 
 			size_t bin = min<size_t>( numBins - round( float( valuePos.y / getHeight() ) * numBins ), numBins - 1 );
-			size_t frame = min<size_t>( float( valuePos.x / getWidth() ) * mSTFT.size(), mSTFT.size() - 1 );
+			size_t frame = frameAtPos( valuePos.x );
 
 			mBinUnderMouse = { frame, bin };
 		}
@@ -544,32 +574,42 @@ void AudioSpectrogramView::update( const audio::TrackRef &track )
 
 void AudioSpectrogramView::draw( ::vu::Renderer *ren )
 {
-	if( ! mSTFT.empty() && ! mTex ) {
+	if( ! mLiveEnabled && mCache && ! mTex ) {
 		makeTex();
 	}
 
-	// TODO: use ImageView
-	if( mTex ) {
-		gl::draw( mTex, getBoundsLocal() );
-	}
+	if( mTex && mTexNumRows > 0 && mGlsl ) {
+		// when the ring is full the oldest frame is at the write row, otherwise rows start at 0
+		const size_t oldestRow = mTexNumRows < (size_t)mTex->getHeight() ? 0 : mTexWriteRow;
+
+		gl::ScopedTextureBind scopedMagTex( mTex, 0 );
+		gl::ScopedTextureBind scopedLutTex( mLutTex, 1 );
+		gl::ScopedGlslProg scopedGlsl( mGlsl );
+		mGlsl->uniform( "uMagTex", 0 );
+		mGlsl->uniform( "uLutTex", 1 );
+		mGlsl->uniform( "uRowOffset", float( oldestRow ) / float( mTex->getHeight() ) );
+		mGlsl->uniform( "uRowScale", float( mTexNumRows ) / float( mTex->getHeight() ) );
 
-	if( 0 ) {
-		auto tex = gl::Texture::create( mLUT.makeSurface32a() );
-		gl::draw( tex, Rectf( 6, 6, 260, 40 ) );
+		gl::drawSolidRect( getBoundsLocal() );
 	}
 
 	// draw current time in track
-	{
-		float barCenter = mTrackTimePercent * getWidth();
+	if( ! mLiveEnabled ) {
+		float barPos = mTrackTimePercent;
+		if( mCache ) {
+			barPos = ( mTrackTimePercent * mCache->getNumFrames() - mVisibleBeginFrame ) / float( mVisibleEndFrame - mVisibleBeginFrame );
+		}
+
+		float barCenter = barPos * getWidth();
 		Rectf verticalBar = { barCenter - 2, 0, barCenter + 2, getHeight() };
 
 		ren->setColor( ColorA( 1, 0.45f, 1, 0.4f ) );
 		ren->drawSolidRect( verticalBar );
 	}
 
-	if( mDrawValueAtMouse && mBinUnderMouse.x >= 0 && mBinUnderMouse.y >= 0 ) {
+	if( mDrawValueAtMouse && mCache && mBinUnderMouse.x >= 0 && mBinUnderMouse.y >= 0 ) {
 		// draw the magnitude and frequency at that bin
-		float magLinear = mSTFT[mBinUnderMouse.x][mBinUnderMouse.y];
+		float magLinear = mCache->getValue( mBinUnderMouse.x, mBinUnderMouse.y );
 		float magDb = ci::audio::linearToDecibel( magLinear ) / 100.0f;
 
 		string valueStr = fmt::format( "[{}, {}] mag linear: {:.6f}, db: {:.6f}", mBinUnderMouse.x, mBinUnderMouse.y, magLinear, magDb );
@@ -608,11 +648,19 @@ bool AudioSpectrogramView::touchesMoved( app::TouchEvent &event )
 
 void AudioSpectrogramView::setTrackPos( float x )
 {
+	if( mLiveEnabled )
+		return;
+
 	auto track = ma::audio::analyzer()->getTrack( mTrackIndex );
 	if( ! track )
 		return;
 
-	double time = track->getSampleDuration() * x / getWidth();
+	double pos = x / getWidth();
+	if( mCache ) {
+		pos = ( mVisibleBeginFrame + pos * ( mVisibleEndFrame - mVisibleBeginFrame ) ) / double( mCache->getNumFrames() );
+	}
+
+	double time = track->getSampleDuration() * pos;
 	glm::clamp<double>( time, 0.0, track->getSamplePlaybackTime() );
 
 	// TODO: refactor AudioAnalyzer so that individual tracks can be seeked
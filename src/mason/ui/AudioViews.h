@@ -30,6 +30,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 // TODO: decouple these views from AudioAnalyzer
 #include "mason/audio/AudioAnalyzer.h"
+#include "mason/audio/SpectrogramCache.h"
+#include "mason/audio/WaveformPyramid.h"
 
 // note: using namespace mason::mui so as not to conflict with vu::*. Oh well..
 namespace mason { namespace mui {
@@ -39,17 +41,26 @@ using AudioSpectrumViewRef		= std::shared_ptr<class AudioSpectrumView>;
 using AudioSpectrogramViewRef	= std::shared_ptr<class AudioSpectrogramView>;
 using AudioBarkBandsViewRef		= std::shared_ptr<class AudioFrequencyBandsView>;
 
-//! Displays the entire contents of an audio::Buffer as a waveform plot.
+//! Displays the contents of an audio::Buffer as a min / max / RMS waveform plot.
+//! A WaveformPyramid is built for each channel on load, drawing picks the level that matches the current zoom so long files stay interactive.
 // TODO: support calling load() methods async
 class MA_API AudioBufferView : public ::vu::View {
   public:
 	AudioBufferView( const ci::Rectf &bounds = ci::Rectf::zero() );
 
+	//! Copies \a samples and displays them as a single channel.
 	// TODO: make this overload take float* + count, so it is more generic
 	void load( const std::vector<float> &samples, size_t pixelsPerVertex = 2 );
-
+	//! Displays all channels of \a buffer, which is retained for drawing when zoomed in further than the pyramid's finest level.
 	void load( const ci::audio::BufferRef &buffer, size_t pixelsPerVertex = 2 );
 
+	//! Limits the displayed frames to [\a beginFrame, \a endFrame). An empty range shows the entire buffer.
+	void setVisibleRange( size_t beginFrame, size_t endFrame );
+	size_t getVisibleBeginFrame() const	{ return mVisibleBeginFrame; }
+	size_t getVisibleEndFrame() const	{ return mVisibleEndFrame; }
+	//! Returns the number of frames in the loaded buffer, or 0 if nothing is loaded.
+	size_t getNumFrames() const			{ return mBuffer ? mBuffer->getNumFrames() : 0; }
+
 	void setTitle( const std::string &title );
 
 	//void enableScaleDecibels( bool b = true )	{ mScaleDecibels = b; }
@@ -67,19 +78,25 @@ class MA_API AudioBufferView : public ::vu::View {
 	void draw( ::vu::Renderer *ren ) override;
 
   private:
-	enum CalcMode { MIN_MAX, AVERAGE };
-
-	void loadWaveform( const float *samples, size_t numSamples, const ci::vec2 &waveSize, size_t pixelsPerVertex, CalcMode mode );
+	void updateWaveformMeshes();
 
 	//bool					mScaleDecibels = false;
 	bool					mBorderEnabled = true;
 	//bool					mDrawValueAtMouse = true;
 	ci::ColorA				mBorderColor = ci::ColorA( 0.5f, 0.5f, 0.5f, 1 );
 	ci::ColorA				mColorMinMax = ci::ColorA::gray( 0.5f );
-	ci::ColorA				mColorAverage = ci::ColorA::gray( 0.75f );
+	ci::ColorA				mColorRms = ci::ColorA::gray( 0.75f );
 	vu::LabelRef			mTitleLabel;
 
-	std::vector<ci::gl::VboMeshRef>	mWaveformVbos;
+	ci::audio::BufferRef						mBuffer;
+	std::vector<ma::audio::WaveformPyramidRef>	mPyramids; // one per channel
+	size_t										mPixelsPerVertex = 2;
+	size_t										mVisibleBeginFrame = 0;
+	size_t										mVisibleEndFrame = 0;
+	bool										mMeshesDirty = false;
+
+	std::vector<ci::gl::VboMeshRef>	mWaveformVbos; // min / max and RMS triangle strips for each channel
+	std::vector<ci::vec2>			mVertices;
 };
 
 //! Shows one frame of the magnitude spectrum
@@ -124,6 +141,9 @@ private:
 };
 
 //! Shows the magnitude spectrum of an entire audio::Source
+//! The STFT is cached on disk in build/audio/ and memory mapped, so reopening a previously analyzed file doesn't read it in up front.
+//! Frames are uploaded as rows of linear magnitudes, decibel scaling and coloring happen in a shader. When live, each update()
+//! writes the Track's current spectrum as one row into a ring buffer texture, so the cost per frame doesn't depend on history length.
 class MA_API AudioSpectrogramView : public ::vu::View {
 public:
 	AudioSpectrogramView( int trackIndex, const ci::Rectf &bounds = ci::Rectf::zero() );
@@ -132,6 +152,20 @@ public:
 
 	void update( const audio::TrackRef &track );
 
+	//! Limits the displayed STFT frames to [\a beginFrame, \a endFrame), only this range is read when the texture is rebuilt. An empty range shows all frames.
+	void setVisibleFrameRange( size_t beginFrame, size_t endFrame );
+	size_t getVisibleBeginFrame() const	{ return mVisibleBeginFrame; }
+	size_t getVisibleEndFrame() const	{ return mVisibleEndFrame; }
+	//! Returns the number of STFT frames, or 0 if nothing is loaded.
+	size_t getNumFrames() const			{ return mCache ? mCache->getNumFrames() : 0; }
+
+	//! Sets whether the Track's live magnitude spectrum is shown, appending one frame per update(), instead of the loaded STFT.
+	void setLiveEnabled( bool enable );
+	bool isLiveEnabled() const			{ return mLiveEnabled; }
+	//! Sets how many frames are shown when live. Defaults to 512.
+	void setNumLiveFrames( size_t numFrames );
+	size_t getNumLiveFrames() const		{ return mNumLiveFrames; }
+
 protected:
 	void draw( ::vu::Renderer *ren ) override;
 	bool touchesBegan( ci::app::TouchEvent &event )	override;
@@ -140,13 +174,23 @@ protected:
 
 private:
 	void makeTex();
-	bool readSTFTFromDisk( const ci::fs::path &sampleName );
-	void writeSTFTToDisk( const ci::fs::path &sampleName );
+	void appendLiveFrame( const std::vector<float> &magSpectrum );
 	void setTrackPos( float x );
-
-	std::vector<std::vector<float>>	mSTFT; // actual analysis data
-	ci::gl::TextureRef				mTex;
+	size_t frameAtPos( float x ) const;
+
+	ma::audio::SpectrogramCacheRef	mCache; // actual analysis data
+	ci::gl::TextureRef				mTex; // one frame per row (R32F, numBins wide), a ring buffer when live
+	size_t							mTexWriteRow = 0;
+	size_t							mTexNumRows = 0; // rows that hold frames
+	size_t							mVisibleBeginFrame = 0;
+	size_t							mVisibleEndFrame = 0;
 	ma::ColorLUT<ci::ColorAf>		mLUT;
+	ci::gl::TextureRef				mLutTex;
+	ci::gl::GlslProgRef				mGlsl;
+	ci::signals::ScopedConnection	mConnGlsl;
+
+	bool				mLiveEnabled = false;
+	size_t				mNumLiveFrames = 512;
 
 	bool				mDrawValueAtMouse = true;
 	ci::ivec2			mBinUnderMouse = { -1, -1 };
@@ -0,0 +1,476 @@
+#include "AudioBenchmarkTest.h"
+
+#include "mason/audio/AudioAnalyzer.h"
+#include "mason/audio/CompressorNode.h"
+#include "mason/audio/Effects.h"
+#include "mason/audio/Gens.h"
+#include "mason/audio/OfflineContext.h"
+
+#include "cinder/audio/ChannelRouterNode.h"
+#include "cinder/audio/GainNode.h"
+#include "cinder/audio/GenNode.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Log.h"
+#include "cinder/Timer.h"
+
+#include "fmt/format.h"
+
+#include <thread>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+const size_t FRAMES_PER_BLOCK = 512;
+const double SECONDS_TO_RENDER = 20;
+
+// Renders SECONDS_TO_RENDER of audio and returns the wall-clock seconds it took.
+double renderSeconds( const ma::audio::OfflineContextRef &ctx )
+{
+	Timer timer( true );
+	ctx->renderBlocks( size_t( SECONDS_TO_RENDER * ctx->getSampleRate() ), []( const audio::Buffer &, size_t, size_t ) {} );
+	return timer.getSeconds();
+}
+
+ma::audio::OfflineContextRef makeContext( size_t numChannels )
+{
+	auto ctx = make_shared<ma::audio::OfflineContext>();
+	ctx->setOuputNumChannels( numChannels );
+	ctx->setFramesPerBlock( FRAMES_PER_BLOCK );
+	return ctx;
+}
+
+// Returns the seconds to render noise through \a numChannels of FilterNodeT, either as one multichannel node or one mono node per channel.
+// When \a ramp is true the cutoff ramps for the entire render, which forces per-sample coefficients.
+template <typename FilterNodeT>
+double benchFilter( size_t numChannels, bool multichannel, bool ramp )
+{
+	auto ctx = makeContext( numChannels );
+	auto noise = ctx->makeNode<audio::GenNoiseNode>();
+
+	vector<shared_ptr<FilterNodeT>> filters;
+	if( multichannel ) {
+		auto filter = ctx->makeNode<FilterNodeT>( audio::Node::Format().channels( numChannels ) );
+		noise >> filter >> ctx->getOutput();
+		filters.push_back( filter );
+	}
+	else {
+		auto router = ctx->makeNode<audio::ChannelRouterNode>( audio::Node::Format().channels( numChannels ) );
+		for( size_t ch = 0; ch < numChannels; ch++ ) {
+			auto filter = ctx->makeNode<FilterNodeT>( audio::Node::Format().channels( 1 ) );
+			noise >> filter >> router->route( 0, ch );
+			filters.push_back( filter );
+		}
+		router >> ctx->getOutput();
+	}
+
+	for( auto &filter : filters ) {
+		filter->setFreq( 200 );
+		if( ramp ) {
+			filter->getParamFreq()->applyRamp( 5000, (float)SECONDS_TO_RENDER );
+		}
+	}
+
+	noise->enable();
+	ctx->enable();
+
+	return renderSeconds( ctx );
+}
+
+// Cost of the noise source and output alone, subtracted from the filter timings.
+double benchBaseline( size_t numChannels )
+{
+	auto ctx = makeContext( numChannels );
+	auto noise = ctx->makeNode<audio::GenNoiseNode>();
+	noise >> ctx->getOutput();
+
+	noise->enable();
+	ctx->enable();
+
+	return renderSeconds( ctx );
+}
+
+// Largest absolute sample difference allowed between the approximate and reference compressor gain computers (-100 dBFS).
+const float COMPRESSOR_MAX_ERROR = 1e-5f;
+
+struct CompressorSettings {
+	const char	*mName;
+	float		mThreshold, mRatio, mKnee, mAttackTime, mReleaseTime, mMix;
+};
+
+const CompressorSettings COMPRESSOR_SETTINGS[] = {
+	{ "default", -24, 12, 30, 0.003f, 0.25f, 1 },
+	{ "limiter", -50, 20, 0, 0.0005f, 0.05f, 1 },
+	{ "gentle", -10, 2, 6, 0.01f, 0.5f, 0.5f }
+};
+
+ma::audio::CompressorNodeRef makeCompressor( const ma::audio::OfflineContextRef &ctx, const CompressorSettings &settings, size_t numChannels, bool approximate )
+{
+	auto compressor = ctx->makeNode<ma::audio::CompressorNode>( ma::audio::CompressorNode::Format().channels( numChannels ).approximations( approximate ) );
+	compressor->getParamThreshold()->setValue( settings.mThreshold );
+	compressor->getParamRatio()->setValue( settings.mRatio );
+	compressor->getParamKnee()->setValue( settings.mKnee );
+	compressor->getParamAttackTime()->setValue( settings.mAttackTime );
+	compressor->getParamReleaseTime()->setValue( settings.mReleaseTime );
+	compressor->getParamMix()->setValue( settings.mMix );
+	return compressor;
+}
+
+// Noise with its gain swept by a slow triangle LFO between -0.7 and 0.7 (about -3 dB, inverted on the negative half), passing through silence
+// at each zero crossing, so the compressor goes through attack, release and idle.
+audio::NodeRef makeCompressorSource( const ma::audio::OfflineContextRef &ctx )
+{
+	auto noise = ctx->makeNode<audio::GenNoiseNode>();
+	auto lfo = ctx->makeNode<audio::GenTriangleNode>( 0.7f );
+	auto lfoGain = ctx->makeNode<audio::GainNode>( 0.7f );
+	auto gain = ctx->makeNode<audio::GainNode>();
+
+	gain->getParam()->setProcessor( lfo >> lfoGain );
+	noise >> gain;
+
+	noise->enable();
+	lfo->enable();
+	return gain;
+}
+
+// Renders the same input through an approximate and a reference CompressorNode, side by side in one context so they see identical noise.
+// Returns the max and RMS difference over all channels.
+pair<float, float> compressorError( const CompressorSettings &settings, size_t numChannels )
+{
+	auto ctx = makeContext( numChannels * 2 );
+	auto source = makeCompressorSource( ctx );
+	auto router = ctx->makeNode<audio::ChannelRouterNode>( audio::Node::Format().channels( numChannels * 2 ) );
+
+	source >> makeCompressor( ctx, settings, numChannels, true ) >> router->route( 0, 0, numChannels );
+	source >> makeCompressor( ctx, settings, numChannels, false ) >> router->route( 0, numChannels, numChannels );
+	router >> ctx->getOutput();
+	ctx->enable();
+
+	float maxError = 0;
+	double sumSquares = 0;
+	size_t numSamples = 0;
+	ctx->renderBlocks( size_t( SECONDS_TO_RENDER * ctx->getSampleRate() ), [&]( const audio::Buffer &buffer, size_t numFrames, size_t ) {
+		for( size_t ch = 0; ch < numChannels; ch++ ) {
+			const float *approximate = buffer.getChannel( ch );
+			const float *reference = buffer.getChannel( ch + numChannels );
+			for( size_t i = 0; i < numFrames; i++ ) {
+				float error = fabsf( approximate[i] - reference[i] );
+				maxError = std::max( maxError, error );
+				sumSquares += error * error;
+			}
+		}
+		numSamples += numFrames * numChannels;
+	} );
+
+	return { maxError, float( sqrt( sumSquares / std::max<size_t>( 1, numSamples ) ) ) };
+}
+
+double benchCompressor( const CompressorSettings &settings, size_t numChannels, bool approximate )
+{
+	auto ctx = makeContext( numChannels );
+	makeCompressorSource( ctx ) >> makeCompressor( ctx, settings, numChannels, approximate ) >> ctx->getOutput();
+	ctx->enable();
+
+	return renderSeconds( ctx );
+}
+
+double benchCompressorBaseline( size_t numChannels )
+{
+	auto ctx = makeContext( numChannels );
+	makeCompressorSource( ctx ) >> ctx->getOutput();
+	ctx->enable();
+
+	return renderSeconds( ctx );
+}
+
+// Number of generators summed into the output, roughly what a generative sound bed runs.
+const size_t NUM_NOISE_NODES = 32;
+
+// Returns the samples per second generated when rendering NUM_NOISE_NODES instances of NoiseNodeT summed into a mono output.
+template <typename NoiseNodeT>
+double benchNoise()
+{
+	auto ctx = makeContext( 1 );
+	for( size_t i = 0; i < NUM_NOISE_NODES; i++ ) {
+		auto noise = ctx->makeNode<NoiseNodeT>();
+		noise >> ctx->getOutput();
+		noise->enable();
+	}
+
+	ctx->enable();
+
+	double seconds = renderSeconds( ctx );
+	return NUM_NOISE_NODES * SECONDS_TO_RENDER * ctx->getSampleRate() / seconds;
+}
+
+// Writes SECONDS_TO_RENDER of stereo pink noise to a temporary file for the analyzer tracks to play.
+fs::path writeAnalyzerTestFile()
+{
+	auto ctx = makeContext( 2 );
+	auto noise = ctx->makeNode<ma::audio::GenPinkNoiseNode>();
+	auto gain = ctx->makeNode<audio::GainNode>( 0.5f );
+	noise >> gain >> ctx->getOutput();
+	noise->enable();
+	ctx->enable();
+
+	auto filePath = fs::temp_directory_path() / "mason_analyzer_bench.wav";
+	ctx->renderToFile( SECONDS_TO_RENDER, filePath );
+	return filePath;
+}
+
+// Returns the seconds to analyze SECONDS_TO_RENDER of \a numTracks buffer tracks with a headless AudioAnalyzer, calling update() at 60hz.
+// \a meanVolume is set to the average RMS volume of the first track over all updates, as a sanity check that the pipeline ran.
+double benchAnalyzer( const fs::path &filePath, size_t numTracks, bool features, float *meanVolume )
+{
+	auto ctx = make_shared<ma::audio::OfflineContext>();
+	auto analyzer = make_shared<ma::audio::AudioAnalyzer>( ma::audio::AudioAnalyzer::Options().context( ctx ).keyboardShortcuts( false ) );
+	analyzer->getSignalResolvePath().connect( []( const string &url ) { return fs::path( url ); } );
+
+	ma::Info featuresInfo;
+	featuresInfo.set( "enabled", features );
+
+	vector<ma::Info> tracks;
+	for( size_t i = 0; i < numTracks; i++ ) {
+		ma::Info trackInfo;
+		trackInfo.set( "id", fmt::format( "track {}", i ) );
+		trackInfo.set( "gain", 1.0f );
+		trackInfo.set( "inputType", string( "buffer" ) );
+		trackInfo.set( "fileName", filePath.string() );
+		tracks.push_back( trackInfo );
+	}
+
+	ma::Info config;
+	config.set( "enabled", true );
+	config.set( "framesPerBlock", FRAMES_PER_BLOCK );
+	config.set( "features", featuresInfo );
+	config.set( "tracks", tracks );
+
+	analyzer->initialize( config );
+	analyzer->play();
+
+	float volumeSum = 0;
+	size_t numUpdates = 0;
+	Timer timer( true );
+	analyzer->renderOffline( SECONDS_TO_RENDER, 1.0 / 60.0, [&] {
+		volumeSum += analyzer->getTracks().front()->getVolumeRMS();
+		numUpdates++;
+	} );
+	double seconds = timer.getSeconds();
+
+	*meanVolume = numUpdates ? volumeSum / numUpdates : 0;
+	return seconds;
+}
+
+// Number of filtered noise voices rendered in the OfflineContext benchmark.
+const size_t NUM_RENDER_VOICES = 16;
+
+// Builds NUM_RENDER_VOICES of filtered pink noise panned across a stereo output. When \a mixer is true the voices are summed by a
+// GainNode before the output, so the render has to split the graph above it to run them in parallel.
+ma::audio::OfflineContextRef makeRenderContext( bool mixer )
+{
+	auto ctx = makeContext( 2 );
+	auto mixerGain = ctx->makeNode<audio::GainNode>( 1.0f / NUM_RENDER_VOICES );
+	for( size_t i = 0; i < NUM_RENDER_VOICES; i++ ) {
+		auto noise = ctx->makeNode<ma::audio::GenPinkNoiseNode>();
+		auto filter = ctx->makeNode<ma::audio::MoogFilterNode>();
+		auto router = ctx->makeNode<audio::ChannelRouterNode>( audio::Node::Format().channels( 2 ) );
+		filter->setFreq( 200 + 100 * i );
+
+		noise >> filter >> router->route( 0, i % 2 );
+		if( mixer )
+			router >> mixerGain;
+		else
+			router >> ctx->getOutput();
+
+		noise->enable();
+	}
+
+	if( mixer )
+		mixerGain >> ctx->getOutput();
+
+	ctx->enable();
+	return ctx;
+}
+
+// Returns the seconds to pull SECONDS_TO_RENDER into a preallocated buffer, one block copied at a time.
+double benchPull( bool mixer )
+{
+	auto ctx = makeRenderContext( mixer );
+	audio::Buffer buffer( size_t( SECONDS_TO_RENDER * ctx->getSampleRate() ) / FRAMES_PER_BLOCK * FRAMES_PER_BLOCK, 2 );
+
+	Timer timer( true );
+	ctx->pull( &buffer );
+	return timer.getSeconds();
+}
+
+// Returns the seconds to render SECONDS_TO_RENDER with OfflineContext::render() on \a numThreads.
+double benchRenderThreads( bool mixer, size_t numThreads )
+{
+	auto ctx = makeRenderContext( mixer );
+	audio::BufferDynamic buffer;
+
+	Timer timer( true );
+	ctx->render( SECONDS_TO_RENDER, &buffer, numThreads );
+	return timer.getSeconds();
+}
+
+} // anonymous namespace
+
+AudioBenchmarkTest::AudioBenchmarkTest()
+{
+	mResults.push_back( "press 'f' to benchmark filters, 'c' to compare the compressor's approximate gain computer against the reference, 'n' to benchmark noise generators, 'a' to benchmark the headless AudioAnalyzer, 'r' to benchmark OfflineContext rendering" );
+}
+
+bool AudioBenchmarkTest::keyDown( app::KeyEvent &event )
+{
+	bool handled = true;
+	if( event.getChar() == 'f' ) {
+		benchFilters();
+	}
+	else if( event.getChar() == 'c' ) {
+		benchCompressors();
+	}
+	else if( event.getChar() == 'n' ) {
+		benchNoiseGenerators();
+	}
+	else if( event.getChar() == 'a' ) {
+		benchAudioAnalyzer();
+	}
+	else if( event.getChar() == 'r' ) {
+		benchRender();
+	}
+	else
+		handled = false;
+
+	return handled;
+}
+
+void AudioBenchmarkTest::benchFilters()
+{
+	mResults.clear();
+	mResults.push_back( fmt::format( "filters, {} seconds of audio, {} frames per block. cost is microseconds per channel per second of audio", SECONDS_TO_RENDER, FRAMES_PER_BLOCK ) );
+	mResults.push_back( "node         channels  params   multichannel  N mono    speedup" );
+
+	auto addResult = [this]( const string &name, size_t numChannels, bool ramp, double baseline, double multi, double mono ) {
+		double scale = 1e6 / ( numChannels * SECONDS_TO_RENDER );
+		double multiCost = std::max( 0.0, multi - baseline ) * scale;
+		double monoCost = std::max( 0.0, mono - baseline ) * scale;
+		string line = fmt::format( "{:<12} {:>8}  {:<8} {:>12.2f}  {:>8.2f}  {:>6.2f}x", name, numChannels, ramp ? "ramping" : "static", multiCost, monoCost, multiCost > 0 ? monoCost / multiCost : 0.0 );
+		CI_LOG_I( line );
+		mResults.push_back( line );
+	};
+
+	for( size_t numChannels : { 1, 2, 4, 8, 16 } ) {
+		double baseline = benchBaseline( numChannels );
+		for( bool ramp : { false, true } ) {
+			addResult( "MoogFilter", numChannels, ramp, baseline, benchFilter<ma::audio::MoogFilterNode>( numChannels, true, ramp ), benchFilter<ma::audio::MoogFilterNode>( numChannels, false, ramp ) );
+			addResult( "Vcf", numChannels, ramp, baseline, benchFilter<ma::audio::VcfNode>( numChannels, true, ramp ), benchFilter<ma::audio::VcfNode>( numChannels, false, ramp ) );
+		}
+	}
+}
+
+void AudioBenchmarkTest::benchCompressors()
+{
+	mResults.clear();
+	mResults.push_back( fmt::format( "CompressorNode approximate vs. reference, {} seconds of audio, {} frames per block, max error allowed: {}", SECONDS_TO_RENDER, FRAMES_PER_BLOCK, COMPRESSOR_MAX_ERROR ) );
+	mResults.push_back( "settings   channels   max error   rms error   reference (ms)  approximate (ms)  speedup" );
+
+	for( const auto &settings : COMPRESSOR_SETTINGS ) {
+		for( size_t numChannels : { 1, 2 } ) {
+			auto error = compressorError( settings, numChannels );
+			double baseline = benchCompressorBaseline( numChannels );
+			double reference = std::max( 0.0, benchCompressor( settings, numChannels, false ) - baseline ) * 1000;
+			double approximate = std::max( 0.0, benchCompressor( settings, numChannels, true ) - baseline ) * 1000;
+
+			string line = fmt::format( "{:<10} {:>8}   {:>9.2e}   {:>9.2e}   {:>14.2f}  {:>16.2f}  {:>6.2f}x", settings.mName, numChannels, error.first, error.second, reference, approximate, approximate > 0 ? reference / approximate : 0.0 );
+			if( error.first > COMPRESSOR_MAX_ERROR ) {
+				line += "  FAILED";
+				CI_LOG_E( line );
+			}
+			else
+				CI_LOG_I( line );
+
+			mResults.push_back( line );
+		}
+	}
+}
+
+void AudioBenchmarkTest::benchNoiseGenerators()
+{
+	mResults.clear();
+	mResults.push_back( fmt::format( "noise generators, {} nodes summed, {} seconds of audio, {} frames per block", NUM_NOISE_NODES, SECONDS_TO_RENDER, FRAMES_PER_BLOCK ) );
+	mResults.push_back( "generator              Msamples / second" );
+
+	auto addResult = [this]( const string &name, double samplesPerSecond ) {
+		string line = fmt::format( "{:<22} {:>10.1f}", name, samplesPerSecond / 1e6 );
+		CI_LOG_I( line );
+		mResults.push_back( line );
+	};
+
+	addResult( "ci::audio::GenNoise", benchNoise<audio::GenNoiseNode>() );
+	addResult( "GenWhiteNoise", benchNoise<ma::audio::GenWhiteNoiseNode>() );
+	addResult( "GenPinkNoise", benchNoise<ma::audio::GenPinkNoiseNode>() );
+	addResult( "GenBrownNoise", benchNoise<ma::audio::GenBrownNoiseNode>() );
+	addResult( "GenBlueNoise", benchNoise<ma::audio::GenBlueNoiseNode>() );
+	addResult( "PeriodicNoise", benchNoise<ma::audio::PeriodicNoiseNode>() );
+}
+
+void AudioBenchmarkTest::benchAudioAnalyzer()
+{
+	mResults.clear();
+	mResults.push_back( fmt::format( "headless AudioAnalyzer with buffer tracks, {} seconds of audio, {} frames per block, updated at 60hz", SECONDS_TO_RENDER, FRAMES_PER_BLOCK ) );
+	mResults.push_back( "tracks  features   realtime factor   mean volume" );
+
+	auto filePath = writeAnalyzerTestFile();
+	for( size_t numTracks : { 1, 4, 16 } ) {
+		for( bool features : { false, true } ) {
+			float meanVolume = 0;
+			double seconds = benchAnalyzer( filePath, numTracks, features, &meanVolume );
+
+			string line = fmt::format( "{:>6}  {:<8} {:>16.1f}x   {:>11.4f}", numTracks, features ? "on" : "off", SECONDS_TO_RENDER / seconds, meanVolume );
+			if( meanVolume <= 0 ) {
+				line += "  FAILED";
+				CI_LOG_E( line );
+			}
+			else
+				CI_LOG_I( line );
+
+			mResults.push_back( line );
+		}
+	}
+
+	fs::remove( filePath );
+}
+
+void AudioBenchmarkTest::benchRender()
+{
+	mResults.clear();
+	mResults.push_back( fmt::format( "OfflineContext, {} filtered noise voices, {} seconds of audio, {} frames per block. speedup is over pull()", NUM_RENDER_VOICES, SECONDS_TO_RENDER, FRAMES_PER_BLOCK ) );
+	mResults.push_back( "graph     method    threads   seconds   speedup" );
+
+	auto addResult = [this]( bool mixer, const string &method, size_t numThreads, double seconds, double pullSeconds ) {
+		string line = fmt::format( "{:<8}  {:<8} {:>8}  {:>8.3f}  {:>6.2f}x", mixer ? "mixer" : "output", method, numThreads, seconds, seconds > 0 ? pullSeconds / seconds : 0.0 );
+		CI_LOG_I( line );
+		mResults.push_back( line );
+	};
+
+	const size_t hardwareThreads = std::max<size_t>( 1, thread::hardware_concurrency() );
+	for( bool mixer : { false, true } ) {
+		double pullSeconds = benchPull( mixer );
+		addResult( mixer, "pull", 1, pullSeconds, pullSeconds );
+
+		for( size_t numThreads : { size_t( 1 ), size_t( 2 ), size_t( 4 ), hardwareThreads } ) {
+			addResult( mixer, "render", numThreads, benchRenderThreads( mixer, numThreads ), pullSeconds );
+		}
+	}
+}
+
+void AudioBenchmarkTest::draw( vu::Renderer *ren )
+{
+	vec2 pos( 20, 40 );
+	for( const auto &line : mResults ) {
+		gl::drawString( line, pos, Color::white(), Font( "Courier New", 16 ) );
+		pos.y += 20;
+	}
+}
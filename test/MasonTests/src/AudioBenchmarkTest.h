@@ -0,0 +1,26 @@
+#pragma once
+
+#include "vu/Suite.h"
+
+#include "mason/Mason.h"
+
+//! Offline benchmarks for mason's audio nodes. Press 'f' to compare multichannel filters against one mono node per channel,
+//! 'c' to check the CompressorNode's approximate gain computer against the reference implementation for error and speed,
+//! 'n' to measure the throughput of the noise generators, 'a' to run the full AudioAnalyzer track pipeline headless against an OfflineContext,
+//! 'r' to compare OfflineContext::render() on several threads against pulling the graph one block at a time.
+class AudioBenchmarkTest : public vu::SuiteView {
+  public:
+	AudioBenchmarkTest();
+
+	bool keyDown( ci::app::KeyEvent &event ) override;
+	void draw( vu::Renderer *ren )	override;
+
+  private:
+	void benchFilters();
+	void benchCompressors();
+	void benchNoiseGenerators();
+	void benchAudioAnalyzer();
+	void benchRender();
+
+	std::vector<std::string>	mResults;
+};
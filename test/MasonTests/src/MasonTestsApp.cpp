@@ -10,6 +10,7 @@
 #include "mason/Assets.h"
 #include "mason/Profiling.h"
 
+#include "AudioBenchmarkTest.h"
 #include "HudTest.h"
 #include "MiscTest.h"
 
@@ -50,6 +51,7 @@ void MasonTestsApp::setup()
 
 	mSuite->registerSuiteView<HudTest>( "hud" );
 	mSuite->registerSuiteView<MiscTest>( "misc" );
+	mSuite->registerSuiteView<AudioBenchmarkTest>( "audio bench" );
 
 	mSuite->getSignalSuiteViewWillChange().connect( [this] {
 		CI_LOG_I( "selecting test: " << mSuite->getCurrentKey() );
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2020, Richard Eakin - All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided
+ that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this list of conditions and
+ the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+// Headless batch analysis of a directory of audio files.
+//
+// usage: AudioBatchAnalyzer <input dir> [output dir] [options]
+//   --threads N      number of worker threads (default: hardware concurrency)
+//   --fft N          fft size (default: 2048)
+//   --window N       window size (default: 2048)
+//   --hop N          hop size (default: 512)
+//   --block N        frames per OfflineContext pull (default: 8192)
+//   --mfcc N         number of MFCC coefficients (default: 13)
+//   --recursive      search sub-directories for audio files
+//   --no-spectrogram don't write the magnitude spectrogram
+//
+// Writes one '.maaf' file per input, mirroring the input directory's layout, see mason::audio::AnalysisFileHeader for the format.
+
+#include "mason/Mason.h"
+#include "mason/audio/BatchAnalysis.h"
+
+#include "cinder/Timer.h"
+
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+using namespace ci;
+using namespace std;
+
+namespace {
+
+void printUsage()
+{
+	cout << "usage: AudioBatchAnalyzer <input dir> [output dir] [--threads N] [--fft N] [--window N] [--hop N] [--block N] [--mfcc N] [--recursive] [--no-spectrogram]" << endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	if( argc < 2 ) {
+		printUsage();
+		return 1;
+	}
+
+	fs::path inputDir;
+	fs::path outputDir;
+	size_t numThreads = 0;
+	bool recursive = false;
+	ma::audio::AnalysisOptions options;
+
+	try {
+		for( int i = 1; i < argc; i++ ) {
+			string arg = argv[i];
+			auto nextValue = [&]() -> size_t {
+				if( i + 1 >= argc )
+					throw invalid_argument( "missing value for " + arg );
+				return (size_t)stoul( argv[++i] );
+			};
+
+			if( arg == "--threads" )
+				numThreads = nextValue();
+			else if( arg == "--fft" )
+				options.mFftSize = nextValue();
+			else if( arg == "--window" )
+				options.mWindowSize = nextValue();
+			else if( arg == "--hop" )
+				options.mHopSize = nextValue();
+			else if( arg == "--block" )
+				options.mFramesPerBlock = nextValue();
+			else if( arg == "--mfcc" )
+				options.mNumMfccCoeffs = nextValue();
+			else if( arg == "--recursive" )
+				recursive = true;
+			else if( arg == "--no-spectrogram" )
+				options.mWriteSpectrogram = false;
+			else if( arg == "--help" || arg == "-h" ) {
+				printUsage();
+				return 0;
+			}
+			else if( inputDir.empty() )
+				inputDir = arg;
+			else if( outputDir.empty() )
+				outputDir = arg;
+			else
+				throw invalid_argument( "unexpected argument: " + arg );
+		}
+	}
+	catch( exception &exc ) {
+		cerr << "error: " << exc.what() << endl;
+		printUsage();
+		return 1;
+	}
+
+	if( ! fs::is_directory( inputDir ) ) {
+		cerr << "error: input directory doesn't exist: " << inputDir << endl;
+		return 1;
+	}
+
+	if( outputDir.empty() )
+		outputDir = inputDir / "analysis";
+
+	auto audioFiles = ma::audio::findAudioFiles( inputDir, recursive );
+	cout << "analyzing " << audioFiles.size() << " files from " << inputDir << " into " << outputDir << endl;
+
+	mutex printMutex;
+	auto printResult = [&printMutex]( const ma::audio::AnalysisResult &result ) {
+		lock_guard<mutex> lock( printMutex );
+		if( result.mSucceeded ) {
+			cout << fixed << setprecision( 2 ) << result.mInputPath.filename().string()
+				<< ": " << result.mAudioSeconds << "s audio in " << result.mProcessSeconds << "s (" << result.getRealtimeFactor() << "x realtime)"
+				<< ", frames: " << result.mNumFrames << ", onsets: " << result.mNumOnsets << endl;
+		}
+		else {
+			cerr << result.mInputPath.filename().string() << ": failed - " << result.mError << endl;
+		}
+	};
+
+	Timer timer( true );
+	auto results = ma::audio::analyzeFiles( audioFiles, outputDir, options, numThreads, printResult );
+	double totalSeconds = timer.getSeconds();
+
+	double totalAudioSeconds = 0;
+	size_t numFailed = 0;
+	for( const auto &result : results ) {
+		totalAudioSeconds += result.mAudioSeconds;
+		if( ! result.mSucceeded )
+			numFailed++;
+	}
+
+	cout << fixed << setprecision( 2 ) << "done. " << totalAudioSeconds << "s of audio in " << totalSeconds << "s ("
+		<< ( totalSeconds > 0 ? totalAudioSeconds / totalSeconds : 0 ) << "x realtime), failed: " << numFailed << endl;
+
+	return numFailed == 0 ? 0 : 1;
+}